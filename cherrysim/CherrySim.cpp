@@ -38,6 +38,7 @@
 #include <malloc.h>
 #include <algorithm>
 #include <thread>
+#include <mutex>
 #include <sstream>
 #include <fstream>
 #include <iostream>
@@ -102,9 +103,9 @@ using json = nlohmann::json;
 // These values may not change while simulating a node.
 //#########################################################################################
 
-CherrySim* cherrySimInstance = nullptr; // Use this to access the simulator from C functions
-NRF_UART_Type* simUartPtr = nullptr;
-bool meshGwCommunication = false;
+SIM_THREAD_LOCAL CherrySim* cherrySimInstance = nullptr; // Use this to access the simulator from C functions, each thread has its own instance
+SIM_THREAD_LOCAL NRF_UART_Type* simUartPtr = nullptr;
+SIM_THREAD_LOCAL bool meshGwCommunication = false;
 
 //This is normally populated by the linker script when compiling FruityMesh,
 //Sadly, this must be done manually for the simulator. Include all the connection resolvers used
@@ -307,13 +308,12 @@ CherrySim::CherrySim(const SimConfiguration &simConfig)
 {
 #ifdef CI_PIPELINE
     //Static is okay, as the seg fault handler works accross all simulations.
-    static bool segfaultHandlerSet = false;
-    if (!segfaultHandlerSet)
+    static std::once_flag segfaultHandlerSet;
+    std::call_once(segfaultHandlerSet, []()
     {
         signal(SIGSEGV, SegFaultHandler);
-        segfaultHandlerSet = true;
         printf("Segfault handler set!\n");
-    }
+    });
 #endif
 
     if (simConfig.replayPath != "")
@@ -324,10 +324,22 @@ CherrySim::CherrySim(const SimConfiguration &simConfig)
         SIMEXCEPTION(IllegalStateException);
 #endif
         auto replayPath = simConfig.replayPath;
-        const std::string replayFileContents = LoadFileContents(simConfig.replayPath.c_str());
-        CheckVersionFromReplayRecord(replayFileContents);
-        replayRecordEntries = ExtractReplayRecord(replayFileContents);
-        this->simConfig = ExtractSimConfigurationFromReplayRecord(replayFileContents);
+        if (IsBinaryReplayRecord(replayPath))
+        {
+            BinaryReplayRecord record = LoadBinaryReplayRecord(replayPath);
+            for (ReplayRecordEntry& entry : record.entries)
+            {
+                replayRecordEntries.push(std::move(entry));
+            }
+            this->simConfig = record.config;
+        }
+        else
+        {
+            const std::string replayFileContents = LoadFileContents(simConfig.replayPath.c_str());
+            CheckVersionFromReplayRecord(replayFileContents);
+            replayRecordEntries = ExtractReplayRecord(replayFileContents);
+            this->simConfig = ExtractSimConfigurationFromReplayRecord(replayFileContents);
+        }
         this->simConfig.replayPath = replayPath; //Overwrite the replay path so that we know that we are currently in a replay
         if (this->simConfig.storeFlashToFile != "")
         {
@@ -429,7 +441,7 @@ void CherrySim::Init()
         LoadPresetNodePositions();
     }
 
-    server = new FruitySimServer();
+    if (simConfig.startServer) server = new FruitySimServer();
 }
 
 //This will load the site data from a json and will read the device json to import all devices
@@ -439,22 +451,11 @@ void CherrySim::ImportDataFromJson()
     json siteJson;
     json devicesJson;
 
-    if (simConfig.replayPath != "")
-    {
-        const std::string replayFileContents = LoadFileContents(simConfig.replayPath.c_str());
-        siteJson    = nlohmann::json::parse(ExtractAndCleanReplayToken(replayFileContents, "[!]SITE START:[!]",    "[!]SITE END[!]"));
-        devicesJson = nlohmann::json::parse(ExtractAndCleanReplayToken(replayFileContents, "[!]DEVICES START:[!]", "[!]DEVICES END[!]"));
-    }
-    else
-    {
-        //Load the site json
-        std::ifstream siteJsonStream(simConfig.siteJsonPath);
-        siteJsonStream >> siteJson;
-
-        //Load the devices json
-        std::ifstream devicesJsonStream(simConfig.devicesJsonPath);
-        devicesJsonStream >> devicesJson;
-    }
+    std::string siteString;
+    std::string devicesString;
+    LoadReplaySiteAndDevices(siteString, devicesString);
+    siteJson    = nlohmann::json::parse(siteString);
+    devicesJson = nlohmann::json::parse(devicesString);
 
     if (simConfig.logReplayCommands)
     {
@@ -513,17 +514,10 @@ void CherrySim::ImportPositionsFromJson()
 {
     json devicesJson;
 
-    if (simConfig.replayPath != "")
-    {
-        const std::string replayFileContents = LoadFileContents(simConfig.replayPath.c_str());
-        devicesJson = nlohmann::json::parse(ExtractAndCleanReplayToken(replayFileContents, "[!]DEVICES START:[!]", "[!]DEVICES END[!]"));
-    }
-    else
-    {
-        //Load the devices json
-        std::ifstream devicesJsonStream(simConfig.devicesJsonPath);
-        devicesJsonStream >> devicesJson;
-    }
+    std::string siteString;
+    std::string devicesString;
+    LoadReplaySiteAndDevices(siteString, devicesString);
+    devicesJson = nlohmann::json::parse(devicesString);
 
     //Get other data from our devices
     int j = 0;
@@ -670,6 +664,9 @@ std::queue<ReplayRecordEntry> CherrySim::ExtractReplayRecord(const std::string &
     const std::string commandStartPattern = "[!]COMMAND EXECUTION START:[!]";
     const std::string commandEndPattern = "[!]COMMAND EXECUTION END[!]";
 
+    //Building the regex is expensive compared to matching it, so it is only done once.
+    static const std::regex commandRegex("index:(\\d+),time:(\\d+),cmd:(.+)$");
+
     std::vector<ReplayRecordEntry> replayRecordEntries;
 
     size_t commandStartIndex = 0;
@@ -684,10 +681,8 @@ std::queue<ReplayRecordEntry> CherrySim::ExtractReplayRecord(const std::string &
             SIMEXCEPTION(IllegalArgumentException);
         }
 
-        std::string commandWithMeta = fileContents.substr(commandStartIndex, commandEndIndex - commandStartIndex);
-        std::regex reg("index:(\\d+),time:(\\d+),cmd:(.+)$");
         std::smatch matches;
-        if (std::regex_search(commandWithMeta, matches, reg) && matches.size() == 4)
+        if (std::regex_search(fileContents.cbegin() + commandStartIndex, fileContents.cbegin() + commandEndIndex, matches, commandRegex) && matches.size() == 4)
         {
             ReplayRecordEntry entry;
             entry.index = Utility::StringToU32(matches[1].str().c_str());
@@ -706,7 +701,8 @@ std::queue<ReplayRecordEntry> CherrySim::ExtractReplayRecord(const std::string &
 
     //Although the vector is probably already sorted, it is probably better to
     //make sure as features like jittering might disturb the vector a little.
-    std::sort(replayRecordEntries.begin(), replayRecordEntries.end());
+    //The sort must be stable to keep the order of commands for the same time.
+    std::stable_sort(replayRecordEntries.begin(), replayRecordEntries.end());
 
     std::queue<ReplayRecordEntry> retVal;
     for (size_t i = 0; i < replayRecordEntries.size(); i++)
@@ -766,6 +762,317 @@ void CherrySim::CheckVersionFromReplayRecord(const std::string &fileContents)
     }
 }
 
+//A binary replay record consists of the following parts:
+//  BinaryReplayHeader
+//  configuration, site and devices json (lengths given in the header)
+//  BinaryReplayIndexEntry[entryCount] sorted by time, commands of the same time keep their execution order
+//  BinaryReplayNodeTableEntry[nodeCount] sorted by the node index
+//  u32[entryCount] positions inside the index, grouped by node, each group sorted by time
+//  the commands, stored in the same order as the index
+//The commands of a time window are therefore stored next to each other and can be found with
+//a binary search in the index, without reading the rest of the file.
+static constexpr char BINARY_REPLAY_MAGIC[8] = { 'F', 'M', 'R', 'E', 'P', 'L', 'A', 'Y' };
+static constexpr u32 BINARY_REPLAY_FORMAT_VERSION = 1;
+
+#pragma pack(push, 1)
+struct BinaryReplayHeader
+{
+    char magic[8];
+    u32 formatVersion;
+    u32 fmVersion;
+    u32 configLength;
+    u32 siteLength;
+    u32 devicesLength;
+    u32 entryCount;
+    u32 nodeCount;
+    u32 commandsLength;
+};
+struct BinaryReplayIndexEntry
+{
+    u32 time;
+    u32 nodeIndex;
+    u32 commandOffset; //Relative to the start of the commands
+    u32 commandLength : 31;
+    u32 skipCrcCheck  : 1;
+};
+struct BinaryReplayNodeTableEntry
+{
+    u32 nodeIndex;
+    u32 firstPosition;
+    u32 amountOfPositions;
+};
+#pragma pack(pop)
+static_assert(sizeof(BinaryReplayHeader) == 40, "Binary replay header has the wrong size");
+static_assert(sizeof(BinaryReplayIndexEntry) == 16, "Binary replay index entry has the wrong size");
+
+template<typename T>
+static void ReadBinaryReplayData(std::ifstream& file, T* data, size_t amount)
+{
+    file.read((char*)data, sizeof(T) * amount);
+    if (!file)
+    {
+        //The file is shorter than announced by its header.
+        SIMEXCEPTION(FileException);
+    }
+}
+
+static std::string ReadBinaryReplayString(std::ifstream& file, u32 length)
+{
+    std::string retVal(length, '\0');
+    if (length > 0) ReadBinaryReplayData(file, &retVal[0], length);
+    return retVal;
+}
+
+bool CherrySim::IsBinaryReplayRecord(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    char magic[sizeof(BINARY_REPLAY_MAGIC)] = {};
+    file.read(magic, sizeof(magic));
+    return file && memcmp(magic, BINARY_REPLAY_MAGIC, sizeof(magic)) == 0;
+}
+
+void CherrySim::StoreBinaryReplayRecord(const std::string& path, const BinaryReplayRecord& record)
+{
+    const std::string configString = nlohmann::json(record.config).dump();
+
+    std::vector<BinaryReplayIndexEntry> index;
+    index.reserve(record.entries.size());
+    std::map<u32, std::vector<u32>> nodePositions;
+    u32 commandsLength = 0;
+    for (size_t i = 0; i < record.entries.size(); i++)
+    {
+        const ReplayRecordEntry& entry = record.entries[i];
+        if (i > 0 && entry.time < record.entries[i - 1].time)
+        {
+            //Entries must be given in the order of their execution.
+            SIMEXCEPTION(IllegalArgumentException);
+            return;
+        }
+        BinaryReplayIndexEntry indexEntry;
+        indexEntry.time = entry.time;
+        indexEntry.nodeIndex = entry.index;
+        indexEntry.commandOffset = commandsLength;
+        indexEntry.commandLength = (u32)entry.command.size();
+        indexEntry.skipCrcCheck = entry.skipCrcCheck ? 1 : 0;
+        index.push_back(indexEntry);
+        nodePositions[entry.index].push_back((u32)i);
+        commandsLength += (u32)entry.command.size();
+    }
+
+    std::vector<BinaryReplayNodeTableEntry> nodeTable;
+    std::vector<u32> positions;
+    positions.reserve(index.size());
+    for (const auto& node : nodePositions)
+    {
+        BinaryReplayNodeTableEntry nodeTableEntry;
+        nodeTableEntry.nodeIndex = node.first;
+        nodeTableEntry.firstPosition = (u32)positions.size();
+        nodeTableEntry.amountOfPositions = (u32)node.second.size();
+        nodeTable.push_back(nodeTableEntry);
+        positions.insert(positions.end(), node.second.begin(), node.second.end());
+    }
+
+    BinaryReplayHeader header;
+    memcpy(header.magic, BINARY_REPLAY_MAGIC, sizeof(header.magic));
+    header.formatVersion = BINARY_REPLAY_FORMAT_VERSION;
+    header.fmVersion = FM_VERSION;
+    header.configLength = (u32)configString.size();
+    header.siteLength = (u32)record.siteJson.size();
+    header.devicesLength = (u32)record.devicesJson.size();
+    header.entryCount = (u32)index.size();
+    header.nodeCount = (u32)nodeTable.size();
+    header.commandsLength = commandsLength;
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+    {
+        SIMEXCEPTION(FileException);
+        return;
+    }
+    file.write((const char*)&header, sizeof(header));
+    file.write(configString.data(), configString.size());
+    file.write(record.siteJson.data(), record.siteJson.size());
+    file.write(record.devicesJson.data(), record.devicesJson.size());
+    file.write((const char*)index.data(), index.size() * sizeof(BinaryReplayIndexEntry));
+    file.write((const char*)nodeTable.data(), nodeTable.size() * sizeof(BinaryReplayNodeTableEntry));
+    file.write((const char*)positions.data(), positions.size() * sizeof(u32));
+    for (const ReplayRecordEntry& entry : record.entries)
+    {
+        file.write(entry.command.data(), entry.command.size());
+    }
+}
+
+BinaryReplayRecord CherrySim::LoadBinaryReplayRecord(const std::string& path, u32 fromTimeMs, u32 toTimeMs, u32 nodeIndex)
+{
+    BinaryReplayRecord record;
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        SIMEXCEPTION(FileException);
+        return record;
+    }
+
+    BinaryReplayHeader header;
+    ReadBinaryReplayData(file, &header, 1);
+    if (memcmp(header.magic, BINARY_REPLAY_MAGIC, sizeof(header.magic)) != 0 || header.formatVersion != BINARY_REPLAY_FORMAT_VERSION)
+    {
+        //Not a binary replay record or one of an unsupported format.
+        SIMEXCEPTION(IllegalArgumentException);
+        return record;
+    }
+    if (header.fmVersion != FM_VERSION)
+    {
+        //The version from the replay file does not match the version from the current repository state.
+        SIMEXCEPTION(IllegalArgumentException);
+        return record;
+    }
+
+    record.config = nlohmann::json::parse(ReadBinaryReplayString(file, header.configLength));
+    record.siteJson = ReadBinaryReplayString(file, header.siteLength);
+    record.devicesJson = ReadBinaryReplayString(file, header.devicesLength);
+
+    std::vector<BinaryReplayIndexEntry> index(header.entryCount);
+    if (!index.empty()) ReadBinaryReplayData(file, index.data(), index.size());
+    std::vector<BinaryReplayNodeTableEntry> nodeTable(header.nodeCount);
+    if (!nodeTable.empty()) ReadBinaryReplayData(file, nodeTable.data(), nodeTable.size());
+    const std::streamoff positionsStart = file.tellg();
+    const std::streamoff commandsStart = positionsStart + (std::streamoff)header.entryCount * sizeof(u32);
+
+    //Collects the positions inside the index of all requested entries
+    std::vector<u32> positions;
+    if (nodeIndex == BINARY_REPLAY_ALL_NODES)
+    {
+        auto begin = std::partition_point(index.begin(), index.end(), [&](const BinaryReplayIndexEntry& entry) { return entry.time < fromTimeMs; });
+        auto end = std::partition_point(begin, index.end(), [&](const BinaryReplayIndexEntry& entry) { return entry.time <= toTimeMs; });
+        for (auto it = begin; it != end; it++) positions.push_back((u32)(it - index.begin()));
+    }
+    else
+    {
+        auto node = std::lower_bound(nodeTable.begin(), nodeTable.end(), nodeIndex,
+            [](const BinaryReplayNodeTableEntry& entry, u32 index) { return entry.nodeIndex < index; });
+        if (node != nodeTable.end() && node->nodeIndex == nodeIndex && node->amountOfPositions > 0)
+        {
+            std::vector<u32> nodePositions(node->amountOfPositions);
+            file.seekg(positionsStart + (std::streamoff)node->firstPosition * sizeof(u32));
+            ReadBinaryReplayData(file, nodePositions.data(), nodePositions.size());
+            auto begin = std::partition_point(nodePositions.begin(), nodePositions.end(), [&](u32 position) { return index[position].time < fromTimeMs; });
+            auto end = std::partition_point(begin, nodePositions.end(), [&](u32 position) { return index[position].time <= toTimeMs; });
+            positions.assign(begin, end);
+        }
+    }
+
+    if (positions.empty()) return record;
+
+    //All requested commands lie between the first and the last requested one, so a single read suffices.
+    const BinaryReplayIndexEntry& first = index[positions.front()];
+    const BinaryReplayIndexEntry& last = index[positions.back()];
+    file.seekg(commandsStart + (std::streamoff)first.commandOffset);
+    const std::string commands = ReadBinaryReplayString(file, last.commandOffset + last.commandLength - first.commandOffset);
+
+    record.entries.reserve(positions.size());
+    for (u32 position : positions)
+    {
+        const BinaryReplayIndexEntry& indexEntry = index[position];
+        ReplayRecordEntry entry;
+        entry.index = indexEntry.nodeIndex;
+        entry.time = indexEntry.time;
+        entry.command = commands.substr(indexEntry.commandOffset - first.commandOffset, indexEntry.commandLength);
+        entry.skipCrcCheck = indexEntry.skipCrcCheck != 0;
+        record.entries.push_back(std::move(entry));
+    }
+
+    return record;
+}
+
+void CherrySim::ConvertReplayLogToBinary(const std::string& logPath, const std::string& binaryPath)
+{
+    const std::string fileContents = LoadFileContents(logPath.c_str());
+    CheckVersionFromReplayRecord(fileContents);
+
+    BinaryReplayRecord record;
+    record.config = ExtractSimConfigurationFromReplayRecord(fileContents);
+    record.config.replayPath = "";
+    if (record.config.importFromJson)
+    {
+        record.siteJson    = ExtractAndCleanReplayToken(fileContents, "[!]SITE START:[!]",    "[!]SITE END[!]");
+        record.devicesJson = ExtractAndCleanReplayToken(fileContents, "[!]DEVICES START:[!]", "[!]DEVICES END[!]");
+    }
+    std::queue<ReplayRecordEntry> entries = ExtractReplayRecord(fileContents);
+    record.entries.reserve(entries.size());
+    while (!entries.empty())
+    {
+        record.entries.push_back(std::move(entries.front()));
+        entries.pop();
+    }
+
+    StoreBinaryReplayRecord(binaryPath, record);
+}
+
+void CherrySim::StoreBinaryReplay(const std::string& path)
+{
+    if (!simConfig.recordTerminalCommands)
+    {
+        //Without recording, the executed commands are not known.
+        SIMEXCEPTION(IllegalStateException);
+        return;
+    }
+    BinaryReplayRecord record;
+    record.config = simConfig;
+    //Commands of a replay that were executed so far are already part of the executed commands.
+    record.config.replayPath = "";
+    if (simConfig.importFromJson)
+    {
+        LoadReplaySiteAndDevices(record.siteJson, record.devicesJson);
+    }
+    record.entries = executedTerminalCommands;
+    StoreBinaryReplayRecord(path, record);
+}
+
+void CherrySim::LoadReplaySiteAndDevices(std::string& siteJson, std::string& devicesJson)
+{
+    if (simConfig.replayPath != "" && IsBinaryReplayRecord(simConfig.replayPath))
+    {
+        //An empty time window, only the site and devices are needed.
+        BinaryReplayRecord record = LoadBinaryReplayRecord(simConfig.replayPath, 1, 0);
+        siteJson    = std::move(record.siteJson);
+        devicesJson = std::move(record.devicesJson);
+    }
+    else if (simConfig.replayPath != "")
+    {
+        const std::string replayFileContents = LoadFileContents(simConfig.replayPath.c_str());
+        siteJson    = ExtractAndCleanReplayToken(replayFileContents, "[!]SITE START:[!]",    "[!]SITE END[!]");
+        devicesJson = ExtractAndCleanReplayToken(replayFileContents, "[!]DEVICES START:[!]", "[!]DEVICES END[!]");
+    }
+    else
+    {
+        siteJson    = LoadFileContents(simConfig.siteJsonPath.c_str());
+        devicesJson = LoadFileContents(simConfig.devicesJsonPath.c_str());
+    }
+}
+
+nlohmann::json CherrySim::GetStateSummary()
+{
+    nlohmann::json nodeStates = nlohmann::json::array();
+    for (u32 i = 0; i < GetTotalNodes(); i++)
+    {
+        nodeStates.push_back({
+            { "clusterId"      , nodes[i].gs.node.clusterId        },
+            { "clusterSize"    , nodes[i].gs.node.GetClusterSize() },
+            { "simulatedFrames", nodes[i].simulatedFrames          },
+        });
+    }
+
+    nlohmann::json state;
+    state["simTimeMs"]               = simState.simTimeMs;
+    state["rnd"]                     = simState.rnd.GetStateChecksum();
+    state["globalConnHandleCounter"] = simState.globalConnHandleCounter;
+    state["globalEventIdCounter"]    = simState.globalEventIdCounter;
+    state["globalPacketIdCounter"]   = simState.globalPacketIdCounter;
+    state["nodes"]                   = nodeStates;
+    return state;
+}
+
 void CherrySim::LoadPresetNodePositions()
 {
     if (simConfig.preDefinedPositions.size() != 0)
@@ -807,7 +1114,7 @@ void CherrySim::SimulateStepForAllNodes()
     CheckForMultiTensorflowUsage();
 
     //Check if the webserver has some open requests to process
-    server->ProcessServerRequests();
+    if (server != nullptr) server->ProcessServerRequests();
 
     int64_t sumOfAllSimulatedFrames = 0;
     for (u32 i = 0; i < GetTotalNodes(); i++) {
@@ -820,7 +1127,7 @@ void CherrySim::SimulateStepForAllNodes()
     while ((s = replayRecordEntries.size()) > 0 && replayRecordEntries.front().time <= simState.simTimeMs)
     {
         NodeIndexSetter setter(replayRecordEntries.front().index);
-        GS->terminal.PutIntoTerminalCommandQueue(replayRecordEntries.front().command, false);
+        GS->terminal.PutIntoTerminalCommandQueue(replayRecordEntries.front().command, replayRecordEntries.front().skipCrcCheck);
         replayRecordEntries.pop();
     }
 
@@ -864,6 +1171,8 @@ void CherrySim::SimulateStepForAllNodes()
                 //Node broke out of its current simulation and rebootet
                 if (simEventListener) simEventListener->CherrySimEventHandler("NODE_RESET");
             }
+
+            UpdateClusterMembership(currentNode);
         }
 
         globalBreakCounter++;
@@ -1117,6 +1426,19 @@ TerminalCommandHandlerReturnType CherrySim::TerminalCommandHandler(const std::ve
             PrintPacketStats(nodeId, "ROUTED");
             return TerminalCommandHandlerReturnType::SUCCESS;
         }
+        else if (commandArgs[1] == "timesync") {
+            //Print the time error of all nodes against the given node, which should be the one whose time was set
+            NodeId nodeId = commandArgs.size() >= 3 ? Utility::StringToU16(commandArgs[2].c_str()) : 1;
+            NodeEntry* node = FindNodeById(nodeId);
+            if (node == nullptr) return TerminalCommandHandlerReturnType::WRONG_ARGUMENT;
+            PrintTimeSyncAccuracy(node->index);
+            return TerminalCommandHandlerReturnType::SUCCESS;
+        }
+        else if (commandArgs[1] == "flashwear") {
+            //Print the flash erase and write counters of all nodes
+            PrintFlashWear();
+            return TerminalCommandHandlerReturnType::SUCCESS;
+        }
 
         else if (commandArgs[1] == "animation")
         {
@@ -1745,6 +2067,10 @@ void CherrySim::FlashNode(u32 i) {
         //Set the simulated ble stack to default
         nodes[i].bleStackType = simConfig.defaultBleStackType;
     }
+
+    if (simConfig.maxClockDriftPpm != 0) {
+        nodes[i].clockDriftPpm = (i32)simState.rnd.NextU32(0, 2 * simConfig.maxClockDriftPpm) - (i32)simConfig.maxClockDriftPpm;
+    }
 }
 
 void CherrySim::ErasePage(u32 pageAddress)
@@ -1808,6 +2134,7 @@ void CherrySim::BootCurrentNode()
     //Initialize new SoftDevice state
     currentNode->state.~SoftdeviceState();
     new (&currentNode->state) SoftdeviceState();
+    connectivityDirty = true;
 
     //Allocate halMemory
     const u32 halMemorySize = FruityHal::GetHalMemorySize() / sizeof(u32) + 1;
@@ -2048,13 +2375,18 @@ void CherrySim::ConnectMasterToSlave(NodeEntry* master, NodeEntry* slave)
     freeInConnection->rssiMeasurementActive = false;
     freeInConnection->connectionIndex = 0;
     freeInConnection->connectionHandle = simState.globalConnHandleCounter;
-    freeInConnection->connectionInterval = master->state.connectionParamIntervalMs;
+    freeInConnection->connectionIntervalUs = master->state.connectionParamIntervalUs;
     freeInConnection->connectionSupervisionTimeoutMs = master->state.connectionTimeoutMs;
     freeInConnection->owningNode = slave;
     freeInConnection->partner = master;
     freeInConnection->connectionMtu = GATT_MTU_SIZE_DEFAULT;
     freeInConnection->isCentral = false;
     freeInConnection->lastReceivedPacketTimestampMs = simState.simTimeMs;
+    freeInConnection->phyBitrateKbps = 1000;
+    //FruityMesh requests the data length extension on every connection, the SoftDevices of all simulated nodes
+    //support the maximum data length so the negotiated value is applied directly
+    freeInConnection->linkLayerMaxPayload = SIM_LL_MAX_PAYLOAD;
+    freeInConnection->nextConnectionEventUs = (uint64_t)slave->state.timeMs * 1000 + freeInConnection->connectionIntervalUs;
 
     //Generate an event for the current node
     simBleEvent s2;
@@ -2064,8 +2396,8 @@ void CherrySim::ConnectMasterToSlave(NodeEntry* master, NodeEntry* slave)
     s2.bleEvent.header.evt_len = s2.globalId;
     s2.bleEvent.evt.gap_evt.conn_handle = simState.globalConnHandleCounter;
 
-    s2.bleEvent.evt.gap_evt.params.connected.conn_params.min_conn_interval = slave->state.connectionParamIntervalMs;
-    s2.bleEvent.evt.gap_evt.params.connected.conn_params.max_conn_interval = slave->state.connectionParamIntervalMs;
+    s2.bleEvent.evt.gap_evt.params.connected.conn_params.min_conn_interval = (u16)(slave->state.connectionParamIntervalUs / 1250);
+    s2.bleEvent.evt.gap_evt.params.connected.conn_params.max_conn_interval = (u16)(slave->state.connectionParamIntervalUs / 1250);
     s2.bleEvent.evt.gap_evt.params.connected.peer_addr = Convert(&master->address);
     s2.bleEvent.evt.gap_evt.params.connected.role = BLE_GAP_ROLE_PERIPH;
 
@@ -2101,18 +2433,24 @@ void CherrySim::ConnectMasterToSlave(NodeEntry* master, NodeEntry* slave)
     freeOutConnection->connectionActive = true;
     freeOutConnection->rssiMeasurementActive = false;
     freeOutConnection->connectionHandle = simState.globalConnHandleCounter;
-    freeOutConnection->connectionInterval = master->state.connectionParamIntervalMs;
+    freeOutConnection->connectionIntervalUs = master->state.connectionParamIntervalUs;
     freeOutConnection->connectionSupervisionTimeoutMs = master->state.connectionTimeoutMs;
     freeOutConnection->owningNode = master;
     freeOutConnection->partner = slave;
     freeOutConnection->connectionMtu = GATT_MTU_SIZE_DEFAULT;
     freeOutConnection->isCentral = true;
     freeOutConnection->lastReceivedPacketTimestampMs = simState.simTimeMs;
+    freeOutConnection->phyBitrateKbps = 1000;
+    freeOutConnection->linkLayerMaxPayload = SIM_LL_MAX_PAYLOAD;
+    freeOutConnection->nextConnectionEventUs = (uint64_t)master->state.timeMs * 1000 + freeOutConnection->connectionIntervalUs;
 
     //Save connection references
     freeInConnection->partnerConnection = freeOutConnection;
     freeOutConnection->partnerConnection = freeInConnection;
 
+    if (!connectivityDirty) MergeConnectivity(master->index, slave->index);
+    clusterMembershipChanged = true;
+
     //Generate an event for the remote node
     simBleEvent s;
     CheckedMemset(&s, 0, sizeof(s));
@@ -2121,8 +2459,8 @@ void CherrySim::ConnectMasterToSlave(NodeEntry* master, NodeEntry* slave)
     s.bleEvent.header.evt_len = s.globalId;
     s.bleEvent.evt.gap_evt.conn_handle = simState.globalConnHandleCounter;
 
-    s.bleEvent.evt.gap_evt.params.connected.conn_params.min_conn_interval = slave->state.connectionParamIntervalMs;
-    s.bleEvent.evt.gap_evt.params.connected.conn_params.max_conn_interval = slave->state.connectionParamIntervalMs;
+    s.bleEvent.evt.gap_evt.params.connected.conn_params.min_conn_interval = (u16)(slave->state.connectionParamIntervalUs / 1250);
+    s.bleEvent.evt.gap_evt.params.connected.conn_params.max_conn_interval = (u16)(slave->state.connectionParamIntervalUs / 1250);
     s.bleEvent.evt.gap_evt.params.connected.peer_addr = Convert(&slave->address);
     s.bleEvent.evt.gap_evt.params.connected.role = BLE_GAP_ROLE_CENTRAL;
 
@@ -2132,6 +2470,18 @@ void CherrySim::ConnectMasterToSlave(NodeEntry* master, NodeEntry* slave)
     master->state.connectingActive = false;
 }
 
+static u32 GetAmountOfBufferedPackets(const SoftdeviceConnection* connection)
+{
+    u32 amount = 0;
+    for (int i = 0; i < SIM_NUM_RELIABLE_BUFFERS; i++) {
+        if (connection->reliableBuffers[i].sender != nullptr) amount++;
+    }
+    for (int i = 0; i < SIM_NUM_UNRELIABLE_BUFFERS; i++) {
+        if (connection->unreliableBuffers[i].sender != nullptr) amount++;
+    }
+    return amount;
+}
+
 u32 CherrySim::DisconnectSimulatorConnection(SoftdeviceConnection* connection, u32 hciReason, u32 hciReasonPartner) {
 
     //If it could not be found, the connection might have been terminated by a peer or the sim already or something was wrong
@@ -2162,7 +2512,8 @@ u32 CherrySim::DisconnectSimulatorConnection(SoftdeviceConnection* connection, u
         SIMEXCEPTIONFORCE(IllegalStateException);
     }
 
-    //Clear the transmitbuffers for both nodes
+    //Clear the transmitbuffers for both nodes, all packets that were still buffered are lost
+    simState.packetsDroppedOnDisconnect += GetAmountOfBufferedPackets(connection) + GetAmountOfBufferedPackets(partnerConnection);
     CheckedMemset(connection->reliableBuffers, 0x00, sizeof(connection->reliableBuffers));
     CheckedMemset(connection->unreliableBuffers, 0x00, sizeof(connection->unreliableBuffers));
     CheckedMemset(partnerConnection->reliableBuffers, 0x00, sizeof(connection->reliableBuffers));
@@ -2170,6 +2521,8 @@ u32 CherrySim::DisconnectSimulatorConnection(SoftdeviceConnection* connection, u
 
     //#### Our own node
     connection->connectionActive = false;
+    connectivityDirty = true;
+    clusterMembershipChanged = true;
 
     simBleEvent s1;
     CheckedMemset(&s1, 0, sizeof(s1));
@@ -2273,127 +2626,261 @@ void CherrySim::SendUnreliableTxCompleteEvent(NodeEntry* node, int connHandle, u
     }
 }
 
-void CherrySim::SimulateConnections() {
-    /* Currently, the simulation will only take one connection event to transmit a reliable packet and both the packet event and the ACK will be generated
-    * at the same time. Also, all unreliable packets are always sent in one conneciton event.
-    * If many connections exist with short connection intervals, the behaviour is not realistic as the amount of packets that are being sent should decrease.
-    * There is also no probability of failure and the buffer is always emptied
-    */
+//Returns the time on air of a single link layer packet with the given payload length
+u32 CherrySim::GetLinkLayerPacketAirtimeUs(const SoftdeviceConnection* connection, u32 payloadLength) const
+{
+    const u32 preamble = connection->phyBitrateKbps >= 2000 ? 2 : 1;
+    const u32 mic = (connection->connectionEncrypted && payloadLength > 0) ? SIM_LL_MIC_SIZE : 0;
+    const u32 bits = (preamble + SIM_LL_PDU_OVERHEAD + payloadLength + mic) * 8;
 
-    if (blockConnections) return;
+    return bits * 1000 / connection->phyBitrateKbps;
+}
 
-    //Simulate sending data for each connection individually
-    for (int i = 0; i < currentNode->state.configuredTotalConnectionCount; i++) {
-        SoftdeviceConnection* connection = &currentNode->state.connections[i];
-        if (connection->connectionActive) {
+//The radio of a node is shared by all of its connections, so a connection event can only take
+//a fraction of the connection interval on both sides of the connection
+u32 CherrySim::GetConnectionEventBudgetUs(const SoftdeviceConnection* connection)
+{
+    const u32 connectionIntervalUs = connection->connectionIntervalUs;
+    const u32 numConnections = std::max(GetNumSimConnections(connection->owningNode), GetNumSimConnections(connection->partner));
 
-            //FIXME: This implementation will currently not calculate a correct throughput for packets
-            //if the interval is smaller than the simulation timestep, it will only simulate one connectionEvent
-            //To fix this, we should calculate the throughput according to our documented measurements
-            //depending on the number of connections, whether scanning / advertising are active, the eventLength and the interval
+    return std::min(SIM_CONNECTION_EVENT_LENGTH_US, connectionIntervalUs / std::max(numConnections, 1u));
+}
 
-            u16 connectionIntervalMs = connection->connectionInterval;
+//Simulates one connection event of a connection, must be called with the central half of the connection.
+//In every exchange the central sends a link layer packet and the peripheral answers with one of its own packets,
+//both directions share the time budget of the event. A lost exchange has to be repeated by both sides.
+//The event goes on while one of the sides sets the more data bit and ends once its budget is used up
+//or too many CRC errors occured in a row.
+void CherrySim::SimulateConnectionEvent(SoftdeviceConnection* connection)
+{
+    if (!connection->isCentral || connection->partnerConnection == nullptr)
+    {
+        SIMEXCEPTION(IllegalArgumentException);
+        return;
+    }
 
-            //FIXME: This is a workaround as the simulation timestep is probably not dividable by (int)7.5
-            if (connectionIntervalMs == (int)7.5f) connectionIntervalMs = 10;
+    const uint64_t centralToPeripheral = CalculateReceptionProbability(connection->owningNode, connection->partner);
+    const uint64_t peripheralToCentral = CalculateReceptionProbability(connection->partner, connection->owningNode);
+    const u32 exchangeProbability = (u32)(centralToPeripheral * peripheralToCentral / UINT32_MAX);
+    const u32 budgetUs = GetConnectionEventBudgetUs(connection);
 
-            //Each connecitonInterval, we see if there are any packets to send
-            if (ShouldSimIvTrigger(connectionIntervalMs)) {
+    ConnectionEventDirection central;
+    central.connection = connection;
+    ConnectionEventDirection peripheral;
+    peripheral.connection = connection->partnerConnection;
 
-                //Depending on the number of connections, we send a random amount of packets from the unreliable buffers
-                u8 numConnections = GetNumSimConnections(currentNode);
-                u8 numPacketsToSend;
-                u32 unreliablePacketsSent = 0;
+    u32 usedUs = 0;
+    u32 consecutiveCrcErrors = 0;
+    StartNextLinkLayerPacket(central, budgetUs);
+    StartNextLinkLayerPacket(peripheral, budgetUs);
 
-                if (numConnections == 1) numPacketsToSend = (u8)PSRNGINT(0, SIM_NUM_UNRELIABLE_BUFFERS);
-                else if (numConnections == 2) numPacketsToSend = (u8)PSRNGINT(0, 5);
-                else numPacketsToSend = (u8)PSRNGINT(0, 3);
+    //The first exchange opens the event and keeps the connection alive even if there is nothing to send
+    bool anchorReceived = false;
+    while (!anchorReceived || central.moreData || peripheral.moreData)
+    {
+        const u32 centralLength = std::min(central.remainingLength, connection->linkLayerMaxPayload);
+        const u32 peripheralLength = std::min(peripheral.remainingLength, connection->linkLayerMaxPayload);
+        const u32 exchangeUs = GetLinkLayerPacketAirtimeUs(connection, centralLength) + GetLinkLayerPacketAirtimeUs(connection, peripheralLength) + 2 * SIM_LL_T_IFS_US;
+        if (usedUs + exchangeUs > budgetUs)
+        {
+            if (anchorReceived) SIMSTATCOUNT("connectionEventBudgetExhausted");
+            break;
+        }
+        usedUs += exchangeUs;
 
-                const double rssiMult = CalculateReceptionProbability(connection->owningNode, connection->partner);
-                if (rssiMult == 0)
-                {
-                    numPacketsToSend = 0;
-                }
-                else
-                {
-                    currentNode->state.connections[i].lastReceivedPacketTimestampMs = this->simState.simTimeMs;
-                }
-                
+        if (!PSRNG(exchangeProbability))
+        {
+            SIMSTATCOUNT("linkLayerRetransmissions");
+            if (++consecutiveCrcErrors >= SIM_LL_MAX_CONSECUTIVE_CRC_ERRORS) break;
+            continue;
+        }
+        consecutiveCrcErrors = 0;
+        anchorReceived = true;
 
-                //Simulate timeouts if messages can't be send anymore.
-                SoftDeviceBufferedPacket* packet = getNextPacketToWrite(connection);
-                if (packet != nullptr)
-                {
-                    const u32 timeInQueueMs = simState.simTimeMs - packet->queueTimeMs;
-                    if (timeInQueueMs > 30 * 1000)
-                    {
-                        DisconnectSimulatorConnection(&currentNode->state.connections[i], BLE_HCI_CONNECTION_TIMEOUT, BLE_HCI_CONNECTION_TIMEOUT);
-                        continue;
-                    }
-                }
+        AdvanceConnectionEventDirection(central, centralLength, budgetUs - usedUs);
+        AdvanceConnectionEventDirection(peripheral, peripheralLength, budgetUs - usedUs);
+    }
 
-                // Simulate timeouts if there was no message received within connection interval
-                if (simState.simTimeMs >= 
-                    (currentNode->state.connections[i].lastReceivedPacketTimestampMs + 
-                     currentNode->state.connections[i].connectionSupervisionTimeoutMs))
-                {
-                    DisconnectSimulatorConnection(&currentNode->state.connections[i], BLE_HCI_CONNECTION_TIMEOUT, BLE_HCI_CONNECTION_TIMEOUT);
-                }
+    if (anchorReceived)
+    {
+        connection->lastReceivedPacketTimestampMs = this->simState.simTimeMs;
+        connection->partnerConnection->lastReceivedPacketTimestampMs = this->simState.simTimeMs;
+    }
 
-                for (int k = 0; k < numPacketsToSend; k++) {
-                    SoftDeviceBufferedPacket* packet = getNextPacketToWrite(connection);
-                    if (packet == nullptr) break;
+    //Send remaining accumulated tx complete events for notifications and unreliable writes
+    //A packet that was interrupted stays in the SoftDevice buffer and is sent again from the start in the next event
+    SendUnreliableTxCompleteEvent(central.connection->owningNode, central.connection->connectionHandle, central.unreliablePacketsSent);
+    SendUnreliableTxCompleteEvent(peripheral.connection->owningNode, peripheral.connection->connectionHandle, peripheral.unreliablePacketsSent);
+}
 
-                    //Notifications
-                    if (packet->isHvx) {
-                        GenerateNotification(packet);
-                        //Remove packet from softdevice buffer
-                        packet->sender = nullptr;
-                        unreliablePacketsSent++;
-                    }
-                    //Unreliable Writes
-                    else if (packet->params.writeParams.write_op == BLE_GATT_OP_WRITE_CMD) {
-                        GenerateWrite(packet);
-                        //Remove packet from softdevice buffer
-                        packet->sender = nullptr;
-                        unreliablePacketsSent++;
-                    }
-                    //Reliable Writes
-                    else if (packet->params.writeParams.write_op == BLE_GATT_OP_WRITE_REQ) {
-
-                        //Send tx complete for all previous unreliable writes if there were any
-                        SendUnreliableTxCompleteEvent(currentNode, connection->connectionHandle, unreliablePacketsSent);
-                        unreliablePacketsSent = 0;
-
-                        GenerateWrite(packet);
-                        //Remove packet from softdevice buffer
-                        packet->sender = nullptr;
-
-                        //Generate the event that the write was successful immediately
-                        //TODO: Could be postponed a bit to better match the real world
-                        simBleEvent s2;
-                        CheckedMemset(&s2, 0, sizeof(s2));
-                        s2.globalId = simState.globalEventIdCounter++;
-                        s2.bleEvent.header.evt_id = BLE_GATTC_EVT_WRITE_RSP;
-                        s2.bleEvent.header.evt_len = s2.globalId;
-                        s2.bleEvent.evt.gattc_evt.conn_handle = connection->connectionHandle;
-                        s2.bleEvent.evt.gattc_evt.gatt_status = (u16)FruityHal::BleGattEror::SUCCESS;
-                        //Save the global packet id so that we can track where a packet was generated after we receive it
-                        s2.additionalInfo = packet->globalPacketId;
-                        currentNode->eventQueue.push_back(s2);
-
-
-
-                        //Do not send any more packets this connectionEvent as we need to wait for an ACK
-                        break;
-                    }
-                    else {
-                        SIMEXCEPTION(IllegalArgumentException);
-                    }
-                }
+//Picks the next packet of one side from its SoftDevice buffers. A packet is only started if it fits
+//into the remaining budget of the event when the other side answers with empty packets.
+void CherrySim::StartNextLinkLayerPacket(ConnectionEventDirection& direction, u32 remainingBudgetUs)
+{
+    direction.packet = nullptr;
+    direction.remainingLength = 0;
+    direction.moreData = false;
+    if (direction.finished) return;
+
+    SoftdeviceConnection* connection = direction.connection;
+    SoftDeviceBufferedPacket* packet = getNextPacketToWrite(connection);
+    if (packet == nullptr) return;
+
+    const u32 attLength = packet->isHvx ? (u32)(uintptr_t)packet->params.hvxParams.p_len : packet->params.writeParams.len;
+    const u32 length = attLength + SIM_L2CAP_ATT_HEADER_SIZE;
+
+    const u32 maxPayload = connection->linkLayerMaxPayload;
+    const u32 numFragments = (length + maxPayload - 1) / maxPayload;
+    const u32 lastFragmentLength = length - (numFragments - 1) * maxPayload;
+    const u32 responseUs = GetLinkLayerPacketAirtimeUs(connection, 0) + 2 * SIM_LL_T_IFS_US;
+    const u32 packetUs = (numFragments - 1) * (GetLinkLayerPacketAirtimeUs(connection, maxPayload) + responseUs)
+        + GetLinkLayerPacketAirtimeUs(connection, lastFragmentLength) + responseUs;
+    if (packetUs > remainingBudgetUs)
+    {
+        SIMSTATCOUNT("connectionEventBudgetExhausted");
+        direction.finished = true;
+        return;
+    }
+
+    direction.packet = packet;
+    direction.remainingLength = length;
+    direction.moreData = true;
+}
+
+//Called after an exchange was received by both sides, acknowledges the fragment that one side has sent
+void CherrySim::AdvanceConnectionEventDirection(ConnectionEventDirection& direction, u32 fragmentLength, u32 remainingBudgetUs)
+{
+    if (direction.packet == nullptr) return;
+
+    direction.remainingLength -= fragmentLength;
+    if (direction.remainingLength > 0) return;
+
+    CompleteLinkLayerPacket(direction);
+    StartNextLinkLayerPacket(direction, remainingBudgetUs);
+}
+
+//Delivers a packet that was fully received by the partner and removes it from the SoftDevice buffer of the sender
+void CherrySim::CompleteLinkLayerPacket(ConnectionEventDirection& direction)
+{
+    SoftDeviceBufferedPacket* packet = direction.packet;
+    NodeEntry* sender = direction.connection->owningNode;
+
+    //The events are generated in the context of the sender, which is not the current node for the peripheral
+    NodeIndexSetter setter(sender->index);
+
+    //Notifications
+    if (packet->isHvx) {
+        GenerateNotification(packet);
+        //Remove packet from softdevice buffer
+        packet->sender = nullptr;
+        direction.unreliablePacketsSent++;
+    }
+    //Unreliable Writes
+    else if (packet->params.writeParams.write_op == BLE_GATT_OP_WRITE_CMD) {
+        GenerateWrite(packet);
+        //Remove packet from softdevice buffer
+        packet->sender = nullptr;
+        direction.unreliablePacketsSent++;
+    }
+    //Reliable Writes
+    else if (packet->params.writeParams.write_op == BLE_GATT_OP_WRITE_REQ) {
+
+        //Send tx complete for all previous unreliable writes if there were any
+        SendUnreliableTxCompleteEvent(sender, direction.connection->connectionHandle, direction.unreliablePacketsSent);
+        direction.unreliablePacketsSent = 0;
+
+        GenerateWrite(packet);
+        //Remove packet from softdevice buffer
+        packet->sender = nullptr;
+
+        //Generate the event that the write was successful immediately
+        //TODO: Could be postponed a bit to better match the real world
+        simBleEvent s2;
+        CheckedMemset(&s2, 0, sizeof(s2));
+        s2.globalId = simState.globalEventIdCounter++;
+        s2.bleEvent.header.evt_id = BLE_GATTC_EVT_WRITE_RSP;
+        s2.bleEvent.header.evt_len = s2.globalId;
+        s2.bleEvent.evt.gattc_evt.conn_handle = direction.connection->connectionHandle;
+        s2.bleEvent.evt.gattc_evt.gatt_status = (u16)FruityHal::BleGattEror::SUCCESS;
+        //Save the global packet id so that we can track where a packet was generated after we receive it
+        s2.additionalInfo = packet->globalPacketId;
+        sender->eventQueue.push_back(s2);
 
-                //Send remaining accumulated tx complete events for notifications and unreliable writes
-                SendUnreliableTxCompleteEvent(currentNode, connection->connectionHandle, unreliablePacketsSent);
+        //Do not send any more packets this connectionEvent as we need to wait for an ACK
+        direction.finished = true;
+    }
+    else {
+        SIMEXCEPTION(IllegalArgumentException);
+    }
+}
+
+//Disconnects the connection if a packet could not be sent for too long or if nothing was received from the partner
+//within the supervision timeout, returns false if the connection was disconnected
+bool CherrySim::CheckConnectionTimeouts(SoftdeviceConnection* connection)
+{
+    //Simulate timeouts if messages can't be send anymore.
+    SoftDeviceBufferedPacket* packet = getNextPacketToWrite(connection);
+    if (packet != nullptr)
+    {
+        const u32 timeInQueueMs = simState.simTimeMs - packet->queueTimeMs;
+        if (timeInQueueMs > 30 * 1000)
+        {
+            DisconnectSimulatorConnection(connection, BLE_HCI_CONNECTION_TIMEOUT, BLE_HCI_CONNECTION_TIMEOUT);
+            return false;
+        }
+    }
+
+    // Simulate timeouts if there was no message received within connection interval
+    if (simState.simTimeMs >=
+        (connection->lastReceivedPacketTimestampMs +
+         connection->connectionSupervisionTimeoutMs))
+    {
+        DisconnectSimulatorConnection(connection, BLE_HCI_CONNECTION_TIMEOUT, BLE_HCI_CONNECTION_TIMEOUT);
+        return false;
+    }
+
+    return true;
+}
+
+void CherrySim::SimulateConnections() {
+    /* Each connection is simulated as a series of connection events that take place every connection interval.
+    * The events are driven by the central and carry the packets of both sides. The number of packets that can be
+    * sent in an event depends on the PHY, the negotiated data length, the packet sizes, the retransmissions
+    * due to CRC errors and the share of the radio time that the connection gets on both of its nodes,
+    * see SimulateConnectionEvent. A reliable write is acknowledged in the same event but ends the event for its sender.
+    */
+
+    if (blockConnections) return;
+
+    const uint64_t nowUs = (uint64_t)currentNode->state.timeMs * 1000;
+
+    //Simulate sending data for each connection individually
+    for (int i = 0; i < currentNode->state.configuredTotalConnectionCount; i++) {
+        SoftdeviceConnection* connection = &currentNode->state.connections[i];
+        if (connection->connectionActive) {
+
+            //The peripheral takes part in the events of the central, it only has to check for its own timeouts
+            if (!connection->isCentral)
+            {
+                CheckConnectionTimeouts(connection);
+                continue;
+            }
+
+            const u32 connectionIntervalUs = connection->connectionIntervalUs;
+            if (connectionIntervalUs == 0)
+            {
+                SIMEXCEPTION(IllegalStateException);
+                continue;
+            }
+
+            //Intervals shorter than a simulation step result in multiple events per step
+            while (connection->connectionActive && connection->nextConnectionEventUs <= nowUs)
+            {
+                connection->nextConnectionEventUs += connectionIntervalUs;
+
+                if (!CheckConnectionTimeouts(connection)) break;
+
+                SimulateConnectionEvent(connection);
             }
         }
     }
@@ -2486,6 +2973,8 @@ void CherrySim::GenerateWrite(SoftDeviceBufferedPacket* bufferedPacket) {
 #endif
 
     CheckedMemcpy(&s.bleEvent.evt.gatts_evt.params.write.data, p_write_params.p_value, p_write_params.len);
+    simState.packetsDelivered++;
+    simState.bytesDelivered += p_write_params.len;
     s.bleEvent.evt.gatts_evt.params.write.handle = p_write_params.handle;
     s.bleEvent.evt.gatts_evt.params.write.len = p_write_params.len;
     s.bleEvent.evt.gatts_evt.params.write.offset = 0;
@@ -2528,6 +3017,8 @@ void CherrySim::GenerateNotification(SoftDeviceBufferedPacket* bufferedPacket) {
     s.bleEvent.evt.gattc_evt.params.hvx.handle = hvx_params.handle;
     // This is a workaround for hvxParams keeping only pointer to len.
     s.bleEvent.evt.gattc_evt.params.hvx.len = (u16)(u32)hvx_params.p_len;
+    simState.packetsDelivered++;
+    simState.bytesDelivered += (u32)hvx_params.p_len;
     s.bleEvent.evt.gattc_evt.params.hvx.type = hvx_params.type;
 
     receiver->eventQueue.push_back(s);
@@ -2696,22 +3187,22 @@ void CherrySim::SimulateBatteryUsage()
     for (u32 i = 0; i < currentNode->state.configuredTotalConnectionCount; i++) {
         SoftdeviceConnection* conn = currentNode->state.connections + i;
         if (conn->connectionActive) {
-            if (conn->connectionInterval == 100) {
+            if (conn->connectionIntervalUs == 100000) {
                 currentNode->nanoAmperePerMsTotal += conn100Ms;
             }
-            else if (conn->connectionInterval == 7) {
+            else if (conn->connectionIntervalUs == 7500) {
                 currentNode->nanoAmperePerMsTotal += conn7_5Ms;
             }
-            else if (conn->connectionInterval == 10) {
+            else if (conn->connectionIntervalUs == 10000) {
                 currentNode->nanoAmperePerMsTotal += conn10Ms;
             }
-            else if (conn->connectionInterval == 15) {
+            else if (conn->connectionIntervalUs == 15000) {
                 currentNode->nanoAmperePerMsTotal += conn15Ms;
             }
-            else if (conn->connectionInterval == 30) {
+            else if (conn->connectionIntervalUs == 30000) {
                 currentNode->nanoAmperePerMsTotal += conn30Ms;
             }
-            else if (conn->connectionInterval == 90) {
+            else if (conn->connectionIntervalUs == 90000) {
                 currentNode->nanoAmperePerMsTotal += conn90Ms;
             }
             else {
@@ -2736,6 +3227,16 @@ void CherrySim::SimulateTimer() {
 
     if (ShouldSimIvTrigger(100L * MAIN_TIMER_TICK * 10 / ticksPerSecond)) {
         app_timer_handler(nullptr);
+
+        //A drifting crystal delivers a few more or less ticks than expected
+        if (currentNode->clockDriftPpm != 0) {
+            currentNode->clockDriftRemainder += MAIN_TIMER_TICK * currentNode->clockDriftPpm;
+            const i32 driftTicks = currentNode->clockDriftRemainder / 1000000;
+            if (driftTicks != 0) {
+                currentNode->clockDriftRemainder -= driftTicks * 1000000;
+                GS->timeManager.AddSimulatedClockDrift(driftTicks);
+            }
+        }
     }
 }
 
@@ -2754,7 +3255,7 @@ struct InterruptGuard
 {
     //Protects us against interrupting inside an interrupt using RAII.
 
-    static inline bool currentlyInAnInterrupt = false;
+    static inline thread_local bool currentlyInAnInterrupt = false;
 
     InterruptGuard() {
         currentlyInAnInterrupt = true;
@@ -2811,6 +3312,10 @@ void CherrySim::SimulateInterrupts()
 //      connection, but this would allow us to run the check for all clusterings in the automated test.
 void CherrySim::CheckMeshingConsistency()
 {
+    //The cluster sizes can only become inconsistent if a connection or the cluster of a node changed
+    if (!clusterMembershipChanged) return;
+    clusterMembershipChanged = false;
+
     //Reset all validity information
     u32 numNoneAssetNodes = GetTotalNodes() - GetAssetNodes();
     for (u32 i = 0; i < numNoneAssetNodes; i++)
@@ -3171,17 +3676,131 @@ void CherrySim::SetBleStack(NodeEntry* node)
 // 
 //#########################################################################################
 
-bool CherrySim::IsClusteringDone()
+u32 CherrySim::FindConnectivityRoot(u32 nodeIndex)
 {
-    u32 numNoneAssetNodes = GetTotalNodes() - GetAssetNodes();
-    std::set<ClusterId> clusterIds;
-    for (u32 i = 0; i < numNoneAssetNodes; i++) {
-        clusterIds.insert(nodes[i].gs.node.clusterId);
-        if ((u32)nodes[i].gs.node.GetClusterSize() != numNoneAssetNodes) {
-            return false;
+    while (connectivityParent[nodeIndex] != nodeIndex)
+    {
+        //Path halving keeps the trees flat
+        connectivityParent[nodeIndex] = connectivityParent[connectivityParent[nodeIndex]];
+        nodeIndex = connectivityParent[nodeIndex];
+    }
+    return nodeIndex;
+}
+
+void CherrySim::MergeConnectivity(u32 nodeIndexA, u32 nodeIndexB)
+{
+    //Connections to assets do not make a mesh
+    if (nodeIndexA >= connectivityParent.size() || nodeIndexB >= connectivityParent.size()) return;
+
+    const u32 rootA = FindConnectivityRoot(nodeIndexA);
+    const u32 rootB = FindConnectivityRoot(nodeIndexB);
+    if (rootA != rootB)
+    {
+        connectivityParent[std::max(rootA, rootB)] = std::min(rootA, rootB);
+        connectivityComponents--;
+    }
+}
+
+void CherrySim::RebuildConnectivity()
+{
+    const u32 numNoneAssetNodes = GetTotalNodes() - GetAssetNodes();
+    connectivityParent.resize(numNoneAssetNodes);
+    for (u32 i = 0; i < numNoneAssetNodes; i++) connectivityParent[i] = i;
+    connectivityComponents = numNoneAssetNodes;
+
+    for (u32 i = 0; i < numNoneAssetNodes; i++)
+    {
+        for (int k = 0; k < nodes[i].state.configuredTotalConnectionCount; k++)
+        {
+            const SoftdeviceConnection& connection = nodes[i].state.connections[k];
+            if (connection.connectionActive && connection.isCentral)
+            {
+                MergeConnectivity(i, connection.partner->index);
+            }
+        }
+    }
+
+    connectivityDirty = false;
+}
+
+std::vector<u32> CherrySim::GetHopDistances(u32 fromNodeIndex)
+{
+    std::vector<u32> distances(GetTotalNodes(), UINT32_MAX);
+    std::queue<u32> openNodes;
+    distances[fromNodeIndex] = 0;
+    openNodes.push(fromNodeIndex);
+
+    while (!openNodes.empty())
+    {
+        const u32 current = openNodes.front();
+        openNodes.pop();
+        for (int k = 0; k < nodes[current].state.configuredTotalConnectionCount; k++)
+        {
+            const SoftdeviceConnection& connection = nodes[current].state.connections[k];
+            if (connection.connectionActive && distances[connection.partner->index] == UINT32_MAX)
+            {
+                distances[connection.partner->index] = distances[current] + 1;
+                openNodes.push(connection.partner->index);
+            }
         }
     }
-    return clusterIds.size() == 1;
+
+    return distances;
+}
+
+i32 CherrySim::GetTimeErrorTicks(u32 nodeIndex, u32 referenceNodeIndex)
+{
+    TimePoint referenceTime;
+    {
+        NodeIndexSetter setter(referenceNodeIndex);
+        referenceTime = GS->timeManager.GetTimePoint();
+    }
+    NodeIndexSetter setter(nodeIndex);
+    return GS->timeManager.GetTimePoint() - referenceTime;
+}
+
+u32 CherrySim::GetNumberOfConnectedComponents()
+{
+    if (connectivityDirty) RebuildConnectivity();
+    return connectivityComponents;
+}
+
+void CherrySim::UpdateClusterMembership(NodeEntry* node)
+{
+    const u32 numNoneAssetNodes = GetTotalNodes() - GetAssetNodes();
+    if (node->index >= numNoneAssetNodes) return;
+    if (clusterMemberships.size() < numNoneAssetNodes) clusterMemberships.resize(numNoneAssetNodes);
+
+    ClusterMembership& membership = clusterMemberships[node->index];
+    const ClusterId clusterId = node->gs.node.clusterId;
+    const ClusterSize clusterSize = node->gs.node.GetClusterSize();
+    if (membership.tracked && membership.clusterId == clusterId && membership.clusterSize == clusterSize) return;
+
+    if (membership.tracked)
+    {
+        if (--clusterMemberCounts[membership.clusterId] == 0) clusterMemberCounts.erase(membership.clusterId);
+        if (--clusterSizeCounts[membership.clusterSize] == 0) clusterSizeCounts.erase(membership.clusterSize);
+    }
+
+    membership.tracked = true;
+    membership.clusterId = clusterId;
+    membership.clusterSize = clusterSize;
+    clusterMemberCounts[clusterId]++;
+    clusterSizeCounts[clusterSize]++;
+    clusterMembershipChanged = true;
+}
+
+bool CherrySim::IsClusteringDone()
+{
+    //The nodes can only agree on a single cluster once they are connected with each other
+    if (GetNumberOfConnectedComponents() > 1) return false;
+
+    //All nodes must be in the same cluster and must all report the full cluster size
+    const u32 numNoneAssetNodes = GetTotalNodes() - GetAssetNodes();
+    return clusterMemberCounts.size() == 1
+        && clusterSizeCounts.size() == 1
+        && (u32)clusterSizeCounts.begin()->first == numNoneAssetNodes
+        && clusterSizeCounts.begin()->second == numNoneAssetNodes;
 }
 
 struct ClusterNetworkPair {
@@ -3453,6 +4072,79 @@ void CherrySim::AddMessageToStats(PacketStat* statArray, u8* message, u16 messag
     AddPacketToStats(statArray, &packet);
 }
 
+void CherrySim::PrintTimeSyncAccuracy(u32 referenceNodeIndex)
+{
+    const std::vector<u32> distances = GetHopDistances(referenceNodeIndex);
+
+    //Maximum and summed up absolute error in ticks for each hop distance
+    std::map<u32, std::pair<u32, uint64_t>> errorsByHops;
+    std::map<u32, u32> nodesByHops;
+
+    printf(">----------------------------------------------------<" EOL);
+    printf("Time error against node %u" EOL, nodes[referenceNodeIndex].id);
+    for (u32 i = 0; i < GetTotalNodes(); i++)
+    {
+        if (distances[i] == UINT32_MAX) continue;
+        const i32 errorTicks = GetTimeErrorTicks(i, referenceNodeIndex);
+        const u32 absErrorTicks = errorTicks < 0 ? -errorTicks : errorTicks;
+        printf("Node %u, hops %u, error %d ticks (%.2f ms), drift %d ppm, estimated %d ppm" EOL,
+            nodes[i].id, distances[i], errorTicks, errorTicks * 1000.0 / ticksPerSecond, nodes[i].clockDriftPpm, nodes[i].gs.timeManager.GetClockDriftPpm());
+
+        std::pair<u32, uint64_t>& entry = errorsByHops[distances[i]];
+        if (absErrorTicks > entry.first) entry.first = absErrorTicks;
+        entry.second += absErrorTicks;
+        nodesByHops[distances[i]]++;
+    }
+    for (const auto& entry : errorsByHops)
+    {
+        printf("Hops %u: %u nodes, max error %.2f ms, avg error %.2f ms" EOL,
+            entry.first, nodesByHops[entry.first],
+            entry.second.first * 1000.0 / ticksPerSecond,
+            entry.second.second * 1000.0 / ticksPerSecond / nodesByHops[entry.first]);
+    }
+    printf(">----------------------------------------------------<" EOL);
+}
+
+void CherrySim::PrintFlashWear()
+{
+    u32 totalErases = 0;
+    u32 totalWrites = 0;
+    u32 totalCoalescedWrites = 0;
+    u32 maxErases = 0;
+
+    printf(">----------------------------------------------------<" EOL);
+    for (u32 i = 0; i < GetTotalNodes(); i++)
+    {
+        u8 numEntries = 0;
+        const FlashStoragePageWear* entries = nodes[i].gs.flashStorage.GetPageWearEntries(numEntries);
+        u32 nodeErases = 0;
+        u32 nodeWrites = 0;
+        u32 nodeMaxErases = 0;
+        u32 nodeMaxErasesPage = 0;
+        for (u32 k = 0; k < numEntries; k++)
+        {
+            nodeErases += entries[k].erases;
+            nodeWrites += entries[k].writes;
+            if (entries[k].erases > nodeMaxErases)
+            {
+                nodeMaxErases = entries[k].erases;
+                nodeMaxErasesPage = entries[k].page;
+            }
+        }
+        const u32 coalescedWrites = nodes[i].gs.flashStorage.GetCoalescedWrites();
+        printf("Node %u, pages %u, erases %u (max %u on page %u), writes %u, coalesced writes %u" EOL,
+            nodes[i].id, numEntries, nodeErases, nodeMaxErases, nodeMaxErasesPage, nodeWrites, coalescedWrites);
+
+        totalErases += nodeErases;
+        totalWrites += nodeWrites;
+        totalCoalescedWrites += coalescedWrites;
+        if (nodeMaxErases > maxErases) maxErases = nodeMaxErases;
+    }
+    printf("Total erases %u (max %u per page), writes %u, coalesced writes %u after %u ms" EOL,
+        totalErases, maxErases, totalWrites, totalCoalescedWrites, simState.simTimeMs);
+    printf(">----------------------------------------------------<" EOL);
+}
+
 void CherrySim::PrintPacketStats(NodeId nodeId, const char* statId)
 {
     if (!simConfig.enableSimStatistics) return;
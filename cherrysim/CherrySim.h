@@ -53,6 +53,7 @@ struct ReplayRecordEntry
     u32 index = 0;
     u32 time = 0;
     std::string command = "";
+    bool skipCrcCheck = false;
 
     bool operator<(const ReplayRecordEntry &other) const
     {
@@ -60,6 +61,17 @@ struct ReplayRecordEntry
     }
 };
 
+//Content of a binary replay record, see CherrySim::StoreBinaryReplayRecord
+struct BinaryReplayRecord
+{
+    SimConfiguration config;
+    std::string siteJson;
+    std::string devicesJson;
+    std::vector<ReplayRecordEntry> entries;
+};
+
+constexpr u32 BINARY_REPLAY_ALL_NODES = UINT32_MAX;
+
 struct FeaturesetPointers
 {
     FeatureSetGroup(*getFeaturesetGroupPtr)(void) = nullptr;
@@ -75,6 +87,8 @@ struct FeaturesetPointers
     const char* featuresetName = nullptr;
 };
 
+//A CherrySim instance must only be used on the thread that created it. Multiple instances
+//can be simulated concurrently as long as each of them is driven by its own thread.
 class CherrySim
 {
     friend class NodeIndexSetter;
@@ -103,6 +117,10 @@ public:
 
     std::queue<ReplayRecordEntry> replayRecordEntries;
 
+    //All terminal commands that were executed so far, in the order of their execution. They are
+    //stored inside binary replays and are only recorded if simConfig.recordTerminalCommands is set.
+    std::vector<ReplayRecordEntry> executedTerminalCommands;
+
     NodeEntry* GetNodeEntryBySerialNumber(u32 serialNumber);
 
     static std::string LoadFileContents(const char* path);
@@ -112,6 +130,15 @@ public:
     static SimConfiguration ExtractSimConfigurationFromReplayRecord(const std::string &fileContents);
     static void CheckVersionFromReplayRecord(const std::string &fileContents);
 
+    //Binary replay records contain the same information as a replay log but are indexed by
+    //time and by node, so that loading them or a time window of them requires no parsing.
+    static bool IsBinaryReplayRecord(const std::string& path);
+    static void StoreBinaryReplayRecord(const std::string& path, const BinaryReplayRecord& record);
+    static BinaryReplayRecord LoadBinaryReplayRecord(const std::string& path, u32 fromTimeMs = 0, u32 toTimeMs = UINT32_MAX, u32 nodeIndex = BINARY_REPLAY_ALL_NODES);
+    static void ConvertReplayLogToBinary(const std::string& logPath, const std::string& binaryPath);
+    void StoreBinaryReplay(const std::string& path); //Stores all terminal commands that were executed so far as a binary replay record
+    nlohmann::json GetStateSummary(); //A summary of the simulation state, e.g. to compare a replayed simulation with the original one
+
 private:
 
 TESTER_PUBLIC:
@@ -141,8 +168,27 @@ TESTER_PUBLIC:
 
     bool ShouldSimIvTrigger(u32 ivMs);
 
+    //Union-find over the simulated connections between non asset nodes. A connect merges two components
+    //right away, a disconnect marks the structure as dirty so that it is rebuilt with the next query.
+    std::vector<u32> connectivityParent;
+    u32 connectivityComponents = 0;
+    bool connectivityDirty = true;
+    u32 FindConnectivityRoot(u32 nodeIndex);
+    void MergeConnectivity(u32 nodeIndexA, u32 nodeIndexB);
+    void RebuildConnectivity();
+
+    //Cluster membership of the non asset nodes as reported by their firmware. It is updated after a node has
+    //processed its events, e.g. connects and disconnects, so that the clustering state is known without
+    //going through all nodes.
+    std::vector<ClusterMembership> clusterMemberships;
+    std::map<ClusterId, u32> clusterMemberCounts;
+    std::map<ClusterSize, u32> clusterSizeCounts;
+    bool clusterMembershipChanged = true; //Set by connects, disconnects and membership changes, cleared by CheckMeshingConsistency
+    void UpdateClusterMembership(NodeEntry* node);
+
     void StoreFlashToFile();
     void LoadFlashFromFile();
+    void LoadReplaySiteAndDevices(std::string& siteJson, std::string& devicesJson);
     void PrepareSimulatedFeatureSets();
     void QueueInterrupts();
 
@@ -219,6 +265,13 @@ public:
 
     //GATT Simulation
     void SimulateConnections();
+    u32 GetLinkLayerPacketAirtimeUs(const SoftdeviceConnection* connection, u32 payloadLength) const;
+    u32 GetConnectionEventBudgetUs(const SoftdeviceConnection* connection);
+    void SimulateConnectionEvent(SoftdeviceConnection* connection);
+    void StartNextLinkLayerPacket(ConnectionEventDirection& direction, u32 remainingBudgetUs);
+    void AdvanceConnectionEventDirection(ConnectionEventDirection& direction, u32 fragmentLength, u32 remainingBudgetUs);
+    void CompleteLinkLayerPacket(ConnectionEventDirection& direction);
+    bool CheckConnectionTimeouts(SoftdeviceConnection* connection);
     void SendUnreliableTxCompleteEvent(NodeEntry* node, int connHandle, u8 packetCount);
     void GenerateWrite(SoftDeviceBufferedPacket* bufferedPacket);
     void GenerateNotification(SoftDeviceBufferedPacket* bufferedPacket);
@@ -258,8 +311,13 @@ public:
     void AddPacketToStats(PacketStat* statArray, PacketStat* packet);
     void AddMessageToStats(PacketStat* statArray, u8* message, u16 messageLength);
     void PrintPacketStats(NodeId nodeId, const char* statId);
+    void PrintTimeSyncAccuracy(u32 referenceNodeIndex);
+    void PrintFlashWear();
 
     //#### Helpers
+    u32 GetNumberOfConnectedComponents(); //Number of groups of non asset nodes that are connected through simulated connections
+    std::vector<u32> GetHopDistances(u32 fromNodeIndex); //Hops over simulated connections to each node, UINT32_MAX if unreachable
+    i32 GetTimeErrorTicks(u32 nodeIndex, u32 referenceNodeIndex); //How far the time of the node is ahead of the reference
     bool IsClusteringDone();
     bool IsClusteringDoneWithDifferentNetworkIds();    //Checks if each network Id for itself is completly clustered.
     bool IsClusteringDoneWithExpectedNumberOfClusters(u32 clusters);
@@ -44,11 +44,14 @@
 /**
 The CherrySimRunner is used to start the simulator in a forever running loop.
 Terminal input into all nodes is possible and visualization works using FruityMap.
+
+Alternatively, it can run a headless batch of simulations over a range of seeds and
+node counts ("sweep" parameter), see CherrySimSweep.
 */
 
 static bool shortLived = false; //Used for making sure that the Runner is able to run on CI.
 static std::chrono::high_resolution_clock::time_point startTime;
-extern bool meshGwCommunication;
+extern SIM_THREAD_LOCAL bool meshGwCommunication;
 
 #ifdef CHERRYSIM_RUNNER_ENABLED
 int main(int argc, char** argv) {
@@ -61,11 +64,21 @@ int main(int argc, char** argv) {
 
     CherrySimRunnerConfig runnerConfig = CherrySimRunner::CreateDefaultTesterConfiguration();
     SimConfiguration simConfig = CherrySimRunner::CreateDefaultRunConfiguration();
+    CherrySimSweepConfig sweepConfig;
+    bool sweep = false;
 
     for (int i = 0; i < argc; i++)
     {
         std::string s = argv[i];
-        if (s == "MeshGwCommunication")
+        if (s == "sweep")
+        {
+            sweep = true;
+        }
+        else if (s.find('=') != std::string::npos && CherrySimSweep::ParseArgument(sweepConfig, s))
+        {
+            //Parsed into the sweepConfig
+        }
+        else if (s == "MeshGwCommunication")
         {
             meshGwCommunication = true;
             std::ifstream i("MeshGWCommunicationConfig.json");
@@ -82,6 +95,13 @@ int main(int argc, char** argv) {
         {
             shortLived = true;
         }
+        else if (s == "convertReplay" && i + 2 < argc)
+        {
+            //Converts a replay log into the binary replay format: convertReplay <log> <binary>
+            CherrySim::ConvertReplayLogToBinary(argv[i + 1], argv[i + 2]);
+            printf("Converted %s to %s" EOL, argv[i + 1], argv[i + 2]);
+            return 0;
+        }
         else
         {
             if (i != 0) std::cerr << "WARNING: unknown parameter " << s << "\n";
@@ -93,19 +113,17 @@ int main(int argc, char** argv) {
     printf("Current Working Directory: %s" EOL, currentWorkingDir.string().c_str());
 #endif
 
-    //The following exceptions are correctly handled by FruityMesh, they don't require us to terminate the simulator.
-    Exceptions::ExceptionDisabler<ErrorCodeUnknownException> ecue;
-    Exceptions::ExceptionDisabler<CRCMissingException> crcme;
-    Exceptions::ExceptionDisabler<CRCInvalidException> crcie;
-    Exceptions::ExceptionDisabler<CommandNotFoundException> disabler;
+    RunnerExceptionDisablers disablers;
 
-    //Failing a SystemTest just because one Error Message was logged somewhere is
-    //probably too harsh and will lead to more issues than it solves in the future.
-    Exceptions::ExceptionDisabler<ErrorLoggedException> ele;
+    if (sweep)
+    {
+        return CherrySimSweep::Run(sweepConfig, simConfig);
+    }
 
     //@ReplayFeature@ <- Don't change this, it's a label used in the documentation.
     //You may use the following line to enable the replay feature. As this change
-    //should not get commited anyway, you may use absolut paths.
+    //should not get commited anyway, you may use absolut paths. Binary replay records
+    //(see "convertReplay") can be used the same way.
     //simConfig.replayPath = "C:/Path/to/some/log/file/MyLog.log";
 
     CherrySimRunner* runner = new CherrySimRunner(runnerConfig, simConfig, meshGwCommunication);
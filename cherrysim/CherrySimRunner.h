@@ -30,6 +30,7 @@
 #pragma once
 
 #include <CherrySim.h>
+#include <CherrySimSweep.h>
 #include <thread>
 #include <string>
 #include <vector>
@@ -0,0 +1,296 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH. 
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "CherrySimSweep.h"
+#include "CherrySim.h"
+#include <string>
+#include <fstream>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include "json.hpp"
+
+/**
+The CherrySimSweep runs a headless batch of simulations over a range of seeds and node counts
+and writes the aggregated results to a CSV and a JSON file. It is started by the CherrySimRunner
+with the "sweep" parameter.
+*/
+
+extern SIM_THREAD_LOCAL std::map<std::string, int> simStatCounts;
+
+void to_json(nlohmann::json& j, const CherrySimSweepResult& result)
+{
+    j = nlohmann::json{
+        { "seed"                 , result.seed                  },
+        { "nodes"                , result.nodes                 },
+        { "completed"            , result.completed             },
+        { "clustered"            , result.clustered             },
+        { "clusteringTimeMs"     , result.clusteringTimeMs      },
+        { "simTimeMs"            , result.simTimeMs             },
+        { "packetsSent"          , result.packetsSent           },
+        { "packetsDelivered"     , result.packetsDelivered      },
+        { "packetsDropped"       , result.packetsDropped        },
+        { "bytesDelivered"       , result.bytesDelivered        },
+        { "packetLossPercent"    , result.packetLossPercent     },
+        { "throughputBytesPerSec", result.throughputBytesPerSec },
+    };
+}
+
+void from_json(const nlohmann::json& j, CherrySimSweepResult& result)
+{
+    j.at("seed").get_to(result.seed);
+    j.at("nodes").get_to(result.nodes);
+    j.at("completed").get_to(result.completed);
+    j.at("clustered").get_to(result.clustered);
+    j.at("clusteringTimeMs").get_to(result.clusteringTimeMs);
+    j.at("simTimeMs").get_to(result.simTimeMs);
+    j.at("packetsSent").get_to(result.packetsSent);
+    j.at("packetsDelivered").get_to(result.packetsDelivered);
+    j.at("packetsDropped").get_to(result.packetsDropped);
+    j.at("bytesDelivered").get_to(result.bytesDelivered);
+    j.at("packetLossPercent").get_to(result.packetLossPercent);
+    j.at("throughputBytesPerSec").get_to(result.throughputBytesPerSec);
+}
+
+//Parses arguments of the form key=value, e.g. seeds=100-199 nodes=10,25,50 scenario=site.json jobs=8 out=results
+bool CherrySimSweep::ParseArgument(CherrySimSweepConfig& config, const std::string& arg)
+{
+    const size_t separator = arg.find('=');
+    if (separator == std::string::npos) return false;
+    const std::string key = arg.substr(0, separator);
+    const std::string value = arg.substr(separator + 1);
+
+    try
+    {
+        if (key == "seeds")
+        {
+            const size_t dash = value.find('-');
+            config.seedStart = (u32)std::stoul(value.substr(0, dash));
+            config.seedEnd = dash == std::string::npos ? config.seedStart : (u32)std::stoul(value.substr(dash + 1));
+            if (config.seedEnd < config.seedStart) return false;
+        }
+        else if (key == "nodes")
+        {
+            config.nodeCounts.clear();
+            size_t start = 0;
+            while (start <= value.size())
+            {
+                size_t end = value.find(',', start);
+                if (end == std::string::npos) end = value.size();
+                config.nodeCounts.push_back((u32)std::stoul(value.substr(start, end - start)));
+                start = end + 1;
+            }
+        }
+        else if (key == "scenario")       config.scenarioPath = value;
+        else if (key == "meshFeatureset") config.meshFeatureset = value;
+        else if (key == "timeLimitSec")   config.timeLimitSec = (u32)std::stoul(value);
+        else if (key == "measureSec")     config.measureSec = (u32)std::stoul(value);
+        else if (key == "jobs")           config.jobs = (u32)std::stoul(value);
+        else if (key == "out")            config.outputPath = value;
+        else return false;
+    }
+    catch (const std::logic_error&)
+    {
+        //Thrown by std::stoul for malformed numbers
+        return false;
+    }
+    return true;
+}
+
+CherrySimSweepResult CherrySimSweep::RunEntry(const CherrySimSweepConfig& config, const SimConfiguration& defaultConfig, u32 seed, u32 nodes)
+{
+    CherrySimSweepResult result;
+    result.seed = seed;
+    result.nodes = nodes;
+
+    //The statistics are kept per thread and a thread executes multiple runs
+    simStatCounts.clear();
+
+    SimConfiguration simConfig = defaultConfig;
+    if (config.scenarioPath != "")
+    {
+        std::ifstream i(config.scenarioPath);
+        if (!i)
+        {
+            SIMEXCEPTION(FileException);
+            return result;
+        }
+        nlohmann::json configJson;
+        i >> configJson;
+        simConfig = configJson;
+    }
+
+    //Runs are headless and as fast as possible
+    simConfig.seed = seed;
+    simConfig.playDelay = 0;
+    simConfig.realTime = false;
+    simConfig.terminalId = -1;
+    simConfig.verbose = false;
+    simConfig.verboseCommands = false;
+    simConfig.logReplayCommands = false;
+    simConfig.replayPath = "";
+    simConfig.startServer = false;
+
+    //All other featuresets keep their amount of nodes, the mesh featureset fills up the rest
+    u32 otherNodes = 0;
+    for (const auto& entry : simConfig.nodeConfigName)
+    {
+        if (entry.first != config.meshFeatureset) otherNodes += entry.second;
+    }
+    if (nodes <= otherNodes)
+    {
+        SIMEXCEPTION(IllegalArgumentException);
+        return result;
+    }
+    simConfig.nodeConfigName[config.meshFeatureset] = nodes - otherNodes;
+
+    CherrySim* sim = new CherrySim(simConfig);
+    sim->Init();
+    sim->nodes[0].uicr.CUSTOMER[11] = (u32)DeviceType::SINK; //deviceType
+    for (u32 i = 0; i < sim->GetTotalNodes(); i++) {
+        NodeIndexSetter setter(i);
+        sim->BootCurrentNode();
+    }
+
+    const u32 timeLimitMs = config.timeLimitSec * 1000;
+    u32 stopTimeMs = timeLimitMs;
+    while (sim->simState.simTimeMs < stopTimeMs)
+    {
+        sim->SimulateStepForAllNodes();
+        if (!result.clustered && sim->IsClusteringDone())
+        {
+            result.clustered = true;
+            result.clusteringTimeMs = sim->simState.simTimeMs;
+            stopTimeMs = sim->simState.simTimeMs + config.measureSec * 1000;
+        }
+    }
+
+    // A cluster update that did not fit into the queue is reported as sendQueueFull and additionally
+    // as vitalPrioQueueFull. It is retried later and thus not lost, so it is not counted as a drop.
+    u32 queueDrops = 0;
+    if (simStatCounts.find("sendQueueFull") != simStatCounts.end()) queueDrops += simStatCounts["sendQueueFull"];
+    if (simStatCounts.find("vitalPrioQueueFull") != simStatCounts.end()) queueDrops -= std::min<u32>(queueDrops, simStatCounts["vitalPrioQueueFull"]);
+
+    result.completed = true;
+    result.simTimeMs = sim->simState.simTimeMs;
+    result.packetsSent = sim->simState.globalPacketIdCounter;
+    result.packetsDelivered = sim->simState.packetsDelivered;
+    result.packetsDropped = sim->simState.packetsDroppedOnDisconnect + queueDrops;
+    result.bytesDelivered = sim->simState.bytesDelivered;
+    if (result.packetsSent + queueDrops > 0)
+    {
+        result.packetLossPercent = 100.0 * result.packetsDropped / (result.packetsSent + queueDrops);
+    }
+    if (result.simTimeMs > 0)
+    {
+        result.throughputBytesPerSec = 1000.0 * result.bytesDelivered / result.simTimeMs;
+    }
+
+    delete sim;
+    return result;
+}
+
+int CherrySimSweep::Run(const CherrySimSweepConfig& config, const SimConfiguration& defaultConfig)
+{
+    if (config.nodeCounts.empty())
+    {
+        printf("Sweep requires a node count list, e.g. nodes=10,25,50" EOL);
+        return 1;
+    }
+
+    std::vector<CherrySimSweepResult> results;
+    for (u32 seed = config.seedStart; seed <= config.seedEnd; seed++)
+    {
+        for (const u32 nodes : config.nodeCounts)
+        {
+            CherrySimSweepResult result;
+            result.seed = seed;
+            result.nodes = nodes;
+            results.push_back(result);
+        }
+    }
+
+    u32 amountOfThreads = config.jobs;
+    if (amountOfThreads == 0) amountOfThreads = std::thread::hardware_concurrency();
+    if (amountOfThreads == 0) amountOfThreads = 1;
+    if (amountOfThreads > results.size()) amountOfThreads = (u32)results.size();
+
+    printf("Sweeping %u runs on %u threads" EOL, (u32)results.size(), amountOfThreads);
+
+    //Every thread simulates its own CherrySim instance, see SIM_THREAD_LOCAL
+    std::atomic<size_t> nextRun{ 0 };
+    u32 finishedRuns = 0;
+    std::mutex printMutex;
+    auto worker = [&]()
+    {
+        RunnerExceptionDisablers disablers;
+        size_t index;
+        while ((index = nextRun++) < results.size())
+        {
+            CherrySimSweepResult& result = results[index];
+            try
+            {
+                result = RunEntry(config, defaultConfig, result.seed, result.nodes);
+            }
+            catch (const std::exception& e)
+            {
+                std::lock_guard<std::mutex> guard(printMutex);
+                printf("Run with seed %u and %u nodes failed: %s" EOL, result.seed, result.nodes, e.what());
+            }
+
+            std::lock_guard<std::mutex> guard(printMutex);
+            finishedRuns++;
+            printf("[%u/%u] seed %u, %u nodes: %s" EOL, finishedRuns, (u32)results.size(), result.seed, result.nodes, result.completed ? "done" : "FAILED");
+        }
+    };
+    std::vector<std::thread> threads;
+    for (u32 i = 0; i < amountOfThreads; i++) threads.emplace_back(worker);
+    for (std::thread& t : threads) t.join();
+
+    std::ofstream csvFile(config.outputPath + ".csv");
+    std::ofstream jsonFile(config.outputPath + ".json");
+    if (!csvFile || !jsonFile)
+    {
+        SIMEXCEPTION(FileException);
+        return 1;
+    }
+    bool allCompleted = true;
+    csvFile << "seed,nodes,completed,clustered,clusteringTimeMs,simTimeMs,packetsSent,packetsDelivered,packetsDropped,bytesDelivered,packetLossPercent,throughputBytesPerSec\n";
+    for (const CherrySimSweepResult& r : results)
+    {
+        csvFile << r.seed << "," << r.nodes << "," << r.completed << "," << r.clustered << "," << r.clusteringTimeMs << "," << r.simTimeMs << ","
+            << r.packetsSent << "," << r.packetsDelivered << "," << r.packetsDropped << "," << r.bytesDelivered << ","
+            << r.packetLossPercent << "," << r.throughputBytesPerSec << "\n";
+        if (!r.completed) allCompleted = false;
+    }
+    jsonFile << nlohmann::json(results).dump(4);
+
+    printf("Sweep results written to %s.csv and %s.json" EOL, config.outputPath.c_str(), config.outputPath.c_str());
+    return allCompleted ? 0 : 1;
+}
@@ -0,0 +1,93 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH. 
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <CherrySim.h>
+#include <string>
+#include <vector>
+
+//The following exceptions are correctly handled by FruityMesh, they don't require us to terminate the simulator.
+//Exceptions are disabled per thread, so every thread that runs a simulation needs its own instance.
+struct RunnerExceptionDisablers
+{
+    Exceptions::ExceptionDisabler<ErrorCodeUnknownException> ecue;
+    Exceptions::ExceptionDisabler<CRCMissingException> crcme;
+    Exceptions::ExceptionDisabler<CRCInvalidException> crcie;
+    Exceptions::ExceptionDisabler<CommandNotFoundException> disabler;
+
+    //Failing a SystemTest just because one Error Message was logged somewhere is
+    //probably too harsh and will lead to more issues than it solves in the future.
+    Exceptions::ExceptionDisabler<ErrorLoggedException> ele;
+};
+
+//Configures a headless batch run over a range of seeds and node counts, see CherrySimSweep::Run
+struct CherrySimSweepConfig
+{
+    u32 seedStart = 1;
+    u32 seedEnd = 1; //Inclusive
+    std::vector<u32> nodeCounts;
+    std::string scenarioPath = ""; //Optional SimConfiguration json, the default run configuration is used otherwise
+    std::string meshFeatureset = "prod_mesh_nrf52"; //The amount of nodes of this featureset is adjusted to reach the node count of a run
+    u32 timeLimitSec = 600; //Simulated time after which a run is stopped if it did not cluster
+    u32 measureSec = 60; //Simulated time that a run continues after clustering so that the packet statistics also cover the clustered mesh
+    u32 jobs = 0; //Amount of runs that are executed concurrently, 0 uses one per CPU core
+    std::string outputPath = "sweep"; //Results are written to <outputPath>.csv and <outputPath>.json
+};
+
+struct CherrySimSweepResult
+{
+    u32 seed = 0;
+    u32 nodes = 0;
+    bool completed = false; //False if the run crashed or threw an exception
+    bool clustered = false;
+    u32 clusteringTimeMs = 0;
+    u32 simTimeMs = 0;
+    u32 packetsSent = 0; //Packets handed to the SoftDevices
+    u32 packetsDelivered = 0;
+    u32 packetsDropped = 0; //Packets dropped because of full send queues or lost in the SoftDevice on a disconnect
+    uint64_t bytesDelivered = 0;
+    double packetLossPercent = 0;
+    double throughputBytesPerSec = 0;
+};
+
+//These two functions must be named exactly like they are! They are used by nlohmann::json.
+void to_json(nlohmann::json& j, const CherrySimSweepResult& result);
+void from_json(const nlohmann::json& j, CherrySimSweepResult& result);
+
+class CherrySimSweep
+{
+public:
+    //Parses arguments of the form key=value, returns false if the argument is not a sweep argument
+    static bool ParseArgument(CherrySimSweepConfig& config, const std::string& arg);
+    //Executes all runs of the sweep on multiple threads and writes the aggregated results.
+    //The defaultConfig is used for all runs unless the config specifies a scenario.
+    static int Run(const CherrySimSweepConfig& config, const SimConfiguration& defaultConfig);
+    static CherrySimSweepResult RunEntry(const CherrySimSweepConfig& config, const SimConfiguration& defaultConfig, u32 seed, u32 nodes);
+};
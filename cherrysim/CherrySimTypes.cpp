@@ -55,17 +55,20 @@ void to_json(nlohmann::json& j, const SimConfiguration & config)
         { "devicesJsonPath"                   , config.devicesJsonPath                   },
         { "replayPath"                        , config.replayPath                        },
         { "logReplayCommands"                 , config.logReplayCommands                 },
+        { "recordTerminalCommands"            , config.recordTerminalCommands            },
         { "useLogAccumulator"                 , config.useLogAccumulator                 },
         { "defaultNetworkId"                  , config.defaultNetworkId                  },
         { "preDefinedPositions"               , config.preDefinedPositions               },
         { "rssiNoise"                         , config.rssiNoise                         },
         { "simulateWatchdog"                  , config.simulateWatchdog                  },
         { "simulateJittering"                 , config.simulateJittering                 },
+        { "maxClockDriftPpm"                  , config.maxClockDriftPpm                  },
         { "verbose"                           , config.verbose                           },
         { "enableClusteringValidityCheck"     , config.enableClusteringValidityCheck     },
         { "enableSimStatistics"               , config.enableSimStatistics               },
         { "storeFlashToFile"                  , config.storeFlashToFile                  },
         { "verboseCommands"                   , config.verboseCommands                   },
+        { "startServer"                       , config.startServer                       },
         { "defaultBleStackType"               , config.defaultBleStackType               },
     };
 }
@@ -100,17 +103,20 @@ void from_json(const nlohmann::json & j, SimConfiguration & config)
         else if(it.key() == "devicesJsonPath"                   ) config.devicesJsonPath                   = *it;
         else if(it.key() == "replayPath"                        ) config.replayPath                        = *it;
         else if(it.key() == "logReplayCommands"                 ) config.logReplayCommands                 = *it;
+        else if(it.key() == "recordTerminalCommands"            ) config.recordTerminalCommands            = *it;
         else if(it.key() == "useLogAccumulator"                 ) config.useLogAccumulator                 = *it;
         else if(it.key() == "defaultNetworkId"                  ) config.defaultNetworkId                  = *it;
         else if(it.key() == "preDefinedPositions"               ) j.at("preDefinedPositions").get_to(config.preDefinedPositions);
         else if(it.key() == "rssiNoise"                         ) config.rssiNoise                         = *it;
         else if(it.key() == "simulateWatchdog"                  ) config.simulateWatchdog                  = *it;
         else if(it.key() == "simulateJittering"                 ) config.simulateJittering                 = *it;
+        else if(it.key() == "maxClockDriftPpm"                  ) config.maxClockDriftPpm                  = *it;
         else if(it.key() == "verbose"                           ) config.verbose                           = *it;
         else if(it.key() == "enableClusteringValidityCheck"     ) config.enableClusteringValidityCheck     = *it;
         else if(it.key() == "enableSimStatistics"               ) config.enableSimStatistics               = *it;
         else if(it.key() == "storeFlashToFile"                  ) config.storeFlashToFile                  = *it;
         else if(it.key() == "verboseCommands"                   ) config.verboseCommands                   = *it;
+        else if(it.key() == "startServer"                       ) config.startServer                       = *it;
         else if(it.key() == "defaultBleStackType"               ) config.defaultBleStackType               = *it;
         else SIMEXCEPTION(UnknownJsonEntryException);
     }
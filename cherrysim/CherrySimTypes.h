@@ -49,7 +49,7 @@ extern "C" {
 
 //Making the instance available to softdevice calls and others
 class CherrySim;
-extern CherrySim* cherrySimInstance;
+extern SIM_THREAD_LOCAL CherrySim* cherrySimInstance;
 
 constexpr int SIM_EVT_QUEUE_SIZE = 50;
 constexpr int SIM_MAX_CONNECTION_NUM = 10; //Maximum total num of connections supported by the simulator
@@ -57,6 +57,16 @@ constexpr int SIM_MAX_CONNECTION_NUM = 10; //Maximum total num of connections su
 constexpr int SIM_NUM_RELIABLE_BUFFERS   = 1;
 constexpr int SIM_NUM_UNRELIABLE_BUFFERS = 7;
 
+//Link layer timing used to simulate connection events, see CherrySim::SimulateConnectionEvent
+constexpr u32 SIM_CONNECTION_EVENT_LENGTH_US     = 5000;      //Same as the event_length configured in FruityHalNrf
+constexpr u32 SIM_LL_DEFAULT_PAYLOAD             = 27;        //Maximum link layer payload until the data length is negotiated
+constexpr u32 SIM_LL_MAX_PAYLOAD                 = 251;       //Maximum link layer payload with data length extension
+constexpr u32 SIM_LL_T_IFS_US                    = 150;       //Inter frame space between two packets
+constexpr u32 SIM_LL_PDU_OVERHEAD                = 4 + 2 + 3; //Access address, header and CRC, the preamble depends on the PHY
+constexpr u32 SIM_LL_MIC_SIZE                    = 4;         //Only present on encrypted connections
+constexpr u32 SIM_L2CAP_ATT_HEADER_SIZE          = 4 + 3;     //L2CAP header plus ATT opcode and handle
+constexpr u32 SIM_LL_MAX_CONSECUTIVE_CRC_ERRORS  = 2;         //The connection event is closed after this many CRC errors in a row
+
 constexpr int SIM_NUM_SERVICES = 6;
 constexpr int SIM_NUM_CHARS    = 5;
 
@@ -116,11 +126,14 @@ struct SoftdeviceConnection {
     NodeEntry* owningNode = nullptr;
     NodeEntry* partner = nullptr;
     struct SoftdeviceConnection* partnerConnection = nullptr;
-    int connectionInterval = 0;
+    u32 connectionIntervalUs = 0; //In us, as the 1.25ms units of the BLE specification do not fit into whole ms
     int connectionMtu = 0;
     u32 connectionSupervisionTimeoutMs = 0;
     bool isCentral = false;
     u32 lastReceivedPacketTimestampMs = 0;
+    u32 phyBitrateKbps = 1000;
+    u32 linkLayerMaxPayload = SIM_LL_DEFAULT_PAYLOAD; //Negotiated data length of the connection
+    uint64_t nextConnectionEventUs = 0; //Node time at which the next connection event takes place, only used by the central
 
     SoftDeviceBufferedPacket reliableBuffers[SIM_NUM_RELIABLE_BUFFERS] = {};
     SoftDeviceBufferedPacket unreliableBuffers[SIM_NUM_UNRELIABLE_BUFFERS] = {};
@@ -130,6 +143,25 @@ struct SoftdeviceConnection {
 
 };
 
+//The cluster that a node belonged to when the simulator last looked at it, see CherrySim::UpdateClusterMembership
+struct ClusterMembership
+{
+    bool tracked = false;
+    ClusterId clusterId = 0;
+    ClusterSize clusterSize = 0;
+};
+
+//The data that one side of a connection transmits during a connection event, see CherrySim::SimulateConnectionEvent
+struct ConnectionEventDirection
+{
+    SoftdeviceConnection* connection = nullptr; //The half of the connection that belongs to the sender
+    SoftDeviceBufferedPacket* packet = nullptr; //The packet that is currently being transmitted
+    u32 remainingLength = 0; //Bytes of the packet that were not yet acknowledged
+    bool moreData = false; //The MD bit, set while the sender has something to transmit in this event
+    bool finished = false; //No further packets are started in this event, e.g. after a reliable write
+    u32 unreliablePacketsSent = 0;
+};
+
 struct CharacteristicDB_t
 {
     ble_uuid_t  uuid = {};
@@ -173,7 +205,7 @@ struct SoftdeviceState {
     int connectingTimeoutTimestampMs = 0;
 
     //Connection
-    int connectionParamIntervalMs = 0;
+    u32 connectionParamIntervalUs = 0;
     int connectionTimeoutMs = 0;
 
     //Connecting security
@@ -251,6 +283,9 @@ struct NodeEntry {
 
     std::vector<int> impossibleConnection; //The rssi to these nodes is artificially increased to an unconnectable level.
 
+    i32 clockDriftPpm = 0; //Positive if the crystal of the node runs too fast, only affects the TimeManager
+    i32 clockDriftRemainder = 0; //Drift in ticks * 1000000 that was not yet applied
+
     std::map<u32, InterruptSettings> gpioInitializedPins; // Map from pin to settings
     std::queue<u32> interruptQueue;
 
@@ -287,6 +322,11 @@ struct SimulatorState {
     u16 globalConnHandleCounter = 0;
     u32 globalEventIdCounter = 0;
     u32 globalPacketIdCounter = 0;
+
+    //Packet accounting of the simulated SoftDevices, used e.g. for batch runs
+    u32 packetsDelivered = 0;
+    uint64_t bytesDelivered = 0;
+    u32 packetsDroppedOnDisconnect = 0; //Packets that were still buffered in a SoftDevice once its connection was lost
 };
 
 struct SimConfiguration {
@@ -320,12 +360,14 @@ struct SimConfiguration {
     std::string devicesJsonPath                    = "";
     std::string replayPath                         = ""; //If set, a replay is loaded from this path.
     bool        logReplayCommands                  = false; //If set, lines are logged out that can be used as input for the replay feature.
+    bool        recordTerminalCommands             = false; //If set, executed terminal commands are kept in memory, required by CherrySim::StoreBinaryReplay
     bool        useLogAccumulator                  = false; //If set, all logs are written to CherrySim::logAccumulator
     u32         defaultNetworkId                   = 0;
     std::vector<std::pair<double, double>> preDefinedPositions;
     bool        rssiNoise                          = false;
     bool        simulateWatchdog                   = false;
     bool        simulateJittering                  = false;
+    uint32_t    maxClockDriftPpm                   = 0; //The crystal of each node runs too fast or too slow by a random amount up to this value
     bool        verbose                            = false;
 
     bool        enableClusteringValidityCheck      = false; //Enable automatic checking of the clustering after each step
@@ -333,6 +375,7 @@ struct SimConfiguration {
     std::string storeFlashToFile                   = "";
 
     bool        verboseCommands                    = false;
+    bool        startServer                        = true; //Set to false for headless runs that should not serve the FruityMap
 
 
     //BLE Stack capabilities
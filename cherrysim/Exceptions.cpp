@@ -30,8 +30,9 @@
 #include "Exceptions.h"
 #include <map>
 
-static std::map<std::type_index, int> ignoredExceptions;
-static int disableDebugBreakOnExceptionCounter = 0;
+//Disabled exceptions only apply to the thread that disabled them, as each thread may run its own simulation
+static thread_local std::map<std::type_index, int> ignoredExceptions;
+static thread_local int disableDebugBreakOnExceptionCounter = 0;
 
 bool Exceptions::GetDebugBreakOnException()
 {
@@ -36,8 +36,10 @@
 #include <iostream>
 #if defined(SIM_SERVER_PRESENT)
 #include <evhttp.h>
+#include <event2/bufferevent.h>
 #endif // SIM_SERVER_PRESENT
 #include <thread>
+#include <mutex>
 #include <json.hpp>
 #include <stdio.h>
 
@@ -70,9 +72,11 @@ using json = nlohmann::json;
 #ifdef _WIN32
 WSADATA wsaData;
 static bool WSAStartupWasCalled = false;
+static std::mutex wsaStartupMutex;
 #endif //_WIN32
-event_base* eventBase = nullptr;
-std::unique_ptr<evhttp, decltype(&evhttp_free)>* server = nullptr;
+//Every thread that simulates its own CherrySim instance may also run its own server
+SIM_THREAD_LOCAL event_base* eventBase = nullptr;
+SIM_THREAD_LOCAL std::unique_ptr<evhttp, decltype(&evhttp_free)>* server = nullptr;
 
 
 //HACK! WSAStartup has a memory leak when called several times, even then WSACleanup is called the same
@@ -102,7 +106,8 @@ int FruitySimServer::StartServer()
     MersenneTwisterDisabler disabler;
 #if defined(SIM_SERVER_PRESENT)
 #ifdef _WIN32
-    //Initialize Winsock
+    //Initialize Winsock, this is done once for the whole process
+    std::lock_guard<std::mutex> wsaGuard(wsaStartupMutex);
     if (!WSAStartupWasCalled) {
         int result = WSAStartup(MAKEWORD(2, 2), &wsaData);
         if (result != 0) {
@@ -113,7 +118,8 @@ int FruitySimServer::StartServer()
     }
 #endif // _WIN32
     
-    eventBase = event_init();
+    //event_init would set the base process wide, each server uses its own base instead
+    eventBase = event_base_new();
 
     if (!eventBase)
     {
@@ -123,14 +129,14 @@ int FruitySimServer::StartServer()
 
     char const SrvAddress[] = "0.0.0.0";
     std::uint16_t SrvPort = 5555;
-    server = new std::unique_ptr<evhttp, decltype(&evhttp_free)>(evhttp_start(SrvAddress, SrvPort), &evhttp_free);
-    if (!server)
+    server = new std::unique_ptr<evhttp, decltype(&evhttp_free)>(evhttp_new(eventBase), &evhttp_free);
+    if (!server->get() || evhttp_bind_socket(server->get(), SrvAddress, SrvPort) != 0)
     {
         std::cerr << "Failed to init http server." << std::endl;
         return -1;
     }
 
-    void(*OnReq)(evhttp_request *req, void *) = [](evhttp_request *req, void *)
+    void(*OnReq)(evhttp_request *req, void *) = [](evhttp_request *req, void *self)
     {
         FILE* file = nullptr;
     
@@ -138,7 +144,13 @@ int FruitySimServer::StartServer()
         if (!OutBuf)
             return;
 
-        if (strstr(req->uri, "/devices") != nullptr)
+        if (strstr(req->uri, "/devices/stream") != nullptr)
+        {
+            //The reply is kept open and is continued in UpdateDeviceStreams
+            static_cast<FruitySimServer*>(self)->OpenDeviceStream(req);
+            return;
+        }
+        else if (strstr(req->uri, "/devices") != nullptr)
         {
             std::string devices = GenerateDevicesJson();
     
@@ -195,7 +207,7 @@ int FruitySimServer::StartServer()
         evhttp_send_reply(req, HTTP_OK, "OK", OutBuf);
     };
     
-    evhttp_set_gencb(server->get(), OnReq, nullptr);
+    evhttp_set_gencb(server->get(), OnReq, this);
 #endif // SIM_SERVER_PRESENT
     return 0;
 }
@@ -203,6 +215,12 @@ int FruitySimServer::StartServer()
 FruitySimServer::~FruitySimServer()
 {
 #if defined(SIM_SERVER_PRESENT)
+    for (const DeviceStream& stream : deviceStreams)
+    {
+        evhttp_connection_set_closecb(stream.connection, nullptr, nullptr);
+        evhttp_send_reply_end(stream.request);
+    }
+    deviceStreams.clear();
     if (server != nullptr) delete server;
     server = nullptr;
     event_base_free(eventBase);
@@ -216,9 +234,112 @@ void FruitySimServer::ProcessServerRequests()
     MersenneTwisterDisabler disabler;
 #if defined(SIM_SERVER_PRESENT)
     event_base_loop(eventBase, EVLOOP_NONBLOCK);
+    UpdateDeviceStreams(false);
 #endif // SIM_SERVER_PRESENT
 }
 
+#if defined(SIM_SERVER_PRESENT)
+void FruitySimServer::OpenDeviceStream(evhttp_request* request)
+{
+    //Bring all other streams up to date first so that all of them continue from the same state
+    UpdateDeviceStreams(true);
+
+    evhttp_connection* connection = evhttp_request_get_connection(request);
+    evhttp_connection_set_closecb(connection, [](evhttp_connection* connection, void* self)
+    {
+        static_cast<FruitySimServer*>(self)->CloseDeviceStream(connection);
+    }, this);
+
+    evhttp_add_header(evhttp_request_get_output_headers(request), "Content-Type", "text/event-stream");
+    evhttp_add_header(evhttp_request_get_output_headers(request), "Cache-Control", "no-cache");
+    evhttp_send_reply_start(request, HTTP_OK, "OK");
+
+    SendDeviceStreamEvent(request, GetAllStreamedDevices());
+
+    deviceStreams.push_back({ connection, request, false });
+}
+
+void FruitySimServer::CloseDeviceStream(evhttp_connection* connection)
+{
+    deviceStreams.erase(std::remove_if(deviceStreams.begin(), deviceStreams.end(),
+        [connection](const DeviceStream& stream) { return stream.connection == connection; }),
+        deviceStreams.end());
+}
+
+void FruitySimServer::UpdateDeviceStreams(bool force)
+{
+    MersenneTwisterDisabler disabler;
+
+    const auto now = std::chrono::steady_clock::now();
+    if (!force)
+    {
+        if (deviceStreams.empty()) return;
+        if (now - lastDeviceStreamUpdate < std::chrono::milliseconds(DEVICE_STREAM_INTERVAL_MS)) return;
+    }
+    lastDeviceStreamUpdate = now;
+
+    //Only the json of devices whose state hash changed since the last update is generated and sent
+    const unsigned int totalNodes = cherrySimInstance->GetTotalNodes();
+    streamedDevices.resize(totalNodes);
+    streamedDeviceHashes.resize(totalNodes);
+    std::string changedDevices;
+    for (unsigned int i = 0; i < totalNodes; i++)
+    {
+        const uint32_t hash = GenerateDeviceStateHash(i);
+        if (!streamedDevices[i].empty() && hash == streamedDeviceHashes[i]) continue;
+        streamedDeviceHashes[i] = hash;
+
+        std::string device = GenerateDeviceJson(i).dump();
+        if (device != streamedDevices[i])
+        {
+            if (!changedDevices.empty()) changedDevices += ",";
+            changedDevices += device;
+            streamedDevices[i] = std::move(device);
+        }
+    }
+
+    for (DeviceStream& stream : deviceStreams)
+    {
+        //Clients that do not keep up are skipped instead of buffering an unbounded amount of events
+        const size_t pendingBytes = evbuffer_get_length(bufferevent_get_output(evhttp_connection_get_bufferevent(stream.connection)));
+        if (pendingBytes > DEVICE_STREAM_MAX_PENDING_BYTES)
+        {
+            stream.missedEvents = true;
+        }
+        else if (stream.missedEvents)
+        {
+            //All skipped events are coalesced into a single one with the current state of all devices
+            SendDeviceStreamEvent(stream.request, GetAllStreamedDevices());
+            stream.missedEvents = false;
+        }
+        else if (!changedDevices.empty())
+        {
+            SendDeviceStreamEvent(stream.request, changedDevices);
+        }
+    }
+}
+
+std::string FruitySimServer::GetAllStreamedDevices() const
+{
+    std::string devices;
+    for (const std::string& device : streamedDevices)
+    {
+        if (!devices.empty()) devices += ",";
+        devices += device;
+    }
+    return devices;
+}
+
+void FruitySimServer::SendDeviceStreamEvent(evhttp_request* request, const std::string& devices)
+{
+    //Same format as the devices endpoint, but only with the given devices
+    evbuffer* buffer = evbuffer_new();
+    evbuffer_add_printf(buffer, "data: {\"status\":\"success\",\"result\":[%s]}\n\n", devices.c_str());
+    evhttp_send_reply_chunk(request, buffer);
+    evbuffer_free(buffer);
+}
+#endif // SIM_SERVER_PRESENT
+
 #if defined(SIM_SERVER_PRESENT)
 std::string FruitySimServer::GenerateSiteJson()
 {
@@ -241,106 +362,164 @@ std::string FruitySimServer::GenerateDevicesJson()
     json devices;
     devices["status"] = "success";
     for (unsigned int i = 0; i < cherrySimInstance->GetTotalNodes(); i++) {
-        NodeIndexSetter nodeIndexSetter(i);
-        NodeEntry* node = &cherrySimInstance->nodes[i];
-        json device;
-
-        //Get the only handshaked inConnection
-        //TODO: The inConnection is only used to draw the direction arrow in the fruitymap, but currently
-        //the json only supports communicating 1 inConnection, this should be changed at some point so that
-        //Each connection can report its direction and masterBit
-        auto inConnections = node->gs.cm.GetMeshConnections(ConnectionDirection::DIRECTION_IN);
-        MeshConnection* inConnection = nullptr;
-        for (int k = 0; k < inConnections.count; k++) {
-            if (inConnections.handles[k] && inConnections.handles[k].IsHandshakeDone()) {
-                inConnection = inConnections.handles[k].GetConnection();
-            }
+        devices["result"].push_back(GenerateDeviceJson(i));
+    }
+
+    return devices.dump(4);
+}
+
+json FruitySimServer::GenerateDeviceJson(unsigned int nodeIndex)
+{
+    NodeIndexSetter nodeIndexSetter(nodeIndex);
+    NodeEntry* node = &cherrySimInstance->nodes[nodeIndex];
+    json device;
+
+    //Get the only handshaked inConnection
+    //TODO: The inConnection is only used to draw the direction arrow in the fruitymap, but currently
+    //the json only supports communicating 1 inConnection, this should be changed at some point so that
+    //Each connection can report its direction and masterBit
+    auto inConnections = node->gs.cm.GetMeshConnections(ConnectionDirection::DIRECTION_IN);
+    MeshConnection* inConnection = nullptr;
+    for (int k = 0; k < inConnections.count; k++) {
+        if (inConnections.handles[k] && inConnections.handles[k].IsHandshakeDone()) {
+            inConnection = inConnections.handles[k].GetConnection();
         }
+    }
 
-        //UUID is generated based on the node index
-        char uuid[50];
-        sprintf(uuid, "00000000-1111-2222-3333-00000000%04u", node->index);
-
-        device["uuid"] = uuid;
-        device["deviceId"] = node->gs.config.GetSerialNumber();
-        device["platform"] = "BLENODE";
-        device["ledOn"] = node->ledOn;
-        device["inConnectionHasMasterBit"] = false;
-        device["inConnectionPartnerHasMasterBit"] = false;
-
-        //Find out who has the master bit of the inConnection
-        if(inConnection != nullptr) device["inConnectionHasMasterBit"] = inConnection->connectionMasterBit == 1;
-
-        bool partnerHasMB = false;
-
-        if (inConnection != nullptr) {
-            SoftdeviceConnection* foundSoftdeviceConnection = cherrySimInstance->FindConnectionByHandle(node, inConnection->connectionHandle);
-            //We must check if the simulator connection still exists as it might have been cleaned up already
-            if (foundSoftdeviceConnection != nullptr) {
-                NodeEntry* partnerNode = foundSoftdeviceConnection->partner;
-                MeshConnections conn = partnerNode->gs.cm.GetMeshConnections(ConnectionDirection::DIRECTION_OUT);
-                for (int k = 0; k < conn.count; k++) {
-                    if (conn.handles[k] && conn.handles[k].GetConnectionHandle() == inConnection->connectionHandle) {
-                        partnerHasMB = conn.handles[k].GetConnection()->connectionMasterBit;
-                    }
+    //UUID is generated based on the node index
+    char uuid[50];
+    sprintf(uuid, "00000000-1111-2222-3333-00000000%04u", node->index);
+
+    device["uuid"] = uuid;
+    device["deviceId"] = node->gs.config.GetSerialNumber();
+    device["platform"] = "BLENODE";
+    device["ledOn"] = node->ledOn;
+    device["inConnectionHasMasterBit"] = false;
+    device["inConnectionPartnerHasMasterBit"] = false;
+
+    //Find out who has the master bit of the inConnection
+    if(inConnection != nullptr) device["inConnectionHasMasterBit"] = inConnection->connectionMasterBit == 1;
+
+    bool partnerHasMB = false;
+
+    if (inConnection != nullptr) {
+        SoftdeviceConnection* foundSoftdeviceConnection = cherrySimInstance->FindConnectionByHandle(node, inConnection->connectionHandle);
+        //We must check if the simulator connection still exists as it might have been cleaned up already
+        if (foundSoftdeviceConnection != nullptr) {
+            NodeEntry* partnerNode = foundSoftdeviceConnection->partner;
+            MeshConnections conn = partnerNode->gs.cm.GetMeshConnections(ConnectionDirection::DIRECTION_OUT);
+            for (int k = 0; k < conn.count; k++) {
+                if (conn.handles[k] && conn.handles[k].GetConnectionHandle() == inConnection->connectionHandle) {
+                    partnerHasMB = conn.handles[k].GetConnection()->connectionMasterBit;
                 }
             }
         }
+    }
 
-        device["inConnectionPartnerHasMasterBit"] = partnerHasMB;
+    device["inConnectionPartnerHasMasterBit"] = partnerHasMB;
 
-        device["connectionLossCounter"] = node->gs.node.connectionLossCounter;
-        device["inConnectionPartner"] = inConnection == nullptr ? 0 : inConnection->partnerId;
+    device["connectionLossCounter"] = node->gs.node.connectionLossCounter;
+    device["inConnectionPartner"] = inConnection == nullptr ? 0 : inConnection->partnerId;
 
 
-        //FIXME: This mixes fruitymesh and simulator connections, but should only use simulator data
-        if (inConnection != nullptr) {
-            SoftdeviceConnection* sdInConn = cherrySimInstance->FindConnectionByHandle(node, inConnection->connectionHandle);
-            if (sdInConn != nullptr) device["inConnectionRssi"] = (int)cherrySimInstance->GetReceptionRssiNoNoise(node, sdInConn->partner);
-        }
-        else {
-            device["inConnectionRssi"] = 0;
-        }
+    //FIXME: This mixes fruitymesh and simulator connections, but should only use simulator data
+    if (inConnection != nullptr) {
+        SoftdeviceConnection* sdInConn = cherrySimInstance->FindConnectionByHandle(node, inConnection->connectionHandle);
+        if (sdInConn != nullptr) device["inConnectionRssi"] = (int)cherrySimInstance->GetReceptionRssiNoNoise(node, sdInConn->partner);
+    }
+    else {
+        device["inConnectionRssi"] = 0;
+    }
 
 
-        char advData[200];
-        if (node->state.advertisingActive) {
-            Logger::ConvertBufferToHexString(node->state.advertisingData, node->state.advertisingDataLength, advData, sizeof(advData));
-        }
-        else {
-            sprintf(advData, "Not advertising");
+    char advData[200];
+    if (node->state.advertisingActive) {
+        Logger::ConvertBufferToHexString(node->state.advertisingData, node->state.advertisingDataLength, advData, sizeof(advData));
+    }
+    else {
+        sprintf(advData, "Not advertising");
+    }
+
+    device["details"] = {
+        {"platform", "BLENODE"},
+        {"clusterId", node->gs.node.clusterId},
+        {"clusterSize", node->gs.node.GetClusterSize()},
+        {"nodeId", node->gs.node.configuration.nodeId},
+        {"serialNumber", node->gs.config.GetSerialNumber()},
+        {"connections", json::array()},
+        {"nonConnections", json::array()},
+        {"lastSentAdvertisingMessage", advData},
+        {"freeIn", node->gs.cm.freeMeshInConnections},
+        {"freeOut", node->gs.cm.freeMeshOutConnections}
+    };
+    for (int j = 0; j < node->state.configuredTotalConnectionCount; j++) {
+        if (node->state.connections[j].connectionActive) {
+            json connection;
+            connection["handle"] = node->state.connections[j].connectionHandle;
+            connection["rssi"] = 7;
+            connection["target"] = node->state.connections[j].partner->gs.node.configuration.nodeId;
+
+            device["details"]["connections"].push_back(connection);
         }
+    }
+    device["properties"] = {
+        {"onMap", "true"},
+        {"x", node->x},
+        {"y", node->y}
+    };
+    return device;
+}
 
-        device["details"] = {
-            {"platform", "BLENODE"},
-            {"clusterId", node->gs.node.clusterId},
-            {"clusterSize", node->gs.node.GetClusterSize()},
-            {"nodeId", node->gs.node.configuration.nodeId},
-            {"serialNumber", node->gs.config.GetSerialNumber()},
-            {"connections", json::array()},
-            {"nonConnections", json::array()},
-            {"lastSentAdvertisingMessage", advData},
-            {"freeIn", node->gs.cm.freeMeshInConnections},
-            {"freeOut", node->gs.cm.freeMeshOutConnections}
-        };
-        for (int j = 0; j < node->state.configuredTotalConnectionCount; j++) {
-            if (node->state.connections[j].connectionActive) {
-                json connection;
-                connection["handle"] = node->state.connections[j].connectionHandle;
-                connection["rssi"] = 7;
-                connection["target"] = node->state.connections[j].partner->gs.node.configuration.nodeId;
-
-                device["details"]["connections"].push_back(connection);
-            }
+uint32_t FruitySimServer::GenerateDeviceStateHash(unsigned int nodeIndex)
+{
+    //FNV-1a over the raw values that GenerateDeviceJson uses, which is a lot cheaper than generating the json
+    uint32_t hash = 2166136261u;
+    auto add = [&hash](const void* data, size_t length)
+    {
+        for (size_t i = 0; i < length; i++)
+        {
+            hash = (hash ^ ((const uint8_t*)data)[i]) * 16777619u;
         }
-        device["properties"] = {
-            {"onMap", "true"},
-            {"x", node->x},
-            {"y", node->y}
-        };
-        devices["result"].push_back(device);
+    };
+
+    NodeIndexSetter nodeIndexSetter(nodeIndex);
+    const NodeEntry* node = &cherrySimInstance->nodes[nodeIndex];
+    const ClusterSize clusterSize = node->gs.node.GetClusterSize();
+    add(&node->ledOn, sizeof(node->ledOn));
+    add(&node->x, sizeof(node->x));
+    add(&node->y, sizeof(node->y));
+    add(&node->gs.node.clusterId, sizeof(node->gs.node.clusterId));
+    add(&clusterSize, sizeof(clusterSize));
+    add(&node->gs.node.configuration.nodeId, sizeof(node->gs.node.configuration.nodeId));
+    add(&node->gs.node.connectionLossCounter, sizeof(node->gs.node.connectionLossCounter));
+    add(&node->gs.cm.freeMeshInConnections, sizeof(node->gs.cm.freeMeshInConnections));
+    add(&node->gs.cm.freeMeshOutConnections, sizeof(node->gs.cm.freeMeshOutConnections));
+    add(&node->state.advertisingActive, sizeof(node->state.advertisingActive));
+    if (node->state.advertisingActive) add(node->state.advertisingData, node->state.advertisingDataLength);
+
+    //The master bit moves between both ends of a connection, so the own mesh connections are enough to detect a change
+    MeshConnections meshConnections = node->gs.cm.GetMeshConnections(ConnectionDirection::INVALID);
+    for (int i = 0; i < meshConnections.count; i++)
+    {
+        MeshConnection* connection = meshConnections.handles[i].GetConnection();
+        if (connection == nullptr) continue;
+        const bool handshakeDone = connection->HandshakeDone();
+        add(&connection->connectionHandle, sizeof(connection->connectionHandle));
+        add(&connection->partnerId, sizeof(connection->partnerId));
+        add(&connection->connectionMasterBit, sizeof(connection->connectionMasterBit));
+        add(&handshakeDone, sizeof(handshakeDone));
     }
 
-    return devices.dump(4);
+    //The rssi of a connection also changes if the partner moves
+    for (int i = 0; i < node->state.configuredTotalConnectionCount; i++)
+    {
+        const SoftdeviceConnection& connection = node->state.connections[i];
+        if (!connection.connectionActive) continue;
+        add(&connection.connectionHandle, sizeof(connection.connectionHandle));
+        add(&connection.partner->gs.node.configuration.nodeId, sizeof(connection.partner->gs.node.configuration.nodeId));
+        add(&connection.partner->x, sizeof(connection.partner->x));
+        add(&connection.partner->y, sizeof(connection.partner->y));
+    }
+    return hash;
 }
 #endif // SIM_SERVER_PRESENT
@@ -30,6 +30,13 @@
 #pragma once
 
 #include <string>
+#include <vector>
+#include <chrono>
+#include <utility>
+#include <json.hpp>
+
+struct evhttp_request;
+struct evhttp_connection;
 
 class FruitySimServer
 {
@@ -45,5 +52,32 @@ private:
 
     static std::string GenerateDevicesJson();
     static std::string GenerateSiteJson();
-};
+    static nlohmann::json GenerateDeviceJson(unsigned int nodeIndex);
+    //Hash over the simulator state that the device json is generated from
+    static uint32_t GenerateDeviceStateHash(unsigned int nodeIndex);
 
+    //#### Device stream
+    //Clients of /devices/stream receive the devices as server-sent events. The first event contains
+    //all devices, afterwards only devices whose json changed are sent. The json is only
+    //generated again for devices whose state hash changed.
+    static constexpr int DEVICE_STREAM_INTERVAL_MS = 250;
+    //A client that has more than this amount of bytes waiting to be sent does not receive further
+    //events. Once it caught up, it receives all devices again instead of the events it missed.
+    static constexpr size_t DEVICE_STREAM_MAX_PENDING_BYTES = 64 * 1024;
+    struct DeviceStream
+    {
+        evhttp_connection* connection;
+        evhttp_request* request;
+        bool missedEvents;
+    };
+    std::vector<DeviceStream> deviceStreams;
+    std::vector<std::string> streamedDevices; //The last json of each device that was sent to all streams
+    std::vector<uint32_t> streamedDeviceHashes; //The state hash of each device when its json was last generated
+    std::chrono::steady_clock::time_point lastDeviceStreamUpdate;
+
+    void OpenDeviceStream(evhttp_request* request);
+    void CloseDeviceStream(evhttp_connection* connection);
+    void UpdateDeviceStreams(bool force);
+    std::string GetAllStreamedDevices() const;
+    static void SendDeviceStreamEvent(evhttp_request* request, const std::string& devices);
+};
@@ -756,6 +756,18 @@ uint32_t MersenneTwister::NextU32()
     return x;
 }
 
+uint32_t MersenneTwister::GetStateChecksum() const
+{
+    //FNV-1a over the index and the state words
+    uint32_t checksum = 2166136261u;
+    checksum = (checksum ^ m_index) * 16777619u;
+    for (uint32_t i = 0; i < N; i++)
+    {
+        checksum = (checksum ^ m_mt[i]) * 16777619u;
+    }
+    return checksum;
+}
+
 MersenneTwisterDisabler::MersenneTwisterDisabler()
 {
     disableLevel++;
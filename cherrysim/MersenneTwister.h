@@ -29,7 +29,7 @@
 
 class MersenneTwisterDisabler {
 public:
-    static inline int disableLevel = 0;
+    static inline thread_local int disableLevel = 0;
 
     MersenneTwisterDisabler();
     ~MersenneTwisterDisabler();
@@ -62,7 +62,8 @@ private:
     void Twist();
 
 public:
-    static inline uint32_t seedOffset = 0;
+    //Set per thread so that concurrent simulations can use different seeds
+    static inline thread_local uint32_t seedOffset = 0;
 
     MersenneTwister();
     explicit MersenneTwister(uint32_t seed);
@@ -74,6 +75,10 @@ public:
     uint32_t NextU32(uint32_t min, uint32_t max);
 
     bool NextPsrng(uint32_t probability);
+
+    //Checksum over the complete generator state, two generators with the same checksum will
+    //(with a very high probability) produce the same sequence of numbers.
+    uint32_t GetStateChecksum() const;
 };
 
 
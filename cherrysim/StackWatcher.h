@@ -52,8 +52,9 @@ class StackWatcher
     friend StackBaseSetter;
     friend StackWatcherDisabler;
 private:
-    static std::vector<const void*> stackBase;
-    static u32 disableValue;
+    //Kept per thread as every thread has its own stack
+    static thread_local std::vector<const void*> stackBase;
+    static thread_local u32 disableValue;
 
 public:
     static void Check();
@@ -56,20 +56,20 @@ All calls work in conjunction with helper methods and simulation routines define
 using json = nlohmann::json;
 
 //These variables are normally defined by the linker sections, so we need to define them here
-uint32_t __application_start_address;
-uint32_t __application_end_address;
-uint32_t __application_ram_start_address;
-uint32_t __start_conn_type_resolvers;
-uint32_t __stop_conn_type_resolvers;
+SIM_THREAD_LOCAL uint32_t __application_start_address;
+SIM_THREAD_LOCAL uint32_t __application_end_address;
+SIM_THREAD_LOCAL uint32_t __application_ram_start_address;
+SIM_THREAD_LOCAL uint32_t __start_conn_type_resolvers;
+SIM_THREAD_LOCAL uint32_t __stop_conn_type_resolvers;
 
 //Pointer to FruityMesh state
-GlobalState* simGlobalStatePtr;
+SIM_THREAD_LOCAL GlobalState* simGlobalStatePtr;
 
 //nRF hardware abstraction
-NRF_FICR_Type* simFicrPtr;
-NRF_UICR_Type* simUicrPtr;
-NRF_GPIO_Type* simGpioPtr;
-uint8_t* simFlashPtr;
+SIM_THREAD_LOCAL NRF_FICR_Type* simFicrPtr;
+SIM_THREAD_LOCAL NRF_UICR_Type* simUicrPtr;
+SIM_THREAD_LOCAL NRF_GPIO_Type* simGpioPtr;
+SIM_THREAD_LOCAL uint8_t* simFlashPtr;
 
 
 //########################################### SoftDevice Call Redirection #####################################################
@@ -855,7 +855,7 @@ extern "C"
         cherrySimInstance->currentNode->state.connectingWindowMs = UNITS_TO_MSEC(p_scan_params->window, UNIT_0_625_MS);
         cherrySimInstance->currentNode->state.connectingTimeoutTimestampMs = cherrySimInstance->simState.simTimeMs + p_scan_params->timeout * 1000UL;
 
-        cherrySimInstance->currentNode->state.connectionParamIntervalMs = UNITS_TO_MSEC(p_conn_params->min_conn_interval, UNIT_1_25_MS);
+        cherrySimInstance->currentNode->state.connectionParamIntervalUs = (u32)p_conn_params->min_conn_interval * 1250;
         cherrySimInstance->currentNode->state.connectionTimeoutMs = UNITS_TO_MSEC(p_conn_params->conn_sup_timeout, CONFIG_UNIT_10_MS);
 
         //TODO: could save more params, could return invalid state
@@ -975,6 +975,25 @@ extern "C"
             return NRF_ERROR_BUSY;
         }
 
+        SoftdeviceConnection* connection = cherrySimInstance->FindConnectionByHandle(cherrySimInstance->currentNode, conn_handle);
+
+        if (connection == nullptr) {
+            return BLE_ERROR_INVALID_CONN_HANDLE;
+        }
+        if (
+            p_conn_params == nullptr
+            || p_conn_params->min_conn_interval < BLE_GAP_CP_MIN_CONN_INTVL_MIN
+            || p_conn_params->min_conn_interval > p_conn_params->max_conn_interval
+        ) {
+            return NRF_ERROR_INVALID_PARAM;
+        }
+
+        //The negotiation is not simulated, both sides use the new interval right away
+        connection->connectionIntervalUs = (u32)p_conn_params->min_conn_interval * 1250;
+        if (connection->partnerConnection != nullptr) {
+            connection->partnerConnection->connectionIntervalUs = connection->connectionIntervalUs;
+        }
+
         return 0;
     }
 
@@ -1630,7 +1649,7 @@ const char *__asan_default_options() {
 // These calls can be made within FruityMesh using the macros (e.g. SIMSTATCOUNT)
 //#########################################################################################
 
-std::map<std::string, int> simStatCounts;
+SIM_THREAD_LOCAL std::map<std::string, int> simStatCounts;
 void sim_collect_statistic_count(const char* key)
 {
     if (simStatCounts.find(key) != simStatCounts.end())
@@ -1642,8 +1661,8 @@ void sim_collect_statistic_count(const char* key)
     }
 }
 
-std::map<std::string, int> simStatAvgCounts;
-std::map<std::string, int> simStatAvgTotal;
+SIM_THREAD_LOCAL std::map<std::string, int> simStatAvgCounts;
+SIM_THREAD_LOCAL std::map<std::string, int> simStatAvgTotal;
 void sim_collect_statistic_avg(const char* key, int value)
 {
     if (simStatAvgCounts.find(key) != simStatAvgCounts.end())
@@ -107,12 +107,22 @@
 #include <stdbool.h>
 #include <stddef.h>
 
+//Each thread may simulate its own CherrySim instance. All state that is swapped when
+//the simulated node changes is therefore kept per thread.
+#if defined(__cplusplus)
+#define SIM_THREAD_LOCAL thread_local
+#elif defined(_MSC_VER)
+#define SIM_THREAD_LOCAL __declspec(thread)
+#else
+#define SIM_THREAD_LOCAL _Thread_local
+#endif
+
 #ifdef __cplusplus
 typedef class Node Node;
 typedef class GlobalState GlobalState;
 
 //We keep a pointer to our GlobalState, this state contains the whole state of a node as known to FruityMesh
-extern GlobalState* simGlobalStatePtr;
+extern SIM_THREAD_LOCAL GlobalState* simGlobalStatePtr;
 #define GS (simGlobalStatePtr)
 #endif //__cplusplus
 
@@ -140,6 +150,7 @@ extern "C" {
 #define ACTIVATE_MODBUS_MODULE 1
 #define ACTIVATE_MODBUS_COMM 1
 #define ACTIVATE_INS 1
+#define ACTIVATE_BULK_ENROLLMENT 1
 
 #define ACTIVATE_UNSECURE_MEMORY_READBACK 1
 
@@ -697,11 +708,11 @@ extern int globalBreakCounter;
 //We keep a number of pointers to hardware peripherals so that our FruityMesh implementation
 //does not have to include the simulator. It will access all hardware using these pointers and we can
 //therefore redirect all access
-extern NRF_FICR_Type* simFicrPtr;
-extern NRF_UICR_Type* simUicrPtr;
-extern NRF_GPIO_Type* simGpioPtr;
-extern NRF_UART_Type* simUartPtr;
-extern uint8_t* simFlashPtr;
+extern SIM_THREAD_LOCAL NRF_FICR_Type* simFicrPtr;
+extern SIM_THREAD_LOCAL NRF_UICR_Type* simUicrPtr;
+extern SIM_THREAD_LOCAL NRF_GPIO_Type* simGpioPtr;
+extern SIM_THREAD_LOCAL NRF_UART_Type* simUartPtr;
+extern SIM_THREAD_LOCAL uint8_t* simFlashPtr;
 #define NRF_FICR (simFicrPtr)
 #define NRF_UICR (simUicrPtr)
 #define NRF_GPIO (simGpioPtr)
@@ -0,0 +1,182 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH. 
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "gtest/gtest.h"
+#include <CherrySimTester.h>
+#include <Node.h>
+#include <AdvertisingController.h>
+#include <MeshAccessModule.h>
+
+static AdvJob CreateScheduledJob(u8 slots, u16 targetIntervalDs, u16 maxStalenessDs)
+{
+    AdvJob job = {
+        AdvJobTypes::SCHEDULED,
+        slots, //Slots
+        0, //Delay
+        MSEC_TO_UNITS(100, CONFIG_UNIT_0_625_MS), //AdvInterval
+        0, //AdvChannel
+        0, //CurrentSlots
+        0, //CurrentDelay
+        FruityHal::BleGapAdvType::ADV_IND, //Advertising Mode
+        {0x02, 0x01, 0x06}, //AdvData
+        3, //AdvDataLength
+        {0}, //ScanData
+        0 //ScanDataLength
+    };
+    job.targetIntervalDs = targetIntervalDs;
+    job.maxStalenessDs = maxStalenessDs;
+    return job;
+}
+
+//Simulates the node for the given number of slots, the controller selects a job at the start of each slot
+static void ScheduleSlots(CherrySimTester& tester, u32 numSlots)
+{
+    tester.SimulateForGivenTime(numSlots * ADVERTISING_CONTROLLER_SLOT_DS * 100);
+}
+
+static AdvJob* AddJob(const AdvJob& job)
+{
+    NodeIndexSetter setter(0);
+    return GS->advertisingController.AddJob(job);
+}
+
+static void RemoveJob(AdvJob* job)
+{
+    NodeIndexSetter setter(0);
+    GS->advertisingController.RemoveJob(job);
+}
+
+static u32 GetAchievedIntervalDs(const AdvJob* job)
+{
+    NodeIndexSetter setter(0);
+    return GS->advertisingController.GetAchievedIntervalDs(*job);
+}
+
+TEST(TestAdvertisingController, TestDeadlineScheduling) {
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    //An unenrolled node has no join me job and busy errors would leave slots without advertising
+    simConfig.defaultNetworkId = 0;
+    simConfig.sdBusyProbability = 0;
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+    tester.SimulateForGivenTime(1000);
+
+    {
+        NodeIndexSetter setter(0);
+        //Stop the mesh access broadcast so that the module does not write into the jobs of the test
+        MeshAccessModule* maMod = (MeshAccessModule*)GS->node.GetModuleById(ModuleId::MESH_ACCESS_MODULE);
+        if (maMod != nullptr) {
+            maMod->enableAdvertising = false;
+            maMod->UpdateMeshAccessBroadcastPacket();
+        }
+        AdvertisingController& advCtrl = GS->advertisingController;
+        for (u32 i = 0; i < advCtrl.jobs.size(); i++)
+        {
+            advCtrl.RemoveJob(&advCtrl.jobs[i]);
+        }
+    }
+
+    //A join me like job that needs every slot competes with beacons that want to be advertised as often
+    AdvJob* importantJob = AddJob(CreateScheduledJob(5, ADVERTISING_CONTROLLER_SLOT_DS, SEC_TO_DS(1)));
+    AdvJob* beaconA = AddJob(CreateScheduledJob(10, 0, 0));
+    AdvJob* beaconB = AddJob(CreateScheduledJob(10, 0, 0));
+    AdvJob* slowJob = AddJob(CreateScheduledJob(1, SEC_TO_DS(4), 0));
+    ASSERT_NE(importantJob, nullptr);
+    ASSERT_NE(beaconA, nullptr);
+    ASSERT_NE(beaconB, nullptr);
+    ASSERT_NE(slowJob, nullptr);
+
+    ScheduleSlots(tester, 1000);
+
+    //The deadline of the important job is always met, no matter how many jobs are due
+    ASSERT_EQ(importantJob->numDeadlineMisses, 0);
+    ASSERT_GT(GetAchievedIntervalDs(importantJob), 0u);
+    ASSERT_LE(GetAchievedIntervalDs(importantJob), (u32)SEC_TO_DS(1));
+
+    //The others share the remaining slots according to their target rates
+    ASSERT_GT(beaconA->numAdvertisedSlots, 200u);
+    ASSERT_GT(beaconB->numAdvertisedSlots, 200u);
+    ASSERT_GT(slowJob->numAdvertisedSlots, 0u);
+    ASSERT_LT(slowJob->numAdvertisedSlots * 5, beaconA->numAdvertisedSlots);
+    const u32 slowIntervalWhileContended = GetAchievedIntervalDs(slowJob);
+    ASSERT_GT(slowIntervalWhileContended, 0u);
+    //Every slot is advertised by one of the jobs, the simulated time may start in the middle of a slot
+    const u32 totalAdvertisedSlots = importantJob->numAdvertisedSlots + beaconA->numAdvertisedSlots + beaconB->numAdvertisedSlots + slowJob->numAdvertisedSlots;
+    ASSERT_GE(totalAdvertisedSlots, 999u);
+    ASSERT_LE(totalAdvertisedSlots, 1001u);
+
+    //Without competition, a job is advertised at least at its target rate, spare slots go to the job that is furthest behind
+    RemoveJob(importantJob);
+    RemoveJob(beaconA);
+    RemoveJob(beaconB);
+    AdvJob* filler = AddJob(CreateScheduledJob(1, SEC_TO_DS(100), 0));
+    ASSERT_NE(filler, nullptr);
+    const u32 slowAdvertisedBefore = slowJob->numAdvertisedSlots;
+    ScheduleSlots(tester, 100);
+    ASSERT_GE(slowJob->numAdvertisedSlots - slowAdvertisedBefore, 100 * ADVERTISING_CONTROLLER_SLOT_DS / SEC_TO_DS(4));
+    ASSERT_GT(filler->numAdvertisedSlots, 0u);
+
+    //The achieved interval follows the current rate of a job instead of its lifetime average
+    ASSERT_GT(GetAchievedIntervalDs(slowJob), 0u);
+    ASSERT_LT(GetAchievedIntervalDs(slowJob) * 2, slowIntervalWhileContended);
+
+    //A job that is no longer advertised does not keep its old rate
+    {
+        NodeIndexSetter setter(0);
+        slowJob->slots = 0;
+        GS->advertisingController.RefreshJob(slowJob);
+    }
+    ScheduleSlots(tester, 2 * ADVERTISING_CONTROLLER_METRICS_WINDOW_DS / ADVERTISING_CONTROLLER_SLOT_DS + 1);
+    ASSERT_GT(slowJob->numAdvertisedSlots, 0u);
+    ASSERT_EQ(GetAchievedIntervalDs(slowJob), 0u);
+    RemoveJob(slowJob);
+
+    //A delayed job is not advertised before its delay has passed
+    AdvJob delayedJob = CreateScheduledJob(10, 0, SEC_TO_DS(1));
+    delayedJob.delay = 5;
+    AdvJob* delayed = AddJob(delayedJob);
+    ASSERT_NE(delayed, nullptr);
+    ScheduleSlots(tester, 5);
+    ASSERT_EQ(delayed->numAdvertisedSlots, 0u);
+    ScheduleSlots(tester, 5);
+    ASSERT_GT(delayed->numAdvertisedSlots, 0u);
+
+    //After it was advertised for its slots, it is delayed again
+    for (u32 i = 0; i < 100 && delayed->numAdvertisedSlots < delayedJob.slots; i++)
+    {
+        ScheduleSlots(tester, 1);
+    }
+    ASSERT_EQ(delayed->numAdvertisedSlots, delayedJob.slots);
+    ScheduleSlots(tester, 5);
+    ASSERT_EQ(delayed->numAdvertisedSlots, delayedJob.slots);
+    ScheduleSlots(tester, 5);
+    ASSERT_GT(delayed->numAdvertisedSlots, delayedJob.slots);
+}
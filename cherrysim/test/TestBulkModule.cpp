@@ -0,0 +1,229 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH. 
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "gtest/gtest.h"
+#include <CherrySimTester.h>
+#include "BulkModule.h"
+
+static void FillTransferBuffer(CherrySimTester& tester, u32 nodeIndex, u32 size)
+{
+    NodeIndexSetter setter(nodeIndex);
+    BulkModule* mod = (BulkModule*)GS->node.GetModuleById(ModuleId::BULK_MODULE);
+    ASSERT_NE(mod, nullptr);
+
+    u8 data[BulkModule::CHUNK_SIZE];
+    for (u32 offset = 0; offset < size; offset += sizeof(data))
+    {
+        for (u32 i = 0; i < sizeof(data); i++) data[i] = (u8)((offset + i) * 31 + 7);
+        ASSERT_TRUE(mod->WriteTransferData(offset, data, sizeof(data)));
+    }
+}
+
+static void CheckReceivedBuffer(CherrySimTester& tester, u32 senderIndex, u32 receiverIndex, u32 size)
+{
+    const u8* sent = nullptr;
+    {
+        NodeIndexSetter setter(senderIndex);
+        sent = ((BulkModule*)GS->node.GetModuleById(ModuleId::BULK_MODULE))->GetTransferBuffer();
+    }
+    NodeIndexSetter setter(receiverIndex);
+    BulkModule* mod = (BulkModule*)GS->node.GetModuleById(ModuleId::BULK_MODULE);
+    ASSERT_NE(mod, nullptr);
+    ASSERT_EQ(mod->GetReceiveStatus(), BulkTransferStatus::COMPLETE);
+    ASSERT_EQ(memcmp(sent, mod->GetTransferBuffer(), size), 0);
+}
+
+TEST(TestBulkModule, TestTransfer) {
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.terminalId = 0;
+    //Place nodes such that they are only reachable in a line.
+    simConfig.preDefinedPositions = { {0.2, 0.5}, {0.4, 0.55}, {0.6, 0.5}, {0.8, 0.55} };
+    simConfig.nodeConfigName.insert({ "github_dev_nrf52", 4 });
+    simConfig.SetToPerfectConditions();
+    //testerConfig.verbose = true;
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+
+    tester.SimulateUntilClusteringDone(100 * 1000);
+
+    FillTransferBuffer(tester, 0, BulkModule::MAX_TRANSFER_SIZE);
+
+    //Send the blob over three hops to a single node, the last chunk is shorter than the others
+    tester.SendTerminalCommand(1, "bulk send 1 3000 4");
+    tester.SimulateUntilMessageReceived(60 * 1000, 4, "{\"nodeId\":4,\"type\":\"bulk_transfer_received\",\"sender\":1,\"transferId\":1,\"size\":3000,\"code\":1");
+    tester.SimulateUntilMessageReceived(10 * 1000, 1, "{\"nodeId\":1,\"type\":\"bulk_transfer_done\",\"transferId\":1,\"size\":3000,");
+    CheckReceivedBuffer(tester, 0, 3, 3000);
+
+    //Send the full blob to multiple nodes at once
+    tester.SendTerminalCommand(1, "bulk send 2 4096 3 4");
+    tester.SimulateUntilMessageReceived(60 * 1000, 1, "{\"nodeId\":1,\"type\":\"bulk_transfer_result\",\"receiver\":3,\"transferId\":2,\"code\":1,");
+    tester.SimulateUntilMessageReceived(10 * 1000, 1, "{\"nodeId\":1,\"type\":\"bulk_transfer_done\",\"transferId\":2,\"size\":4096,");
+    CheckReceivedBuffer(tester, 0, 2, 4096);
+    CheckReceivedBuffer(tester, 0, 3, 4096);
+}
+
+TEST(TestBulkModule, TestRejections) {
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.terminalId = 0;
+    simConfig.nodeConfigName.insert({ "github_dev_nrf52", 3 });
+    simConfig.SetToPerfectConditions();
+    //testerConfig.verbose = true;
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+
+    tester.SimulateUntilClusteringDone(100 * 1000);
+
+    //Sizes that do not fit into the transfer buffer are refused locally
+    {
+        Exceptions::DisableDebugBreakOnException disabler;
+        tester.SendTerminalCommand(1, "bulk send 1 5000 2");
+        ASSERT_THROW(tester.SimulateGivenNumberOfSteps(1), WrongCommandParameterException);
+    }
+
+    //A node that is sending itself must not receive another blob
+    FillTransferBuffer(tester, 0, 2048);
+    FillTransferBuffer(tester, 1, 2048);
+    tester.SendTerminalCommand(2, "bulk send 7 2048 3");
+    tester.SendTerminalCommand(1, "bulk send 8 2048 2");
+    tester.SimulateUntilMessageReceived(10 * 1000, 1, "{\"nodeId\":1,\"type\":\"bulk_transfer_result\",\"receiver\":2,\"transferId\":8,\"code\":4,");
+    tester.SimulateUntilMessageReceived(60 * 1000, 2, "{\"nodeId\":2,\"type\":\"bulk_transfer_done\",\"transferId\":7,");
+}
+
+TEST(TestBulkModule, TestResume) {
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.terminalId = 0;
+    simConfig.preDefinedPositions = { {0.2, 0.5}, {0.4, 0.55}, {0.6, 0.5} };
+    simConfig.nodeConfigName.insert({ "github_dev_nrf52", 3 });
+    simConfig.SetToPerfectConditions();
+    //testerConfig.verbose = true;
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+
+    tester.SimulateUntilClusteringDone(100 * 1000);
+
+    FillTransferBuffer(tester, 0, BulkModule::MAX_TRANSFER_SIZE);
+
+    tester.SendTerminalCommand(1, "bulk send 3 4096 3");
+
+    //Interrupt the transfer once the receiver has about half of the blob
+    u16 receivedChunks = 0;
+    for (u32 i = 0; i < 600 && receivedChunks < BulkModule::MAX_CHUNKS / 2; i++)
+    {
+        tester.SimulateForGivenTime(100);
+        NodeIndexSetter setter(2);
+        receivedChunks = ((BulkModule*)GS->node.GetModuleById(ModuleId::BULK_MODULE))->GetReceivedChunkCount();
+    }
+    ASSERT_GE(receivedChunks, BulkModule::MAX_CHUNKS / 2);
+    ASSERT_LT(receivedChunks, BulkModule::MAX_CHUNKS);
+
+    tester.SendTerminalCommand(1, "bulk abort");
+    tester.SimulateUntilMessageReceived(10 * 1000, 1, "{\"nodeId\":1,\"type\":\"bulk_transfer_result\",\"receiver\":3,\"transferId\":3,\"code\":6,");
+    tester.SimulateForGivenTime(5 * 1000);
+
+    //Starting the same transfer again must only send the chunks that are still missing
+    tester.SendTerminalCommand(1, "bulk send 3 4096 3");
+    tester.SimulateUntilMessageReceived(60 * 1000, 1, "{\"nodeId\":1,\"type\":\"bulk_transfer_result\",\"receiver\":3,\"transferId\":3,\"code\":1,");
+    CheckReceivedBuffer(tester, 0, 2, BulkModule::MAX_TRANSFER_SIZE);
+
+    {
+        NodeIndexSetter setter(0);
+        BulkModule* mod = (BulkModule*)GS->node.GetModuleById(ModuleId::BULK_MODULE);
+        ASSERT_LE(mod->GetChunksSent(), BulkModule::MAX_CHUNKS - receivedChunks);
+    }
+}
+
+static bool HasBufferedPackets(const NodeEntry& node)
+{
+    for (int i = 0; i < node.state.configuredTotalConnectionCount; i++)
+    {
+        const SoftdeviceConnection& connection = node.state.connections[i];
+        if (!connection.connectionActive) continue;
+        for (int k = 0; k < SIM_NUM_RELIABLE_BUFFERS; k++)
+        {
+            if (connection.reliableBuffers[k].sender != nullptr) return true;
+        }
+        for (int k = 0; k < SIM_NUM_UNRELIABLE_BUFFERS; k++)
+        {
+            if (connection.unreliableBuffers[k].sender != nullptr) return true;
+        }
+    }
+    return false;
+}
+
+TEST(TestBulkModule, TestInterruptedLink) {
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.terminalId = 0;
+    simConfig.preDefinedPositions = { {0.2, 0.5}, {0.4, 0.55}, {0.6, 0.5} };
+    simConfig.nodeConfigName.insert({ "github_dev_nrf52", 3 });
+    simConfig.SetToPerfectConditions();
+    //testerConfig.verbose = true;
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+
+    tester.SimulateUntilClusteringDone(100 * 1000);
+
+    FillTransferBuffer(tester, 0, BulkModule::MAX_TRANSFER_SIZE);
+
+    tester.SendTerminalCommand(1, "bulk send 4 4096 3");
+
+    //Wait until a part of the blob has arrived and chunks are still buffered on the way
+    u16 receivedChunks = 0;
+    for (u32 i = 0; i < 6000 && (receivedChunks < BulkModule::MAX_CHUNKS / 4 || !HasBufferedPackets(tester.sim->nodes[1])); i++)
+    {
+        tester.SimulateGivenNumberOfSteps(1);
+        NodeIndexSetter setter(2);
+        receivedChunks = ((BulkModule*)GS->node.GetModuleById(ModuleId::BULK_MODULE))->GetReceivedChunkCount();
+    }
+    ASSERT_GE(receivedChunks, BulkModule::MAX_CHUNKS / 4);
+    ASSERT_LT(receivedChunks, BulkModule::MAX_CHUNKS);
+
+    //Interrupt the links of the relay node, all chunks that are buffered in the SoftDevices are lost
+    const u32 droppedBefore = tester.sim->simState.packetsDroppedOnDisconnect;
+    for (int i = 0; i < tester.sim->nodes[1].state.configuredTotalConnectionCount; i++) {
+        if (tester.sim->nodes[1].state.connections[i].connectionActive) {
+            tester.sim->DisconnectSimulatorConnection(&tester.sim->nodes[1].state.connections[i], BLE_HCI_CONNECTION_TIMEOUT, BLE_HCI_CONNECTION_TIMEOUT);
+        }
+    }
+    ASSERT_GT(tester.sim->simState.packetsDroppedOnDisconnect, droppedBefore);
+
+    //The lost chunks must be retransmitted once the mesh is back, but not the whole blob
+    tester.SimulateUntilMessageReceived(100 * 1000, 1, "{\"nodeId\":1,\"type\":\"bulk_transfer_result\",\"receiver\":3,\"transferId\":4,\"code\":1,");
+    CheckReceivedBuffer(tester, 0, 2, BulkModule::MAX_TRANSFER_SIZE);
+
+    {
+        NodeIndexSetter setter(0);
+        BulkModule* mod = (BulkModule*)GS->node.GetModuleById(ModuleId::BULK_MODULE);
+        ASSERT_GT(mod->GetChunksRetransmitted(), 0u);
+        ASSERT_LT(mod->GetChunksRetransmitted(), (u32)BulkModule::MAX_CHUNKS);
+    }
+}
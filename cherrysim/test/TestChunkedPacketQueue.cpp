@@ -29,9 +29,11 @@
 ////////////////////////////////////////////////////////////////////////////////
 #include "gtest/gtest.h"
 #include <vector>
+#include <deque>
 #include <CherrySimTester.h>
 #include <CherrySimUtils.h>
 #include "ConnectionQueueMemoryAllocator.h"
+#include "ChunkedPriorityPacketQueue.h"
 #include "MersenneTwister.h"
 
 TEST(TestChunkedPacketQueue, TestSimpleAllocations)
@@ -220,3 +222,167 @@ TEST(TestChunkedPacketQueue, TestSimpleAllocations)
         }
     }
 }
+
+TEST(TestChunkedPacketQueue, TestDeficitRoundRobinScheduling)
+{
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 1 });
+    simConfig.SetToPerfectConditions();
+    //testerConfig.verbose = true;
+
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+
+    tester.SimulateUntilClusteringDone(100 * 1000);
+
+    NodeIndexSetter setter(0);
+    MeshConnections connections = GS->cm.GetMeshConnections(ConnectionDirection::INVALID);
+    ASSERT_EQ(connections.count, 1);
+
+    // As in TestSimpleAllocations, we won't simulate another step and only care about the queue.
+    MeshConnection* conn = connections.handles[0].GetConnection();
+    for (u32 i = 0; i < AMOUNT_OF_SEND_QUEUE_PRIORITIES; i++)
+    {
+        conn->queue.GetQueueByPriority((DeliveryPriority)i)->SimReset();
+    }
+    conn->queue.ResetLatencyStats();
+
+    GS->cm.queueSchedulingMode = QueueSchedulingMode::DEFICIT_ROUND_ROBIN;
+    GS->cm.deficitRoundRobinQuanta = { 0, 240, 0, 80 };
+
+    std::array<u8, 40> message;
+    for (size_t i = 0; i < message.size(); i++)
+    {
+        message[i] = i;
+    }
+    constexpr u32 messagesPerQueue = 40;
+    for (u32 i = 0; i < messagesPerQueue; i++)
+    {
+        ASSERT_TRUE(conn->queue.GetQueueByPriority(DeliveryPriority::HIGH)->AddMessage(message.data(), message.size()));
+        ASSERT_TRUE(conn->queue.GetQueueByPriority(DeliveryPriority::LOW )->AddMessage(message.data(), message.size()));
+    }
+
+    // With equally sized packets, the quanta 240 and 80 must result in a share of 3:1.
+    std::array<u32, AMOUNT_OF_SEND_QUEUE_PRIORITIES> sentPerPriority = {};
+    for (u32 i = 0; i < messagesPerQueue; i++)
+    {
+        const QueuePriorityPair pair = conn->queue.GetSendQueue();
+        ASSERT_NE(pair.queue, nullptr);
+        // Asking again without sending must not change the decision.
+        ASSERT_EQ(conn->queue.GetSendQueue().priority, pair.priority);
+        sentPerPriority[(u32)pair.priority]++;
+        conn->queue.IncrementLookAhead(pair);
+    }
+    ASSERT_EQ(sentPerPriority[(u32)DeliveryPriority::HIGH], 30u);
+    ASSERT_EQ(sentPerPriority[(u32)DeliveryPriority::LOW ], 10u);
+
+    // Every packet that was handed out must be accounted for in the latency histogram.
+    u32 recordedHigh = 0;
+    for (u16 count : conn->queue.GetLatencyStats(DeliveryPriority::HIGH).histogram) recordedHigh += count;
+    ASSERT_EQ(recordedHigh, 30u);
+
+    // Once the high queue runs empty, the low queue gets the whole connection.
+    for (u32 i = 0; i < messagesPerQueue - 20; i++)
+    {
+        const QueuePriorityPair pair = conn->queue.GetSendQueue();
+        ASSERT_NE(pair.queue, nullptr);
+        sentPerPriority[(u32)pair.priority]++;
+        conn->queue.IncrementLookAhead(pair);
+    }
+    ASSERT_EQ(sentPerPriority[(u32)DeliveryPriority::HIGH], messagesPerQueue);
+    ASSERT_EQ(sentPerPriority[(u32)DeliveryPriority::LOW ], messagesPerQueue - 20);
+    ASSERT_EQ(conn->queue.GetSendQueue().queue, conn->queue.GetQueueByPriority(DeliveryPriority::LOW));
+}
+
+TEST(TestChunkedPacketQueue, TestRandomAccess)
+{
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 1 });
+    simConfig.SetToPerfectConditions();
+    //testerConfig.verbose = true;
+
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+
+    tester.SimulateUntilClusteringDone(100 * 1000);
+
+    NodeIndexSetter setter(0);
+    MeshConnections connections = GS->cm.GetMeshConnections(ConnectionDirection::INVALID);
+    ASSERT_EQ(connections.count, 1);
+
+    // As in TestSimpleAllocations, we won't simulate another step and only care about the queue.
+    MeshConnection* conn = connections.handles[0].GetConnection();
+    ChunkedPacketQueue& queue = *conn->queue.GetQueueByPriority(DeliveryPriority::HIGH);
+    queue.SimReset();
+
+    struct Message
+    {
+        u16 size;
+        u8 data[MAX_MESH_PACKET_SIZE];
+    };
+    std::deque<Message> messages;
+    u32 amountLookedAhead = 0;
+    u32 maxMessages = 0;
+    MersenneTwister mt(2);
+    for (int repeat = 0; repeat < 5000; repeat++)
+    {
+        // Prefer adding so that the queue regularly holds more packets than the offset index.
+        const u32 dice = mt.NextU32() % 8;
+        if (dice < 4 || messages.size() == 0)
+        {
+            Message message;
+            CheckedMemset(&message, 0, sizeof(message));
+            // Mostly small packets, as they are the ones that exceed the offset index.
+            message.size = (dice == 0) ? mt.NextU32() % MAX_MESH_PACKET_SIZE + 1 : mt.NextU32() % 30 + 1;
+            for (size_t i = 0; i < message.size; i++)
+            {
+                message.data[i] = (u8)mt.NextU32();
+            }
+            if (queue.AddMessage(message.data, message.size))
+            {
+                messages.push_back(message);
+            }
+        }
+        else if (dice < 6)
+        {
+            queue.PopPacket();
+            messages.pop_front();
+            if (amountLookedAhead > 0) amountLookedAhead--;
+        }
+        else if (dice < 7)
+        {
+            if (queue.HasMoreToLookAhead())
+            {
+                queue.IncrementLookAhead();
+                amountLookedAhead++;
+            }
+        }
+        else
+        {
+            queue.RollbackLookAhead();
+            amountLookedAhead = 0;
+        }
+
+        ASSERT_EQ(queue.GetAmountOfPackets(), messages.size());
+        if (messages.size() > maxMessages) maxMessages = messages.size();
+        for (u32 i = 0; i < messages.size(); i++)
+        {
+            u8 peekBuffer[MAX_MESH_PACKET_SIZE];
+            ASSERT_EQ(queue.RandomAccessPeek(peekBuffer, sizeof(peekBuffer), i), messages[i].size);
+            ASSERT_EQ(memcmp(peekBuffer, messages[i].data, messages[i].size), 0);
+            ASSERT_EQ(queue.IsRandomAccessIndexLookedAhead(i), i < amountLookedAhead);
+        }
+        // Accessing the packets out of order must not be confused by the enumeration cursor.
+        for (u32 i = messages.size(); i > 0; i--)
+        {
+            u8 peekBuffer[MAX_MESH_PACKET_SIZE];
+            ASSERT_EQ(queue.RandomAccessPeek(peekBuffer, sizeof(peekBuffer), i - 1), messages[i - 1].size);
+            ASSERT_EQ(memcmp(peekBuffer, messages[i - 1].data, messages[i - 1].size), 0);
+        }
+    }
+    ASSERT_GT(maxMessages, (u32)CHUNKED_PACKET_QUEUE_OFFSET_INDEX_SIZE);
+}
@@ -625,7 +625,7 @@ TEST_P(MultiStackFixture, TestSinkDetectionWithSingleSink)
     }
 }
 
-extern std::map<std::string, int> simStatCounts;
+extern SIM_THREAD_LOCAL std::map<std::string, int> simStatCounts;
 TEST(TestClustering, TestVitalPrioQueueFull) {
     for (int seed = 0; seed < 3; seed++) {
         CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
@@ -729,6 +729,42 @@ TEST(TestClustering, TestEmergencyDisconnect) {
 }
 
 
+TEST(TestClustering, TestConnectedComponentTracking) {
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    //testerConfig.verbose = true;
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.terminalId = 0;
+    simConfig.SetToPerfectConditions();
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 4 });
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+
+    //Before any connection is made, each node is on its own
+    ASSERT_EQ(tester.sim->GetNumberOfConnectedComponents(), 5u);
+
+    tester.SimulateUntilClusteringDone(100 * 1000);
+    ASSERT_EQ(tester.sim->GetNumberOfConnectedComponents(), 1u);
+
+    //Cutting off a node splits the mesh, which must be noticed before the nodes handle their disconnects
+    for (int i = 0; i < tester.sim->nodes[2].state.configuredTotalConnectionCount; i++) {
+        if (tester.sim->nodes[2].state.connections[i].connectionActive) {
+            tester.sim->DisconnectSimulatorConnection(&tester.sim->nodes[2].state.connections[i], BLE_HCI_CONNECTION_TIMEOUT, BLE_HCI_CONNECTION_TIMEOUT);
+        }
+    }
+    ASSERT_GT(tester.sim->GetNumberOfConnectedComponents(), 1u);
+    ASSERT_FALSE(tester.sim->IsClusteringDone());
+
+    tester.SimulateUntilClusteringDone(100 * 1000);
+    ASSERT_EQ(tester.sim->GetNumberOfConnectedComponents(), 1u);
+
+    //The tracked cluster membership must agree with the state of the nodes
+    ASSERT_TRUE(tester.sim->IsClusteringDoneWithExpectedNumberOfClusters(1));
+    for (u32 i = 0; i < tester.sim->GetTotalNodes(); i++) {
+        ASSERT_EQ(tester.sim->nodes[i].gs.node.GetClusterSize(), 5);
+    }
+}
+
 //TODO: Write a test that checks reestablishing while the mesh is flooded
 
 //This executes all MultiStackFixture Tests with the S130 and S132 stacks
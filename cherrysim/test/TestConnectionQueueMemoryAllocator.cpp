@@ -29,6 +29,9 @@
 ////////////////////////////////////////////////////////////////////////////////
 #include "gtest/gtest.h"
 #include <vector>
+#include <cstring>
+#include <CherrySimTester.h>
+#include <CherrySimUtils.h>
 #include "ConnectionQueueMemoryAllocator.h"
 #include "MersenneTwister.h"
 
@@ -163,7 +166,8 @@ TEST(TestConnectionQueueMemoryAllocator, TestRandomAllocations) {
                     ASSERT_EQ(chunk->data[i], 0);
                 }
                 ASSERT_EQ(chunk->nextChunk, nullptr);
-                chunk->data = GenerateUniqueChunkData(chunk);
+                const std::array<u8, CONNECTION_QUEUE_MEMORY_CHUNK_SIZE> uniqueData = GenerateUniqueChunkData(chunk);
+                memcpy(chunk->data, uniqueData.data(), uniqueData.size());
                 chunk->nextChunk = chunk;
                 chunks.push_back(chunk);
             }
@@ -172,10 +176,144 @@ TEST(TestConnectionQueueMemoryAllocator, TestRandomAllocations) {
         {
             //deallocate
             const u32 index = randomness.NextU32() % chunks.size();
-            ASSERT_EQ(chunks[index]->data, GenerateUniqueChunkData(chunks[index]));
+            const std::array<u8, CONNECTION_QUEUE_MEMORY_CHUNK_SIZE> uniqueData = GenerateUniqueChunkData(chunks[index]);
+            ASSERT_EQ(memcmp(chunks[index]->data, uniqueData.data(), uniqueData.size()), 0);
             ASSERT_EQ(chunks[index]->nextChunk, chunks[index]);
             allocator.Deallocate(chunks[index]);
             chunks.erase(chunks.begin() + index);
         }
     }
 }
+
+TEST(TestConnectionQueueMemoryAllocator, TestSmallQueueHeads) {
+    ConnectionQueueMemoryAllocator allocator;
+    std::vector<ConnectionQueueMemoryChunk*> heads;
+
+    //Queue heads are small until all small chunks are used...
+    for (u32 i = 0; i < CONNECTION_QUEUE_MEMORY_SMALL_CHUNK_AMOUNT; i++)
+    {
+        ConnectionQueueMemoryChunk* chunk = allocator.AllocateQueueHead();
+        ASSERT_NE(chunk, nullptr);
+        ASSERT_TRUE(chunk->IsSmall());
+        ASSERT_EQ(chunk->capacity, CONNECTION_QUEUE_MEMORY_SMALL_CHUNK_SIZE);
+        heads.push_back(chunk);
+    }
+    ASSERT_FALSE(allocator.IsSmallChunkAvailable());
+    ASSERT_EQ(allocator.GetAmountOfFreeChunks(), CONNECTION_QUEUE_MEMORY_CHUNK_AMOUNT);
+
+    //...then they fall back to full sized chunks.
+    ConnectionQueueMemoryChunk* fullSizedHead = allocator.AllocateQueueHead();
+    ASSERT_NE(fullSizedHead, nullptr);
+    ASSERT_FALSE(fullSizedHead->IsSmall());
+    ASSERT_EQ(allocator.GetAmountOfFreeChunks(), CONNECTION_QUEUE_MEMORY_CHUNK_AMOUNT - 1);
+
+    //Small chunks go back to their own free list and are zeroed.
+    for (u32 i = 0; i < CONNECTION_QUEUE_MEMORY_SMALL_CHUNK_SIZE; i++)
+    {
+        heads[0]->data[i] = (u8)(i + 1);
+    }
+    allocator.Deallocate(heads[0]);
+    ASSERT_EQ(allocator.GetAmountOfFreeSmallChunks(), 1u);
+    heads[0] = allocator.AllocateQueueHead();
+    ASSERT_TRUE(heads[0]->IsSmall());
+    for (u32 i = 0; i < CONNECTION_QUEUE_MEMORY_SMALL_CHUNK_SIZE; i++)
+    {
+        ASSERT_EQ(heads[0]->data[i], 0);
+    }
+
+    //Full sized allocations never hand out small chunks.
+    allocator.Deallocate(heads[1]);
+    for (u32 i = 0; i < CONNECTION_QUEUE_MEMORY_CHUNK_AMOUNT - 1; i++)
+    {
+        ConnectionQueueMemoryChunk* chunk = allocator.Allocate(true);
+        ASSERT_NE(chunk, nullptr);
+        ASSERT_FALSE(chunk->IsSmall());
+    }
+    {
+        Exceptions::DisableDebugBreakOnException disabler;
+        Exceptions::ExceptionDisabler<AllocatorOutOfMemoryException> aoome;
+        ASSERT_EQ(allocator.Allocate(true), nullptr);
+    }
+    ASSERT_EQ(allocator.GetAmountOfFreeSmallChunks(), 1u);
+}
+
+TEST(TestConnectionQueueMemoryAllocator, BenchmarkPacketsPerRam) {
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 1 });
+    simConfig.SetToPerfectConditions();
+    //testerConfig.verbose = true;
+
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+
+    tester.SimulateUntilClusteringDone(100 * 1000);
+
+    NodeIndexSetter setter(0);
+    MeshConnections connections = GS->cm.GetMeshConnections(ConnectionDirection::INVALID);
+    ASSERT_EQ(connections.count, 1);
+
+    // We won't simulate another step, so the queues can be filled without anything being sent.
+    MeshConnection* conn = connections.handles[0].GetConnection();
+    for (u32 i = 0; i < AMOUNT_OF_SEND_QUEUE_PRIORITIES; i++)
+    {
+        conn->queue.GetQueueByPriority((DeliveryPriority)i)->SimReset();
+    }
+
+    // A typical small status packet, taking 28 bytes in the queue.
+    std::array<u8, 24> message{};
+    constexpr u32 sizeInQueue = 28;
+    ChunkedPacketQueue& queue = *conn->queue.GetQueueByPriority(DeliveryPriority::LOW);
+    const u32 freeChunksBefore = GS->connectionQueueMemoryAllocator.GetAmountOfFreeChunks();
+    u32 packetsThatFit = 0;
+    while (queue.AddMessage(message.data(), message.size()))
+    {
+        packetsThatFit++;
+    }
+
+    // Before small chunks existed, the default configuration had 40 full sized chunks. Every existing queue pinned
+    // one of them and a queue only got another chunk if afterwards one chunk was left for every queue of every
+    // connection that could still be created and for every higher priority. The bookkeeping of each chunk
+    // (16 byte on the target) is part of the compared RAM.
+    constexpr u32 chunkBookkeeping = 16;
+    constexpr u32 legacyChunkAmount = 40;
+    ASSERT_EQ(legacyChunkAmount * (CONNECTION_QUEUE_MEMORY_CHUNK_SIZE + chunkBookkeeping),
+        CONNECTION_QUEUE_MEMORY_CHUNK_AMOUNT * (CONNECTION_QUEUE_MEMORY_CHUNK_SIZE + chunkBookkeeping) + CONNECTION_QUEUE_MEMORY_SMALL_CHUNK_AMOUNT * (CONNECTION_QUEUE_MEMORY_SMALL_CHUNK_SIZE + chunkBookkeeping));
+    const u32 connectionCount = GS->cm.GetConnectionsOfType(ConnectionType::INVALID, ConnectionDirection::INVALID).count;
+    const u32 legacyReservedChunks = ((u32)TOTAL_NUM_CONNECTIONS + 1 - connectionCount) * AMOUNT_OF_SEND_QUEUE_PRIORITIES;
+    const u32 legacyRequestedChunks = 1 + (u32)DeliveryPriority::LOW;
+    u32 legacyChunksOfLowQueue = 1;
+    for (u32 chunksLeft = legacyChunkAmount - connectionCount * AMOUNT_OF_SEND_QUEUE_PRIORITIES; chunksLeft >= legacyRequestedChunks && chunksLeft - legacyRequestedChunks >= legacyReservedChunks; chunksLeft--)
+    {
+        legacyChunksOfLowQueue++;
+    }
+    const u32 legacyPacketsThatFit = legacyChunksOfLowQueue * CONNECTION_QUEUE_MEMORY_CHUNK_SIZE / sizeInQueue;
+
+    printf("Packets of %u bytes in one queue: %u, previously %u" EOL, (u32)message.size(), packetsThatFit, legacyPacketsThatFit);
+    ASSERT_GT(packetsThatFit, legacyPacketsThatFit);
+    ASSERT_GE(queue.GetAllocatedBytes(), packetsThatFit * sizeInQueue);
+
+    // The chunks that are left must still be enough for the queues of all connections that can still be created.
+    {
+        std::vector<ConnectionQueueMemoryChunk*> heads;
+        for (u32 i = 0; i < legacyReservedChunks; i++)
+        {
+            ConnectionQueueMemoryChunk* head = GS->connectionQueueMemoryAllocator.AllocateQueueHead();
+            ASSERT_NE(head, nullptr);
+            heads.push_back(head);
+        }
+        for (ConnectionQueueMemoryChunk* head : heads)
+        {
+            GS->connectionQueueMemoryAllocator.Deallocate(head);
+        }
+    }
+
+    // Draining the queue must give back all full sized chunks.
+    while (queue.HasPackets())
+    {
+        queue.PopPacket();
+    }
+    ASSERT_EQ(queue.GetAllocatedBytes(), (u32)CONNECTION_QUEUE_MEMORY_SMALL_CHUNK_SIZE);
+    ASSERT_EQ(GS->connectionQueueMemoryAllocator.GetAmountOfFreeChunks(), freeChunksBefore);
+}
@@ -34,6 +34,7 @@
 #include <vector>
 #include <cmath>
 #include "MeshAccessModule.h"
+#include "EnrollmentModule.h"
 
 #ifndef GITHUB_RELEASE
 TEST(TestEnrollmentModule, TestCommands) {
@@ -393,4 +394,65 @@ TEST(TestEnrollmentModule, TestRequestProposals) {
     };
     tester.SimulateUntilMessagesReceived(10 * 1000, messages);
 }
+
+TEST(TestEnrollmentModule, TestBulkEnrollment) {
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.terminalId = 0;
+    simConfig.mapWidthInMeters = 5;
+    simConfig.mapHeightInMeters = 5;
+    testerConfig.verbose = false;
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1});
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 12 });
+    simConfig.SetToPerfectConditions();
+
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+
+    //The sink and nodes 2 to 4 form the mesh and act as enrollers, all others are unenrolled
+    constexpr u32 firstUnenrolledIndex = 4;
+    for (u32 i = firstUnenrolledIndex; i < tester.sim->GetTotalNodes(); i++)
+    {
+        tester.sim->nodes[i].uicr.CUSTOMER[9] = 0;
+    }
+
+    tester.Start();
+
+    tester.SimulateUntilClusteringDoneWithExpectedNumberOfClusters(100 * 1000, tester.sim->GetTotalNodes() - firstUnenrolledIndex + 1);
+
+    tester.SendTerminalCommand(1, "enroll bulk_enrollers 2 3 4");
+    tester.SendTerminalCommand(1, "enroll bulk_start 10");
+    tester.SimulateGivenNumberOfSteps(1);
+
+    EnrollmentModule* mod = static_cast<EnrollmentModule*>(tester.sim->nodes[0].gs.node.GetModuleById(ModuleId::ENROLLMENT_MODULE));
+    const u32 amountOfEnrollments = tester.sim->GetTotalNodes() - firstUnenrolledIndex;
+
+    //Stream the enrollments just like a gateway would, only adding more once the queue has space
+    u32 nextIndex = firstUnenrolledIndex;
+    for (u32 step = 0; step < 300 && mod->GetBulkEnrolledCount() + mod->GetBulkFailedCount() < amountOfEnrollments; step++)
+    {
+        while (nextIndex < tester.sim->GetTotalNodes() && mod->GetBulkEnrollmentFreeQueueSlots() > 0)
+        {
+            char serial[NODE_SERIAL_NUMBER_MAX_CHAR_LENGTH];
+            Utility::GenerateBeaconSerialForIndex(nextIndex, serial);
+            const u32 key = nextIndex + 1;
+            tester.SendTerminalCommand(1, "enroll bulk_add %s %u %02X:00:00:00:%02X:00:00:00:%02X:00:00:00:%02X:00:00:00", serial, 100 + nextIndex, key, key, key, key);
+            tester.SimulateGivenNumberOfSteps(1);
+            nextIndex++;
+        }
+        tester.SimulateForGivenTime(1000);
+    }
+
+    ASSERT_EQ((u32)mod->GetBulkEnrolledCount(), amountOfEnrollments);
+    ASSERT_EQ((u32)mod->GetBulkFailedCount(), (u32)0);
+
+    tester.SendTerminalCommand(1, "enroll bulk_status");
+    tester.SimulateUntilMessageReceived(10 * 1000, 1, "\"type\":\"bulk_enroll_status\",\"active\":1,\"enrollers\":3,\"queued\":0,\"inFlight\":0,\"enrolled\":%u,\"failed\":0", amountOfEnrollments);
+
+    //All enrolled nodes must join the mesh with their new nodeId
+    tester.SimulateUntilClusteringDone(100 * 1000);
+    for (u32 i = firstUnenrolledIndex; i < tester.sim->GetTotalNodes(); i++)
+    {
+        ASSERT_EQ((u32)tester.sim->nodes[i].gs.node.configuration.nodeId, 100 + i);
+    }
+}
 #endif
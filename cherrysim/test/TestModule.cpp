@@ -187,8 +187,9 @@ TEST(TestModule, TestSetAndGetConfiguration) {
     statusConfig.nearbyReportingIntervalDs = 0;
     statusConfig.deviceInfoReportingIntervalDs = 0;
     statusConfig.liveReportingState = LiveReportTypes::LEVEL_ERROR;
+    statusConfig.deltaReportKeyframeInterval = 0;
 
-    static_assert(sizeof(StatusReporterModuleConfiguration) == 13, "Size changed from when test was written, change defaults");
+    static_assert(sizeof(StatusReporterModuleConfiguration) == 14, "Size changed from when test was written, change defaults");
 
     char statusConfigString[200];
     Logger::ConvertBufferToHexString((u8*)&statusConfig, sizeof(StatusReporterModuleConfiguration), statusConfigString, sizeof(statusConfigString));
@@ -200,7 +201,7 @@ TEST(TestModule, TestSetAndGetConfiguration) {
 
     //Read the config back and check if it is the same
     tester.SendTerminalCommand(1, "get_config 2 status");
-    tester.SimulateUntilMessageReceived(10 * 1000, 1, "{\"nodeId\":2,\"type\":\"config\",\"module\":3,\"requestHandle\":0,\"config\":\"03:02:01:00:00:00:0A:00:00:00:00:00:00\"}");
+    tester.SimulateUntilMessageReceived(10 * 1000, 1, "{\"nodeId\":2,\"type\":\"config\",\"module\":3,\"requestHandle\":0,\"config\":\"03:02:01:00:00:00:0A:00:00:00:00:00:00:00\"}");
 
     VendorTemplateModuleConfiguration templateConfig;
     templateConfig.moduleId = VENDOR_TEMPLATE_MODULE_ID;
@@ -266,6 +267,7 @@ TEST(TestModule, TestGetModuleList) {
         "{\"id\":2,\"version\":2,\"active\":1},"
         "{\"id\":5,\"version\":1,\"active\":1},"
         "{\"id\":6,\"version\":1,\"active\":1},"
+        "{\"id\":13,\"version\":1,\"active\":1},"
         "{\"id\":\"0xABCD01F0\",\"version\":1,\"active\":1},"
         "{\"id\":10,\"version\":2,\"active\":1}"
         "]}");
@@ -33,6 +33,7 @@
 #include "CherrySimUtils.h"
 #include "Logger.h"
 #include <string>
+#include <algorithm>
 #include "GlobalState.h"
 #include "Config.h"
 #include "Node.h"
@@ -815,3 +816,365 @@ TEST(TestNode, TestComponentSenseAndActWithModuleIdWrapper)
     tester.SimulateUntilMessageReceived(10 * 1000, 1, "{\"nodeId\":1,\"type\":\"component_sense\",\"module\":\"0xABCD77F0\",\"requestHandle\":0,\"actionType\":3,\"component\":\"0x1111\",\"register\":\"0x2222\",\"payload\":\"MzM=\"}");
 
 }
+
+//Tests that a node with exhausted send queues tells its partners to hold back their sink bound traffic
+TEST(TestNode, TestFlowControl)
+{
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 1 });
+    simConfig.SetToPerfectConditions();
+    //testerConfig.verbose = true;
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+
+    tester.SimulateUntilClusteringDone(100 * 1000);
+
+    {
+        NodeIndexSetter setter(1);
+        ASSERT_FALSE(GS->cm.IsSinkPathCongested());
+    }
+
+    //Take away the send queue chunks of the sink as if its queues were full
+    std::vector<ConnectionQueueMemoryChunk*> chunks;
+    {
+        NodeIndexSetter setter(0);
+        while (GS->connectionQueueMemoryAllocator.GetAmountOfFreeChunks() >= FLOW_CONTROL_CONGESTION_CHUNK_THRESHOLD)
+        {
+            ConnectionQueueMemoryChunk* chunk = GS->connectionQueueMemoryAllocator.Allocate();
+            ASSERT_NE(chunk, nullptr);
+            chunks.push_back(chunk);
+        }
+    }
+
+    tester.SimulateForGivenTime(2 * 1000);
+    {
+        NodeIndexSetter setter(1);
+        ASSERT_TRUE(GS->cm.IsSinkPathCongested());
+        ASSERT_LT(GS->cm.GetFlowControlCredits(), FLOW_CONTROL_CONGESTION_CHUNK_THRESHOLD);
+    }
+
+    //The congestion must stay in place as long as it is refreshed
+    tester.SimulateForGivenTime(30 * 1000);
+    {
+        NodeIndexSetter setter(1);
+        ASSERT_TRUE(GS->cm.IsSinkPathCongested());
+    }
+
+    //Once the chunks are free again, the congestion is released
+    {
+        NodeIndexSetter setter(0);
+        for (ConnectionQueueMemoryChunk* chunk : chunks)
+        {
+            GS->connectionQueueMemoryAllocator.Deallocate(chunk);
+        }
+    }
+
+    tester.SimulateForGivenTime(2 * 1000);
+    {
+        NodeIndexSetter setter(1);
+        ASSERT_FALSE(GS->cm.IsSinkPathCongested());
+        ASSERT_GE(GS->cm.GetFlowControlCredits(), FLOW_CONTROL_CONGESTION_CHUNK_THRESHOLD + FLOW_CONTROL_HYSTERESIS_CHUNKS);
+    }
+}
+
+static u32 GetSimConnectionIntervalUs(CherrySimTester& tester, u32 nodeIndex)
+{
+    for (int i = 0; i < tester.sim->nodes[nodeIndex].state.configuredTotalConnectionCount; i++)
+    {
+        if (tester.sim->nodes[nodeIndex].state.connections[i].connectionActive)
+        {
+            return tester.sim->nodes[nodeIndex].state.connections[i].connectionIntervalUs;
+        }
+    }
+    return 0;
+}
+
+//Tests that idle connections are stretched and that busy connections get a short interval
+TEST(TestNode, TestAdaptiveConnectionInterval)
+{
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 1 });
+    simConfig.SetToPerfectConditions();
+    //testerConfig.verbose = true;
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+
+    for (u32 i = 0; i < tester.sim->GetTotalNodes(); i++)
+    {
+        NodeIndexSetter setter(i);
+        Conf::GetInstance().meshBusyConnectionInterval = (u16)MSEC_TO_UNITS(7.5, CONFIG_UNIT_1_25_MS);
+        Conf::GetInstance().meshIdleConnectionInterval = (u16)MSEC_TO_UNITS(100, CONFIG_UNIT_1_25_MS);
+    }
+
+    tester.SimulateUntilClusteringDone(100 * 1000);
+
+    //Without any traffic, the connection is stretched after a few evaluations
+    tester.SimulateForGivenTime(20 * 1000);
+    ASSERT_EQ(GetSimConnectionIntervalUs(tester, 0), 100000u);
+    ASSERT_EQ(GetSimConnectionIntervalUs(tester, 1), 100000u);
+
+    //A lot of traffic switches the connection to the busy interval
+    for (int i = 0; i < 50; i++)
+    {
+        {
+            NodeIndexSetter setter(1);
+            for (int k = 0; k < 5; k++)
+            {
+                u8 buffer[SIZEOF_CONN_PACKET_HEADER + 10] = {};
+                ConnPacketHeader* header = (ConnPacketHeader*)buffer;
+                header->messageType = MessageType::DATA_1;
+                header->sender = GS->node.configuration.nodeId;
+                header->receiver = NODE_ID_BROADCAST;
+                GS->cm.SendMeshMessage(buffer, sizeof(buffer));
+            }
+        }
+        tester.SimulateForGivenTime(100);
+    }
+    ASSERT_EQ(GetSimConnectionIntervalUs(tester, 0), 7500u);
+    ASSERT_EQ(GetSimConnectionIntervalUs(tester, 1), 7500u);
+
+    //An explicitly set interval is not adapted, even if the connection is idle
+    for (u32 i = 0; i < tester.sim->GetTotalNodes(); i++)
+    {
+        NodeIndexSetter setter(i);
+        GS->cm.SetMeshConnectionInterval((u16)MSEC_TO_UNITS(50, CONFIG_UNIT_1_25_MS));
+    }
+    tester.SimulateForGivenTime(20 * 1000);
+    ASSERT_EQ(GetSimConnectionIntervalUs(tester, 0), 50000u);
+    ASSERT_EQ(GetSimConnectionIntervalUs(tester, 1), 50000u);
+
+    //Once it is cleared, the idle connection is stretched again
+    for (u32 i = 0; i < tester.sim->GetTotalNodes(); i++)
+    {
+        NodeIndexSetter setter(i);
+        GS->cm.SetMeshConnectionInterval(0);
+    }
+    tester.SimulateForGivenTime(20 * 1000);
+    ASSERT_EQ(GetSimConnectionIntervalUs(tester, 0), 100000u);
+    ASSERT_EQ(GetSimConnectionIntervalUs(tester, 1), 100000u);
+}
+
+//Tests that sink bound traffic is routed away from a loaded sink if another sink is available
+TEST(TestNode, TestSinkLoadBalancing)
+{
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 2 });
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 1 });
+    simConfig.SetToPerfectConditions();
+    //testerConfig.verbose = true;
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+
+    std::vector<u32> sinkIndices;
+    u32 meshIndex = 0;
+    for (u32 i = 0; i < tester.sim->GetTotalNodes(); i++)
+    {
+        NodeIndexSetter setter(i);
+        if (GET_DEVICE_TYPE() == DeviceType::SINK) sinkIndices.push_back(i);
+        else meshIndex = i;
+    }
+    ASSERT_EQ(sinkIndices.size(), 2);
+
+    //The sinks can only reach each other through the mesh node and both links have the same quality
+    tester.sim->nodes[sinkIndices[0]].impossibleConnection.push_back(sinkIndices[1]);
+    tester.sim->nodes[sinkIndices[1]].impossibleConnection.push_back(sinkIndices[0]);
+    tester.sim->nodes[meshIndex].x = 0.5f;
+    tester.sim->nodes[meshIndex].y = 0.5f;
+    tester.sim->nodes[sinkIndices[0]].x = 0.49f;
+    tester.sim->nodes[sinkIndices[0]].y = 0.5f;
+    tester.sim->nodes[sinkIndices[1]].x = 0.51f;
+    tester.sim->nodes[sinkIndices[1]].y = 0.5f;
+
+    tester.SimulateUntilClusteringDone(100 * 1000);
+
+    NodeId routedSinkId = 0;
+    {
+        NodeIndexSetter setter(meshIndex);
+        routedSinkId = GS->cm.GetMeshConnectionToShortestSink(nullptr).GetPartnerId();
+        ASSERT_NE(routedSinkId, 0);
+    }
+
+    u32 loadedSinkIndex = 0;
+    u32 otherSinkIndex = 0;
+    for (u32 sinkIndex : sinkIndices)
+    {
+        NodeIndexSetter setter(sinkIndex);
+        if (GS->node.configuration.nodeId == routedSinkId) loadedSinkIndex = sinkIndex;
+        else otherSinkIndex = sinkIndex;
+    }
+
+    //Take away the send queue chunks of the sink that is currently used as if its queues were filling up
+    std::vector<ConnectionQueueMemoryChunk*> chunks;
+    {
+        NodeIndexSetter setter(loadedSinkIndex);
+        while (GS->connectionQueueMemoryAllocator.GetAmountOfFreeChunks() > FLOW_CONTROL_CONGESTION_CHUNK_THRESHOLD)
+        {
+            ConnectionQueueMemoryChunk* chunk = GS->connectionQueueMemoryAllocator.Allocate();
+            ASSERT_NE(chunk, nullptr);
+            chunks.push_back(chunk);
+        }
+    }
+
+    tester.SimulateForGivenTime(10 * 1000);
+    {
+        NodeIndexSetter setter(loadedSinkIndex);
+        ASSERT_GT(GS->cm.GetSinkLoad(nullptr), 50);
+    }
+    NodeId otherSinkId = 0;
+    {
+        NodeIndexSetter setter(otherSinkIndex);
+        otherSinkId = GS->node.configuration.nodeId;
+    }
+    {
+        NodeIndexSetter setter(meshIndex);
+        ASSERT_EQ(GS->cm.GetMeshConnectionToShortestSink(nullptr).GetPartnerId(), otherSinkId);
+        //The hops that are advertised for clustering are still the shortest ones
+        ASSERT_EQ(GS->cm.GetMeshHopsToShortestSink(nullptr), 0);
+    }
+
+    //Once the sink has recovered, its load is no longer advertised and both sinks are equal again
+    {
+        NodeIndexSetter setter(loadedSinkIndex);
+        for (ConnectionQueueMemoryChunk* chunk : chunks)
+        {
+            GS->connectionQueueMemoryAllocator.Deallocate(chunk);
+        }
+    }
+
+    tester.SimulateForGivenTime(60 * 1000);
+    {
+        NodeIndexSetter setter(meshIndex);
+        ASSERT_EQ(GS->cm.GetSinkLoad(nullptr), 0);
+    }
+}
+
+//Tests that sink bound traffic takes two good links instead of a single weak link to a sink
+TEST(TestNode, TestSinkEtxRouting)
+{
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 2 });
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 2 });
+    simConfig.SetToPerfectConditions();
+    //testerConfig.verbose = true;
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+
+    std::vector<u32> sinkIndices;
+    std::vector<u32> meshIndices;
+    for (u32 i = 0; i < tester.sim->GetTotalNodes(); i++)
+    {
+        NodeIndexSetter setter(i);
+        if (GET_DEVICE_TYPE() == DeviceType::SINK) sinkIndices.push_back(i);
+        else meshIndices.push_back(i);
+    }
+    ASSERT_EQ(sinkIndices.size(), 2);
+    ASSERT_EQ(meshIndices.size(), 2);
+
+    //Builds the line weakSink - node - relay - strongSink where the link to the weak sink has an rssi of about -80
+    const u32 weakSinkIndex = sinkIndices[0];
+    const u32 strongSinkIndex = sinkIndices[1];
+    const u32 nodeIndex = meshIndices[0];
+    const u32 relayIndex = meshIndices[1];
+    tester.sim->nodes[weakSinkIndex].x = 0.348f;
+    tester.sim->nodes[nodeIndex].x = 0.5f;
+    tester.sim->nodes[relayIndex].x = 0.51f;
+    tester.sim->nodes[strongSinkIndex].x = 0.52f;
+    for (u32 i = 0; i < tester.sim->GetTotalNodes(); i++) tester.sim->nodes[i].y = 0.5f;
+    tester.sim->nodes[weakSinkIndex].impossibleConnection.push_back(relayIndex);
+    tester.sim->nodes[weakSinkIndex].impossibleConnection.push_back(strongSinkIndex);
+    tester.sim->nodes[nodeIndex].impossibleConnection.push_back(strongSinkIndex);
+
+    tester.SimulateUntilClusteringDone(100 * 1000);
+
+    //Give the rssi averages and the advertisements some time to settle
+    tester.SimulateForGivenTime(60 * 1000);
+
+    NodeId relayId = 0;
+    {
+        NodeIndexSetter setter(relayIndex);
+        relayId = GS->node.configuration.nodeId;
+    }
+    {
+        NodeIndexSetter setter(nodeIndex);
+        ASSERT_EQ(GS->cm.GetMeshConnectionToShortestSink(nullptr).GetPartnerId(), relayId);
+        ASSERT_LT(GS->cm.GetMeshEtxToShortestSink(nullptr), 3 * SINK_ETX_PER_TRANSMISSION);
+        //The hops that are advertised for clustering are still the shortest ones
+        ASSERT_EQ(GS->cm.GetMeshHopsToShortestSink(nullptr), 1);
+    }
+}
+
+extern SIM_THREAD_LOCAL std::map<std::string, int> simStatCounts;
+TEST(TestNode, TestTopologyOptimization)
+{
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 4 });
+    simConfig.SetToPerfectConditions();
+    //testerConfig.verbose = true;
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+
+    //Builds the line sink - A - B - C - D, every node can only reach its neighbours
+    std::vector<u32> lineIndices;
+    for (u32 i = 0; i < tester.sim->GetTotalNodes(); i++)
+    {
+        NodeIndexSetter setter(i);
+        if (GET_DEVICE_TYPE() == DeviceType::SINK) lineIndices.insert(lineIndices.begin(), i);
+        else lineIndices.push_back(i);
+    }
+    ASSERT_EQ(lineIndices.size(), 5);
+    for (u32 i = 0; i < lineIndices.size(); i++)
+    {
+        tester.sim->nodes[lineIndices[i]].x = 0.5f + i * 0.01f;
+        tester.sim->nodes[lineIndices[i]].y = 0.5f;
+        for (u32 k = i + 2; k < lineIndices.size(); k++)
+        {
+            tester.sim->nodes[lineIndices[i]].impossibleConnection.push_back(lineIndices[k]);
+        }
+    }
+
+    tester.SimulateUntilClusteringDone(100 * 1000);
+
+    const u32 nodeAIndex = lineIndices[1];
+    const u32 nodeDIndex = lineIndices[4];
+    {
+        NodeIndexSetter setter(nodeDIndex);
+        ASSERT_EQ(GS->cm.GetMeshHopsToShortestSink(nullptr), 4);
+    }
+
+    //A and D are now able to reach each other, which should shorten the route of D
+    std::vector<int>& impossibleOfA = tester.sim->nodes[nodeAIndex].impossibleConnection;
+    impossibleOfA.erase(std::remove(impossibleOfA.begin(), impossibleOfA.end(), (int)nodeDIndex), impossibleOfA.end());
+    for (u32 i = 0; i < tester.sim->GetTotalNodes(); i++)
+    {
+        NodeIndexSetter setter(i);
+        Conf::GetInstance().topologyOptimizationIntervalDs = SEC_TO_DS(10);
+    }
+
+    NodeId nodeAId = 0;
+    {
+        NodeIndexSetter setter(nodeAIndex);
+        nodeAId = GS->node.configuration.nodeId;
+    }
+
+    //D refuses its old partner C while it is rewired, so A gets D with its first request
+    const int requestsBefore = simStatCounts["topologyRewireRequested"];
+    const int rewiresBefore = simStatCounts["topologyRewire"];
+    tester.SimulateForGivenTime(100 * 1000);
+    ASSERT_EQ(simStatCounts["topologyRewireRequested"], requestsBefore + 1);
+    ASSERT_EQ(simStatCounts["topologyRewire"], rewiresBefore + 1);
+
+    tester.SimulateUntilClusteringDone(100 * 1000);
+    {
+        NodeIndexSetter setter(nodeDIndex);
+        ASSERT_EQ(GS->cm.GetMeshHopsToShortestSink(nullptr), 2);
+        ASSERT_EQ(GS->cm.GetMeshConnectionToShortestSink(nullptr).GetPartnerId(), nodeAId);
+    }
+}
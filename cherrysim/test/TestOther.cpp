@@ -30,6 +30,7 @@
 #include "gtest/gtest.h"
 #include <fstream>
 #include <CherrySimTester.h>
+#include <CherrySimSweep.h>
 #include <Logger.h>
 #include <Utility.h>
 #include <string>
@@ -39,6 +40,14 @@
 #include "RingIndexGenerator.h"
 #include "json.hpp"
 #include "SimpleQueue.h"
+#include "DebugModule.h"
+#include <thread>
+#include <chrono>
+#if defined(SIM_SERVER_PRESENT)
+#include <event2/event.h>
+#include <event2/http.h>
+#include <event2/buffer.h>
+#endif //SIM_SERVER_PRESENT
 
 
 extern "C"{
@@ -337,6 +346,7 @@ TEST(TestOther, TestJsonConfigSerialization)
     new (&simConfig->replayPath) std::string;
     simConfig->replayPath = "path";
     simConfig->logReplayCommands = true;
+    simConfig->recordTerminalCommands = true;
     simConfig->useLogAccumulator = true;
     simConfig->defaultNetworkId = 19;
     new (&simConfig->preDefinedPositions)std::vector<std::pair<double, double>>;
@@ -350,6 +360,7 @@ TEST(TestOther, TestJsonConfigSerialization)
     new (&simConfig->storeFlashToFile) std::string;
     simConfig->storeFlashToFile = "eee";
     simConfig->verboseCommands = true;
+    simConfig->startServer = false;
     simConfig->defaultBleStackType = BleStackType::NRF_SD_132_ANY;
 
     for (size_t i = 0; i < sizeof(memoryArea) / sizeof(*memoryArea); i++)
@@ -398,6 +409,7 @@ TEST(TestOther, TestJsonConfigSerialization)
     ASSERT_EQ(copy.devicesJsonPath, "bbb");
     ASSERT_EQ(copy.replayPath, "path");
     ASSERT_EQ(copy.logReplayCommands, true);
+    ASSERT_EQ(copy.recordTerminalCommands, true);
     ASSERT_EQ(copy.useLogAccumulator, true);
     ASSERT_EQ(copy.defaultNetworkId, 19);
     ASSERT_EQ(copy.preDefinedPositions.size(), 2);
@@ -413,6 +425,7 @@ TEST(TestOther, TestJsonConfigSerialization)
     ASSERT_EQ(copy.enableSimStatistics, true);
     ASSERT_EQ(copy.storeFlashToFile, "eee");
     ASSERT_EQ(copy.verboseCommands, true);
+    ASSERT_EQ(copy.startServer, false);
     ASSERT_EQ(copy.defaultBleStackType, BleStackType::NRF_SD_132_ANY);
 
     simConfig->storeFlashToFile.~basic_string();
@@ -504,6 +517,61 @@ TEST(TestOther, TestReplay)
 }
 #endif //GITHUB_RELEASE
 
+//Stores the executed commands as a binary replay record and checks that replaying it results in the same state.
+TEST(TestOther, TestBinaryReplay)
+{
+    const std::string replayPath = "TestBinaryReplay.fmreplay";
+    nlohmann::json stateAtEnd;
+    u32 endTimeMs = 0;
+
+    {
+        CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+        SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+        simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1});
+        simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 9});
+        simConfig.recordTerminalCommands = true;
+        CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+        tester.Start();
+        tester.SimulateUntilClusteringDone(100 * 1000);
+
+        tester.SendTerminalCommand(1, "action 2 status get_status");
+        tester.SimulateUntilMessageReceived(10 * 1000, 1, "{\"nodeId\":2,\"type\":\"status\"");
+        tester.SendTerminalCommand(5, "status");
+        tester.SimulateForGivenTime(1000);
+
+        tester.sim->StoreBinaryReplay(replayPath);
+        stateAtEnd = tester.sim->GetStateSummary();
+        endTimeMs = tester.sim->simState.simTimeMs;
+    }
+
+    ASSERT_TRUE(CherrySim::IsBinaryReplayRecord(replayPath));
+    const BinaryReplayRecord record = CherrySim::LoadBinaryReplayRecord(replayPath);
+    ASSERT_EQ(record.entries.size(), 2);
+    ASSERT_EQ(record.entries[0].index, 0);
+    ASSERT_TRUE(record.entries[0].command.find("action 2 status get_status") == 0);
+    ASSERT_EQ(record.entries[1].index, 4);
+    ASSERT_TRUE(record.entries[1].command.find("status") == 0);
+
+    //Time windows and single nodes can be loaded without the other entries.
+    const BinaryReplayRecord window = CherrySim::LoadBinaryReplayRecord(replayPath, record.entries[1].time, endTimeMs);
+    ASSERT_EQ(window.entries.size(), 1);
+    ASSERT_EQ(window.entries[0].index, 4);
+    const BinaryReplayRecord node = CherrySim::LoadBinaryReplayRecord(replayPath, 0, UINT32_MAX, 0);
+    ASSERT_EQ(node.entries.size(), 1);
+    ASSERT_EQ(node.entries[0].time, record.entries[0].time);
+
+    {
+        CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+        SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+        simConfig.replayPath = replayPath;
+        CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+        tester.Start();
+        tester.SimulateForGivenTime(endTimeMs);
+
+        ASSERT_EQ(tester.sim->GetStateSummary(), stateAtEnd);
+    }
+}
+
 TEST(TestOther, TestSimCommandCrc)
 {
     CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
@@ -541,6 +609,210 @@ TEST(TestOther, SinkInMesh)
     //TODO: check that configurations were used
 }
 
+//Runs the same simulation concurrently on two threads and on the main thread. As every thread
+//has its own simulator context, all of them must end up in exactly the same state. Another
+//thread simulates with a different seed offset at the same time, which must not influence the others.
+TEST(TestOther, TestConcurrentSimulations)
+{
+    struct SimulationOutcome
+    {
+        bool completed = false;
+        bool ownBoardConfig = false;
+        u32 clusterId = 0;
+        u32 globalEventIdCounter = 0;
+        u32 globalPacketIdCounter = 0;
+    };
+    auto simulate = [](SimulationOutcome* outcome, u32 seedOffset)
+    {
+        try
+        {
+            MersenneTwister::seedOffset = seedOffset;
+            CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+            SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+            simConfig.startServer = false;
+            simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1});
+            simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 9});
+            CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+            tester.Start();
+            tester.SimulateUntilClusteringDone(100 * 1000);
+            tester.SimulateForGivenTime(10 * 1000);
+
+            outcome->clusterId = tester.sim->nodes[0].gs.node.clusterId;
+            outcome->globalEventIdCounter = tester.sim->simState.globalEventIdCounter;
+            outcome->globalPacketIdCounter = tester.sim->simState.globalPacketIdCounter;
+            //The board configuration that is visible to C code must belong to a node of this thread
+            for (u32 i = 0; i < tester.sim->GetTotalNodes(); i++)
+            {
+                if (fmBoardConfigPtr == &tester.sim->nodes[i].gs.boardconf.configuration.boardType) outcome->ownBoardConfig = true;
+            }
+            outcome->completed = true;
+        }
+        catch (const std::exception&)
+        {
+            outcome->completed = false;
+        }
+    };
+
+    const u32 seedOffset = MersenneTwister::seedOffset;
+    SimulationOutcome outcomes[3];
+    SimulationOutcome otherSeedOutcome;
+    std::thread first(simulate, &outcomes[0], seedOffset);
+    std::thread second(simulate, &outcomes[1], seedOffset);
+    std::thread otherSeed(simulate, &otherSeedOutcome, seedOffset + 1);
+    simulate(&outcomes[2], seedOffset);
+    first.join();
+    second.join();
+    otherSeed.join();
+
+    ASSERT_TRUE(otherSeedOutcome.completed);
+    ASSERT_TRUE(otherSeedOutcome.ownBoardConfig);
+    for (const SimulationOutcome& outcome : outcomes)
+    {
+        ASSERT_TRUE(outcome.completed);
+        ASSERT_TRUE(outcome.ownBoardConfig);
+        ASSERT_EQ(outcome.clusterId, outcomes[0].clusterId);
+        ASSERT_EQ(outcome.globalEventIdCounter, outcomes[0].globalEventIdCounter);
+        ASSERT_EQ(outcome.globalPacketIdCounter, outcomes[0].globalPacketIdCounter);
+    }
+}
+
+#if defined(SIM_SERVER_PRESENT)
+//Connects to /simulator/devices/stream of the FruitySimServer. The first event must contain all devices,
+//the following ones only the devices that changed while the mesh clustered.
+TEST(TestOther, TestDeviceStream)
+{
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.startServer = true;
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1});
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 2});
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+
+    std::string received;
+    event_base* clientBase = event_base_new();
+    evhttp_connection* connection = evhttp_connection_base_new(clientBase, nullptr, "127.0.0.1", 5555);
+    evhttp_request* request = evhttp_request_new([](evhttp_request*, void*) {}, &received);
+    evhttp_request_set_chunked_cb(request, [](evhttp_request* request, void* received)
+    {
+        evbuffer* input = evhttp_request_get_input_buffer(request);
+        std::string chunk(evbuffer_get_length(input), '\0');
+        evbuffer_remove(input, &chunk[0], chunk.size());
+        static_cast<std::string*>(received)->append(chunk);
+    });
+    evhttp_add_header(evhttp_request_get_output_headers(request), "Host", "127.0.0.1");
+    ASSERT_EQ(evhttp_make_request(connection, request, EVHTTP_REQ_GET, "/simulator/devices/stream"), 0);
+
+    //Splits the received data into the events and returns the devices of each of them
+    auto getEvents = [&received]()
+    {
+        std::vector<nlohmann::json> events;
+        size_t start = 0;
+        size_t end;
+        while ((end = received.find("\n\n", start)) != std::string::npos)
+        {
+            const std::string data = received.substr(start, end - start);
+            EXPECT_EQ(data.find("data: "), 0);
+            events.push_back(nlohmann::json::parse(data.substr(strlen("data: ")))["result"]);
+            start = end + 2;
+        }
+        return events;
+    };
+    //Events are sent in real time, so the simulation continues until the condition is met or a real time timeout passes
+    auto simulateUntil = [&](std::function<bool()> condition)
+    {
+        const auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(20);
+        while (!condition() && std::chrono::steady_clock::now() < timeout)
+        {
+            tester.SimulateGivenNumberOfSteps(1);
+            event_base_loop(clientBase, EVLOOP_NONBLOCK);
+        }
+        return condition();
+    };
+
+    ASSERT_TRUE(simulateUntil([&]() { return getEvents().size() >= 1; }));
+    ASSERT_EQ(getEvents()[0].size(), 3);
+
+    //After clustering, every device must have been updated with the new cluster size by some event
+    tester.SimulateUntilClusteringDone(100 * 1000);
+    auto allDevicesClustered = [&]()
+    {
+        std::map<std::string, u32> clusterSizes;
+        for (const nlohmann::json& event : getEvents())
+        {
+            for (const nlohmann::json& device : event) clusterSizes[device["uuid"]] = device["details"]["clusterSize"];
+        }
+        for (const auto& entry : clusterSizes)
+        {
+            if (entry.second != 3) return false;
+        }
+        return clusterSizes.size() == 3;
+    };
+    ASSERT_TRUE(simulateUntil(allDevicesClustered));
+    const std::vector<nlohmann::json> events = getEvents();
+    ASSERT_GE(events.size(), 2);
+    for (size_t i = 1; i < events.size(); i++)
+    {
+        //Events after the first one only contain changed devices, never an empty list
+        ASSERT_GE(events[i].size(), 1);
+        ASSERT_LE(events[i].size(), 3);
+    }
+
+    evhttp_connection_free(connection);
+    event_base_free(clientBase);
+}
+#endif //SIM_SERVER_PRESENT
+
+//Sweeps over two node counts and checks that both runs are executed and reported in the result files.
+TEST(TestOther, TestSweep)
+{
+    CherrySimSweepConfig sweepConfig;
+    ASSERT_TRUE(CherrySimSweep::ParseArgument(sweepConfig, "seeds=1"));
+    ASSERT_TRUE(CherrySimSweep::ParseArgument(sweepConfig, "nodes=3,5"));
+    ASSERT_TRUE(CherrySimSweep::ParseArgument(sweepConfig, "jobs=2"));
+    ASSERT_FALSE(CherrySimSweep::ParseArgument(sweepConfig, "unknown=1"));
+    sweepConfig.timeLimitSec = 100;
+    sweepConfig.measureSec = 10;
+    sweepConfig.outputPath = "TestSweep";
+
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1});
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 1});
+
+    ASSERT_EQ(CherrySimSweep::Run(sweepConfig, simConfig), 0);
+
+    std::ifstream jsonFile(sweepConfig.outputPath + ".json");
+    ASSERT_TRUE((bool)jsonFile);
+    nlohmann::json resultsJson;
+    jsonFile >> resultsJson;
+    const std::vector<CherrySimSweepResult> results = resultsJson;
+    ASSERT_EQ(results.size(), 2);
+    for (u32 i = 0; i < results.size(); i++)
+    {
+        const CherrySimSweepResult& result = results[i];
+        ASSERT_EQ(result.seed, 1);
+        ASSERT_EQ(result.nodes, i == 0 ? 3 : 5);
+        ASSERT_TRUE(result.completed);
+        ASSERT_TRUE(result.clustered);
+        //After clustering, each run continues for the measurement time
+        ASSERT_GE(result.simTimeMs, result.clusteringTimeMs + sweepConfig.measureSec * 1000);
+        ASSERT_GT(result.packetsSent, 0);
+        ASSERT_GT(result.packetsDelivered, 0);
+    }
+    //The larger mesh has to exchange more packets for clustering
+    ASSERT_GT(results[1].packetsSent, results[0].packetsSent);
+
+    std::ifstream csvFile(sweepConfig.outputPath + ".csv");
+    ASSERT_TRUE((bool)csvFile);
+    std::vector<std::string> lines;
+    std::string line;
+    while (std::getline(csvFile, line)) lines.push_back(line);
+    ASSERT_EQ(lines.size(), 3);
+    ASSERT_TRUE(lines[0].find("seed,nodes,") == 0);
+    ASSERT_TRUE(lines[1].find("1,3,1,1,") == 0);
+    ASSERT_TRUE(lines[2].find("1,5,1,1,") == 0);
+}
+
 //Not sure what this test is doing, could ressurect it, but maybe not worth the effort
 TEST(TestOther, TestEncryption) {
     //Boot up a simulator for our Logger
@@ -902,6 +1174,84 @@ TEST(TestOther, TestTimeSyncDuration_long) {
     ASSERT_TRUE(timeDiff <= 1);     //We allow 1 second off
 }
 
+TEST(TestOther, TestTimeSyncDriftCompensation_long) {
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    //testerConfig.verbose = true;
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.terminalId = 0;
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1});
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 3});
+    simConfig.SetToPerfectConditions();
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+
+    //Builds the line root - A - B - C so that the time has to travel over several hops
+    std::vector<u32> lineIndices;
+    for (u32 i = 0; i < tester.sim->GetTotalNodes(); i++)
+    {
+        NodeIndexSetter setter(i);
+        if (GET_DEVICE_TYPE() == DeviceType::SINK) lineIndices.insert(lineIndices.begin(), i);
+        else lineIndices.push_back(i);
+    }
+    ASSERT_EQ(lineIndices.size(), 4);
+    const i32 driftsPpm[] = { 0, 100, -50, 80 };
+    for (u32 i = 0; i < lineIndices.size(); i++)
+    {
+        tester.sim->nodes[lineIndices[i]].x = 0.5f + i * 0.01f;
+        tester.sim->nodes[lineIndices[i]].y = 0.5f;
+        tester.sim->nodes[lineIndices[i]].clockDriftPpm = driftsPpm[i];
+        for (u32 k = i + 2; k < lineIndices.size(); k++)
+        {
+            tester.sim->nodes[lineIndices[i]].impossibleConnection.push_back(lineIndices[k]);
+        }
+    }
+    const u32 rootIndex = lineIndices[0];
+    const NodeId rootId = tester.sim->nodes[rootIndex].id;
+
+    tester.SimulateUntilClusteringDone(100 * 1000);
+
+    tester.SendTerminalCommand(rootId, "settime 1560262597 0");
+    tester.SimulateForGivenTime(60 * 1000);
+
+    //The root refreshes its time regularly, which is propagated through the mesh and lets the nodes estimate their drift
+    constexpr u32 syncIntervalMs = 30 * 60 * 1000;
+    for (u32 round = 0; round < 5; round++)
+    {
+        tester.SimulateForGivenTime(syncIntervalMs);
+
+        //The refresh has to happen early in a second so that it matches the current time of the root
+        u32 rootTime = 0;
+        while (true)
+        {
+            {
+                NodeIndexSetter setter(rootIndex);
+                rootTime = GS->timeManager.GetTime();
+                if (GS->timeManager.GetTimePoint().GetAdditionalTicks() < ticksPerSecond / 4) break;
+            }
+            tester.SimulateGivenNumberOfSteps(1);
+        }
+        tester.SendTerminalCommand(rootId, "settime %u 0", rootTime);
+        tester.SimulateForGivenTime(60 * 1000);
+    }
+
+    for (u32 i = 1; i < lineIndices.size(); i++)
+    {
+        NodeIndexSetter setter(lineIndices[i]);
+        const i32 expectedDriftPpm = driftsPpm[0] - driftsPpm[i];
+        ASSERT_NEAR(GS->timeManager.GetClockDriftPpm(), expectedDriftPpm, 25);
+    }
+
+    //Without a refresh, the nodes must now stay much closer to the root than their drift would allow
+    tester.SimulateForGivenTime(syncIntervalMs);
+    for (u32 i = 1; i < lineIndices.size(); i++)
+    {
+        const i32 relativeDriftPpm = driftsPpm[i] - driftsPpm[0];
+        const i32 uncompensatedErrorTicks = (i32)((syncIntervalMs / 1000) * ticksPerSecond / 1000000.0 * (relativeDriftPpm < 0 ? -relativeDriftPpm : relativeDriftPpm));
+        const i32 errorTicks = tester.sim->GetTimeErrorTicks(lineIndices[i], rootIndex);
+        ASSERT_LT(errorTicks < 0 ? -errorTicks : errorTicks, uncompensatedErrorTicks / 2);
+    }
+}
+
 TEST(TestOther, TestRestrainedKeyGeneration) {
     CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
     //testerConfig.verbose = true;
@@ -1483,3 +1833,76 @@ TEST(TestOther, TestConnectionSupervisionTimeoutWontDisconnect) {
     }
 }
 #endif //GITHUB_RELEASE
+
+extern SIM_THREAD_LOCAL std::map<std::string, int> simStatCounts;
+TEST(TestOther, TestLinkLayerThroughputModel) {
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    // testerConfig.verbose = true;
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.terminalId = 0;
+    simConfig.SetToPerfectConditions();
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1});
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 1});
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+
+    tester.SimulateUntilClusteringDone(10 * 1000);
+
+    SoftdeviceConnection* connection = nullptr;
+    for (int i = 0; i < tester.sim->nodes[1].state.configuredTotalConnectionCount; i++) {
+        if (tester.sim->nodes[1].state.connections[i].connectionActive) connection = &tester.sim->nodes[1].state.connections[i];
+    }
+    ASSERT_TRUE(connection != nullptr);
+
+    //Preamble, access address, header and CRC are always sent, the payload adds 8us per byte on the 1M PHY
+    connection->connectionEncrypted = false;
+    ASSERT_EQ(tester.sim->GetLinkLayerPacketAirtimeUs(connection, 0), 80u);
+    ASSERT_EQ(tester.sim->GetLinkLayerPacketAirtimeUs(connection, SIM_LL_DEFAULT_PAYLOAD), 296u);
+    ASSERT_EQ(tester.sim->GetLinkLayerPacketAirtimeUs(connection, SIM_LL_MAX_PAYLOAD), 2088u);
+    connection->phyBitrateKbps = 2000;
+    ASSERT_EQ(tester.sim->GetLinkLayerPacketAirtimeUs(connection, SIM_LL_DEFAULT_PAYLOAD), 152u);
+    connection->phyBitrateKbps = 1000;
+    ASSERT_LE(tester.sim->GetConnectionEventBudgetUs(connection), SIM_CONNECTION_EVENT_LENGTH_US);
+
+    //Both halves of the connection use the negotiated data length
+    ASSERT_EQ(connection->linkLayerMaxPayload, SIM_LL_MAX_PAYLOAD);
+    ASSERT_EQ(connection->partnerConnection->linkLayerMaxPayload, SIM_LL_MAX_PAYLOAD);
+    ASSERT_NE(connection->isCentral, connection->partnerConnection->isCentral);
+
+    auto floodForGivenTime = [&](u32 timeMs, bool bothDirections) {
+        for (u32 i = 0; i < timeMs / tester.sim->simConfig.simTickDurationMs; i++) {
+            for (u32 nodeIndex = 0; nodeIndex < 2; nodeIndex++) {
+                if (nodeIndex == 0 && !bothDirections) continue;
+                NodeIndexSetter setter(nodeIndex);
+                DebugModule* mod = (DebugModule*)GS->node.GetModuleById(ModuleId::DEBUG_MODULE);
+                mod->SendQueueFloodMessage(DeliveryPriority::LOW);
+            }
+            tester.SimulateGivenNumberOfSteps(1);
+        }
+    };
+
+    //Without any packet loss, nothing has to be retransmitted
+    const int retransmissionsBefore = simStatCounts["linkLayerRetransmissions"];
+    u32 deliveredBefore = tester.sim->simState.packetsDelivered;
+    floodForGivenTime(5 * 1000, false);
+    const u32 deliveredPerfect = tester.sim->simState.packetsDelivered - deliveredBefore;
+    ASSERT_EQ(simStatCounts["linkLayerRetransmissions"], retransmissionsBefore);
+
+    //The packets of both sides are exchanged in the same connection events and share their airtime
+    deliveredBefore = tester.sim->simState.packetsDelivered;
+    floodForGivenTime(5 * 1000, true);
+    const u32 deliveredBothDirections = tester.sim->simState.packetsDelivered - deliveredBefore;
+    ASSERT_GT(deliveredBothDirections, deliveredPerfect);
+    ASSERT_EQ(simStatCounts["linkLayerRetransmissions"], retransmissionsBefore);
+
+    //CRC errors cause retransmissions which reduce the throughput
+    tester.sim->simConfig.receptionProbabilityVeryClose = UINT32_MAX / 2;
+    tester.sim->simConfig.receptionProbabilityClose     = UINT32_MAX / 2;
+    tester.sim->simConfig.receptionProbabilityFar       = UINT32_MAX / 2;
+    tester.sim->simConfig.receptionProbabilityVeryFar   = UINT32_MAX / 2;
+    deliveredBefore = tester.sim->simState.packetsDelivered;
+    floodForGivenTime(5 * 1000, false);
+    const u32 deliveredLossy = tester.sim->simState.packetsDelivered - deliveredBefore;
+    ASSERT_GT(simStatCounts["linkLayerRetransmissions"], retransmissionsBefore);
+    ASSERT_LT(deliveredLossy, deliveredPerfect);
+}
@@ -43,7 +43,7 @@ private:
     CherrySimTester* tester = nullptr;
 public:
     u8* startPage;
-    static constexpr u16 numPages = RECORD_STORAGE_NUM_PAGES;
+    u16 numPages = RECORD_STORAGE_NUM_PAGES;
 
     void SetUp() override
     {
@@ -77,6 +77,99 @@ public:
     void DefragmentPage(RecordStoragePage* pageToDefragment, bool force) {
         GS->recordStorage.DefragmentPage(*pageToDefragment, false);
     }
+    //Uses a different number of pages than RECORD_STORAGE_NUM_PAGES, the pages must be cleared and repaired afterwards
+    void SetNumPages(u16 pages) {
+        //The pages end at the bootloader, so additional pages are placed below the default ones
+        startPage = (u8*)Utility::GetSettingsPageBaseAddress() - ((i32)pages - RECORD_STORAGE_NUM_PAGES) * (i32)FruityHal::GetCodePageSize();
+        numPages = pages;
+        GS->recordStorage.startPage = startPage;
+        GS->recordStorage.numPages = pages;
+    }
+    u32 GetLargestFreeSpace() {
+        u32 freeSpace = 0;
+        for (u32 i = 0; i < numPages; i++) {
+            RecordStoragePage& page = GS->recordStorage.getPage(i);
+            if (GS->recordStorage.GetPageState(page) == RecordStoragePageState::ACTIVE && GS->recordStorage.GetFreeSpaceOnPage(page) > freeSpace) freeSpace = GS->recordStorage.GetFreeSpaceOnPage(page);
+        }
+        return freeSpace;
+    }
+    bool IsDefragmenting() {
+        return GS->recordStorage.defragmentationStage != DefragmentationStage::NO_DEFRAGMENTATION;
+    }
+    bool IsDefragmentingInBackground() {
+        return IsDefragmenting() && GS->recordStorage.defragmentInBackground;
+    }
+    u16 GetDefragmentPageNumber() {
+        return ((u32)GS->recordStorage.defragmentPage - FLASH_REGION_START_ADDRESS) / FruityHal::GetCodePageSize();
+    }
+    //Outdates record versions until all pages are filled far enough for a background defragmentation
+    void FillWithOutdatedRecords(u16 recordId) {
+        u8 data[200];
+        for (u32 i = 0; GetLargestFreeSpace() >= FruityHal::GetCodePageSize() / 4; i++) {
+            CheckedMemset(data, i, sizeof(data));
+            GS->recordStorage.SaveRecord(recordId, data, sizeof(data), nullptr, 0);
+            cherrySimInstance->SimCommitFlashOperations();
+        }
+    }
+
+    //Fills the pages until a page is defragmented in the background and saves records in the meantime
+    void TestBackgroundDefragmentationWithPages(u16 pages)
+    {
+        //Setup
+        SetNumPages(pages);
+        CheckedMemset(startPage, 0xff, numPages*FruityHal::GetCodePageSize());
+        RepairPages();
+
+        cherrySimInstance->SimCommitFlashOperations();
+
+        u8 data[] = { 1,2,3,4,5,6,7,8 };
+        GS->recordStorage.SaveRecord(2, data, sizeof(data), nullptr, 0);
+        cherrySimInstance->SimCommitFlashOperations();
+
+        //While there is still a page that is less than half full, nothing is defragmented
+        u8 data1[200];
+        CheckedMemset(data1, 0x11, sizeof(data1));
+        for (u32 i = 0; i < 20; i++) {
+            GS->recordStorage.SaveRecord(1, data1, sizeof(data1), nullptr, 0);
+            cherrySimInstance->SimCommitFlashOperations();
+            data1[0]++;
+        }
+        ASSERT_GE(GetLargestFreeSpace(), FruityHal::GetCodePageSize() / 2);
+        for (u32 i = 0; i < 2u * numPages; i++) {
+            GS->recordStorage.TimerEventHandler(1);
+            cherrySimInstance->SimCommitFlashOperations();
+        }
+        ASSERT_FALSE(IsDefragmenting());
+
+        FillWithOutdatedRecords(1);
+        for (u32 i = 0; i < 100 && !IsDefragmenting(); i++) {
+            GS->recordStorage.TimerEventHandler(1);
+            cherrySimInstance->SimCommitFlashOperations();
+        }
+        ASSERT_TRUE(IsDefragmentingInBackground());
+
+        //Other pages still have space, so records are saved while the defragmentation continues in the background
+        u8 data3[] = { 3,3,3,3 };
+        GS->recordStorage.SaveRecord(3, data3, sizeof(data3), nullptr, 0);
+        cherrySimInstance->SimCommitFlashOperations();
+        SizedData record3 = GS->recordStorage.GetRecordData(3);
+        ASSERT_EQ(record3.length.GetRaw(), sizeof(data3));
+        ASSERT_EQ(memcmp(record3.data, data3, sizeof(data3)), 0);
+        ASSERT_TRUE(IsDefragmentingInBackground());
+
+        for (u32 i = 0; i < 100 && IsDefragmenting(); i++) {
+            GS->recordStorage.TimerEventHandler(1);
+            cherrySimInstance->SimCommitFlashOperations();
+        }
+        ASSERT_FALSE(IsDefragmenting());
+
+        SizedData record2 = GS->recordStorage.GetRecordData(2);
+        ASSERT_EQ(record2.length.GetRaw(), sizeof(data));
+        ASSERT_EQ(memcmp(record2.data, data, sizeof(data)), 0);
+        ASSERT_EQ(GS->recordStorage.GetRecordData(1).length.GetRaw(), 200);
+        record3 = GS->recordStorage.GetRecordData(3);
+        ASSERT_EQ(memcmp(record3.data, data3, sizeof(data3)), 0);
+    }
 
     void RecordStorageEventHandler(u16 recordId, RecordStorageResultCode resultCode, u32 userType, u8* userData, u16 userDataLength) override
     {
@@ -527,3 +620,155 @@ TEST_F(TestRecordStorage, TestRandomMultiRecordUpdates) {
         }
     }
 }
+
+class FlashStorageOrderListener : public FlashStorageEventListener
+{
+public:
+    std::vector<u32> executedUserTypes;
+
+    void FlashStorageItemExecuted(FlashStorageTaskItem* task, FlashStorageError errorCode) override
+    {
+        if (errorCode == FlashStorageError::SUCCESS) executedUserTypes.push_back(task->header.userType);
+    }
+};
+
+TEST_F(TestRecordStorage, TestFlashStorageCoalescing) {
+    NodeIndexSetter setter(0);
+
+    //Setup
+    CheckedMemset(startPage, 0xff, numPages*FruityHal::GetCodePageSize());
+    RepairPages();
+
+    cherrySimInstance->SimCommitFlashOperations();
+    GS->flashStorage.ResetWearStatistics();
+
+    //Use the end of the last page, which is not touched by the RecordStorage
+    u8* lastPage = startPage + (numPages - 1) * FruityHal::GetCodePageSize();
+    u32* destination = (u32*)(lastPage + FruityHal::GetCodePageSize() - 64);
+    const u16 page = ((u32)lastPage - FLASH_REGION_START_ADDRESS) / FruityHal::GetCodePageSize();
+
+    FlashStorageOrderListener listener;
+    const u32 first[] = { 0x11111111, 0x22222222 };
+    const u32 adjacent[] = { 0x33333333, 0x44444444 };
+    const u32 overlapping = 0x3C3C3C3C;
+    const u8 unaligned[] = { 0x55, 0x66, 0x77 };
+
+    //The first write is executed at once, the others are queued behind it and merged
+    GS->flashStorage.CacheAndWriteData(first, destination, sizeof(first), &listener, 1);
+    GS->flashStorage.CacheAndWriteData(adjacent, destination + 2, sizeof(adjacent), &listener, 2);
+    GS->flashStorage.CacheAndWriteData(&overlapping, destination + 2, sizeof(overlapping), &listener, 3);
+    GS->flashStorage.CacheAndWriteData((u32*)unaligned, destination + 4, sizeof(unaligned), &listener, 4);
+
+    cherrySimInstance->SimCommitFlashOperations();
+
+    //All listeners are notified in the order of the writes
+    ASSERT_EQ(listener.executedUserTypes, std::vector<u32>({ 1, 2, 3, 4 }));
+
+    //Overlapping data only clears bits, as it would have without merging
+    ASSERT_EQ(destination[0], 0x11111111u);
+    ASSERT_EQ(destination[1], 0x22222222u);
+    ASSERT_EQ(destination[2], 0x30303030u);
+    ASSERT_EQ(destination[3], 0x44444444u);
+    ASSERT_EQ(destination[4], 0xFF776655u);
+
+    const FlashStoragePageWear* wear = GS->flashStorage.GetPageWear(page);
+    ASSERT_NE(wear, nullptr);
+    ASSERT_EQ(wear->writes, 2u);
+    ASSERT_EQ(wear->erases, 0u);
+    ASSERT_EQ(GS->flashStorage.GetCoalescedWrites(), 2u);
+
+    //Writes to other pages must not be merged
+    const u32 otherPageData = 0x12345678;
+    GS->flashStorage.CacheAndWriteData(&otherPageData, destination + 8, sizeof(otherPageData), nullptr, 0);
+    GS->flashStorage.CacheAndWriteData(&otherPageData, (u32*)(lastPage - 64), sizeof(otherPageData), nullptr, 0);
+    GS->flashStorage.CacheAndWriteData(&otherPageData, destination + 9, sizeof(otherPageData), nullptr, 0);
+    cherrySimInstance->SimCommitFlashOperations();
+    ASSERT_EQ(wear->writes, 4u);
+    ASSERT_EQ(GS->flashStorage.GetCoalescedWrites(), 2u);
+
+    //Only pages that are not empty are erased and counted
+    GS->flashStorage.ErasePage(page, nullptr, 0);
+    cherrySimInstance->SimCommitFlashOperations();
+    GS->flashStorage.ErasePage(page, nullptr, 0);
+    cherrySimInstance->SimCommitFlashOperations();
+    ASSERT_EQ(wear->erases, 1u);
+    ASSERT_EQ(destination[0], 0xFFFFFFFFu);
+}
+
+TEST_F(TestRecordStorage, TestBackgroundDefragmentation) {
+    NodeIndexSetter setter(0);
+
+    //Setup
+    CheckedMemset(startPage, 0xff, numPages*FruityHal::GetCodePageSize());
+    RepairPages();
+
+    cherrySimInstance->SimCommitFlashOperations();
+
+    u8 data[] = { 1,2,3,4,5,6,7,8 };
+    GS->recordStorage.SaveRecord(2, data, sizeof(data), nullptr, 0);
+    cherrySimInstance->SimCommitFlashOperations();
+
+    logt("WARNING", "---- TEST DEFRAGMENTATION DRIVEN BY TIMER ----");
+    FillWithOutdatedRecords(1);
+    GS->flashStorage.ResetWearStatistics();
+
+    //Checking the pages and defragmenting is spread over many ticks, a single tick must not finish it
+    u32 ticks = 0;
+    for (; ticks < 100; ticks++) {
+        GS->recordStorage.TimerEventHandler(1);
+        cherrySimInstance->SimCommitFlashOperations();
+        if (ticks == 0 && IsDefragmenting()) FAIL() << "Pages should be checked one per tick"; //LCOV_EXCL_LINE assertion
+        if (IsDefragmenting()) break;
+    }
+    ASSERT_TRUE(IsDefragmentingInBackground());
+    const u16 defragmentedPage = GetDefragmentPageNumber();
+    for (; ticks < 100 && IsDefragmenting(); ticks++) {
+        GS->recordStorage.TimerEventHandler(1);
+        cherrySimInstance->SimCommitFlashOperations();
+    }
+    ASSERT_FALSE(IsDefragmenting());
+    ASSERT_GE(GetLargestFreeSpace(), FruityHal::GetCodePageSize() / 2);
+
+    const FlashStoragePageWear* wear = GS->flashStorage.GetPageWear(defragmentedPage);
+    ASSERT_NE(wear, nullptr);
+    ASSERT_EQ(wear->erases, 1u);
+
+    SizedData record1 = GS->recordStorage.GetRecordData(1);
+    SizedData record2 = GS->recordStorage.GetRecordData(2);
+    ASSERT_EQ(record1.length.GetRaw(), 200);
+    ASSERT_EQ(record2.length.GetRaw(), sizeof(data));
+    ASSERT_EQ(memcmp(record2.data, data, sizeof(data)), 0);
+
+    //Without further record operations, there is nothing left to check
+    GS->recordStorage.TimerEventHandler(1);
+    cherrySimInstance->SimCommitFlashOperations();
+    ASSERT_FALSE(IsDefragmenting());
+
+    logt("WARNING", "---- TEST OPERATION WAITING FOR DEFRAGMENTATION ----");
+    FillWithOutdatedRecords(1);
+    for (u32 i = 0; i < 100 && !IsDefragmenting(); i++) {
+        GS->recordStorage.TimerEventHandler(1);
+        cherrySimInstance->SimCommitFlashOperations();
+    }
+    ASSERT_TRUE(IsDefragmentingInBackground());
+
+    //The defragmented page is the only active page, so the operation has to wait but is not rejected
+    u8 data2[] = { 8,7,6,5,4,3,2,1 };
+    GS->recordStorage.SaveRecord(2, data2, sizeof(data2), this, 1);
+    cherrySimInstance->SimCommitFlashOperations();
+
+    ASSERT_FALSE(IsDefragmenting());
+    record2 = GS->recordStorage.GetRecordData(2);
+    ASSERT_EQ(record2.length.GetRaw(), sizeof(data2));
+    ASSERT_EQ(memcmp(record2.data, data2, sizeof(data2)), 0);
+    ASSERT_EQ(GS->recordStorage.GetRecordData(1).length.GetRaw(), 200);
+}
+
+TEST_F(TestRecordStorage, TestBackgroundDefragmentationWithMorePages) {
+    NodeIndexSetter setter(0);
+
+    //The trigger has to work the same for any number of pages, not only for a few more
+    TestBackgroundDefragmentationWithPages(4);
+    TestBackgroundDefragmentationWithPages(8);
+    TestBackgroundDefragmentationWithPages(16);
+}
@@ -231,4 +231,109 @@ TEST(TestScanController, TestScannerWillStopOnceAllJobsAreDeleted) {
     RemoveJob(p_job_2, tester);
 
     simulateAndCheckScanning(1000, false, tester);
-}
\ No newline at end of file
+}
+
+TEST(TestScanController, TestAdaptiveScanDutyCycle) {
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.terminalId = 1;
+    //testerConfig.verbose = true;
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1});
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 2});
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+
+    tester.SimulateUntilClusteringDone(100 * 1000);
+
+    u16 windowHigh = 0;
+    u16 intervalLow = 0;
+    {
+        NodeIndexSetter setter(0);
+        ASSERT_EQ(GS->node.currentDiscoveryState, DiscoveryState::HIGH);
+        windowHigh = Conf::GetInstance().meshScanWindowHigh;
+        intervalLow = Conf::GetInstance().meshScanIntervalLow;
+        //Every advertiser makes the environment dense
+        Conf::GetInstance().adaptiveScanDenseReportRate = 1;
+    }
+
+    //During discovery high, the window is only halved
+    simulateAndCheckWindow(20 * 1000, UNITS_TO_MSEC(windowHigh >> 1, CONFIG_UNIT_0_625_MS), tester);
+    u32 reportRate = 0;
+    {
+        NodeIndexSetter setter(0);
+        reportRate = GS->scanController.GetReportRate();
+        ASSERT_GT(reportRate, 1u);
+    }
+
+    //A rate below the dense rate but above a quarter of it keeps the reduced window
+    {
+        NodeIndexSetter setter(0);
+        Conf::GetInstance().adaptiveScanDenseReportRate = (u16)(reportRate * 2);
+    }
+    simulateAndCheckWindow(10 * 1000, UNITS_TO_MSEC(windowHigh >> 1, CONFIG_UNIT_0_625_MS), tester);
+
+    //Once the environment is clearly not dense anymore, the full window is used again
+    {
+        NodeIndexSetter setter(0);
+        Conf::GetInstance().adaptiveScanDenseReportRate = UINT16_MAX;
+    }
+    simulateAndCheckWindow(10 * 1000, UNITS_TO_MSEC(windowHigh, CONFIG_UNIT_0_625_MS), tester);
+
+    //In discovery low, the interval is increased if the environment is sparse
+    {
+        NodeIndexSetter setter(0);
+        Conf::GetInstance().adaptiveScanSparseReportRate = UINT16_MAX;
+        GS->node.ChangeState(DiscoveryState::LOW);
+    }
+    tester.SimulateForGivenTime(20 * 1000);
+    {
+        NodeIndexSetter setter(0);
+        ASSERT_EQ(tester.sim->currentNode->state.scanIntervalMs, (int)UNITS_TO_MSEC(intervalLow << SCAN_ADAPTATION_MAX_SHIFT, CONFIG_UNIT_0_625_MS));
+    }
+
+    //A timed job that waits for scan results disables the adaptation at once
+    ScanJob job;
+    job.timeMode = ScanJobTimeMode::TIMED;
+    job.timeLeftDs = SEC_TO_DS(10);
+    job.interval = MSEC_TO_UNITS(1000, CONFIG_UNIT_0_625_MS);
+    job.window = MSEC_TO_UNITS(5, CONFIG_UNIT_0_625_MS);
+    job.state = ScanJobState::ACTIVE;
+    job.type = ScanState::CUSTOM;
+    AddJob(job, tester);
+    {
+        NodeIndexSetter setter(0);
+        ASSERT_EQ(tester.sim->currentNode->state.scanIntervalMs, (int)UNITS_TO_MSEC(intervalLow, CONFIG_UNIT_0_625_MS));
+    }
+
+    //After the job timed out, the adapted interval is used again
+    tester.SimulateForGivenTime(11 * 1000);
+    {
+        NodeIndexSetter setter(0);
+        ASSERT_EQ(tester.sim->currentNode->state.scanIntervalMs, (int)UNITS_TO_MSEC(intervalLow << SCAN_ADAPTATION_MAX_SHIFT, CONFIG_UNIT_0_625_MS));
+        Conf::GetInstance().adaptiveScanSparseReportRate = 0;
+    }
+    tester.SimulateForGivenTime(6 * 1000);
+    {
+        NodeIndexSetter setter(0);
+        ASSERT_EQ(tester.sim->currentNode->state.scanIntervalMs, (int)UNITS_TO_MSEC(intervalLow, CONFIG_UNIT_0_625_MS));
+    }
+
+    //Reach the largest shifts in discovery low, these must not be applied to the high job after a state change
+    u16 intervalHigh = 0;
+    {
+        NodeIndexSetter setter(0);
+        intervalHigh = Conf::GetInstance().meshScanIntervalHigh;
+        Conf::GetInstance().adaptiveScanDenseReportRate = 1;
+        Conf::GetInstance().adaptiveScanSparseReportRate = UINT16_MAX;
+    }
+    tester.SimulateForGivenTime(20 * 1000);
+    {
+        NodeIndexSetter setter(0);
+        ASSERT_EQ(GS->node.currentDiscoveryState, DiscoveryState::LOW);
+        ASSERT_EQ(tester.sim->currentNode->state.scanIntervalMs, (int)UNITS_TO_MSEC(intervalLow << SCAN_ADAPTATION_MAX_SHIFT, CONFIG_UNIT_0_625_MS));
+
+        GS->node.ChangeState(DiscoveryState::HIGH);
+        ASSERT_EQ(tester.sim->currentNode->state.scanWindowMs, (int)UNITS_TO_MSEC(windowHigh >> 1, CONFIG_UNIT_0_625_MS));
+        ASSERT_EQ(tester.sim->currentNode->state.scanIntervalMs, (int)UNITS_TO_MSEC(intervalHigh, CONFIG_UNIT_0_625_MS));
+    }
+}
@@ -36,6 +36,29 @@
 #endif //GITHUB_RELEASE
 #include "ScanningModule.h"
 
+//Simulates that the node with the given index scanned a legacy asset advertising packet
+static void DispatchLegacyAssetAdvertisement(u32 nodeIndex, NodeId assetNodeId, i8 rssi)
+{
+    alignas(ble_evt_t) u8 buffer[1024];
+    CheckedMemset(buffer, 0, sizeof(buffer));
+    ble_evt_t& evt = *(ble_evt_t*)buffer;
+    AdvPacketServiceAndDataHeader* packet = (AdvPacketServiceAndDataHeader*)evt.evt.gap_evt.params.adv_report.data;
+    AdvPacketLegacyAssetServiceData* assetPacket = (AdvPacketLegacyAssetServiceData*)&packet->data;
+    evt.header.evt_id = BLE_GAP_EVT_ADV_REPORT;
+    evt.evt.gap_evt.params.adv_report.dlen = SIZEOF_ADV_STRUCTURE_LEGACY_ASSET_SERVICE_DATA;
+    evt.evt.gap_evt.params.adv_report.rssi = rssi;
+    packet->flags.len = SIZEOF_ADV_STRUCTURE_FLAGS - 1;
+    packet->uuid.len = SIZEOF_ADV_STRUCTURE_UUID16 - 1;
+    packet->data.uuid.type = (u8)BleGapAdType::TYPE_SERVICE_DATA;
+    packet->data.uuid.uuid = MESH_SERVICE_DATA_SERVICE_UUID16;
+    packet->data.messageType = ServiceDataMessageType::LEGACY_ASSET;
+    assetPacket->serialNumberIndex = 10;
+    assetPacket->nodeId = assetNodeId;
+
+    NodeIndexSetter setter(nodeIndex);
+    FruityHal::DispatchBleEvents(&evt);
+}
+
 TEST(TestScanningModule, TestCommands) {
     CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
     SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
@@ -72,4 +95,89 @@ TEST(TestScanningModule, TestCommands) {
     tester.SimulateGivenNumberOfSteps(1);
 
     //jstodo This test currently doesn't do much. Investigate if it is still needed.
-}
\ No newline at end of file
+}
+
+TEST(TestScanningModule, TestAssetReportAggregation) {
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.terminalId = 0;
+    //testerConfig.verbose = true;
+    //Uses the github featuresets as a real sink is needed to receive the reports
+    simConfig.nodeConfigName.insert({ "github_sink_nrf52", 1});
+    simConfig.nodeConfigName.insert({ "github_mesh_nrf52", 2});
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+
+    tester.SimulateUntilClusteringDone(100 * 1000);
+
+    //Both mesh nodes coalesce asset reports and report their own observations every second
+    for (u32 nodeIndex = 1; nodeIndex <= 2; nodeIndex++)
+    {
+        NodeIndexSetter setter(nodeIndex);
+        ScanningModule* mod = (ScanningModule*)GS->node.GetModuleById(ModuleId::SCANNING_MODULE);
+        mod->assetReportingIntervalDs = SEC_TO_DS(1);
+        mod->assetAggregationWindowDs = SEC_TO_DS(2);
+    }
+
+    //The same asset is scanned by both mesh nodes
+    DispatchLegacyAssetAdvertisement(1, 1337, -45);
+    DispatchLegacyAssetAdvertisement(2, 1337, -60);
+
+    //The sink must still get the observation of each node, no matter if it was merged by a relay
+    std::vector<SimulationMessage> messages = {
+        SimulationMessage(1, "{\"nodeId\":2,\"type\":\"tracked_assets_ins\",\"assets\":[{\"id\":1337,"),
+        SimulationMessage(1, "{\"nodeId\":3,\"type\":\"tracked_assets_ins\",\"assets\":[{\"id\":1337,"),
+    };
+    tester.SimulateUntilMessagesReceived(10 * 1000, messages);
+
+    //Several assets that are scanned within one window must be merged into a single mesh packet
+    DispatchLegacyAssetAdvertisement(1, 1340, -50);
+    DispatchLegacyAssetAdvertisement(1, 1341, -50);
+    DispatchLegacyAssetAdvertisement(1, 1342, -50);
+    std::vector<SimulationMessage> mergedMessages = {
+        SimulationMessage(2, "Sending 3 aggregated asset reports"),
+        SimulationMessage(1, "{\"id\":1340,"),
+    };
+    tester.SimulateUntilMessagesReceived(10 * 1000, mergedMessages);
+}
+
+TEST(TestScanningModule, TestTrackedAssetBufferIsSentEarlyWhenFull) {
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.terminalId = 0;
+    //testerConfig.verbose = true;
+    simConfig.nodeConfigName.insert({ "github_sink_nrf52", 1});
+    simConfig.nodeConfigName.insert({ "github_mesh_nrf52", 1});
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+
+    tester.SimulateUntilClusteringDone(100 * 1000);
+
+    {
+        NodeIndexSetter setter(1);
+        ScanningModule* mod = (ScanningModule*)GS->node.GetModuleById(ModuleId::SCANNING_MODULE);
+        mod->assetReportingIntervalDs = SEC_TO_DS(60);
+    }
+
+    //More assets than the buffer can hold are scanned, the strongest ones must be kept
+    for (NodeId assetNodeId = 2000; assetNodeId < 2000 + ASSET_PACKET_BUFFER_SIZE + 10; assetNodeId++)
+    {
+        DispatchLegacyAssetAdvertisement(1, assetNodeId, assetNodeId < 2000 + ASSET_PACKET_BUFFER_SIZE ? -80 : -40);
+    }
+
+    {
+        NodeIndexSetter setter(1);
+        u32 droppedAssets = 0;
+        for (u32 i = 0; i < GS->logger.errorLogPosition; i++)
+        {
+            if (GS->logger.errorLog[i].errorType == LoggingError::CUSTOM && GS->logger.errorLog[i].errorCode == (u32)CustomErrorTypes::COUNT_DROPPED_TRACKED_ASSETS)
+            {
+                droppedAssets = GS->logger.errorLog[i].extraInfo;
+            }
+        }
+        ASSERT_EQ(droppedAssets, 10);
+    }
+
+    //The buffer reached its high water mark, so it must be sent long before the reporting interval
+    tester.SimulateUntilMessageReceived(5 * 1000, 1, "{\"id\":%u,", 2000 + ASSET_PACKET_BUFFER_SIZE + 9);
+}
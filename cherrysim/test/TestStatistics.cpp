@@ -67,6 +67,8 @@ TEST(TestStatistics, TestNumberClusteringMessagesSent) {
     CheckAndClearStat(stat, MessageType::CLUSTER_ACK_1, ModuleId::INVALID_MODULE, 10, 50);
     CheckAndClearStat(stat, MessageType::CLUSTER_ACK_2, ModuleId::INVALID_MODULE, 10, 50);
     CheckAndClearStat(stat, MessageType::CLUSTER_INFO_UPDATE, ModuleId::INVALID_MODULE, 10, 200);
+    //Sent if the link quality changes the expected transmissions towards the sink
+    CheckAndClearStat(stat, MessageType::SINK_ROUTE, ModuleId::INVALID_MODULE, 0, 100);
 
     //This check surpassed 1000 cases. See IOT-3997
     CheckAndClearStat(stat, MessageType::MODULE_GENERAL, ModuleId::STATUS_REPORTER_MODULE, 10, 2000, (u8)StatusReporterModule::StatusModuleGeneralMessages::LIVE_REPORT);
@@ -78,6 +80,45 @@ TEST(TestStatistics, TestNumberClusteringMessagesSent) {
     checkStatEmpty(stat);
 }
 
+//Every packet that was handed to a simulated SoftDevice must either be delivered, be lost on a disconnect or still be buffered
+TEST(TestStatistics, TestSoftDevicePacketAccounting) {
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1});
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 9});
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+
+    tester.SimulateUntilClusteringDone(100 * 1000);
+
+    //Drop some connections so that packets that are still buffered get lost
+    for (u32 i = 0; i < 20; i++) {
+        tester.SimulateForGivenTime(3 * 1000);
+        NodeEntry& node = tester.sim->nodes[i % tester.sim->GetTotalNodes()];
+        for (int k = 0; k < node.state.configuredTotalConnectionCount; k++) {
+            if (node.state.connections[k].connectionActive) {
+                tester.sim->DisconnectSimulatorConnection(&node.state.connections[k], BLE_HCI_CONNECTION_TIMEOUT, BLE_HCI_CONNECTION_TIMEOUT);
+                break;
+            }
+        }
+    }
+
+    u32 stillBuffered = 0;
+    for (u32 i = 0; i < tester.sim->GetTotalNodes(); i++) {
+        const NodeEntry& node = tester.sim->nodes[i];
+        for (int k = 0; k < node.state.configuredTotalConnectionCount; k++) {
+            const SoftdeviceConnection& connection = node.state.connections[k];
+            for (int b = 0; b < SIM_NUM_RELIABLE_BUFFERS; b++) if (connection.reliableBuffers[b].sender != nullptr) stillBuffered++;
+            for (int b = 0; b < SIM_NUM_UNRELIABLE_BUFFERS; b++) if (connection.unreliableBuffers[b].sender != nullptr) stillBuffered++;
+        }
+    }
+
+    const SimulatorState& state = tester.sim->simState;
+    ASSERT_GT(state.packetsDelivered, 0u);
+    ASSERT_GT(state.bytesDelivered, state.packetsDelivered);
+    ASSERT_EQ(state.globalPacketIdCounter, state.packetsDelivered + state.packetsDroppedOnDisconnect + stillBuffered);
+}
+
 //#################################### Helpers for Statistic Tests #######################################
 
 void CheckAndClearStat(PacketStat* stat, MessageType mt, ModuleId moduleId, u32 minCount, u32 maxCount, u8 actionType)
@@ -33,6 +33,7 @@
 #include "CherrySimUtils.h"
 #include "Logger.h"
 #include "DebugModule.h"
+#include "StatusReporterModule.h"
 #include <json.hpp>
 
 using json = nlohmann::json;
@@ -354,3 +355,43 @@ TEST(TestStatusReporterModule, TestConnectionRssiReportingWithNoise) {
     }
 }
 #endif //GITHUB_RELEASE
+
+extern SIM_THREAD_LOCAL std::map<std::string, int> simStatCounts;
+TEST(TestStatusReporterModule, TestDeltaReports) {
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.terminalId = 0;
+    simConfig.SetToPerfectConditions();
+    simConfig.rssiNoise = false;
+    //testerConfig.verbose = true;
+
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 1 });
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+
+    tester.SimulateUntilClusteringDone(100 * 1000);
+
+    {
+        NodeIndexSetter setter(1);
+        StatusReporterModule* mod = (StatusReporterModule*)GS->node.GetModuleById(ModuleId::STATUS_REPORTER_MODULE);
+        ASSERT_TRUE(mod != nullptr);
+        mod->configuration.statusReportingIntervalDs = SEC_TO_DS(2);
+        mod->configuration.deltaReportKeyframeInterval = 5;
+    }
+
+    //The first periodic report is a full keyframe
+    tester.SimulateUntilMessageReceived(10 * 1000, 1, "{\"nodeId\":2,\"type\":\"status\",\"module\":3");
+
+    //Nothing changed, so the following reports must not be sent
+    const int suppressedBefore = simStatCounts["statusDeltaSuppressed"];
+    tester.SimulateForGivenTime(5 * 1000);
+    ASSERT_GE(simStatCounts["statusDeltaSuppressed"], suppressedBefore + 2);
+
+    //A changed field is sent on its own with the next report
+    {
+        NodeIndexSetter setter(1);
+        GS->node.connectionLossCounter = 42;
+    }
+    tester.SimulateUntilMessageReceived(10 * 1000, 1, "{\"nodeId\":2,\"type\":\"status_delta\",\"module\":3,\"connectionLossCounter\":42}");
+}
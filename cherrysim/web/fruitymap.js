@@ -29379,6 +29379,40 @@ define("test/tests/mesh/testSimulatorMap", ["require", "exports", "src/app/relut
         startUpdatingDeviceModels(fruityMap, serverUrl, intervalDurationMs);
     }
     function startUpdatingDeviceModels(fruityMap, serverUrl, intervalDurationMs) {
+        if (window.EventSource) {
+            startStreamingDeviceModels(fruityMap, serverUrl, intervalDurationMs);
+        }
+        else {
+            startPollingDeviceModels(fruityMap, serverUrl, intervalDurationMs);
+        }
+    }
+    // The stream first sends all devices and afterwards only the devices that changed.
+    function startStreamingDeviceModels(fruityMap, serverUrl, intervalDurationMs) {
+        let devicesByUuid = {};
+        let changed = false;
+        let eventSource = new EventSource(serverUrl + "/devices/stream");
+        eventSource.onmessage = function (event) {
+            let resultObject = JSON.parse(event.data);
+            if (resultObject["status"] === "success") {
+                resultObject.result.forEach((device) => {
+                    devicesByUuid[device.uuid] = device;
+                });
+                changed = true;
+            }
+        };
+        eventSource.onerror = function () {
+            Logger_13.Logger.logDebug("Device stream interrupted, reconnecting.");
+        };
+        setInterval(function () {
+            if (changed) {
+                changed = false;
+                let devicesObject = Object.keys(devicesByUuid).map((uuid) => devicesByUuid[uuid]);
+                let deviceModels = RelutionMapModelLoader_5.RelutionMapModelLoader.loadModels(devicesObject, DeviceModel_9.DeviceModel, false);
+                fruityMap.getBuilding().getCurrentFloor().updateDevices(deviceModels);
+            }
+        }, intervalDurationMs);
+    }
+    function startPollingDeviceModels(fruityMap, serverUrl, intervalDurationMs) {
         let lastDevicesObject = "";
         setInterval(function () {
             HttpUtils_5.HttpUtils.getJson(serverUrl + "/devices", function (resultObject) {
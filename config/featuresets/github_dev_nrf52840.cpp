@@ -36,6 +36,7 @@
 #include "ScanningModule.h"
 #include "EnrollmentModule.h"
 #include "IoModule.h"
+#include "BulkModule.h"
 #include "MeshAccessModule.h"
 #include "VendorTemplateModule.h"
 #include "GlobalState.h"
@@ -95,6 +96,7 @@ u32 InitializeModules_github_dev_nrf52840(bool createModule)
     size += GS->InitializeModule<ScanningModule>(createModule);
     size += GS->InitializeModule<EnrollmentModule>(createModule);
     size += GS->InitializeModule<IoModule>(createModule);
+    size += GS->InitializeModule<BulkModule>(createModule);
 
     //Each Vendor module needs a RecordStorage id if it wants to store a persistent configuration
     //see the section for VendorModules in RecordStorage.h for more info
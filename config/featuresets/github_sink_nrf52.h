@@ -33,3 +33,4 @@
 #define ACTIVATE_LOGGING 0
 #define ACTIVATE_UART 1
 #define ACTIVATE_STACK_UNWINDING 1
+#define ACTIVATE_BULK_ENROLLMENT 1 //The sink coordinates bulk enrollments for the MeshGateway
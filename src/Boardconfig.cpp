@@ -38,7 +38,12 @@ extern void SetBoard_4(BoardConfiguration* c);
 extern void SetBoard_18(BoardConfiguration* c);
 extern void SetBoard_19(BoardConfiguration* c);
 
+#ifdef SIM_ENABLED
+//Points to the board configuration of the node that is currently simulated on this thread
+SIM_THREAD_LOCAL void* fmBoardConfigPtr;
+#else
 void* fmBoardConfigPtr;
+#endif
 
 Boardconf::Boardconf()
 {
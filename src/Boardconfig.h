@@ -116,8 +116,12 @@ typedef struct BoardConfiguration
 #endif //__cplusplus
 
 //Can be used to make the boardconfig available to C
-#ifdef __cplusplus
+#if defined(__cplusplus) && defined(SIM_ENABLED)
+extern SIM_THREAD_LOCAL void* fmBoardConfigPtr;
+#elif defined(__cplusplus)
 extern void* fmBoardConfigPtr;
+#elif defined(SIM_ENABLED)
+extern SIM_THREAD_LOCAL struct BoardConfiguration* fmBoardConfigPtr;
 #else
 extern struct BoardConfiguration* fmBoardConfigPtr;
 #endif
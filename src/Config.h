@@ -155,7 +155,29 @@ static_assert(false, "Featureset was not defined, which is mandatory!");
 
 // The total amount of send queue chunks. See: ConnectionQueueMemoryChunk
 #ifndef CONNECTION_QUEUE_MEMORY_CHUNK_AMOUNT
-#define CONNECTION_QUEUE_MEMORY_CHUNK_AMOUNT 40
+#define CONNECTION_QUEUE_MEMORY_CHUNK_AMOUNT 34
+#endif
+
+// Every send queue starts with a small chunk so that idle queues (e.g. most VITAL queues) do not pin a full
+// chunk. All further chunks of a queue are full sized. There should be one small chunk for each queue that can
+// exist at the same time. Set the amount to 0 to start every queue with a full sized chunk instead.
+// Including the 16 byte of bookkeeping per chunk, 34 full sized and 24 small chunks use 10880 byte, which is
+// the same as 40 full sized chunks.
+#ifndef CONNECTION_QUEUE_MEMORY_SMALL_CHUNK_SIZE
+#define CONNECTION_QUEUE_MEMORY_SMALL_CHUNK_SIZE 52
+#endif
+#ifndef CONNECTION_QUEUE_MEMORY_SMALL_CHUNK_AMOUNT
+#define CONNECTION_QUEUE_MEMORY_SMALL_CHUNK_AMOUNT 24
+#endif
+
+// Each send queue caches the position of this many packets, counted from the oldest one, so that they can be
+// accessed without walking through the chunks. This is a bounded cache and not an index of the whole queue: packets
+// behind it are found by walking the chunks from the last cached position or from the last accessed packet, which
+// is cheap when enumerating in order but linear otherwise. The cache costs 2 byte per entry plus 12 byte, and the
+// position of the last accessed packet another 12 byte, per queue. With 16 entries, this is 56 byte per queue or
+// 224 byte per connection.
+#ifndef CHUNKED_PACKET_QUEUE_OFFSET_INDEX_SIZE
+#define CHUNKED_PACKET_QUEUE_OFFSET_INDEX_SIZE 16
 #endif
 
 // The maximum amount of chunks one connection can hold is limited by CONNECTION_QUEUE_MEMORY_MAX_CHUNKS_PER_CONNECTION.
@@ -163,7 +185,28 @@ static_assert(false, "Featureset was not defined, which is mandatory!");
 // Reestablishment. In such a case the rest of the connections have to share the rest of the chunks. If this rest gets
 // to low, a high amount of dropped packets is to be expected and should therefore be avoided.
 #ifndef CONNECTION_QUEUE_MEMORY_MAX_CHUNKS_PER_CONNECTION
-#define CONNECTION_QUEUE_MEMORY_MAX_CHUNKS_PER_CONNECTION 25
+#define CONNECTION_QUEUE_MEMORY_MAX_CHUNKS_PER_CONNECTION 21
+#endif
+
+// Sink bound traffic is flow controlled with credits: every node advertises to its partners how many full sized
+// send queue chunks it and its path towards the sink can still take. Once these credits drop below the threshold,
+// the partners hold back their periodic sink bound reports until the credits have recovered by the hysteresis.
+#ifndef FLOW_CONTROL_CONGESTION_CHUNK_THRESHOLD
+#define FLOW_CONTROL_CONGESTION_CHUNK_THRESHOLD 8
+#endif
+#ifndef FLOW_CONTROL_HYSTERESIS_CHUNKS
+#define FLOW_CONTROL_HYSTERESIS_CHUNKS 4
+#endif
+
+// Sinks advertise their load so that sink bound traffic is spread over all sinks of the mesh. The load is the
+// higher of the send queue usage and the received packets in relation to the capacity of the sink. Routes towards
+// a fully loaded sink are treated as if they needed the given amount of additional transmissions, 0 always routes
+// to the sink with the least expected transmissions.
+#ifndef SINK_LOAD_CAPACITY_PACKETS_PER_SECOND
+#define SINK_LOAD_CAPACITY_PACKETS_PER_SECOND 50
+#endif
+#ifndef SINK_LOAD_MAX_HOP_PENALTY
+#define SINK_LOAD_MAX_HOP_PENALTY 3
 #endif
 
 // Each connection does also have a buffer to assemble packets that were split into 20 byte chunks
@@ -286,6 +329,11 @@ static_assert(false, "Featureset was not defined, which is mandatory!");
 #define ACTIVATE_BATTERY_MEASUREMENT 1
 #endif
 
+// Activate to let this node coordinate bulk enrollments over a number of enrolling nodes
+#ifndef ACTIVATE_BULK_ENROLLMENT
+#define ACTIVATE_BULK_ENROLLMENT 0
+#endif
+
 // ########### Config class ##########################################
 //This class holds the configuration and some bits are changeable at runtime
 
@@ -443,6 +491,14 @@ class Conf
         u16 meshMaxConnectionInterval = 0;
         //(100-32000) Connection supervisory timeout
         static constexpr u16 meshConnectionSupervisionTimeout = (u16)MSEC_TO_UNITS(1000, CONFIG_UNIT_10_MS);
+        //Adaptive connection intervals: Mesh connections with a lot of traffic switch to the busy interval, idle
+        //connections are stretched to the idle interval (must be below half the supervision timeout).
+        //Set both to 0 to keep the interval that was used for setting up the connection.
+        u16 meshBusyConnectionInterval = 0;
+        u16 meshIdleConnectionInterval = 0;
+        //Once the clustering was stable for this time, nodes check whether one of the nodes in their own cluster would
+        //have a shorter route to the sink if it was connected to them instead of its current partner. 0 disables this.
+        u32 topologyOptimizationIntervalDs = 0;
 
         //Mesh discovery parameters
         //DISCOVERY_HIGH
@@ -460,6 +516,12 @@ class Conf
         //(2.5-1024) Determines scan window in units of 0.625 millisecond.
         u16 meshScanWindowLow = 0;
 
+        //Adaptive scan duty cycle of the mesh discovery, rates are advertising reports per second of scanning. 0 disables each.
+        //Above this rate, the scan window is reduced
+        u16 adaptiveScanDenseReportRate = 0;
+        //Below this rate, the scan interval is increased during discovery low
+        u16 adaptiveScanSparseReportRate = 0;
+
 
         // ########### CONNECTION ################################################
 
@@ -513,11 +575,11 @@ class Conf
 
 // Linker variables
 #if defined(SIM_ENABLED)
-    extern u32 __application_start_address;
-    extern u32 __application_end_address;
-    extern u32 __application_ram_start_address;
-    extern u32 __start_conn_type_resolvers;
-    extern u32 __stop_conn_type_resolvers;
+    extern SIM_THREAD_LOCAL u32 __application_start_address;
+    extern SIM_THREAD_LOCAL u32 __application_end_address;
+    extern SIM_THREAD_LOCAL u32 __application_ram_start_address;
+    extern SIM_THREAD_LOCAL u32 __start_conn_type_resolvers;
+    extern SIM_THREAD_LOCAL u32 __stop_conn_type_resolvers;
 #else
     extern u32 __application_start_address[]; //Variable is set in the linker script
     extern u32 __application_end_address[]; //Variable is set in the linker script
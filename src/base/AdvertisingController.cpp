@@ -79,11 +79,14 @@ void AdvertisingController::Deactivate()
 }
 
 /**
- * The Advertising Job Scheduler accepts a number of jobs with slots and delay
- * Each job is give its number of slots uniformly distributed over a cycle where all jobs
- * are processed. After all jobs have been processed, a new cycle is started. A delay can
- * span multiple cycles and enables advertising e.g. each hour for 10 slots.
- * Afterwards, the delay is reloaded
+ * The Advertising Job Scheduler selects a job for every slot. Each scheduled job declares the interval in which
+ * it should be advertised (its target rate) and optionally a maximum staleness. A job whose maximum staleness
+ * would be exceeded after the current slot is always selected first, the one with the earliest deadline wins.
+ * Otherwise, the job that is the furthest behind its target rate relative to its target interval is selected.
+ * If the advertiser is overbooked, all jobs therefore get a share that is proportional to their target rate.
+ * A delay can be given to advertise a scheduled job e.g. only for 10 slots from time to time. Once the job was
+ * advertised for its number of slots, the delay is reloaded.
+ * The number of slots that were actually advertised and the missed deadlines are counted for each job.
  */
 
 AdvJob* AdvertisingController::AddJob(const AdvJob& job){
@@ -94,9 +97,16 @@ AdvJob* AdvertisingController::AddJob(const AdvJob& job){
             currentNumJobs++;
             jobs[i] = job;
 
-            if(jobs[i].type == AdvJobTypes::IMMEDIATE){
-                jobs[i].currentSlots = jobs[i].slots;
-            }
+            jobs[i].currentSlots = jobs[i].slots;
+            jobs[i].currentDelay = jobs[i].delay;
+            jobs[i].addedDs = GS->appTimerDs;
+            //A new job is due right away
+            jobs[i].lastAdvertisedDs = GS->appTimerDs - GetTargetIntervalDs(jobs[i]);
+            jobs[i].numAdvertisedSlots = 0;
+            jobs[i].numDeadlineMisses = 0;
+            jobs[i].metricsWindowStartDs = GS->appTimerDs;
+            jobs[i].slotsInMetricsWindow = 0;
+            jobs[i].slotsInPreviousMetricsWindow = 0;
             logt("ADV", "Adding job %u", i);
             RefreshJob(&(jobs[i]));
             return &(jobs[i]);
@@ -153,11 +163,6 @@ void AdvertisingController::RemoveJob(AdvJob* jobHandle)
             logt("ADV", "Removing job %u", i);
             currentNumJobs--;
 
-            //Remove the remaining slots from our currently active scheduling
-            if (jobHandle->type == AdvJobTypes::SCHEDULED) {
-                sumSlots -= jobHandle->currentSlots;
-            }
-
             jobHandle->type = AdvJobTypes::INVALID;
 
             //Update Advertising interval
@@ -180,7 +185,7 @@ void AdvertisingController::RemoveJob(AdvJob* jobHandle)
 
 void AdvertisingController::TimerEventHandler(u16 passedTimeDs)
 {
-    if(SHOULD_IV_TRIGGER(GS->appTimerDs, passedTimeDs, 4)){
+    if(SHOULD_IV_TRIGGER(GS->appTimerDs, passedTimeDs, ADVERTISING_CONTROLLER_SLOT_DS)){
         DetermineAndSetAdvertisingJob();
     }
 }
@@ -199,27 +204,53 @@ void AdvertisingController::DetermineAndSetAdvertisingJob()
 
     //Must be called every time as this will restart advertising if necessary
     SetAdvertisingState(jobToSet);
+
+    //Only a slot in which the softdevice really advertises the job is counted
+    if(jobToSet != nullptr && jobToSet == currentActiveJob && advertisingState == AdvertisingState::ENABLED){
+        CountAdvertisedSlot(*jobToSet);
+    }
 }
 
-//Must be called once upfront before using Advertising Job Scheduler
-//Is automatically called by the scheduler as soon as a cycle has finished
-void AdvertisingController::InitJobScheduling(){
-    logt("ADVS", "Resetting Scheduling" SEP);
-    sumSlots = 0;
-    for(u32 i=0; i< jobs.size(); i++){
-        if (jobs[i].type == AdvJobTypes::SCHEDULED) {
-            //Refill slots, but only if there are none left (happens if a delay is set)
-            if (jobs[i].currentSlots == 0) {
-                jobs[i].currentSlots = jobs[i].slots;
-                jobs[i].currentDelay = jobs[i].delay;
-            }
-            //Count the max number of slots (Only the ones that aren't delayed)
-            if (jobs[i].currentDelay == 0) {
-                sumSlots += jobs[i].currentSlots;
-            }
-        }
+void AdvertisingController::CountAdvertisedSlot(AdvJob& job)
+{
+    //Start a new metrics window once the current one has passed, windows without slots are skipped
+    const u32 passedWindows = (GS->appTimerDs - job.metricsWindowStartDs) / ADVERTISING_CONTROLLER_METRICS_WINDOW_DS;
+    if(passedWindows > 0){
+        job.slotsInPreviousMetricsWindow = passedWindows == 1 ? job.slotsInMetricsWindow : 0;
+        job.slotsInMetricsWindow = 0;
+        job.metricsWindowStartDs += passedWindows * ADVERTISING_CONTROLLER_METRICS_WINDOW_DS;
+    }
+
+    if(job.slotsInMetricsWindow < UINT16_MAX) job.slotsInMetricsWindow++;
+    job.numAdvertisedSlots++;
+}
+
+u16 AdvertisingController::GetTargetIntervalDs(const AdvJob& job)
+{
+    if (job.targetIntervalDs != 0) return job.targetIntervalDs;
+
+    //Without a target rate, 10 slots mean that the job should be advertised in every slot
+    return job.slots == 0 ? UINT16_MAX : ADVERTISING_CONTROLLER_SLOT_DS * 10 / job.slots;
+}
+
+u32 AdvertisingController::GetAchievedIntervalDs(const AdvJob& job) const
+{
+    const u32 now = GS->appTimerDs;
+    u32 windowStartDs = job.metricsWindowStartDs;
+    u32 numSlots = job.slotsInMetricsWindow + job.slotsInPreviousMetricsWindow;
+
+    //The windows are only rolled over once the job is advertised again, a job that stopped must not keep its old rate
+    const u32 passedWindows = (now - windowStartDs) / ADVERTISING_CONTROLLER_METRICS_WINDOW_DS;
+    if (passedWindows > 0) {
+        numSlots = passedWindows == 1 ? job.slotsInMetricsWindow : 0;
+        windowStartDs += passedWindows * ADVERTISING_CONTROLLER_METRICS_WINDOW_DS;
     }
-    logt("ADVS", "sumSlots %u" SEP, sumSlots);
+    if (numSlots == 0) return 0;
+
+    //The previous window is part of the measurement unless the job was added in the current one
+    const u32 measuredSinceDs = windowStartDs == job.addedDs ? job.addedDs : windowStartDs - ADVERTISING_CONTROLLER_METRICS_WINDOW_DS;
+
+    return (now - measuredSinceDs) / numSlots;
 }
 
 AdvJob* AdvertisingController::DetermineCurrentAdvertisingJob()
@@ -228,7 +259,7 @@ AdvJob* AdvertisingController::DetermineCurrentAdvertisingJob()
     //Some logging
     for (u32 i = 0; i < jobs.size(); i++) {
         if (jobs[i].type != AdvJobTypes::INVALID) {
-            logt("ADVS", "job %u: slots: %u, currentSlots: %u", i, jobs[i].slots, jobs[i].currentSlots);
+            logt("ADVS", "job %u: slots: %u, target: %u, staleness: %u, advertised: %u", i, jobs[i].slots, jobs[i].targetIntervalDs, jobs[i].maxStalenessDs, jobs[i].numAdvertisedSlots);
         }
     }
 
@@ -237,70 +268,87 @@ AdvJob* AdvertisingController::DetermineCurrentAdvertisingJob()
         return nullptr;
     }
 
-    //Check if we reached the end of this scheduling cycle
-    if (sumSlots == 0) {
-        InitJobScheduling();
-    }
-
+    const u32 now = GS->appTimerDs;
     AdvJob* selectedJob = nullptr;
 
-    //Generate a random number between 0 and sumSlots
-    //TODO: Don't use hardware random
-    i32 rnd = sumSlots == 0 ? 0 : Utility::GetRandomInteger() % sumSlots;
-
-    logt("ADVS", "Rnd: %d, sumCurrentSlots %u", rnd, sumSlots);
-
-    //Go through list to pick the right job by random
-    //This loop must run to the end to
+    //If we have an immediate job, select it
     for(u32 i=0; i< jobs.size(); i++){
-        //If we have an immediate job, select it
         if(jobs[i].type == AdvJobTypes::IMMEDIATE){
-            //An immediate job does not count against sumSlots and delay is not considered
+            //An immediate job does not take part in the scheduling and delay is not considered
             jobs[i].currentSlots--;
             //Clear job if done
             if(jobs[i].currentSlots == 0){
                 RemoveJob(&(jobs[i]));
             }
-            else {
+            else if(selectedJob == nullptr) {
                 //Select job
                 selectedJob = &(jobs[i]);
             }
         }
-        //Job is checked only if it exists and if it still has available slots
-        if(jobs[i].type == AdvJobTypes::SCHEDULED && jobs[i].currentSlots != 0){
-            if(jobs[i].currentDelay > 0){
-                jobs[i].currentDelay--; //Decrement delay for all jobs
-                if(jobs[i].currentDelay == 0){
-                    //If a delay of 0 was reached, we must account for this job in the current scheduling cycle
-                    sumSlots += jobs[i].currentSlots;
-                } else {
-                    //Job still delayed
-                    continue;
-                }
-            }
-            //This job should advertise its message
-            if(selectedJob == nullptr && rnd >= 0 && rnd < jobs[i].currentSlots){
-                jobs[i].currentSlots--;
-                sumSlots--;
+    }
+    if(selectedJob != nullptr){
+        return selectedJob;
+    }
 
-                selectedJob = &(jobs[i]);
+    AdvJob* mostUrgentJob = nullptr;
+    i32 smallestSlackDs = INT32_MAX;
+    AdvJob* mostBehindJob = nullptr;
+    u32 biggestLag = 0;
 
-                logt("ADVS", "Advertising job %u selected", i);
-            }
-            //Jump to next job, this one wasn't selected
-            else
-            {
+    for(u32 i=0; i< jobs.size(); i++){
+        //Job is checked only if it exists and if it is not disabled
+        if(jobs[i].type != AdvJobTypes::SCHEDULED || jobs[i].slots == 0) continue;
+
+        if(jobs[i].currentDelay > 0){
+            jobs[i].currentDelay--;
+            continue;
+        }
+
+        const u32 ageDs = now - jobs[i].lastAdvertisedDs;
+
+        //The deadline would be missed if the job is not selected in this slot
+        if(jobs[i].maxStalenessDs != 0 && ageDs + ADVERTISING_CONTROLLER_SLOT_DS > jobs[i].maxStalenessDs){
+            const i32 slackDs = (i32)jobs[i].maxStalenessDs - (i32)ageDs;
+            if(slackDs < smallestSlackDs){
+                smallestSlackDs = slackDs;
+                mostUrgentJob = &(jobs[i]);
             }
-            //Decrement rnd, as soon as it is below 0, it can not trigger a job anymore
-            rnd -= jobs[i].currentSlots;
+        }
+
+        //How far the job is behind its target rate, 1000 means that it is exactly due
+        const u32 lag = ageDs * 1000 / GetTargetIntervalDs(jobs[i]);
+        if(mostBehindJob == nullptr || lag > biggestLag){
+            biggestLag = lag;
+            mostBehindJob = &(jobs[i]);
         }
     }
 
+    selectedJob = mostUrgentJob != nullptr ? mostUrgentJob : mostBehindJob;
+
     if(selectedJob == nullptr){
         logt("ADVS", "No advertising job selected");
     }
+    else {
+        if(selectedJob->maxStalenessDs != 0 && now - selectedJob->lastAdvertisedDs > selectedJob->maxStalenessDs){
+            selectedJob->numDeadlineMisses++;
+        }
+        selectedJob->lastAdvertisedDs = now;
+
+        //A delayed job is delayed again once it was advertised for its slots
+        if(selectedJob->delay != 0){
+            if(selectedJob->currentSlots > 1){
+                selectedJob->currentSlots--;
+            }
+            else {
+                selectedJob->currentSlots = selectedJob->slots;
+                selectedJob->currentDelay = selectedJob->delay;
+            }
+        }
+
+        logt("ADVS", "Advertising job %u selected", (u32)(selectedJob - jobs.data()));
+    }
 
-    logt("ADVS", "Timer advState %u, numJobs %u, sumSlots %u", (u32)advertisingState, currentNumJobs, sumSlots);
+    logt("ADVS", "Timer advState %u, numJobs %u", (u32)advertisingState, currentNumJobs);
 
     return selectedJob;
 }
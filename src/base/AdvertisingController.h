@@ -42,11 +42,16 @@ enum class AdvJobTypes : u8{
 
 };
 
+//A new advertising job is selected every this many deciseconds, which is one slot
+constexpr u16 ADVERTISING_CONTROLLER_SLOT_DS = 4;
+//The achieved interval of a job is measured over the last one to two windows of this length
+constexpr u32 ADVERTISING_CONTROLLER_METRICS_WINDOW_DS = SEC_TO_DS(30);
+
 struct AdvJob {
     AdvJobTypes type;
     //For Scheduler
-    u8 slots; //Number of slots this advertising message will get (1-10), 0 = Invalid
-    u8 delay; //Number of slots that this message will be delayed
+    u8 slots; //Scheduled: Determines the target rate if no targetIntervalDs is given (1-10), 0 = Invalid; Immediate: Number of slots
+    u8 delay; //Number of slots that this message will be delayed after it was added and after it was advertised for its slots
     u16 advertisingInterval; //In units of 0.625ms
     u8 advertisingChannelMask;
 
@@ -60,7 +65,19 @@ struct AdvJob {
     u8 advDataLength;
     u8 scanData[31];
     u8 scanDataLength;
-    
+
+    //Deadline Scheduling (Scheduled jobs only)
+    u16 targetIntervalDs; //The job should be advertised once in this interval, which is its target rate. 0 = Derived from the slots
+    u16 maxStalenessDs; //The job is preferred over all others once it was not advertised for this time. 0 = No deadline
+
+    //Internal Scheduling and Metrics
+    u32 lastAdvertisedDs;
+    u32 addedDs;
+    u32 numAdvertisedSlots; //Slots in which the job was actually advertised since it was added
+    u16 numDeadlineMisses;
+    u32 metricsWindowStartDs;
+    u16 slotsInMetricsWindow;
+    u16 slotsInPreviousMetricsWindow;
 };
 
 struct AdvData {
@@ -81,7 +98,6 @@ struct AdvData {
 class AdvertisingController
 {
 private:
-    u32 sumSlots = 0;
     u16 currentAdvertisingInterval = UINT16_MAX;
     u8 handle = 0xFF; //BLE_GAP_ADV_SET_HANDLE_NOT_SET
 
@@ -91,6 +107,8 @@ private:
 
     bool isActive = true;
 
+    void CountAdvertisedSlot(AdvJob& job);
+
 public:
     AdvertisingController();
 
@@ -125,12 +143,14 @@ public:
     void Initialize();
 
     //Job Scheduling
-    void InitJobScheduling();
     AdvJob* AddJob(const AdvJob& job);
     void RefreshJob(const AdvJob* jobHandle);
     void RemoveJob(AdvJob* jobHandle);
     AdvJob* DetermineCurrentAdvertisingJob();
     void DetermineAndSetAdvertisingJob();
+    static u16 GetTargetIntervalDs(const AdvJob& job);
+    //Average time between two advertised slots of this job in the current and the previous metrics window, 0 if it was not advertised in that time
+    u32 GetAchievedIntervalDs(const AdvJob& job) const;
 
     //Change Advertising with Softdevice
     void SetAdvertisingData(AdvJob* job);
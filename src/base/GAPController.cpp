@@ -216,7 +216,7 @@ void GAPController::StartEncryptingConnection(u16 connectionHandle) const
     logt("SEC", "encrypting connection handle %u with key. result %u", connectionHandle, (u32)err);
 }
 
-void GAPController::RequestConnectionParameterUpdate(u16 connectionHandle, u16 minConnectionInterval, u16 maxConnectionInterval, u16 slaveLatency, u16 supervisionTimeout) const
+ErrorType GAPController::RequestConnectionParameterUpdate(u16 connectionHandle, u16 minConnectionInterval, u16 maxConnectionInterval, u16 slaveLatency, u16 supervisionTimeout) const
 {
     ErrorType err = ErrorType::SUCCESS;
 
@@ -237,5 +237,5 @@ void GAPController::RequestConnectionParameterUpdate(u16 connectionHandle, u16 m
 
     //TODO: Use connection parameters negitation library: http://infocenter.nordicsemi.com/index.jsp?topic=%2Fcom.nordic.infocenter.sdk5.v11.0.0%2Fgroup__ble__sdk__lib__conn__params.html
 
-
+    return err;
 }
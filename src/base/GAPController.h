@@ -51,7 +51,7 @@ public:
     void StartEncryptingConnection(u16 connectionHandle) const;
 
     //Update the connection interval
-    void RequestConnectionParameterUpdate(u16 connectionHandle, u16 minConnectionInterval, u16 maxConnectionInterval, u16 slaveLatency, u16 supervisionTimeout) const;
+    ErrorType RequestConnectionParameterUpdate(u16 connectionHandle, u16 minConnectionInterval, u16 maxConnectionInterval, u16 slaveLatency, u16 supervisionTimeout) const;
 
 
 
@@ -198,6 +198,7 @@ class GlobalState
         FruityHal::AppErrorHandler    appErrorHandler = nullptr;
 #ifdef SIM_ENABLED
         FruityHal::DBDiscoveryHandler dbDiscoveryHandler = nullptr;
+        FruityHal::AdcEventHandler    adcEventHandler = nullptr;
 #endif
         u32 numApplicationInterruptHandlers = 0;
         std::array<FruityHal::ApplicationInterruptHandler, 16> applicationInterruptHandlers{};
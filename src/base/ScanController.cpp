@@ -40,6 +40,12 @@
  * IMPORTANT: The ScanController must be informed if the scan state changes without its
  * knowledge, e.g. when callind sd_ble_gap_connect. Otherwise scanning will stop and it will
  * not know it has to restart scanning.
+ *
+ * The scan parameters of the mesh discovery jobs are adapted to the environment if enabled in the Conf:
+ * The rate of advertising reports per second of scanning is measured. If many advertisers are around, the
+ * scan window is reduced as most of the reports would be redundant anyway. If only few are around while the
+ * node is in discovery low, the scan interval is increased to save energy. Jobs of other types are not adapted
+ * and no adaptation takes place as long as a timed job is waiting for scan results.
  */
 
 ScanController::ScanController()
@@ -49,6 +55,16 @@ ScanController::ScanController()
 
 void ScanController::TimerEventHandler(u16 passedTimeDs)
 {
+    //Measure how long we were scanning to get a rate that does not depend on the duty cycle
+    //A connection setup stops the scanner until it is started again with the next TryConfiguringScanState
+    if (scanning && currentScanParams.interval != 0) {
+        scanTimeInPeriodMs += (u32)passedTimeDs * 100 * currentScanParams.window / currentScanParams.interval;
+    }
+    adaptationPeriodDs += passedTimeDs;
+    if (adaptationPeriodDs >= SCAN_ADAPTATION_PERIOD_DS) {
+        UpdateScanAdaptation();
+    }
+
     for (u8 i = 0; i < jobs.size(); i++)
     {
         if ((jobs[i].state == ScanJobState::ACTIVE) &&
@@ -115,7 +131,6 @@ ScanJob* ScanController::AddJob(ScanJob& job)
 // scannit will be restarted with new params.
 void ScanController::RefreshJobs()
 {
-    u8 currentDutyCycle = currentScanParams.interval != 0 ? (currentScanParams.window * 100) / currentScanParams.interval : 0;
     u8 newDutyCycle = 0;
     ScanJob * p_job = nullptr;
     for (u8 i = 0; i < jobs.size(); i++)
@@ -132,24 +147,110 @@ void ScanController::RefreshJobs()
     }
     
     // no active jobs
-    if ((newDutyCycle != currentDutyCycle) && (newDutyCycle == 0))
+    if ((p_job == nullptr) && (currentScanParams.window != 0))
     {
         scanStateOk = false;
         CheckedMemset(&currentScanParams, 0, sizeof(currentScanParams));
         TryConfiguringScanState();
     }
 
-    // new highest duty cycle
-    if ((newDutyCycle != currentDutyCycle) && (p_job != nullptr))
+    if (p_job == nullptr) return;
+
+    u16 window = p_job->window;
+    u16 interval = p_job->interval;
+    if (IsScanAdaptationAllowed(*p_job))
+    {
+        //The shifts might still be those of discovery low after a state change until the next adaptation
+        //period, so the limits of the high job are applied here as well
+        const u8 jobDenseShift = (p_job->type == ScanState::HIGH && denseShift > 1) ? 1 : denseShift;
+        window = window >> jobDenseShift;
+        if (window < SCAN_ADAPTATION_MIN_WINDOW) window = p_job->window < SCAN_ADAPTATION_MIN_WINDOW ? p_job->window : SCAN_ADAPTATION_MIN_WINDOW;
+        if (p_job->type == ScanState::LOW)
+        {
+            interval = ((u32)interval << sparseShift) > SCAN_ADAPTATION_MAX_INTERVAL ? SCAN_ADAPTATION_MAX_INTERVAL : interval << sparseShift;
+        }
+    }
+
+    // new highest duty cycle or adapted parameters
+    if (window != currentScanParams.window || interval != currentScanParams.interval)
     {
         scanStateOk = false;
-        currentScanParams.window = p_job->window;
-        currentScanParams.interval = p_job->interval;
+        currentScanParams.window = window;
+        currentScanParams.interval = interval;
         currentScanParams.timeout = 0;
         TryConfiguringScanState();
     }
 }
 
+bool ScanController::IsScanAdaptationAllowed(const ScanJob& job) const
+{
+    if (job.type != ScanState::HIGH && job.type != ScanState::LOW) return false;
+
+    //A module is waiting for scan results
+    for (u8 i = 0; i < jobs.size(); i++)
+    {
+        if (jobs[i].state == ScanJobState::ACTIVE && jobs[i].timeMode == ScanJobTimeMode::TIMED) return false;
+    }
+    return true;
+}
+
+//Measures the advertising report rate of the last period and adapts the scan parameters to it
+void ScanController::UpdateScanAdaptation()
+{
+    //Without scanning, there is nothing that we could measure
+    if (scanTimeInPeriodMs != 0)
+    {
+        reportRate = reportsInPeriod * 1000 / scanTimeInPeriodMs;
+    }
+
+    const u8 oldDenseShift = denseShift;
+    const u8 oldSparseShift = sparseShift;
+
+    //Reduce the window step by step for many advertisers and increase it again once there are clearly less
+    //During clustering, we keep most of the window so that join me packets are still received fast enough
+    const u16 denseReportRate = Conf::GetInstance().adaptiveScanDenseReportRate;
+    const u8 maxDenseShift = GS->node.currentDiscoveryState == DiscoveryState::HIGH ? 1 : SCAN_ADAPTATION_MAX_SHIFT;
+    if (denseReportRate == 0)
+    {
+        denseShift = 0;
+    }
+    else if (reportRate > denseReportRate && denseShift < maxDenseShift)
+    {
+        denseShift++;
+    }
+    else if ((reportRate < denseReportRate / 4 && denseShift > 0) || denseShift > maxDenseShift)
+    {
+        denseShift--;
+    }
+
+    //Increase the interval step by step while the mesh is stable and few advertisers are around
+    //Any other state or more advertisers switch back to the full duty cycle at once
+    const u16 sparseReportRate = Conf::GetInstance().adaptiveScanSparseReportRate;
+    if (sparseReportRate != 0 && reportRate < sparseReportRate && GS->node.currentDiscoveryState == DiscoveryState::LOW)
+    {
+        if (sparseShift < SCAN_ADAPTATION_MAX_SHIFT) sparseShift++;
+    }
+    else
+    {
+        sparseShift = 0;
+    }
+
+    if (denseShift != oldDenseShift || sparseShift != oldSparseShift)
+    {
+        logt("SC", "Scan adaptation rate %u, dense %u, sparse %u", reportRate, denseShift, sparseShift);
+        RefreshJobs();
+    }
+
+    reportsInPeriod = 0;
+    scanTimeInPeriodMs = 0;
+    adaptationPeriodDs = 0;
+}
+
+u32 ScanController::GetReportRate() const
+{
+    return reportRate;
+}
+
 void ScanController::RemoveJob(ScanJob * p_jobHandle)
 {
     for (u32 i = 0; i < jobs.size(); i++) {
@@ -178,6 +279,7 @@ void ScanController::TryConfiguringScanState()
         //First, try stopping
         err = FruityHal::BleGapScanStop();
         if ((err == ErrorType::SUCCESS) || (err == ErrorType::INVALID_STATE)) {
+            scanning = false;
             if (currentScanParams.window == 0) {
                 scanStateOk = true;
                 return;
@@ -189,13 +291,17 @@ void ScanController::TryConfiguringScanState()
         }
         //Next, try starting
         err = FruityHal::BleGapScanStart(currentScanParams);
-        if (err == ErrorType::SUCCESS) scanStateOk = true;
+        if (err == ErrorType::SUCCESS) {
+            scanStateOk = true;
+            scanning = true;
+        }
     }
 }
 
 void ScanController::ScanningHasStopped()
 {
     scanStateOk = false;
+    scanning = false;
 }
 
 #ifdef SIM_ENABLED
@@ -211,8 +317,11 @@ ScanJob * ScanController::GetJob(int index)
 #endif //SIM_ENABLED
 
 //If a BLE event occurs, this handler will be called to do the work
-bool ScanController::ScanEventHandler(const FruityHal::GapAdvertisementReportEvent& advertisementReportEvent) const
+bool ScanController::ScanEventHandler(const FruityHal::GapAdvertisementReportEvent& advertisementReportEvent)
 {
+    //All reports cost processing time, not only those of our mesh
+    reportsInPeriod++;
+
     //Check if packet is a valid mesh advertising packet
     const AdvPacketHeader* packetHeader = (const AdvPacketHeader*)advertisementReportEvent.GetData();
 
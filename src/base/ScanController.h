@@ -54,6 +54,15 @@ typedef struct ScanJob
     ScanState       type;
 }ScanJob;
 
+//The advertising report rate is measured over this period to adapt the scan duty cycle
+constexpr u16 SCAN_ADAPTATION_PERIOD_DS = SEC_TO_DS(5);
+//The scan window is at most divided and the scan interval at most multiplied by 2^this
+constexpr u8 SCAN_ADAPTATION_MAX_SHIFT = 2;
+//Smallest scan window (2.5ms) that the window is reduced to in 0.625ms units
+constexpr u16 SCAN_ADAPTATION_MIN_WINDOW = 4;
+//Biggest scan interval (10.24s) that the interval is increased to in 0.625ms units
+constexpr u16 SCAN_ADAPTATION_MAX_INTERVAL = 16384;
+
 //Forward declaration
 class DebugModule;
 
@@ -69,9 +78,21 @@ class ScanController
 private:
     FruityHal::BleGapScanParams currentScanParams;
     bool scanStateOk = true;
+    bool scanning = false;
     std::array<ScanJob, 4> jobs{};
 
+    //Adaptive scan duty cycle, the scan window of mesh jobs is shifted right by denseShift (at most 1 for HIGH jobs)
+    //and the interval of LOW jobs is shifted left by sparseShift
+    u32 reportsInPeriod = 0;
+    u32 scanTimeInPeriodMs = 0;
+    u16 adaptationPeriodDs = 0;
+    u32 reportRate = 0;
+    u8 denseShift = 0;
+    u8 sparseShift = 0;
+
     void TryConfiguringScanState();
+    void UpdateScanAdaptation();
+    bool IsScanAdaptationAllowed(const ScanJob& job) const;
 
 public:
     ScanController();
@@ -87,7 +108,10 @@ public:
 
     void TimerEventHandler(u16 passedTimeDs);
 
-    bool ScanEventHandler(const FruityHal::GapAdvertisementReportEvent& advertisementReportEvent) const;
+    bool ScanEventHandler(const FruityHal::GapAdvertisementReportEvent& advertisementReportEvent);
+
+    //Advertising reports per second of scanning as measured in the last adaptation period
+    u32 GetReportRate() const;
 
     //Must be called if scanning was stopped by any external procedure
     void ScanningHasStopped();
@@ -2366,6 +2366,9 @@ ErrorType FruityHal::AdcInit(AdcEventHandler handler)
     ret_code_t err_code;
     err_code = nrf_drv_saadc_init(nullptr,SaadcCallback);
     FRUITYMESH_ERROR_CHECK(err_code);
+#else
+    if (handler == nullptr) return ErrorType::INVALID_PARAM;
+    GS->adcEventHandler = handler;
 #endif //SIM_ENABLED
     return ErrorType::SUCCESS;
 }
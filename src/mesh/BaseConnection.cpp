@@ -221,7 +221,7 @@ void BaseConnection::FillTransmitBuffers()
             sizedData.data = data;
             sizedData.length = processedMessageLength.GetRaw();
             queueOrigins.Push(queuePriorityPair.priority);
-            activeQueue->IncrementLookAhead();
+            queue.IncrementLookAhead(queuePriorityPair);
             PacketSuccessfullyQueuedWithSoftdevice(&sizedData);
         }
         else if(err == ErrorType::BUSY)
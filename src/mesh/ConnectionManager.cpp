@@ -195,14 +195,83 @@ void ConnectionManager::ForceDisconnectAllConnections(AppDisconnectReason appDis
     }
 }
 
-//Changes the connection interval of all mesh connections
+//Changes the connection interval of all mesh connections. The adaptive connection interval leaves these
+//connections alone until this is called with an interval of 0, which hands them back to the adaptation.
 void ConnectionManager::SetMeshConnectionInterval(u16 connectionInterval) const
 {
     //Go through all connections that we control as a central
     MeshConnections conn = GetMeshConnections(ConnectionDirection::DIRECTION_OUT);
     for(u32 i=0; i< conn.count; i++){
         if (conn.handles[i].IsHandshakeDone()){
-            GS->gapController.RequestConnectionParameterUpdate(conn.handles[i].GetConnectionHandle(), connectionInterval, connectionInterval, 0, Conf::meshConnectionSupervisionTimeout);
+            MeshConnection* connection = conn.handles[i].GetConnection();
+            connection->explicitConnectionInterval = connectionInterval != 0;
+            connection->stretchEvaluations = 0;
+            if (connectionInterval == 0) continue;
+
+            const ErrorType err = GS->gapController.RequestConnectionParameterUpdate(conn.handles[i].GetConnectionHandle(), connectionInterval, connectionInterval, 0, Conf::meshConnectionSupervisionTimeout);
+            if (err != ErrorType::SUCCESS) {
+                logt("CM", "Could not update connection interval %u", (u32)err);
+            }
+            else {
+                connection->adaptiveConnectionInterval = connectionInterval;
+            }
+        }
+    }
+}
+
+//Shortens the interval of busy mesh connections and stretches it for idle ones. Only the central of a
+//connection requests the update, it sees the traffic of its partner through the received packets.
+void ConnectionManager::UpdateAdaptiveConnectionIntervals()
+{
+    const Conf& config = Conf::GetInstance();
+    if (config.meshBusyConnectionInterval == 0 && config.meshIdleConnectionInterval == 0) return;
+
+    MeshConnections conns = GetMeshConnections(ConnectionDirection::DIRECTION_OUT);
+    for (u32 i = 0; i < conns.count; i++)
+    {
+        MeshConnection* conn = conns.handles[i].GetConnection();
+        if (conn == nullptr || conn->connectionState != ConnectionState::HANDSHAKE_DONE) continue;
+        //An interval that was set with SetMeshConnectionInterval is kept until it is cleared
+        if (conn->explicitConnectionInterval) continue;
+
+        const u16 transferredPackets = conn->sentReliable + conn->sentUnreliable + conn->receivedPackets;
+        const u16 packetsInInterval = transferredPackets - conn->transferredPacketsAtLastEvaluation;
+        conn->transferredPacketsAtLastEvaluation = transferredPackets;
+        const u32 queuedPackets = conn->GetPendingPackets();
+
+        u16 desiredInterval = config.meshMinConnectionInterval;
+        if (queuedPackets >= ADAPTIVE_CONNECTION_INTERVAL_BUSY_QUEUED_PACKETS || packetsInInterval >= ADAPTIVE_CONNECTION_INTERVAL_BUSY_PACKETS)
+        {
+            if (config.meshBusyConnectionInterval != 0) desiredInterval = config.meshBusyConnectionInterval;
+        }
+        else if (queuedPackets == 0 && packetsInInterval <= ADAPTIVE_CONNECTION_INTERVAL_IDLE_PACKETS)
+        {
+            if (config.meshIdleConnectionInterval != 0) desiredInterval = config.meshIdleConnectionInterval;
+        }
+
+        const u16 currentInterval = conn->adaptiveConnectionInterval != 0 ? conn->adaptiveConnectionInterval : config.meshMinConnectionInterval;
+        if (desiredInterval == currentInterval)
+        {
+            conn->stretchEvaluations = 0;
+            continue;
+        }
+
+        //Traffic must be handled right away, but the interval is only stretched if the connection stays quiet
+        if (desiredInterval > currentInterval)
+        {
+            conn->stretchEvaluations++;
+            if (conn->stretchEvaluations < ADAPTIVE_CONNECTION_INTERVAL_STRETCH_EVALUATIONS) continue;
+        }
+
+        const ErrorType err = GS->gapController.RequestConnectionParameterUpdate(conn->connectionHandle, desiredInterval, desiredInterval, 0, Conf::meshConnectionSupervisionTimeout);
+
+        logt("CM", "Connection interval of partner %u from %u to %u, queued %u, transferred %u, err %u", conn->partnerId, currentInterval, desiredInterval, queuedPackets, packetsInInterval, (u32)err);
+
+        //If the SoftDevice was busy, we try again with the next evaluation
+        if (err == ErrorType::SUCCESS)
+        {
+            conn->adaptiveConnectionInterval = desiredInterval;
+            conn->stretchEvaluations = 0;
         }
     }
 }
@@ -780,7 +849,7 @@ u32 ConnectionManager::MessageTypeToMinimumPacketSize(MessageType messageType)
     case MessageType::CLUSTER_ACK_2:
         return SIZEOF_CONN_PACKET_CLUSTER_ACK_2;
     case MessageType::CLUSTER_INFO_UPDATE:
-        return SIZEOF_CONN_PACKET_CLUSTER_INFO_UPDATE;
+        return SIZEOF_CONN_PACKET_CLUSTER_INFO_UPDATE_LEGACY;
     case MessageType::RECONNECT:
         return SIZEOF_CONN_PACKET_RECONNECT;
     case MessageType::ENCRYPT_CUSTOM_START:
@@ -795,6 +864,10 @@ u32 ConnectionManager::MessageTypeToMinimumPacketSize(MessageType messageType)
         return SIZEOF_CONN_PACKET_UPDATE_TIMESTAMP;
     case MessageType::UPDATE_CONNECTION_INTERVAL:
         return SIZEOF_CONN_PACKET_UPDATE_CONNECTION_INTERVAL;
+    case MessageType::FLOW_CONTROL:
+        return SIZEOF_CONN_PACKET_FLOW_CONTROL;
+    case MessageType::SINK_ROUTE:
+        return SIZEOF_CONN_PACKET_SINK_ROUTE_LEGACY;
     case MessageType::ASSET_LEGACY:
         return SIZEOF_SCAN_MODULE_TRACKED_ASSET_LEGACY;
     case MessageType::CAPABILITY:
@@ -1319,22 +1392,77 @@ BaseConnection * ConnectionManager::GetRawConnectionFromHandle(u16 connectionHan
 }
 
 //TODO: Only return mesh connections, check
+//Sink bound traffic is routed to the sink with the lowest cost, see GetSinkRouteCost. The route that was selected
+//by SelectSinkRoute is kept as long as it is available so that the traffic does not flap between similar routes.
 MeshConnectionHandle ConnectionManager::GetMeshConnectionToShortestSink(const BaseConnection* excludeConnection) const
 {
-    ClusterSize min = INT16_MAX;
+    u32 minCost = UINT32_MAX;
     MeshConnectionHandle c;
+    MeshConnectionHandle selectedRoute;
     MeshConnections conn = GetMeshConnections(ConnectionDirection::INVALID);
     for (int i = 0; i < conn.count; i++)
     {
         if (excludeConnection != nullptr && conn.handles[i].GetConnection() == excludeConnection)
             continue;
-        if (conn.handles[i].IsHandshakeDone() && conn.handles[i].GetHopsToSink() > -1 && conn.handles[i].GetHopsToSink() < min)
+        if (conn.handles[i].IsHandshakeDone() && conn.handles[i].GetHopsToSink() > -1)
+        {
+            const MeshConnection* meshConnection = conn.handles[i].GetConnection();
+            if (meshConnection->uniqueConnectionId == sinkRouteUniqueConnectionId) selectedRoute = conn.handles[i];
+
+            const u32 cost = GetSinkRouteCost(meshConnection);
+            if (cost < minCost)
+            {
+                minCost = cost;
+                c = conn.handles[i];
+            }
+        }
+    }
+    return selectedRoute ? selectedRoute : c;
+}
+
+//The expected transmissions towards the sink of the route plus a penalty for its load. A fully loaded sink costs
+//as much as SINK_LOAD_MAX_HOP_PENALTY additional transmissions so that the traffic is spread over all sinks of the mesh.
+u32 ConnectionManager::GetSinkRouteCost(const MeshConnection* connection) const
+{
+    return GetSinkRouteEtx(connection) + (u32)GetPartnerSinkLoad(connection) * SINK_LOAD_MAX_HOP_PENALTY * SINK_ETX_PER_TRANSMISSION / 100;
+}
+
+//Switches the route of the sink bound traffic once another route is cheaper by SINK_ROUTE_SWITCH_HYSTERESIS
+void ConnectionManager::SelectSinkRoute()
+{
+    const MeshConnection* selectedRoute = nullptr;
+    u32 selectedCost = UINT32_MAX;
+    const MeshConnection* cheapestRoute = nullptr;
+    u32 cheapestCost = UINT32_MAX;
+
+    MeshConnections conns = GetMeshConnections(ConnectionDirection::INVALID);
+    for (u32 i = 0; i < conns.count; i++)
+    {
+        const MeshConnection* conn = conns.handles[i].GetConnection();
+        if (conn == nullptr || !conn->HandshakeDone() || conns.handles[i].GetHopsToSink() < 0) continue;
+
+        const u32 cost = GetSinkRouteCost(conn);
+        if (conn->uniqueConnectionId == sinkRouteUniqueConnectionId)
+        {
+            selectedRoute = conn;
+            selectedCost = cost;
+        }
+        if (cost < cheapestCost)
         {
-            min = conn.handles[i].GetHopsToSink();
-            c = conn.handles[i];
+            cheapestRoute = conn;
+            cheapestCost = cost;
         }
     }
-    return c;
+
+    if (cheapestRoute == nullptr)
+    {
+        sinkRouteUniqueConnectionId = 0;
+        return;
+    }
+    if (selectedRoute != nullptr && selectedCost <= cheapestCost + SINK_ROUTE_SWITCH_HYSTERESIS) return;
+
+    logt("CM", "Sink route switched to partner %u with cost %u", cheapestRoute->partnerId, cheapestCost);
+    sinkRouteUniqueConnectionId = cheapestRoute->uniqueConnectionId;
 }
 
 ClusterSize ConnectionManager::GetMeshHopsToShortestSink(const BaseConnection* excludeConnection) const
@@ -1366,6 +1494,39 @@ ClusterSize ConnectionManager::GetMeshHopsToShortestSink(const BaseConnection* e
     }
 }
 
+//Returns the expected transmissions in units of SINK_ETX_PER_TRANSMISSION towards the sink that our sink bound traffic
+//is routed to. It belongs to the same route as the load from GetSinkLoad so that both are always advertised together.
+u16 ConnectionManager::GetMeshEtxToShortestSink(const BaseConnection* excludeConnection) const
+{
+    if (GET_DEVICE_TYPE() == DeviceType::SINK) return 0;
+
+    MeshConnectionHandle sinkConnection = GetMeshConnectionToShortestSink(excludeConnection);
+    if (!sinkConnection) return SINK_ETX_UNREACHABLE;
+
+    return (u16)GetSinkRouteEtx(sinkConnection.GetConnection());
+}
+
+//Used for partners that did not advertise their ETX, e.g. during the handshake or because they run an older firmware
+u16 ConnectionManager::GetSinkEtxFromHops(ClusterSize hopsToSink)
+{
+    if (hopsToSink < 0) return SINK_ETX_UNREACHABLE;
+
+    const u32 etx = (u32)hopsToSink * SINK_ETX_PER_TRANSMISSION;
+    return etx < SINK_ETX_UNREACHABLE ? (u16)etx : SINK_ETX_UNREACHABLE - 1;
+}
+
+//Returns the expected transmissions towards the sink if sending through the given connection
+u32 ConnectionManager::GetSinkRouteEtx(const MeshConnection* connection) const
+{
+    //The hops to sink of the connection already contain the hop to the partner
+    const u32 partnerEtx = connection->partnerSinkEtx != SINK_ETX_UNREACHABLE
+        ? connection->partnerSinkEtx
+        : GetSinkEtxFromHops(connection->hopsToSink - 1);
+    const u32 etx = partnerEtx + connection->linkEtx;
+
+    return etx < SINK_ETX_UNREACHABLE ? etx : SINK_ETX_UNREACHABLE - 1;
+}
+
 #define _________________EVENTS____________
 
 void ConnectionManager::GapRssiChangedEventHandler(const FruityHal::GapRssiChangedEvent & rssiChangedEvent) const
@@ -1519,6 +1680,19 @@ void ConnectionManager::TimerEventHandler(u16 passedTimeDs)
         }
     }
 
+    UpdateFlowControl();
+
+    if (SHOULD_IV_TRIGGER(GS->appTimerDs, passedTimeDs, ADAPTIVE_CONNECTION_INTERVAL_EVALUATION_DS)) {
+        UpdateAdaptiveConnectionIntervals();
+    }
+
+    if (SHOULD_IV_TRIGGER(GS->appTimerDs, passedTimeDs, SINK_LOAD_EVALUATION_INTERVAL_DS)) {
+        EvaluateOwnSinkLoad();
+        EvaluateLinkEtx();
+        SelectSinkRoute();
+        UpdateSinkRoutes();
+    }
+
     // Enolled nodes syncing
     timeSinceLastEnrolledNodesSyncDs += passedTimeDs;
     if(timeSinceLastEnrolledNodesSyncDs >= ENROLLED_NODES_SYNC_INTERVALS_DS)
@@ -1547,6 +1721,244 @@ void ConnectionManager::TimerEventHandler(u16 passedTimeDs)
     }
 }
 
+//Returns the amount of full sized send queue chunks that this node and its path towards the sink can still take
+u8 ConnectionManager::GetFlowControlCredits() const
+{
+    u32 credits = GS->connectionQueueMemoryAllocator.GetAmountOfFreeChunks();
+
+    MeshConnectionHandle sinkConnection = GetMeshConnectionToShortestSink(nullptr);
+    const MeshConnection* conn = sinkConnection.GetConnection();
+    if (IsPartnerFlowControlValid(conn) && conn->partnerFlowControlCredits < credits)
+    {
+        credits = conn->partnerFlowControlCredits;
+    }
+
+    return credits < UINT8_MAX ? (u8)credits : UINT8_MAX;
+}
+
+//Sink bound reports should be held back while this returns true, they would only fill up the queues along the way
+bool ConnectionManager::IsSinkPathCongested() const
+{
+    //The sink hands its data to the gateway and not to the mesh
+    if (GET_DEVICE_TYPE() == DeviceType::SINK) return false;
+
+    if (ownQueuesCongested) return true;
+
+    MeshConnectionHandle sinkConnection = GetMeshConnectionToShortestSink(nullptr);
+    const MeshConnection* conn = sinkConnection.GetConnection();
+    return IsPartnerFlowControlValid(conn) && conn->partnerCongested;
+}
+
+bool ConnectionManager::IsPartnerFlowControlValid(const MeshConnection* connection) const
+{
+    return connection != nullptr
+        && connection->partnerFlowControlReceived
+        && GS->appTimerDs < connection->partnerFlowControlUpdatedDs + FLOW_CONTROL_TIMEOUT_DS;
+}
+
+//Credits below the threshold are a congestion that is only released once they recovered by the hysteresis
+bool ConnectionManager::IsCongestedByCredits(u32 credits, bool wasCongested)
+{
+    if (credits < FLOW_CONTROL_CONGESTION_CHUNK_THRESHOLD) return true;
+    if (credits >= FLOW_CONTROL_CONGESTION_CHUNK_THRESHOLD + FLOW_CONTROL_HYSTERESIS_CHUNKS) return false;
+    return wasCongested;
+}
+
+void ConnectionManager::FlowControlReceivedHandler(MeshConnection* connection, ConnPacketFlowControl const * packet)
+{
+    connection->partnerFlowControlCredits = packet->credits;
+    connection->partnerCongested = IsCongestedByCredits(packet->credits, connection->partnerCongested);
+    connection->partnerFlowControlReceived = true;
+    connection->partnerFlowControlUpdatedDs = GS->appTimerDs;
+
+    logt("CM", "Partner %u advertised %u credits, congested %u", connection->partnerId, packet->credits, (u32)connection->partnerCongested);
+}
+
+//Advertises our credits to the partners that send their sink bound traffic through us. As our credits are limited
+//by the ones of our partner towards the sink, a congestion close to the sink travels outwards to where the traffic
+//originates. The credits are only sent if they change the congestion state of the partner, and are refreshed
+//periodically while the partner is congested.
+void ConnectionManager::UpdateFlowControl()
+{
+    ownQueuesCongested = IsCongestedByCredits(GS->connectionQueueMemoryAllocator.GetAmountOfFreeChunks(), ownQueuesCongested);
+
+    MeshConnectionHandle sinkConnection = GetMeshConnectionToShortestSink(nullptr);
+    const u8 credits = GetFlowControlCredits();
+
+    MeshConnections conns = GetMeshConnections(ConnectionDirection::INVALID);
+    for (u32 i = 0; i < conns.count; i++)
+    {
+        MeshConnection* conn = conns.handles[i].GetConnection();
+        if (conn == nullptr || !conn->HandshakeDone()) continue;
+
+        //The sink bound traffic of the partner towards the sink does not flow through us, so it
+        //has no use for our credits.
+        if (conn == sinkConnection.GetConnection()) continue;
+
+        const bool advertiseCongestion = IsCongestedByCredits(credits, conn->congestionAdvertised);
+        if (advertiseCongestion == conn->congestionAdvertised
+            && (!advertiseCongestion || GS->appTimerDs < conn->congestionAdvertisedDs + FLOW_CONTROL_REFRESH_INTERVAL_DS))
+        {
+            continue;
+        }
+
+        ConnPacketFlowControl packet;
+        CheckedMemset(&packet, 0x00, sizeof(packet));
+        packet.header.messageType = MessageType::FLOW_CONTROL;
+        packet.header.sender = GS->node.configuration.nodeId;
+        packet.header.receiver = conn->partnerId;
+        packet.credits = credits;
+
+        //If the packet could not be queued, we try again with the next timer event
+        if (conn->SendData((u8*)&packet, SIZEOF_CONN_PACKET_FLOW_CONTROL, false))
+        {
+            logt("CM", "Advertised %u credits to partner %u, congested %u", packet.credits, conn->partnerId, (u32)advertiseCongestion);
+
+            conn->congestionAdvertised = advertiseCongestion;
+            conn->congestionAdvertisedDs = GS->appTimerDs;
+        }
+    }
+}
+
+//Returns the load in percent of the sink that our sink bound traffic is routed to if it came from the given connection
+u8 ConnectionManager::GetSinkLoad(const BaseConnection* excludeConnection) const
+{
+    if (GET_DEVICE_TYPE() == DeviceType::SINK) return ownSinkLoad;
+
+    MeshConnectionHandle sinkConnection = GetMeshConnectionToShortestSink(excludeConnection);
+    return GetPartnerSinkLoad(sinkConnection.GetConnection());
+}
+
+u8 ConnectionManager::GetPartnerSinkLoad(const MeshConnection* connection) const
+{
+    if (connection == nullptr || GS->appTimerDs >= connection->partnerSinkLoadUpdatedDs + SINK_LOAD_TIMEOUT_DS) return 0;
+
+    return connection->partnerSinkLoad;
+}
+
+void ConnectionManager::SinkRouteReceivedHandler(MeshConnection* connection, ConnPacketSinkRoute const * packet, MessageLength packetLength)
+{
+    //Without the sinkEtx, the ETX of the partner is derived from its hops, see GetSinkRouteEtx
+    const u16 sinkEtx = packetLength >= SIZEOF_CONN_PACKET_SINK_ROUTE ? packet->sinkEtx : SINK_ETX_UNREACHABLE;
+
+    logt("CM", "Partner %u advertised sink load %u, etx %u", connection->partnerId, packet->sinkLoad, sinkEtx);
+
+    connection->partnerSinkLoad = packet->sinkLoad > 100 ? 100 : packet->sinkLoad;
+    connection->partnerSinkLoadUpdatedDs = GS->appTimerDs;
+    connection->partnerSinkEtx = sinkEtx;
+}
+
+//A sink is loaded if its send queues fill up or if it receives more packets than it can pass on to its gateway
+void ConnectionManager::EvaluateOwnSinkLoad()
+{
+    //Messages are counted once they were reassembled, a message that was split into several packets is passed on once
+    u32 receivedMessages = 0;
+    MeshConnections conns = GetMeshConnections(ConnectionDirection::INVALID);
+    for (u32 i = 0; i < conns.count; i++)
+    {
+        MeshConnection* conn = conns.handles[i].GetConnection();
+        if (conn == nullptr) continue;
+
+        receivedMessages += (u16)(conn->receivedMessages - conn->receivedMessagesAtLastSinkLoadEvaluation);
+        conn->receivedMessagesAtLastSinkLoadEvaluation = conn->receivedMessages;
+    }
+
+    if (GET_DEVICE_TYPE() != DeviceType::SINK)
+    {
+        ownSinkLoad = 0;
+        return;
+    }
+
+    const u32 usedChunks = CONNECTION_QUEUE_MEMORY_CHUNK_AMOUNT - GS->connectionQueueMemoryAllocator.GetAmountOfFreeChunks();
+    const u32 queueLoad = usedChunks * 100 / CONNECTION_QUEUE_MEMORY_CHUNK_AMOUNT;
+
+    const u32 capacity = SINK_LOAD_CAPACITY_PACKETS_PER_SECOND * SINK_LOAD_EVALUATION_INTERVAL_DS / 10;
+    u32 trafficLoad = receivedMessages * 100 / (capacity > 0 ? capacity : 1);
+    if (trafficLoad > 100) trafficLoad = 100;
+
+    const u32 load = queueLoad > trafficLoad ? queueLoad : trafficLoad;
+
+    //Smoothed so that single bursts do not move the traffic of the whole mesh around
+    ownSinkLoad = (u8)((ownSinkLoad + load) / 2);
+}
+
+//Estimates how many transmissions a packet needs on each link from the rssi and the dropped packets. The link layer
+//retransmissions are handled by the SoftDevice and are not visible here, a weak rssi is the best indicator for them.
+void ConnectionManager::EvaluateLinkEtx()
+{
+    MeshConnections conns = GetMeshConnections(ConnectionDirection::INVALID);
+    for (u32 i = 0; i < conns.count; i++)
+    {
+        MeshConnection* conn = conns.handles[i].GetConnection();
+        if (conn == nullptr || !conn->HandshakeDone()) continue;
+
+        //An rssi of 0 means that no measurement was reported yet
+        const i8 rssi = conn->GetAverageRSSI();
+        u32 etx = SINK_ETX_PER_TRANSMISSION;
+        if (rssi != 0 && rssi < LINK_ETX_GOOD_RSSI)
+        {
+            etx += (u32)(LINK_ETX_GOOD_RSSI - rssi) * LINK_ETX_PER_DB;
+        }
+
+        const u16 sentPackets = conn->sentReliable + conn->sentUnreliable;
+        const u16 sentInInterval = sentPackets - conn->sentPacketsAtLastEtxEvaluation;
+        const u16 droppedInInterval = conn->droppedPackets - conn->droppedPacketsAtLastEtxEvaluation;
+        conn->sentPacketsAtLastEtxEvaluation = sentPackets;
+        conn->droppedPacketsAtLastEtxEvaluation = conn->droppedPackets;
+        if (droppedInInterval > 0)
+        {
+            etx = etx * (sentInInterval + droppedInInterval) / (sentInInterval > 0 ? sentInInterval : 1);
+        }
+
+        if (etx > LINK_ETX_MAX) etx = LINK_ETX_MAX;
+
+        //Smoothed so that single measurements do not change the routes
+        conn->linkEtx = (u16)((3 * (u32)conn->linkEtx + etx) / 4);
+    }
+}
+
+//Tells our partners how loaded the sink is that their sink bound traffic ends up at if they route it through us
+//and how many transmissions their traffic needs from us to the closest sink
+void ConnectionManager::UpdateSinkRoutes()
+{
+    MeshConnections conns = GetMeshConnections(ConnectionDirection::INVALID);
+    for (u32 i = 0; i < conns.count; i++)
+    {
+        MeshConnection* conn = conns.handles[i].GetConnection();
+        if (conn == nullptr || !conn->HandshakeDone()) continue;
+
+        const u8 sinkLoad = GetSinkLoad(conn);
+        const u8 change = sinkLoad > conn->sinkLoadAdvertised ? sinkLoad - conn->sinkLoadAdvertised : conn->sinkLoadAdvertised - sinkLoad;
+        const u16 sinkEtx = GetMeshEtxToShortestSink(conn);
+        const u16 etxChange = sinkEtx > conn->sinkEtxAdvertised ? sinkEtx - conn->sinkEtxAdvertised : conn->sinkEtxAdvertised - sinkEtx;
+
+        if (change < SINK_LOAD_ADVERTISEMENT_THRESHOLD
+            && etxChange < SINK_ETX_ADVERTISEMENT_THRESHOLD
+            && (sinkLoad == 0 || GS->appTimerDs < conn->sinkLoadAdvertisedDs + SINK_LOAD_REFRESH_INTERVAL_DS))
+        {
+            continue;
+        }
+
+        ConnPacketSinkRoute packet;
+        CheckedMemset(&packet, 0x00, sizeof(packet));
+        packet.header.messageType = MessageType::SINK_ROUTE;
+        packet.header.sender = GS->node.configuration.nodeId;
+        packet.header.receiver = conn->partnerId;
+        packet.sinkLoad = sinkLoad;
+        packet.sinkEtx = sinkEtx;
+
+        //If the packet could not be queued, we try again with the next evaluation
+        if (conn->SendData((u8*)&packet, SIZEOF_CONN_PACKET_SINK_ROUTE, false))
+        {
+            logt("CM", "Advertised sink load %u, etx %u to partner %u", sinkLoad, sinkEtx, conn->partnerId);
+
+            conn->sinkLoadAdvertised = sinkLoad;
+            conn->sinkLoadAdvertisedDs = GS->appTimerDs;
+            conn->sinkEtxAdvertised = sinkEtx;
+        }
+    }
+}
+
 void ConnectionManager::ResetTimeSync()
 {
     BaseConnections conns = GetConnectionsOfType(ConnectionType::FRUITYMESH, ConnectionDirection::INVALID);
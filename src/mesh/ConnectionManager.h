@@ -86,6 +86,48 @@ private:
     static constexpr u16 ENROLLED_NODES_SYNC_INTERVALS_DS = SEC_TO_DS(5);
     u16 timeSinceLastEnrolledNodesSyncDs = 0;
 
+    //A congested node refreshes its advertisement periodically, partners forget it if it is not refreshed
+    static constexpr u16 FLOW_CONTROL_REFRESH_INTERVAL_DS = SEC_TO_DS(5);
+    static constexpr u16 FLOW_CONTROL_TIMEOUT_DS = SEC_TO_DS(15);
+    bool ownQueuesCongested = false;
+    void UpdateFlowControl();
+    bool IsPartnerFlowControlValid(const MeshConnection* connection) const;
+    static bool IsCongestedByCredits(u32 credits, bool wasCongested);
+
+    //Connections are busy if this many packets are queued or were sent and received during one evaluation.
+    //Idle connections must not queue or transfer more than the idle amount for a few evaluations.
+    static constexpr u16 ADAPTIVE_CONNECTION_INTERVAL_EVALUATION_DS = SEC_TO_DS(2);
+    static constexpr u16 ADAPTIVE_CONNECTION_INTERVAL_BUSY_QUEUED_PACKETS = 10;
+    static constexpr u16 ADAPTIVE_CONNECTION_INTERVAL_BUSY_PACKETS = 40;
+    static constexpr u16 ADAPTIVE_CONNECTION_INTERVAL_IDLE_PACKETS = 4;
+    static constexpr u8 ADAPTIVE_CONNECTION_INTERVAL_STRETCH_EVALUATIONS = 3;
+    void UpdateAdaptiveConnectionIntervals();
+
+    //Sinks measure their load with every evaluation. A load is advertised again once it changed by the threshold
+    //and a load above zero is refreshed periodically as partners forget it after the timeout.
+    static constexpr u16 SINK_LOAD_EVALUATION_INTERVAL_DS = SEC_TO_DS(2);
+    static constexpr u16 SINK_LOAD_REFRESH_INTERVAL_DS = SEC_TO_DS(10);
+    static constexpr u16 SINK_LOAD_TIMEOUT_DS = SEC_TO_DS(30);
+    static constexpr u8 SINK_LOAD_ADVERTISEMENT_THRESHOLD = 10;
+    void EvaluateOwnSinkLoad();
+    void UpdateSinkRoutes();
+    u8 GetPartnerSinkLoad(const MeshConnection* connection) const;
+
+    //The route towards the sinks is only switched if another route is cheaper by the hysteresis
+    static constexpr u16 SINK_ROUTE_SWITCH_HYSTERESIS = SINK_ETX_PER_TRANSMISSION / 2;
+    u32 sinkRouteUniqueConnectionId = 0; //The connection that sink bound traffic is routed to, 0 if none was selected yet
+    void SelectSinkRoute();
+    u32 GetSinkRouteCost(const MeshConnection* connection) const;
+
+    //The expected transmissions of a link grow for every dB that the rssi is below the good rssi and with the
+    //share of packets that had to be dropped. A changed ETX towards the sink is advertised once it changed by the threshold.
+    static constexpr i8 LINK_ETX_GOOD_RSSI = -70;
+    static constexpr u16 LINK_ETX_PER_DB = 15;
+    static constexpr u16 LINK_ETX_MAX = 10 * SINK_ETX_PER_TRANSMISSION;
+    static constexpr u16 SINK_ETX_ADVERTISEMENT_THRESHOLD = SINK_ETX_PER_TRANSMISSION / 2;
+    void EvaluateLinkEtx();
+    u32 GetSinkRouteEtx(const MeshConnection* connection) const;
+
     u32 uniqueConnectionIdCounter = 0; //Counts all created connections to assign "unique" ids
 
     BaseConnection* GetRawConnectionByUniqueId(u32 uniqueConnectionId) const;
@@ -113,6 +155,10 @@ public:
     u16 sentMeshPacketsUnreliable = 0;
     u16 sentMeshPacketsReliable = 0;
 
+    //Scheduling of the HIGH, MEDIUM and LOW send queues of all connections, see ChunkedPriorityPacketQueue
+    QueueSchedulingMode queueSchedulingMode = QueueSchedulingMode::PRIORITY_DROPLETS;
+    std::array<u16, AMOUNT_OF_SEND_QUEUE_PRIORITIES> deficitRoundRobinQuanta = DEFAULT_DEFICIT_ROUND_ROBIN_QUANTA;
+
     //ConnectionType Resolving
     void ResolveConnection(BaseConnection* oldConnection, BaseConnectionSendData* sendData, u8 const * data);
 
@@ -180,9 +226,21 @@ public:
 
     MeshConnectionHandle GetMeshConnectionToShortestSink(const BaseConnection* excludeConnection) const;
     ClusterSize GetMeshHopsToShortestSink(const BaseConnection* excludeConnection) const;
+    u16 GetMeshEtxToShortestSink(const BaseConnection* excludeConnection) const;
+    static u16 GetSinkEtxFromHops(ClusterSize hopsToSink);
 
     u16 GetPendingPackets() const;
 
+    //Credit based flow control of sink bound traffic
+    u8 GetFlowControlCredits() const;
+    bool IsSinkPathCongested() const;
+    void FlowControlReceivedHandler(MeshConnection* connection, ConnPacketFlowControl const * packet);
+
+    //Load balancing of sink bound traffic between several sinks, the load is given in percent
+    u8 ownSinkLoad = 0;
+    u8 GetSinkLoad(const BaseConnection* excludeConnection) const;
+    void SinkRouteReceivedHandler(MeshConnection* connection, ConnPacketSinkRoute const * packet, MessageLength packetLength);
+
     void SetMeshConnectionInterval(u16 connectionInterval) const;
 
     void DeleteConnection(BaseConnection* connection, AppDisconnectReason reason);
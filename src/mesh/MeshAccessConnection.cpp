@@ -456,6 +456,7 @@ void MeshAccessConnection::SendClusterState()
     packet.payload.clusterSizeChange = GS->node.GetClusterSize();
     packet.payload.connectionMasterBitHandover = GS->node.HasAllMasterBits();
     packet.payload.hopsToSink = GS->cm.GetMeshHopsToShortestSink(nullptr);
+    packet.payload.sinkEtx = GS->cm.GetMeshEtxToShortestSink(nullptr);
 
     SendData((u8*)&packet, sizeof(ConnPacketClusterInfoUpdate), false);
 }
@@ -1082,7 +1083,7 @@ void MeshAccessConnection::ReceiveMeshAccessMessageHandler(BaseConnectionSendDat
 
 #ifdef SIM_ENABLED
     if (packetHeader->messageType == MessageType::CLUSTER_INFO_UPDATE
-        && sendData->dataLength >= sizeof(ConnPacketClusterInfoUpdate)
+        && sendData->dataLength >= SIZEOF_CONN_PACKET_CLUSTER_INFO_UPDATE_LEGACY
     ) {
         const ConnPacketClusterInfoUpdate* data = (ConnPacketClusterInfoUpdate const *)packetHeader;
         logt("MACONN", "Received ClusterInfoUpdate over MACONN with size:%u and hops:%d", data->payload.clusterSizeChange, data->payload.hopsToSink);
@@ -243,6 +243,11 @@ void MeshConnection::TryReestablishing()
     ErrorType err;
     err = GS->gapController.ConnectToPeripheral(partnerAddress, Conf::GetInstance().meshMinConnectionInterval, Conf::meshExtendedConnectionTimeoutSec);
 
+    //The reestablished connection starts again with the default interval
+    adaptiveConnectionInterval = 0;
+    explicitConnectionInterval = false;
+    stretchEvaluations = 0;
+
     //If the call to connect fails, the ConnectionManager must retry connecting periodically
     mustRetryReestablishing = (err != ErrorType::SUCCESS);
 
@@ -401,6 +406,7 @@ void MeshConnection::ClearCurrentClusterInfoUpdatePacket()
     currentClusterInfoUpdatePacket.header.messageType = MessageType::CLUSTER_INFO_UPDATE;
     currentClusterInfoUpdatePacket.header.sender = GS->node.configuration.nodeId;
     currentClusterInfoUpdatePacket.payload.hopsToSink = GET_DEVICE_TYPE() == DeviceType::SINK ? 0 : -1;
+    currentClusterInfoUpdatePacket.payload.sinkEtx = GET_DEVICE_TYPE() == DeviceType::SINK ? 0 : SINK_ETX_UNREACHABLE;
 }
 
 void MeshConnection::PacketSuccessfullyQueuedWithSoftdevice(SizedData* sentData)
@@ -450,10 +456,14 @@ void MeshConnection::ReceiveDataHandler(BaseConnectionSendData* sendData, u8 con
     Logger::ConvertBufferToHexString(data, sendData->dataLength, stringBuffer, sizeof(stringBuffer));
     logt("CONN_DATA", "Mesh RX %d,length:%d,deliv:%d,data:%s", (u32)packetHeader->messageType, sendData->dataLength.GetRaw(), (u32)sendData->deliveryOption, stringBuffer);
 
+    receivedPackets++;
+
     //This will reassemble the data for us
     data = ReassembleData(sendData, data);
 
     if(data != nullptr){
+        receivedMessages++;
+
         //Route the packet to our other mesh connections
         GS->cm.RouteMeshData(this, sendData, data);
 
@@ -655,6 +665,13 @@ void MeshConnection::ReceiveHandshakePacketHandler(BaseConnectionSendData* sendD
 
                 handshakeFailCode = LiveReportHandshakeFailCode::UNPREFERRED_CONNECTION;
             }
+            else if (GS->node.IsBlacklistedAfterTopologyRewire(packet->header.sender))
+            {
+                logt("HANDSHAKE", "Old partner %u tried to connect during a topology rewire", (u32)(packet->header.sender));
+                this->DisconnectAndRemove(AppDisconnectReason::TOPOLOGY_OPTIMIZATION);
+
+                handshakeFailCode = LiveReportHandshakeFailCode::TOPOLOGY_OPTIMIZATION;
+            }
             else
             {
 
@@ -889,6 +906,8 @@ bool MeshConnection::IsValidMessageType(MessageType t)
         case(MessageType::COMPONENT_ACT):
         case(MessageType::TIME_SYNC):
         case(MessageType::CAPABILITY):
+        case(MessageType::FLOW_CONTROL):
+        case(MessageType::SINK_ROUTE):
             return true;
         default:
             SIMEXCEPTION(MessageTypeInvalidException);
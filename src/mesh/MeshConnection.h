@@ -90,6 +90,36 @@ class MeshConnection
         //Enrolled nodes syncronization
         bool enrolledNodesSynced = false;
 
+        //Adaptive connection interval, see ConnectionManager::UpdateAdaptiveConnectionIntervals
+        u16 adaptiveConnectionInterval = 0; //The last interval that was requested, 0 if it was not changed
+        bool explicitConnectionInterval = false; //Set through ConnectionManager::SetMeshConnectionInterval, disables the adaptation
+        u16 receivedPackets = 0;
+        u16 transferredPacketsAtLastEvaluation = 0;
+        u8 stretchEvaluations = 0;
+
+        //Flow control, see ConnectionManager::UpdateFlowControl
+        u8 partnerFlowControlCredits = 0;
+        bool partnerFlowControlReceived = false;
+        bool partnerCongested = false; //Derived from the partner credits
+        u32 partnerFlowControlUpdatedDs = 0;
+        bool congestionAdvertised = false; //Whether the credits that were last sent to the partner are a congestion
+        u32 congestionAdvertisedDs = 0;
+
+        //Sink load balancing, see ConnectionManager::UpdateSinkRoutes
+        u8 partnerSinkLoad = 0;
+        u32 partnerSinkLoadUpdatedDs = 0;
+        u8 sinkLoadAdvertised = 0;
+        u32 sinkLoadAdvertisedDs = 0;
+        u16 receivedMessages = 0; //Counted after the reassembly
+        u16 receivedMessagesAtLastSinkLoadEvaluation = 0;
+
+        //Expected transmissions towards the sink, see ConnectionManager::EvaluateLinkEtx
+        u16 partnerSinkEtx = SINK_ETX_UNREACHABLE; //As advertised by the partner, without this link
+        u16 linkEtx = SINK_ETX_PER_TRANSMISSION;
+        u16 sinkEtxAdvertised = SINK_ETX_UNREACHABLE;
+        u16 droppedPacketsAtLastEtxEvaluation = 0;
+        u16 sentPacketsAtLastEtxEvaluation = 0;
+
         //Reestablishing
         bool mustRetryReestablishing = false;
         u32 reestablishmentStartedDs = 0;
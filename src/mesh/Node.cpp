@@ -275,6 +275,12 @@ void Node::HandshakeDoneHandler(MeshConnection* connection, bool completedAsWinn
         }
     }
 
+    //A topology rewire is finished once both nodes are connected again
+    if (topologyRewireTargetId != 0 && connection->partnerId == topologyRewireTargetId) {
+        logt("NODE", "Topology rewire of %u done", topologyRewireTargetId);
+        topologyRewireTargetId = 0;
+    }
+
     //We can now commit the changes that were part of the handshake
     //This node was the winner of the handshake and successfully acquired a new member
     if(completedAsWinner){
@@ -282,6 +288,7 @@ void Node::HandshakeDoneHandler(MeshConnection* connection, bool completedAsWinn
         const ClusterSize cluster = GetClusterSize() + 1;
         SetClusterSize(cluster);
         connection->hopsToSink = connection->clusterAck1Packet.payload.hopsToSink < 0 ? -1 : connection->clusterAck1Packet.payload.hopsToSink + 1;
+        connection->partnerSinkEtx = ConnectionManager::GetSinkEtxFromHops(connection->clusterAck1Packet.payload.hopsToSink);
 
         logt("HANDSHAKE", "ClusterSize Change from %d to %d", GetClusterSize()-1, GetClusterSize());
 
@@ -315,6 +322,7 @@ void Node::HandshakeDoneHandler(MeshConnection* connection, bool completedAsWinn
         SetClusterSize(connection->clusterAck2Packet.payload.clusterSize); // The other node knows best
 
         connection->hopsToSink = connection->clusterAck2Packet.payload.hopsToSink < 0 ? -1 : connection->clusterAck2Packet.payload.hopsToSink + 1;
+        connection->partnerSinkEtx = ConnectionManager::GetSinkEtxFromHops(connection->clusterAck2Packet.payload.hopsToSink);
 
         // We want the bigger cluster to send it's information about enrolled nodes.
         connection->enrolledNodesSynced = true;
@@ -508,7 +516,7 @@ void Node::MeshConnectionDisconnectedHandler(AppDisconnectReason appDisconnectRe
 }
 
 //Handles incoming cluster info update
-void Node::ReceiveClusterInfoUpdate(MeshConnection* connection, ConnPacketClusterInfoUpdate const * packet)
+void Node::ReceiveClusterInfoUpdate(MeshConnection* connection, ConnPacketClusterInfoUpdate const * packet, MessageLength packetLength)
 {
     //Check if next expected counter matches, if not, this clusterUpdate was a duplicate and we ignore it (might happen during reconnection)
     if (connection->nextExpectedClusterUpdateCounter == packet->payload.counter) {
@@ -542,6 +550,9 @@ void Node::ReceiveClusterInfoUpdate(MeshConnection* connection, ConnPacketCluste
     //Another sink may have joined or left the network, update this
     //FIXME: race conditions can cause this to work incorrectly...
     connection->hopsToSink = packet->payload.hopsToSink > -1 ? packet->payload.hopsToSink + 1 : -1;
+    connection->partnerSinkEtx = packetLength >= SIZEOF_CONN_PACKET_CLUSTER_INFO_UPDATE
+        ? packet->payload.sinkEtx
+        : ConnectionManager::GetSinkEtxFromHops(packet->payload.hopsToSink);
     
     //Now look if our partner has passed over the connection master bit
     if(packet->payload.connectionMasterBitHandover){
@@ -620,6 +631,8 @@ void Node::SendClusterInfoUpdate(MeshConnection* ignoreConnection, ConnPacketClu
 
         //We currently update the hops to sink at all times
         currentPacket->payload.hopsToSink = GS->cm.GetMeshHopsToShortestSink(conn.handles[i].GetConnection());
+        currentPacket->payload.sinkEtx = GS->cm.GetMeshEtxToShortestSink(conn.handles[i].GetConnection());
+        conn.handles[i].GetConnection()->sinkEtxAdvertised = currentPacket->payload.sinkEtx;
 
         if (conn.handles[i].GetConnection() == ignoreConnection) continue;
         
@@ -663,10 +676,26 @@ void Node::MeshMessageReceivedHandler(BaseConnection* connection, BaseConnection
             {
                 ConnPacketClusterInfoUpdate const * packet = (ConnPacketClusterInfoUpdate const *) packetHeader;
                 logt("HANDSHAKE", "IN <= %d CLUSTER_INFO_UPDATE sizeChange:%d, hop:%d", connection->partnerId, packet->payload.clusterSizeChange, packet->payload.hopsToSink);
-                ReceiveClusterInfoUpdate((MeshConnection*)connection, packet);
+                ReceiveClusterInfoUpdate((MeshConnection*)connection, packet, sendData->dataLength);
 
             }
             break;
+        case MessageType::FLOW_CONTROL:
+            if (
+                    connection != nullptr
+                    && connection->connectionType == ConnectionType::FRUITYMESH)
+            {
+                GS->cm.FlowControlReceivedHandler((MeshConnection*)connection, (ConnPacketFlowControl const *) packetHeader);
+            }
+            break;
+        case MessageType::SINK_ROUTE:
+            if (
+                    connection != nullptr
+                    && connection->connectionType == ConnectionType::FRUITYMESH)
+            {
+                GS->cm.SinkRouteReceivedHandler((MeshConnection*)connection, (ConnPacketSinkRoute const *) packetHeader, sendData->dataLength);
+            }
+            break;
 #if IS_INACTIVE(SAVE_SPACE)
         case MessageType::UPDATE_CONNECTION_INTERVAL:
             {
@@ -869,6 +898,26 @@ void Node::MeshMessageReceivedHandler(BaseConnection* connection, BaseConnection
                     false
                 );
             }
+            else if (packet->actionType == (u8)NodeModuleTriggerActionMessages::TOPOLOGY_REWIRE)
+            {
+                if (sendData->dataLength < SIZEOF_CONN_PACKET_MODULE + sizeof(TopologyRewireMessage)) return;
+                TopologyRewireMessage const * message = (TopologyRewireMessage const *)packet->data;
+
+                TopologyRewireResponseMessage response;
+                CheckedMemset(&response, 0, sizeof(response));
+                response.code = AcceptTopologyRewire(packetHeader->sender, *message);
+
+                //The disconnect is delayed a little so that the response can still be sent over our current connection
+                SendModuleActionMessage(
+                    MessageType::MODULE_ACTION_RESPONSE,
+                    packetHeader->sender,
+                    (u8)NodeModuleActionResponseMessages::TOPOLOGY_REWIRE_RESULT,
+                    packet->requestHandle,
+                    (u8*)&response,
+                    sizeof(response),
+                    false
+                );
+            }
             else if (packet->actionType == (u8)NodeModuleTriggerActionMessages::SET_PREFERRED_CONNECTIONS)
             {
                 PreferredConnectionMessage const * message = (PreferredConnectionMessage const *)packet->data;
@@ -972,6 +1021,17 @@ void Node::MeshMessageReceivedHandler(BaseConnection* connection, BaseConnection
                 }
                 ResetEmergencyDisconnect();
             }
+            else if (packet->actionType == (u8)NodeModuleActionResponseMessages::TOPOLOGY_REWIRE_RESULT)
+            {
+                TopologyRewireResponseMessage const * msg = (TopologyRewireResponseMessage const *)packet->data;
+                logjson("NODE", "{\"type\":\"topology_rewire_result\",\"nodeId\":%d,\"module\":%u,\"code\":%u}" SEP, packetHeader->sender, (u32)ModuleId::NODE, (u32)msg->code);
+
+                //If the node refused, we are free to look for other candidates
+                if (msg->code != TopologyRewireErrorCode::SUCCESS && packetHeader->sender == topologyRewireTargetId)
+                {
+                    topologyRewireTargetId = 0;
+                }
+            }
             else if (packet->actionType == (u8)NodeModuleActionResponseMessages::SET_PREFERRED_CONNECTIONS_RESULT)
             {
                 logjson("NODE", "{\"type\":\"set_preferred_connections_result\",\"nodeId\":%d,\"module\":%u}" SEP, packetHeader->sender, (u32)ModuleId::NODE);
@@ -1432,6 +1492,8 @@ DeliveryPriority Node::GetPriorityOfMessage(const u8* data, MessageLength size)
             || header->messageType == MessageType::CLUSTER_ACK_2
             || header->messageType == MessageType::UPDATE_CONNECTION_INTERVAL
             || header->messageType == MessageType::CLUSTER_INFO_UPDATE
+            || header->messageType == MessageType::FLOW_CONTROL
+            || header->messageType == MessageType::SINK_ROUTE
             || header->messageType == MessageType::DATA_1_VITAL)
         {
             return DeliveryPriority::VITAL;
@@ -1563,6 +1625,19 @@ Node::DecisionStruct Node::DetermineBestClusterAvailable(void)
 
     joinMeBufferPacket* bestClusterAsMaster = DetermineBestClusterAsMaster();
 
+    //A node that left our cluster because we asked it to rewire its connection is preferred over all others
+    if (topologyRewireTargetId != 0)
+    {
+        for (u32 i = 0; i < joinMePackets.size(); i++)
+        {
+            if (joinMePackets[i].payload.sender == topologyRewireTargetId && CalculateClusterScoreAsMaster(joinMePackets[i]) > 0)
+            {
+                bestClusterAsMaster = &joinMePackets[i];
+                break;
+            }
+        }
+    }
+
     //If we still do not have a freeOutConnection, we have no viable cluster to connect to
     if (GS->cm.freeMeshOutConnections > 0)
     {
@@ -1765,6 +1840,8 @@ u32 Node::CalculateClusterScoreAsSlave(const joinMeBufferPacket& packet) const
     //We will only be a slave of a bigger or equal cluster
     if (packet.payload.clusterSize < GetClusterSize()) return 0;
 
+    if (IsBlacklistedAfterTopologyRewire(packet.payload.sender)) return 0;
+
     //Connection should have a minimum of stability
     if(packet.rssi < STABLE_CONNECTION_RSSI_THRESHOLD) return 0;
 
@@ -1791,6 +1868,111 @@ void Node::ResetEmergencyDisconnect()
     }
 }
 
+//Remembers the node of our own cluster that has the longest route to the sink and could connect to us directly
+void Node::UpdateTopologyCandidate(const FruityHal::GapAdvertisementReportEvent& advertisementReportEvent, const AdvPacketJoinMeV0* packet)
+{
+    if (Conf::GetInstance().topologyOptimizationIntervalDs == 0) return;
+
+    //Nodes without a route to the sink, with an unstable link or that are already our partners cannot profit from us
+    if (packet->payload.hopsToSink > INT16_MAX) return;
+    if (advertisementReportEvent.GetRssi() < STABLE_CONNECTION_RSSI_THRESHOLD) return;
+    if (GS->cm.GetMeshConnectionToPartner(packet->payload.sender)) return;
+
+    const bool candidateValid = topologyCandidate.payload.sender != 0 && GS->appTimerDs - topologyCandidate.receivedTimeDs <= MAX_JOIN_ME_PACKET_AGE_DS;
+    if (candidateValid
+        && topologyCandidate.payload.sender != packet->payload.sender
+        && topologyCandidate.payload.hopsToSink >= packet->payload.hopsToSink) return;
+
+    topologyCandidate.addr.addr = advertisementReportEvent.GetPeerAddr();
+    topologyCandidate.addr.addr_type = advertisementReportEvent.GetPeerAddrType();
+    topologyCandidate.advType = advertisementReportEvent.IsConnectable() ? FruityHal::BleGapAdvType::ADV_IND : FruityHal::BleGapAdvType::ADV_NONCONN_IND;
+    topologyCandidate.rssi = advertisementReportEvent.GetRssi();
+    topologyCandidate.receivedTimeDs = GS->appTimerDs;
+    topologyCandidate.payload = packet->payload;
+}
+
+//Once the clustering is stable, the mesh might still have long routes to the sink because the tree was built
+//in the order in which the nodes found each other. If a leaf of our cluster would get significantly closer to the
+//sink by connecting to us, we ask it to drop its current connection. We then connect to it as soon as it is a
+//single node again.
+void Node::OptimizeTopology()
+{
+    //Leafs and assets must not connect to anybody as master
+    if (GET_DEVICE_TYPE() == DeviceType::LEAF || GET_DEVICE_TYPE() == DeviceType::ASSET) return;
+
+    if (topologyRewireTargetId != 0 || GS->cm.pendingConnection != nullptr || GS->cm.freeMeshOutConnections == 0) return;
+    if (GS->appTimerDs - clusterSizeChangedDs < Conf::GetInstance().topologyOptimizationIntervalDs) return;
+    if (topologyCandidate.payload.sender == 0 || GS->appTimerDs - topologyCandidate.receivedTimeDs > MAX_JOIN_ME_PACKET_AGE_DS) return;
+    if (ModifyScoreBasedOnPreferredPartners(1, topologyCandidate.payload.sender) == 0) return;
+
+    const ClusterSize ownHops = GS->cm.GetMeshHopsToShortestSink(nullptr);
+    if (ownHops < 0) return;
+
+    const ClusterSize candidateHops = (ClusterSize)topologyCandidate.payload.hopsToSink;
+    if (candidateHops < ownHops + 1 + TOPOLOGY_OPTIMIZATION_MIN_HOP_GAIN) return;
+
+    logt("NODE", "Asking %u to rewire, hops %d => %d", topologyCandidate.payload.sender, candidateHops, ownHops + 1);
+    SIMSTATCOUNT("topologyRewireRequested");
+
+    TopologyRewireMessage message;
+    CheckedMemset(&message, 0, sizeof(message));
+    message.hopsToSink = ownHops + 1;
+
+    SendModuleActionMessage(
+        MessageType::MODULE_TRIGGER_ACTION,
+        topologyCandidate.payload.sender,
+        (u8)NodeModuleTriggerActionMessages::TOPOLOGY_REWIRE,
+        0,
+        (u8*)&message,
+        sizeof(message),
+        false
+    );
+
+    topologyRewireTargetId = topologyCandidate.payload.sender;
+    topologyRewireRequestedDs = GS->appTimerDs;
+    CheckedMemset(&topologyCandidate, 0x00, sizeof(topologyCandidate));
+}
+
+//Only a node with a single mesh connection where the partner holds the master bit can be rewired, because
+//only then our disconnect dissolves nothing but this node and the rest of the cluster stays intact.
+Node::TopologyRewireErrorCode Node::AcceptTopologyRewire(NodeId parent, const TopologyRewireMessage& message)
+{
+    if (topologyRewireDisconnectDs != 0 || GS->cm.pendingConnection != nullptr) return TopologyRewireErrorCode::BUSY;
+
+    MeshConnections conns = GS->cm.GetMeshConnections(ConnectionDirection::INVALID);
+    if (conns.count != 1 || !conns.handles[0].IsHandshakeDone()) return TopologyRewireErrorCode::NOT_A_LEAF;
+    if (conns.handles[0].HasConnectionMasterBit()) return TopologyRewireErrorCode::HAS_MASTER_BIT;
+
+    const ClusterSize ownHops = GS->cm.GetMeshHopsToShortestSink(nullptr);
+    if (ownHops >= 0 && ownHops <= message.hopsToSink) return TopologyRewireErrorCode::NO_IMPROVEMENT;
+
+    logt("NODE", "Rewiring to %u, hops %d => %d", parent, ownHops, message.hopsToSink);
+
+    topologyRewireDisconnectDs = GS->appTimerDs + TOPOLOGY_REWIRE_DISCONNECT_DELAY_DS;
+
+    return TopologyRewireErrorCode::SUCCESS;
+}
+
+void Node::ExecuteTopologyRewire()
+{
+    topologyRewireDisconnectDs = 0;
+
+    //The situation might have changed since we accepted the rewire
+    MeshConnections conns = GS->cm.GetMeshConnections(ConnectionDirection::INVALID);
+    if (conns.count != 1 || !conns.handles[0].IsHandshakeDone() || conns.handles[0].HasConnectionMasterBit()) return;
+
+    SIMSTATCOUNT("topologyRewire");
+    topologyRewireOldPartnerId = conns.handles[0].GetPartnerId();
+    topologyRewireBlacklistEndDs = GS->appTimerDs + TOPOLOGY_REWIRE_BLACKLIST_DS;
+    conns.handles[0].DisconnectAndRemove(AppDisconnectReason::TOPOLOGY_OPTIMIZATION);
+}
+
+//Our old partner would reconnect to us as quickly as the node that asked us to rewire, so it is refused for a while
+bool Node::IsBlacklistedAfterTopologyRewire(NodeId id) const
+{
+    return topologyRewireOldPartnerId != 0 && id == topologyRewireOldPartnerId && GS->appTimerDs < topologyRewireBlacklistEndDs;
+}
+
 //All advertisement packets are received here if they are valid
 void Node::GapAdvertisementMessageHandler(const FruityHal::GapAdvertisementReportEvent& advertisementReportEvent)
 {
@@ -1824,6 +2006,16 @@ void Node::GapAdvertisementMessageHandler(const FruityHal::GapAdvertisementRepor
                 targetBuffer->receivedTimeDs = GS->appTimerDs;
 
                 targetBuffer->payload = packet->payload;
+
+                //The node that we asked to rewire has left our cluster, we should connect to it before anybody else does
+                if (packet->payload.sender == topologyRewireTargetId && GS->cm.pendingConnection == nullptr)
+                {
+                    lastDecisionTimeDs = 0;
+                }
+            }
+            else if (packet->payload.clusterId == this->clusterId)
+            {
+                UpdateTopologyCandidate(advertisementReportEvent, packet);
             }
         }
     }
@@ -1942,6 +2134,9 @@ void Node::ChangeState(DiscoveryState newState)
         if (meshAdvJobHandle != nullptr){
             meshAdvJobHandle->advertisingInterval =    Conf::meshAdvertisingIntervalHigh;
             meshAdvJobHandle->slots = 5;
+            //Join me packets are needed in every slot for a fast clustering and must not be diluted by other jobs
+            meshAdvJobHandle->targetIntervalDs = ADVERTISING_CONTROLLER_SLOT_DS;
+            meshAdvJobHandle->maxStalenessDs = MESH_ADV_JOB_MAX_STALENESS_HIGH_DS;
             GS->advertisingController.RefreshJob(meshAdvJobHandle);
         }
 
@@ -1957,6 +2152,8 @@ void Node::ChangeState(DiscoveryState newState)
         //Reconfigure the advertising and scanning jobs
         if (meshAdvJobHandle != nullptr) {
             meshAdvJobHandle->advertisingInterval = Conf::meshAdvertisingIntervalLow;
+            meshAdvJobHandle->targetIntervalDs = 0;
+            meshAdvJobHandle->maxStalenessDs = MESH_ADV_JOB_MAX_STALENESS_LOW_DS;
             GS->advertisingController.RefreshJob(meshAdvJobHandle);
         }
         ScanJob scanJob = ScanJob();
@@ -1975,6 +2172,8 @@ void Node::ChangeState(DiscoveryState newState)
 
         if (meshAdvJobHandle != nullptr) {
             meshAdvJobHandle->advertisingInterval = Conf::meshAdvertisingIntervalLow;
+            meshAdvJobHandle->targetIntervalDs = 0;
+            meshAdvJobHandle->maxStalenessDs = MESH_ADV_JOB_MAX_STALENESS_LOW_DS;
             GS->advertisingController.RefreshJob(meshAdvJobHandle);
         }
 
@@ -2082,6 +2281,20 @@ void Node::TimerEventHandler(u16 passedTimeDs)
         ResetEmergencyDisconnect();
     }
 
+    if (topologyRewireTargetId != 0 && topologyRewireRequestedDs + TOPOLOGY_REWIRE_TIMEOUT_DS <= GS->appTimerDs)
+    {
+        logt("NODE", "Topology rewire of %u timed out", topologyRewireTargetId);
+        topologyRewireTargetId = 0;
+    }
+    if (topologyRewireDisconnectDs != 0 && topologyRewireDisconnectDs <= GS->appTimerDs)
+    {
+        ExecuteTopologyRewire();
+    }
+    if (SHOULD_IV_TRIGGER(GS->appTimerDs, passedTimeDs, Conf::GetInstance().topologyOptimizationIntervalDs))
+    {
+        OptimizeTopology();
+    }
+
     //Count the nodes that are a good choice for connecting
     //TODO: We could use this snippet to connect immediately after enought nodes were collected
 //    u8 numGoodNodesInBuffer = 0;
@@ -2275,6 +2488,7 @@ void Node::SetClusterSize(ClusterSize clusterSize)
         clusterSizeChangeHandled = false;
         clusterSizeTransitionTimeoutDs = SEC_TO_DS((u32)Conf::GetInstance().clusterSizeDiscoveryChangeDelaySec);
     }
+    if (this->clusterSize != clusterSize) clusterSizeChangedDs = GS->appTimerDs;
     this->clusterSize = clusterSize;
 }
 
@@ -2485,6 +2699,16 @@ void Node::PrintBufferStatus(void) const
         trace(" OTHER" EOL);
     }
 
+    //Print the send queue memory of all connections
+    trace("Send Queues: freeChunks:%u, freeSmallChunks:%u" EOL, GS->connectionQueueMemoryAllocator.GetAmountOfFreeChunks(), GS->connectionQueueMemoryAllocator.GetAmountOfFreeSmallChunks());
+    BaseConnections conns = GS->cm.GetBaseConnections(ConnectionDirection::INVALID);
+    for (u32 i = 0; i < conns.count; i++)
+    {
+        const BaseConnection* conn = conns.handles[i].GetConnection();
+        if (conn == nullptr) continue;
+        trace("=> conn:%u, partner:%u, packets:%u, bytes:%u, highWaterBytes:%u" EOL, conn->connectionId, conn->partnerId, conn->queue.GetAmountOfPackets(), conn->queue.GetAllocatedBytes(), conn->queue.GetAllocatedBytesHighWater());
+    }
+
     trace("**************" EOL);
 }
 
@@ -2988,6 +3212,7 @@ TerminalCommandHandlerReturnType Node::TerminalCommandHandler(const char* comman
         {
             trace("Time is currently not set: %s" EOL, timestring);    
         }
+        trace("Clock drift %d ppm, last sync error %d ticks" EOL, GS->timeManager.GetClockDriftPpm(), GS->timeManager.GetLastSyncErrorTicks());
         return TerminalCommandHandlerReturnType::SUCCESS;
     }
     else if (TERMARGS(0, "startterm"))
@@ -3052,6 +3277,69 @@ TerminalCommandHandlerReturnType Node::TerminalCommandHandler(const char* comman
         PrintBufferStatus();
         return TerminalCommandHandlerReturnType::SUCCESS;
     }
+    //Print the send queue latency statistics of all connections
+    else if (TERMARGS(0, "queuestat"))
+    {
+        const bool reset = commandArgsSize > 1 && TERMARGS(1, "reset");
+        BaseConnections conns = GS->cm.GetBaseConnections(ConnectionDirection::INVALID);
+        for (u32 i = 0; i < conns.count; i++)
+        {
+            BaseConnection* conn = conns.handles[i].GetConnection();
+            if (conn == nullptr) continue;
+            if (reset)
+            {
+                conn->queue.ResetLatencyStats();
+                continue;
+            }
+            trace("Connection %u, partner %u, pending %u" EOL, conn->connectionId, conn->partnerId, conn->GetPendingPackets());
+            conn->queue.PrintLatencyStats();
+        }
+        if (!reset)
+        {
+            trace("Bucket upper bounds in ms:");
+            for (u32 bucket = 0; bucket < QUEUE_LATENCY_HISTOGRAM_BUCKETS - 1; bucket++)
+            {
+                trace(" %u", ChunkedPriorityPacketQueue::GetLatencyBucketUpperBoundMs(bucket));
+            }
+            trace(EOL);
+        }
+        return TerminalCommandHandlerReturnType::SUCCESS;
+    }
+    //Print the erase and write counters of the flash pages, e.g. "flashstat" or "flashstat reset"
+    else if (TERMARGS(0, "flashstat"))
+    {
+        if (commandArgsSize > 1 && TERMARGS(1, "reset")) GS->flashStorage.ResetWearStatistics();
+        else GS->flashStorage.PrintWearStatistics();
+        return TerminalCommandHandlerReturnType::SUCCESS;
+    }
+    //Switches the scheduling of the HIGH, MEDIUM and LOW send queues, e.g. "queuesched drr 240 160 80" or "queuesched droplets"
+    else if (TERMARGS(0, "queuesched") && commandArgsSize >= 2)
+    {
+        if (TERMARGS(1, "droplets"))
+        {
+            GS->cm.queueSchedulingMode = QueueSchedulingMode::PRIORITY_DROPLETS;
+        }
+        else if (TERMARGS(1, "drr"))
+        {
+            if (commandArgsSize >= 5)
+            {
+                bool didError = false;
+                std::array<u16, AMOUNT_OF_SEND_QUEUE_PRIORITIES> quanta = {};
+                for (u32 i = (u32)DeliveryPriority::HIGH; i < quanta.size(); i++)
+                {
+                    quanta[i] = Utility::StringToU16(commandArgs[1 + i], &didError);
+                }
+                if (didError) return TerminalCommandHandlerReturnType::WRONG_ARGUMENT;
+                GS->cm.deficitRoundRobinQuanta = quanta;
+            }
+            GS->cm.queueSchedulingMode = QueueSchedulingMode::DEFICIT_ROUND_ROBIN;
+        }
+        else
+        {
+            return TerminalCommandHandlerReturnType::WRONG_ARGUMENT;
+        }
+        return TerminalCommandHandlerReturnType::SUCCESS;
+    }
     //Send some large data that is split over a few messages
     else if(TERMARGS(0, "datal"))
     {
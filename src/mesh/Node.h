@@ -108,6 +108,7 @@ private:
             GENERATE_LOAD_CHUNK       = 5,
             EMERGENCY_DISCONNECT      = 6,
             SET_ENROLLED_NODES        = 7,
+            TOPOLOGY_REWIRE           = 8,
         };
 
         enum class NodeModuleActionResponseMessages : u8
@@ -118,6 +119,7 @@ private:
             START_GENERATE_LOAD_RESULT       = 4,
             EMERGENCY_DISCONNECT_RESULT      = 5,
             SET_ENROLLED_NODES_RESULT        = 6,
+            TOPOLOGY_REWIRE_RESULT           = 7,
         };
 
         #pragma pack(push, 1)
@@ -145,6 +147,27 @@ private:
             u16 enrolledNodes;
         };
         STATIC_ASSERT_SIZE(SetEnrolledNodesResponseMessage, 2);
+
+        enum class TopologyRewireErrorCode : u8
+        {
+            SUCCESS        = 0,
+            NOT_A_LEAF     = 1,
+            HAS_MASTER_BIT = 2,
+            NO_IMPROVEMENT = 3,
+            BUSY           = 4,
+        };
+
+        struct TopologyRewireMessage
+        {
+            ClusterSize hopsToSink; //The hops to the sink that the receiver would have after connecting to the sender
+        };
+        STATIC_ASSERT_SIZE(TopologyRewireMessage, 2);
+
+        struct TopologyRewireResponseMessage
+        {
+            TopologyRewireErrorCode code;
+        };
+        STATIC_ASSERT_SIZE(TopologyRewireResponseMessage, 1);
         #pragma pack(pop)
 
         bool stateMachineDisabled = false;
@@ -202,12 +225,32 @@ private:
         MeshAccessConnectionHandle emergencyDisconnectValidationConnectionUniqueId;
         void ResetEmergencyDisconnect(); //Resets all the emergency disconnect variables and closes the validation connection.
 
+        //Background topology optimization, see Node::OptimizeTopology
+        constexpr static u32 TOPOLOGY_REWIRE_TIMEOUT_DS = SEC_TO_DS(20);
+        constexpr static u32 TOPOLOGY_REWIRE_DISCONNECT_DELAY_DS = SEC_TO_DS(1);
+        constexpr static ClusterSize TOPOLOGY_OPTIMIZATION_MIN_HOP_GAIN = 2;
+        constexpr static u32 TOPOLOGY_REWIRE_BLACKLIST_DS = SEC_TO_DS(10); //About one join me cycle
+        u32 clusterSizeChangedDs = 0; //The last time that our cluster size changed, used to wait for a stable clustering
+        joinMeBufferPacket topologyCandidate{}; //The node of our own cluster that would profit most from connecting to us
+        NodeId topologyRewireTargetId = 0; //The node that we asked to connect to us instead of its current partner
+        u32 topologyRewireRequestedDs = 0;
+        u32 topologyRewireDisconnectDs = 0; //When we drop our current connection after accepting a rewire, 0 if not scheduled
+        NodeId topologyRewireOldPartnerId = 0; //Our partner before the rewire, it must not win the race for us against the new parent
+        u32 topologyRewireBlacklistEndDs = 0;
+        void UpdateTopologyCandidate(const FruityHal::GapAdvertisementReportEvent& advertisementReportEvent, const AdvPacketJoinMeV0* packet);
+        void OptimizeTopology();
+        TopologyRewireErrorCode AcceptTopologyRewire(NodeId parent, const TopologyRewireMessage& message);
+        void ExecuteTopologyRewire();
+
     public:    
         DECLARE_CONFIG_AND_PACKED_STRUCT(NodeConfiguration);
 
 
         static constexpr int MAX_JOIN_ME_PACKET_AGE_DS = SEC_TO_DS(10);
         static constexpr int JOIN_ME_PACKET_BUFFER_MAX_ELEMENTS = 10;
+        //The join me packet is advertised at the latest after this time, even if other advertising jobs are due
+        static constexpr u16 MESH_ADV_JOB_MAX_STALENESS_HIGH_DS = SEC_TO_DS(1);
+        static constexpr u16 MESH_ADV_JOB_MAX_STALENESS_LOW_DS = SEC_TO_DS(3);
         std::array<joinMeBufferPacket, JOIN_ME_PACKET_BUFFER_MAX_ELEMENTS> joinMePackets{};
         ClusterId currentAckId = 0;
         u16 connectionLossCounter = 0;
@@ -320,7 +363,7 @@ private:
         Module* GetModuleById(VendorModuleId id) const;
 
         void SendClusterInfoUpdate(MeshConnection* ignoreConnection, ConnPacketClusterInfoUpdate* packet) const;
-        void ReceiveClusterInfoUpdate(MeshConnection* connection, ConnPacketClusterInfoUpdate const * packet);
+        void ReceiveClusterInfoUpdate(MeshConnection* connection, ConnPacketClusterInfoUpdate const * packet, MessageLength packetLength);
 
         void HandOverMasterBitIfNecessary() const;
         
@@ -354,4 +397,5 @@ private:
         
         bool GetKey(FmKeyId fmKeyId, u8* keyOut) const;
         bool IsPreferredConnection(NodeId id) const;
+        bool IsBlacklistedAfterTopologyRewire(NodeId id) const;
 };
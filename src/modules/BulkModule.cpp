@@ -0,0 +1,700 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+
+#include <BulkModule.h>
+
+#include <Logger.h>
+#include <Utility.h>
+#include <GlobalState.h>
+#include <Node.h>
+
+/*
+Module purpose:
+Transfers blobs that are larger than a single mesh packet to one or many nodes.
+The sender keeps a window of chunks in flight, the receivers reassemble the blob
+and report the received chunks with a cumulative index plus a bitmap of the
+chunks received after it, so that only the missing chunks are sent again.
+ */
+
+constexpr u8 BULK_MODULE_CONFIG_VERSION = 1;
+
+BulkModule::BulkModule()
+    : Module(ModuleId::BULK_MODULE, "bulk")
+{
+    CheckedMemset(transferBuffer, 0x00, sizeof(transferBuffer));
+    CheckedMemset(receivers, 0x00, sizeof(receivers));
+    CheckedMemset(chunkSentDs, 0x00, sizeof(chunkSentDs));
+    CheckedMemset(receivedChunks, 0x00, sizeof(receivedChunks));
+
+    //Save configuration to base class variables
+    //sizeof configuration must be a multiple of 4 bytes
+    configurationPointer = &configuration;
+    configurationLength = sizeof(BulkModuleConfiguration);
+
+    //Set defaults
+    ResetToDefaultConfiguration();
+}
+
+void BulkModule::ResetToDefaultConfiguration()
+{
+    //Set default configuration values
+    configuration.moduleId = moduleId;
+    configuration.moduleActive = true;
+    configuration.moduleVersion = BULK_MODULE_CONFIG_VERSION;
+
+    //Set additional config values...
+    configuration.windowSize = DEFAULT_WINDOW_SIZE;
+
+    SET_FEATURESET_CONFIGURATION(&configuration, this);
+}
+
+void BulkModule::ConfigurationLoadedHandler(u8* migratableConfig, u16 migratableConfigLength)
+{
+    //The receivers can only report MAX_WINDOW_SIZE chunks in their bitmap
+    if (configuration.windowSize == 0 || configuration.windowSize > MAX_WINDOW_SIZE)
+    {
+        configuration.windowSize = DEFAULT_WINDOW_SIZE;
+    }
+}
+
+void BulkModule::TimerEventHandler(u16 passedTimeDs)
+{
+    if (sending)
+    {
+        if (GS->appTimerDs - lastProgressDs > TRANSFER_TIMEOUT_DS)
+        {
+            logt("BULK", "Transfer %u timed out", transferId);
+            for (u32 i = 0; i < receiverCount; i++)
+            {
+                if (receivers[i].status == BulkTransferStatus::IN_PROGRESS) receivers[i].status = BulkTransferStatus::TIMEOUT;
+            }
+            FinishSendingIfDone();
+        }
+        else
+        {
+            bool allStarted = true;
+            for (u32 i = 0; i < receiverCount; i++)
+            {
+                if (!receivers[i].started && receivers[i].status == BulkTransferStatus::IN_PROGRESS) allStarted = false;
+            }
+
+            if (!allStarted)
+            {
+                if (GS->appTimerDs - lastStartSentDs >= START_RETRY_DS) SendStart();
+            }
+            else
+            {
+                RetransmitMissingChunks(RETRANSMIT_TIMEOUT_DS, nextNewChunkIndex);
+                SendNewChunks();
+            }
+        }
+    }
+
+    //Acknowledge chunks that were not acknowledged yet, e.g. the last ones of a window
+    if (receiving && chunksSinceAck > 0 && GS->appTimerDs - firstUnackedChunkDs >= ACK_DELAY_DS)
+    {
+        SendAck();
+    }
+}
+
+#ifdef TERMINAL_ENABLED
+TerminalCommandHandlerReturnType BulkModule::TerminalCommandHandler(const char* commandArgs[], u8 commandArgsSize)
+{
+    if (commandArgsSize >= 2 && TERMARGS(0, moduleName))
+    {
+        if (TERMARGS(1, "write"))
+        {
+            //bulk write [offset] [data]
+            if (commandArgsSize < 4) return TerminalCommandHandlerReturnType::NOT_ENOUGH_ARGUMENTS;
+
+            bool didError = false;
+            const u32 offset = Utility::StringToU32(commandArgs[2], &didError);
+            u8 buffer[CHUNK_SIZE];
+            const u32 length = Logger::ParseEncodedStringToBuffer(commandArgs[3], buffer, sizeof(buffer), &didError);
+            if (didError || !WriteTransferData(offset, buffer, length)) return TerminalCommandHandlerReturnType::WRONG_ARGUMENT;
+
+            return TerminalCommandHandlerReturnType::SUCCESS;
+        }
+        else if (TERMARGS(1, "send"))
+        {
+            //bulk send [transferId] [size] [receiverId] {receiverId} ...
+            if (commandArgsSize < 5) return TerminalCommandHandlerReturnType::NOT_ENOUGH_ARGUMENTS;
+            if (commandArgsSize - 4 > MAX_RECEIVERS) return TerminalCommandHandlerReturnType::WRONG_ARGUMENT;
+
+            bool didError = false;
+            const u16 id = Utility::StringToU16(commandArgs[2], &didError);
+            const u32 size = Utility::StringToU32(commandArgs[3], &didError);
+            NodeId receiverIds[MAX_RECEIVERS];
+            const u8 amountOfReceivers = commandArgsSize - 4;
+            for (u32 i = 0; i < amountOfReceivers; i++)
+            {
+                receiverIds[i] = Utility::TerminalArgumentToNodeId(commandArgs[4 + i], &didError);
+            }
+            if (didError) return TerminalCommandHandlerReturnType::WRONG_ARGUMENT;
+
+            const ErrorType err = StartTransfer(id, size, receiverIds, amountOfReceivers);
+            if (err != ErrorType::SUCCESS) return TerminalCommandHandlerReturnType::WRONG_ARGUMENT;
+
+            return TerminalCommandHandlerReturnType::SUCCESS;
+        }
+        else if (TERMARGS(1, "abort"))
+        {
+            AbortTransfer();
+
+            return TerminalCommandHandlerReturnType::SUCCESS;
+        }
+        else if (TERMARGS(1, "status"))
+        {
+            logjson_partial("BULK", "{\"nodeId\":%u,\"type\":\"bulk_status\",\"sending\":%u,\"transferId\":%u,\"size\":%u,", GS->node.configuration.nodeId, (u32)sending, transferId, totalSize);
+            logjson_partial("BULK", "\"windowBase\":%u,\"chunksSent\":%u,\"chunksRetransmitted\":%u,", sending ? GetWindowBase() : 0, chunksSent, chunksRetransmitted);
+            logjson("BULK", "\"receiving\":%u,\"receiveStatus\":%u,\"chunksReceived\":%u,\"module\":%u}" SEP, (u32)receiving, (u32)receiveStatus, receiveNextChunkIndex, (u8)moduleId);
+
+            return TerminalCommandHandlerReturnType::SUCCESS;
+        }
+    }
+
+    //Must be called to allow the module to get and set the config
+    return Module::TerminalCommandHandler(commandArgs, commandArgsSize);
+}
+#endif
+
+void BulkModule::MeshMessageReceivedHandler(BaseConnection* connection, BaseConnectionSendData* sendData, ConnPacketHeader const * packetHeader)
+{
+    //Must call superclass for handling
+    Module::MeshMessageReceivedHandler(connection, sendData, packetHeader);
+
+    if (packetHeader->messageType == MessageType::MODULE_TRIGGER_ACTION) {
+        ConnPacketModule const * packet = (ConnPacketModule const *)packetHeader;
+        const u16 payloadLength = sendData->dataLength.GetRaw() - SIZEOF_CONN_PACKET_MODULE;
+
+        //Check if our module is meant and we should trigger an action
+        if (packet->moduleId == moduleId) {
+            BulkModuleTriggerActionMessages actionType = (BulkModuleTriggerActionMessages)packet->actionType;
+            if (actionType == BulkModuleTriggerActionMessages::START && payloadLength >= SIZEOF_BULK_MODULE_START_MESSAGE)
+            {
+                HandleStart(packet->header.sender, *(BulkModuleStartMessage const *)packet->data);
+            }
+            else if (actionType == BulkModuleTriggerActionMessages::CHUNK && payloadLength > SIZEOF_BULK_MODULE_CHUNK_MESSAGE_HEADER)
+            {
+                HandleChunk(packet->header.sender, (BulkModuleChunkMessage const *)packet->data, payloadLength - SIZEOF_BULK_MODULE_CHUNK_MESSAGE_HEADER);
+            }
+            else if (actionType == BulkModuleTriggerActionMessages::ABORT && payloadLength >= SIZEOF_BULK_MODULE_ABORT_MESSAGE)
+            {
+                BulkModuleAbortMessage const * data = (BulkModuleAbortMessage const *)packet->data;
+                if (receiving && senderId == packet->header.sender && transferId == data->transferId)
+                {
+                    logt("BULK", "Transfer %u aborted by %u", transferId, senderId);
+                    receiveStatus = BulkTransferStatus::ABORTED;
+                    receiving = false;
+                }
+            }
+        }
+    }
+
+    //Parse Module responses
+    if (packetHeader->messageType == MessageType::MODULE_ACTION_RESPONSE) {
+        ConnPacketModule const * packet = (ConnPacketModule const *)packetHeader;
+        const u16 payloadLength = sendData->dataLength.GetRaw() - SIZEOF_CONN_PACKET_MODULE;
+
+        //Check if our module is meant
+        if (packet->moduleId == moduleId)
+        {
+            BulkModuleActionResponseMessages actionType = (BulkModuleActionResponseMessages)packet->actionType;
+            if (actionType == BulkModuleActionResponseMessages::ACK && payloadLength >= SIZEOF_BULK_MODULE_ACK_MESSAGE)
+            {
+                HandleAck(packet->header.sender, *(BulkModuleAckMessage const *)packet->data);
+            }
+        }
+    }
+}
+
+DeliveryPriority BulkModule::GetPriorityOfMessage(const u8* data, MessageLength size)
+{
+    if (size >= SIZEOF_CONN_PACKET_MODULE)
+    {
+        const ConnPacketModule* mod = (const ConnPacketModule*)data;
+        if (mod->header.messageType == MessageType::MODULE_TRIGGER_ACTION
+            && mod->moduleId == moduleId
+            && mod->actionType == (u8)BulkModuleTriggerActionMessages::CHUNK)
+        {
+            return DeliveryPriority::LOW;
+        }
+    }
+    return DeliveryPriority::INVALID;
+}
+
+#define _____________SENDING_____________
+
+bool BulkModule::WriteTransferData(u32 offset, const u8* data, u32 dataLength)
+{
+    if (sending) return false;
+    if (offset > MAX_TRANSFER_SIZE || dataLength > MAX_TRANSFER_SIZE - offset) return false;
+
+    CheckedMemcpy(transferBuffer + offset, data, dataLength);
+    return true;
+}
+
+ErrorType BulkModule::StartTransfer(u16 transferId, u32 totalSize, const NodeId* receiverIds, u8 receiverCount)
+{
+    if (sending) return ErrorType::BUSY;
+    if (totalSize == 0 || totalSize > MAX_TRANSFER_SIZE) return ErrorType::INVALID_PARAM;
+    if (receiverCount == 0 || receiverCount > MAX_RECEIVERS) return ErrorType::INVALID_PARAM;
+
+    //Our buffer is reused for sending, so any blob that we received before is gone
+    receiving = false;
+    senderId = NODE_ID_INVALID;
+    receiveStatus = BulkTransferStatus::IN_PROGRESS;
+
+    this->transferId = transferId;
+    this->totalSize = totalSize;
+    this->crc32 = Utility::CalculateCrc32(transferBuffer, totalSize);
+    numChunks = (totalSize + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+    CheckedMemset(receivers, 0x00, sizeof(receivers));
+    for (u32 i = 0; i < receiverCount; i++)
+    {
+        receivers[i].nodeId = receiverIds[i];
+        receivers[i].status = BulkTransferStatus::IN_PROGRESS;
+    }
+    this->receiverCount = receiverCount;
+
+    sending = true;
+    nextNewChunkIndex = 0;
+    chunksSent = 0;
+    chunksRetransmitted = 0;
+    sendStartDs = GS->appTimerDs;
+    lastProgressDs = GS->appTimerDs;
+    CheckedMemset(chunkSentDs, 0x00, sizeof(chunkSentDs));
+
+    logt("BULK", "Starting transfer %u of %u bytes in %u chunks", transferId, totalSize, numChunks);
+
+    SendStart();
+
+    return ErrorType::SUCCESS;
+}
+
+void BulkModule::AbortTransfer()
+{
+    if (!sending) return;
+
+    BulkModuleAbortMessage message;
+    CheckedMemset(&message, 0x00, sizeof(message));
+    message.transferId = transferId;
+
+    for (u32 i = 0; i < receiverCount; i++)
+    {
+        if (receivers[i].status == BulkTransferStatus::IN_PROGRESS)
+        {
+            receivers[i].status = BulkTransferStatus::ABORTED;
+            SendModuleActionMessage(
+                MessageType::MODULE_TRIGGER_ACTION,
+                receivers[i].nodeId,
+                (u8)BulkModuleTriggerActionMessages::ABORT,
+                0,
+                (u8*)&message,
+                SIZEOF_BULK_MODULE_ABORT_MESSAGE,
+                false
+            );
+        }
+    }
+
+    FinishSendingIfDone();
+}
+
+void BulkModule::SendStart()
+{
+    BulkModuleStartMessage message;
+    CheckedMemset(&message, 0x00, sizeof(message));
+    message.transferId = transferId;
+    message.totalSize = totalSize;
+    message.crc32 = crc32;
+
+    //The start is sent to each receiver individually so that only these take part in the transfer
+    for (u32 i = 0; i < receiverCount; i++)
+    {
+        if (receivers[i].started || receivers[i].status != BulkTransferStatus::IN_PROGRESS) continue;
+
+        SendModuleActionMessage(
+            MessageType::MODULE_TRIGGER_ACTION,
+            receivers[i].nodeId,
+            (u8)BulkModuleTriggerActionMessages::START,
+            0,
+            (u8*)&message,
+            SIZEOF_BULK_MODULE_START_MESSAGE,
+            false
+        );
+    }
+    lastStartSentDs = GS->appTimerDs;
+}
+
+u16 BulkModule::GetChunkLength(u16 chunkIndex) const
+{
+    if ((u32)chunkIndex + 1 < numChunks) return CHUNK_SIZE;
+    return totalSize - (u32)chunkIndex * CHUNK_SIZE;
+}
+
+static bool IsChunkMissingAtReceiver(u16 chunkIndex, u16 nextChunkIndex, u32 receivedBitmap)
+{
+    if (chunkIndex < nextChunkIndex) return false;
+    if (chunkIndex == nextChunkIndex) return true;
+    const u32 bit = chunkIndex - nextChunkIndex - 1;
+    return bit >= 32 || (receivedBitmap & (1UL << bit)) == 0;
+}
+
+u8 BulkModule::SendChunk(u16 chunkIndex)
+{
+    BulkModuleChunkMessage message;
+    CheckedMemset(&message, 0x00, sizeof(message));
+    message.transferId = transferId;
+    message.chunkIndex = chunkIndex;
+
+    const u16 length = GetChunkLength(chunkIndex);
+    CheckedMemcpy(message.data, transferBuffer + (u32)chunkIndex * CHUNK_SIZE, length);
+
+    //Each chunk is only sent to the receivers that miss it, a broadcast would flood the whole mesh
+    u8 sentCount = 0;
+    for (u32 i = 0; i < receiverCount; i++)
+    {
+        if (receivers[i].status != BulkTransferStatus::IN_PROGRESS
+            || !IsChunkMissingAtReceiver(chunkIndex, receivers[i].nextChunkIndex, receivers[i].receivedBitmap))
+        {
+            continue;
+        }
+
+        SendModuleActionMessage(
+            MessageType::MODULE_TRIGGER_ACTION,
+            receivers[i].nodeId,
+            (u8)BulkModuleTriggerActionMessages::CHUNK,
+            0,
+            (u8*)&message,
+            SIZEOF_BULK_MODULE_CHUNK_MESSAGE_HEADER + length,
+            false
+        );
+        sentCount++;
+    }
+
+    chunkSentDs[chunkIndex % MAX_WINDOW_SIZE] = GS->appTimerDs;
+    return sentCount;
+}
+
+u16 BulkModule::GetWindowBase() const
+{
+    //The window can only move on once the slowest receiver has received its first chunk
+    u16 base = numChunks;
+    for (u32 i = 0; i < receiverCount; i++)
+    {
+        if (receivers[i].status == BulkTransferStatus::IN_PROGRESS && receivers[i].nextChunkIndex < base)
+        {
+            base = receivers[i].nextChunkIndex;
+        }
+    }
+    return base;
+}
+
+bool BulkModule::IsChunkMissing(u16 chunkIndex) const
+{
+    for (u32 i = 0; i < receiverCount; i++)
+    {
+        if (receivers[i].status == BulkTransferStatus::IN_PROGRESS
+            && IsChunkMissingAtReceiver(chunkIndex, receivers[i].nextChunkIndex, receivers[i].receivedBitmap))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void BulkModule::SendNewChunks()
+{
+    const u32 windowEnd = (u32)GetWindowBase() + configuration.windowSize;
+    const u32 limit = windowEnd < numChunks ? windowEnd : numChunks;
+
+    //A resumed transfer skips the chunks that all receivers reported in their bitmap
+    while (nextNewChunkIndex < limit)
+    {
+        if (IsChunkMissing(nextNewChunkIndex))
+        {
+            chunksSent += SendChunk(nextNewChunkIndex);
+        }
+        nextNewChunkIndex++;
+    }
+}
+
+void BulkModule::RetransmitMissingChunks(u32 minAgeDs, u16 untilChunkIndex)
+{
+    for (u16 chunkIndex = GetWindowBase(); chunkIndex < untilChunkIndex && chunkIndex < nextNewChunkIndex; chunkIndex++)
+    {
+        if (IsChunkMissing(chunkIndex) && GS->appTimerDs - chunkSentDs[chunkIndex % MAX_WINDOW_SIZE] >= minAgeDs)
+        {
+            logt("BULK", "Retransmitting chunk %u", chunkIndex);
+            const u8 sentCount = SendChunk(chunkIndex);
+            chunksRetransmitted += sentCount;
+            chunksSent += sentCount;
+        }
+    }
+}
+
+void BulkModule::HandleAck(NodeId sender, const BulkModuleAckMessage& ack)
+{
+    if (!sending || ack.transferId != transferId) return;
+
+    ReceiverState* receiver = nullptr;
+    for (u32 i = 0; i < receiverCount; i++)
+    {
+        if (receivers[i].nodeId == sender) receiver = &receivers[i];
+    }
+    if (receiver == nullptr || receiver->status != BulkTransferStatus::IN_PROGRESS) return;
+
+    //Acks might overtake each other, an older one must not move the receiver back
+    if (receiver->started && ack.nextChunkIndex < receiver->nextChunkIndex) return;
+
+    if (!receiver->started || ack.nextChunkIndex > receiver->nextChunkIndex || ack.status != receiver->status)
+    {
+        lastProgressDs = GS->appTimerDs;
+    }
+    receiver->started = true;
+    receiver->nextChunkIndex = ack.nextChunkIndex;
+    receiver->receivedBitmap = ack.receivedBitmap;
+    receiver->status = ack.status;
+
+    FinishSendingIfDone();
+    if (!sending) return;
+
+    for (u32 i = 0; i < receiverCount; i++)
+    {
+        if (!receivers[i].started && receivers[i].status == BulkTransferStatus::IN_PROGRESS) return;
+    }
+
+    //A receiver that resumes a transfer reports where it stopped
+    const u16 base = GetWindowBase();
+    if (nextNewChunkIndex < base) nextNewChunkIndex = base;
+
+    //Chunks before the highest acknowledged one are missing for sure, no need to wait for the timeout
+    if (ack.receivedBitmap != 0)
+    {
+        u32 highestBit = 31;
+        while ((ack.receivedBitmap & (1UL << highestBit)) == 0) highestBit--;
+        RetransmitMissingChunks(FAST_RETRANSMIT_GUARD_DS, ack.nextChunkIndex + 1 + highestBit);
+    }
+
+    SendNewChunks();
+}
+
+void BulkModule::FinishSendingIfDone()
+{
+    for (u32 i = 0; i < receiverCount; i++)
+    {
+        if (receivers[i].status == BulkTransferStatus::IN_PROGRESS) return;
+    }
+
+    sending = false;
+
+    for (u32 i = 0; i < receiverCount; i++)
+    {
+        logjson("BULK", "{\"nodeId\":%u,\"type\":\"bulk_transfer_result\",\"receiver\":%u,\"transferId\":%u,\"code\":%u,\"module\":%u}" SEP, GS->node.configuration.nodeId, receivers[i].nodeId, transferId, (u32)receivers[i].status, (u8)moduleId);
+    }
+    logjson_partial("BULK", "{\"nodeId\":%u,\"type\":\"bulk_transfer_done\",\"transferId\":%u,\"size\":%u,", GS->node.configuration.nodeId, transferId, totalSize);
+    logjson("BULK", "\"timeDs\":%u,\"chunksSent\":%u,\"chunksRetransmitted\":%u,\"module\":%u}" SEP, GS->appTimerDs - sendStartDs, chunksSent, chunksRetransmitted, (u8)moduleId);
+}
+
+#define _____________RECEIVING_____________
+
+bool BulkModule::IsChunkReceived(u16 chunkIndex) const
+{
+    return (receivedChunks[chunkIndex / 8] & (1 << (chunkIndex % 8))) != 0;
+}
+
+void BulkModule::HandleStart(NodeId sender, const BulkModuleStartMessage& start)
+{
+    BulkTransferStatus rejection = BulkTransferStatus::IN_PROGRESS;
+    if (start.totalSize == 0 || start.totalSize > MAX_TRANSFER_SIZE)
+    {
+        rejection = BulkTransferStatus::TOO_LARGE;
+    }
+    //Another transfer is still running and has not stalled
+    else if (sending
+        || (receiving && receiveStatus == BulkTransferStatus::IN_PROGRESS && (senderId != sender || transferId != start.transferId) && GS->appTimerDs - lastProgressDs <= TRANSFER_TIMEOUT_DS))
+    {
+        rejection = BulkTransferStatus::BUSY;
+    }
+
+    if (rejection != BulkTransferStatus::IN_PROGRESS)
+    {
+        logt("BULK", "Rejecting transfer %u from %u: %u", start.transferId, sender, (u32)rejection);
+
+        BulkModuleAckMessage message;
+        CheckedMemset(&message, 0x00, sizeof(message));
+        message.transferId = start.transferId;
+        message.status = rejection;
+
+        SendModuleActionMessage(
+            MessageType::MODULE_ACTION_RESPONSE,
+            sender,
+            (u8)BulkModuleActionResponseMessages::ACK,
+            0,
+            (u8*)&message,
+            SIZEOF_BULK_MODULE_ACK_MESSAGE,
+            false
+        );
+        return;
+    }
+
+    //The same blob is kept so that an interrupted transfer resumes with the chunks that are still missing
+    const bool resume = (receiveStatus == BulkTransferStatus::IN_PROGRESS || receiveStatus == BulkTransferStatus::ABORTED)
+        && senderId == sender
+        && transferId == start.transferId
+        && totalSize == start.totalSize
+        && crc32 == start.crc32;
+
+    if (!resume)
+    {
+        senderId = sender;
+        transferId = start.transferId;
+        totalSize = start.totalSize;
+        crc32 = start.crc32;
+        numChunks = (totalSize + CHUNK_SIZE - 1) / CHUNK_SIZE;
+        CheckedMemset(receivedChunks, 0x00, sizeof(receivedChunks));
+        receiveNextChunkIndex = 0;
+    }
+    receiveStatus = BulkTransferStatus::IN_PROGRESS;
+
+    logt("BULK", "Receiving transfer %u from %u, resuming at chunk %u", transferId, senderId, receiveNextChunkIndex);
+
+    receiving = true;
+    lastProgressDs = GS->appTimerDs;
+    SendAck();
+}
+
+void BulkModule::HandleChunk(NodeId sender, BulkModuleChunkMessage const * chunk, u16 dataLength)
+{
+    if (!receiving || senderId != sender || chunk->transferId != transferId) return;
+
+    //The sender has not seen our final ack yet
+    if (receiveStatus != BulkTransferStatus::IN_PROGRESS)
+    {
+        if (chunksSinceAck == 0) firstUnackedChunkDs = GS->appTimerDs;
+        chunksSinceAck++;
+        return;
+    }
+
+    if (chunk->chunkIndex >= numChunks || dataLength != GetChunkLength(chunk->chunkIndex))
+    {
+        logt("BULK", "Malformed chunk %u with length %u", chunk->chunkIndex, dataLength);
+        SIMEXCEPTION(IllegalArgumentException);
+        return;
+    }
+
+    lastProgressDs = GS->appTimerDs;
+    if (!IsChunkReceived(chunk->chunkIndex))
+    {
+        CheckedMemcpy(transferBuffer + (u32)chunk->chunkIndex * CHUNK_SIZE, chunk->data, dataLength);
+        receivedChunks[chunk->chunkIndex / 8] |= 1 << (chunk->chunkIndex % 8);
+    }
+
+    if (chunksSinceAck == 0) firstUnackedChunkDs = GS->appTimerDs;
+    chunksSinceAck++;
+
+    //A chunk that arrives after a gap is reported immediately so that the sender can fill the gap
+    const bool gap = chunk->chunkIndex > receiveNextChunkIndex;
+
+    while (receiveNextChunkIndex < numChunks && IsChunkReceived(receiveNextChunkIndex))
+    {
+        receiveNextChunkIndex++;
+    }
+
+    if (receiveNextChunkIndex == numChunks)
+    {
+        receiveStatus = Utility::CalculateCrc32(transferBuffer, totalSize) == crc32 ? BulkTransferStatus::COMPLETE : BulkTransferStatus::CRC_MISMATCH;
+
+        logjson("BULK", "{\"nodeId\":%u,\"type\":\"bulk_transfer_received\",\"sender\":%u,\"transferId\":%u,\"size\":%u,\"code\":%u,\"module\":%u}" SEP, GS->node.configuration.nodeId, senderId, transferId, totalSize, (u32)receiveStatus, (u8)moduleId);
+
+        SendAck();
+    }
+    else if (gap || chunksSinceAck >= (configuration.windowSize + 1) / 2)
+    {
+        SendAck();
+    }
+}
+
+void BulkModule::SendAck()
+{
+    BulkModuleAckMessage message;
+    CheckedMemset(&message, 0x00, sizeof(message));
+    message.transferId = transferId;
+    message.nextChunkIndex = receiveNextChunkIndex;
+    message.status = receiveStatus;
+    for (u32 i = 0; i < 32; i++)
+    {
+        const u32 chunkIndex = (u32)receiveNextChunkIndex + 1 + i;
+        if (chunkIndex < numChunks && IsChunkReceived(chunkIndex)) message.receivedBitmap |= 1UL << i;
+    }
+
+    SendModuleActionMessage(
+        MessageType::MODULE_ACTION_RESPONSE,
+        senderId,
+        (u8)BulkModuleActionResponseMessages::ACK,
+        0,
+        (u8*)&message,
+        SIZEOF_BULK_MODULE_ACK_MESSAGE,
+        false
+    );
+
+    chunksSinceAck = 0;
+}
+
+const u8* BulkModule::GetTransferBuffer() const
+{
+    return transferBuffer;
+}
+
+bool BulkModule::IsSending() const
+{
+    return sending;
+}
+
+BulkTransferStatus BulkModule::GetReceiveStatus() const
+{
+    return receiveStatus;
+}
+
+u16 BulkModule::GetReceivedChunkCount() const
+{
+    return receiveNextChunkIndex;
+}
+
+u32 BulkModule::GetChunksSent() const
+{
+    return chunksSent;
+}
+
+u32 BulkModule::GetChunksRetransmitted() const
+{
+    return chunksRetransmitted;
+}
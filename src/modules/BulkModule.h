@@ -0,0 +1,218 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH.
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <Module.h>
+
+#pragma pack(push, 1)
+//Module configuration that is saved persistently
+struct BulkModuleConfiguration : ModuleConfiguration {
+    u8 windowSize; //Amount of chunks that may be in flight without being acknowledged
+};
+STATIC_ASSERT_SIZE(BulkModuleConfiguration, 5);
+#pragma pack(pop)
+
+enum class BulkTransferStatus : u8 {
+    IN_PROGRESS  = 0,
+    COMPLETE     = 1,
+    CRC_MISMATCH = 2,
+    TOO_LARGE    = 3,
+    BUSY         = 4,
+    TIMEOUT      = 5, //Only reported locally by the sender
+    ABORTED      = 6,
+};
+
+/**
+ * The BulkModule transfers larger blobs such as configuration bundles from one node
+ * to one or many other nodes. Chunks are sent in a sliding window and the receivers
+ * acknowledge them selectively so that only missing chunks are retransmitted. If a
+ * transfer is started again, the receivers report what they already have and the
+ * transfer resumes from there.
+ */
+class BulkModule: public Module
+{
+    public:
+        enum class BulkModuleTriggerActionMessages : u8{
+            START = 0,
+            CHUNK = 1,
+            ABORT = 2,
+        };
+
+        enum class BulkModuleActionResponseMessages : u8{
+            ACK = 0,
+        };
+
+        //Chunks and the ack bitmap are limited so that a chunk fits into a single mesh packet
+        static constexpr u32 CHUNK_SIZE = 128;
+        static constexpr u32 MAX_TRANSFER_SIZE = 4096;
+        static constexpr u32 MAX_CHUNKS = MAX_TRANSFER_SIZE / CHUNK_SIZE;
+        static constexpr u8 MAX_WINDOW_SIZE = 32;
+        static constexpr u8 DEFAULT_WINDOW_SIZE = 8;
+        static constexpr u8 MAX_RECEIVERS = 4;
+
+        //####### Module messages (these need to be packed)
+        #pragma pack(push)
+        #pragma pack(1)
+
+            static constexpr int SIZEOF_BULK_MODULE_START_MESSAGE = 10;
+            struct BulkModuleStartMessage
+            {
+                u16 transferId;
+                u32 totalSize;
+                u32 crc32;
+            };
+            STATIC_ASSERT_SIZE(BulkModuleStartMessage, SIZEOF_BULK_MODULE_START_MESSAGE);
+
+            static constexpr int SIZEOF_BULK_MODULE_CHUNK_MESSAGE_HEADER = 4;
+            struct BulkModuleChunkMessage
+            {
+                u16 transferId;
+                u16 chunkIndex;
+                u8 data[CHUNK_SIZE]; //The last chunk may be shorter
+            };
+            STATIC_ASSERT_SIZE(BulkModuleChunkMessage, SIZEOF_BULK_MODULE_CHUNK_MESSAGE_HEADER + CHUNK_SIZE);
+
+            static constexpr int SIZEOF_BULK_MODULE_ABORT_MESSAGE = 2;
+            struct BulkModuleAbortMessage
+            {
+                u16 transferId;
+            };
+            STATIC_ASSERT_SIZE(BulkModuleAbortMessage, SIZEOF_BULK_MODULE_ABORT_MESSAGE);
+
+            static constexpr int SIZEOF_BULK_MODULE_ACK_MESSAGE = 9;
+            struct BulkModuleAckMessage
+            {
+                u16 transferId;
+                u16 nextChunkIndex; //All chunks below this index were received, this is also the offset to resume from
+                u32 receivedBitmap; //Bit i is set if chunk nextChunkIndex + 1 + i was received
+                BulkTransferStatus status;
+            };
+            STATIC_ASSERT_SIZE(BulkModuleAckMessage, SIZEOF_BULK_MODULE_ACK_MESSAGE);
+
+        #pragma pack(pop)
+        //####### Module messages end
+
+    private:
+        static constexpr u32 START_RETRY_DS = SEC_TO_DS(2);
+        //A chunk that is missing is sent again after this time, or earlier if a later chunk was acknowledged
+        static constexpr u32 RETRANSMIT_TIMEOUT_DS = SEC_TO_DS(4);
+        static constexpr u32 FAST_RETRANSMIT_GUARD_DS = SEC_TO_DS(1);
+        static constexpr u32 ACK_DELAY_DS = 5;
+        static constexpr u32 TRANSFER_TIMEOUT_DS = SEC_TO_DS(30);
+
+        //Shared between sending and receiving as a node only takes part in one transfer at a time
+        u8 transferBuffer[MAX_TRANSFER_SIZE];
+
+        u16 transferId = 0;
+        u32 totalSize = 0;
+        u32 crc32 = 0;
+        u16 numChunks = 0;
+        u32 lastProgressDs = 0;
+
+        //Sender state
+        struct ReceiverState {
+            NodeId nodeId;
+            bool started;
+            u16 nextChunkIndex;
+            u32 receivedBitmap;
+            BulkTransferStatus status;
+        };
+        bool sending = false;
+        ReceiverState receivers[MAX_RECEIVERS];
+        u8 receiverCount = 0;
+        u16 nextNewChunkIndex = 0;
+        u32 chunkSentDs[MAX_WINDOW_SIZE];
+        u32 lastStartSentDs = 0;
+        u32 sendStartDs = 0;
+        u32 chunksSent = 0;
+        u32 chunksRetransmitted = 0;
+
+        //Receiver state
+        bool receiving = false;
+        NodeId senderId = NODE_ID_INVALID;
+        u8 receivedChunks[MAX_CHUNKS / 8];
+        u16 receiveNextChunkIndex = 0;
+        u16 chunksSinceAck = 0;
+        u32 firstUnackedChunkDs = 0;
+        BulkTransferStatus receiveStatus = BulkTransferStatus::IN_PROGRESS;
+
+        bool IsChunkReceived(u16 chunkIndex) const;
+        u16 GetChunkLength(u16 chunkIndex) const;
+        u16 GetWindowBase() const;
+        bool IsChunkMissing(u16 chunkIndex) const;
+
+        void SendStart();
+        //Returns the amount of receivers that the chunk was sent to
+        u8 SendChunk(u16 chunkIndex);
+        void SendNewChunks();
+        void RetransmitMissingChunks(u32 minAgeDs, u16 untilChunkIndex);
+        void HandleAck(NodeId sender, const BulkModuleAckMessage& ack);
+        void FinishSendingIfDone();
+
+        void HandleStart(NodeId sender, const BulkModuleStartMessage& start);
+        void HandleChunk(NodeId sender, BulkModuleChunkMessage const * chunk, u16 dataLength);
+        void SendAck();
+
+    public:
+        DECLARE_CONFIG_AND_PACKED_STRUCT(BulkModuleConfiguration);
+
+        BulkModule();
+
+        void ConfigurationLoadedHandler(u8* migratableConfig, u16 migratableConfigLength) override final;
+
+        void ResetToDefaultConfiguration() override final;
+
+        void TimerEventHandler(u16 passedTimeDs) override final;
+
+        void MeshMessageReceivedHandler(BaseConnection* connection, BaseConnectionSendData* sendData, ConnPacketHeader const * packetHeader) override final;
+
+        //Bulk data is transmitted with a low priority so that it does not delay the mesh traffic
+        virtual DeliveryPriority GetPriorityOfMessage(const u8* data, MessageLength size) override;
+
+        #ifdef TERMINAL_ENABLED
+        TerminalCommandHandlerReturnType TerminalCommandHandler(const char* commandArgs[], u8 commandArgsSize) override final;
+        #endif
+
+        //Writes data that should be sent into the transfer buffer
+        bool WriteTransferData(u32 offset, const u8* data, u32 dataLength);
+
+        //Starts sending the first totalSize bytes of the transfer buffer to the given nodes
+        ErrorType StartTransfer(u16 transferId, u32 totalSize, const NodeId* receiverIds, u8 receiverCount);
+
+        void AbortTransfer();
+
+        const u8* GetTransferBuffer() const;
+        bool IsSending() const;
+        BulkTransferStatus GetReceiveStatus() const;
+        u16 GetReceivedChunkCount() const;
+        u32 GetChunksSent() const;
+        u32 GetChunksRetransmitted() const;
+};
@@ -774,7 +774,16 @@ TerminalCommandHandlerReturnType DebugModule::TerminalCommandHandler(const char*
 
         for (u32 i = 0; i < advCtrl->currentNumJobs; i++) {
             Logger::ConvertBufferToHexString(advCtrl->jobs[i].advData, advCtrl->jobs[i].advDataLength, buffer, sizeof(buffer));
-            trace("Job type:%u, slots:%u, iv:%u, advData:%s" EOL, (u32)advCtrl->jobs[i].type, advCtrl->jobs[i].slots, advCtrl->jobs[i].advertisingInterval, buffer);
+            trace("Job type:%u, slots:%u, iv:%u, target:%u, staleness:%u, advertised:%u, achieved:%u, misses:%u, advData:%s" EOL,
+                (u32)advCtrl->jobs[i].type,
+                advCtrl->jobs[i].slots,
+                advCtrl->jobs[i].advertisingInterval,
+                AdvertisingController::GetTargetIntervalDs(advCtrl->jobs[i]),
+                advCtrl->jobs[i].maxStalenessDs,
+                advCtrl->jobs[i].numAdvertisedSlots,
+                advCtrl->GetAchievedIntervalDs(advCtrl->jobs[i]),
+                advCtrl->jobs[i].numDeadlineMisses,
+                buffer);
         }
 
         return TerminalCommandHandlerReturnType::SUCCESS;
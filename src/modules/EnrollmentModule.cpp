@@ -54,6 +54,11 @@ EnrollmentModule::EnrollmentModule()
     : Module(ModuleId::ENROLLMENT_MODULE, "enroll")
 {
     CheckedMemset(&requestProposalIndices, 0xFF, sizeof(requestProposalIndices));
+#if IS_ACTIVE(BULK_ENROLLMENT)
+    CheckedMemset(&bulkEnrollmentTemplate, 0x00, sizeof(bulkEnrollmentTemplate));
+    CheckedMemset(&bulkEnrollmentSlots, 0x00, sizeof(bulkEnrollmentSlots));
+    ClearBulkEnrollment();
+#endif
 
     //Save configuration to base class variables
     //sizeof configuration must be a multiple of 4 bytes
@@ -134,6 +139,10 @@ void EnrollmentModule::TimerEventHandler(u16 passedTimeDs)
             EnrollmentConnectionConnectedHandler();
         }
     }
+
+#if IS_ACTIVE(BULK_ENROLLMENT)
+    ProcessBulkEnrollment();
+#endif
 }
 
 DeliveryPriority EnrollmentModule::GetPriorityOfMessage(const u8* data, MessageLength size)
@@ -155,6 +164,111 @@ DeliveryPriority EnrollmentModule::GetPriorityOfMessage(const u8* data, MessageL
 #ifdef TERMINAL_ENABLED
 TerminalCommandHandlerReturnType EnrollmentModule::TerminalCommandHandler(const char* commandArgs[], u8 commandArgsSize)
 {
+#if IS_ACTIVE(BULK_ENROLLMENT)
+    //Commands for the bulk enrollment that is coordinated by this node
+    if (commandArgsSize >= 2 && TERMARGS(0, moduleName))
+    {
+        if (TERMARGS(1, "bulk_start"))
+        {
+            //enroll bulk_start [newNetworkId] {newNetworkKey} {newUserBaseKey} {newOrganizationKey} {timeoutSec}
+            if (commandArgsSize < 3) return TerminalCommandHandlerReturnType::NOT_ENOUGH_ARGUMENTS;
+
+            bool didError = false;
+            CheckedMemset(&bulkEnrollmentTemplate, 0x00, sizeof(bulkEnrollmentTemplate));
+            bulkEnrollmentTemplate.newNetworkId = Utility::StringToU16(commandArgs[2], &didError);
+            if (bulkEnrollmentTemplate.newNetworkId <= 1) return TerminalCommandHandlerReturnType::WRONG_ARGUMENT;
+            if (commandArgsSize > 3) {
+                Logger::ParseEncodedStringToBuffer(commandArgs[3], bulkEnrollmentTemplate.newNetworkKey.data(), 16);
+            }
+            if (commandArgsSize > 4) {
+                Logger::ParseEncodedStringToBuffer(commandArgs[4], bulkEnrollmentTemplate.newUserBaseKey.data(), 16);
+            }
+            if (commandArgsSize > 5) {
+                Logger::ParseEncodedStringToBuffer(commandArgs[5], bulkEnrollmentTemplate.newOrganizationKey.data(), 16);
+            }
+            bulkEnrollmentTemplate.timeoutSec = commandArgsSize > 6 ? Utility::StringToU8(commandArgs[6], &didError) : 10;
+            if (didError || bulkEnrollmentTemplate.timeoutSec == 0) return TerminalCommandHandlerReturnType::WRONG_ARGUMENT;
+
+            ClearBulkEnrollment();
+            bulkEnrollmentActive = true;
+            bulkEnrollmentStartDs = GS->appTimerDs;
+
+            return TerminalCommandHandlerReturnType::SUCCESS;
+        }
+        else if (TERMARGS(1, "bulk_enrollers"))
+        {
+            //enroll bulk_enrollers [nodeId] {nodeId} ... (up to BULK_ENROLLMENT_MAX_ENROLLERS)
+            if (commandArgsSize < 3) return TerminalCommandHandlerReturnType::NOT_ENOUGH_ARGUMENTS;
+            if (commandArgsSize - 2 > BULK_ENROLLMENT_MAX_ENROLLERS) return TerminalCommandHandlerReturnType::WRONG_ARGUMENT;
+            if (GetBulkEnrollmentsInFlight() != 0) return TerminalCommandHandlerReturnType::WRONG_ARGUMENT;
+
+            bool didError = false;
+            BulkEnrollmentSlot slots[BULK_ENROLLMENT_MAX_ENROLLERS];
+            CheckedMemset(slots, 0x00, sizeof(slots));
+            for (u32 i = 0; i < (u32)commandArgsSize - 2; i++)
+            {
+                slots[i].enrollerId = Utility::StringToU16(commandArgs[i + 2], &didError);
+                slots[i].entry.serialNumberIndex = INVALID_SERIAL_NUMBER_INDEX;
+                if (slots[i].enrollerId == NODE_ID_BROADCAST) didError = true;
+            }
+            if (didError) return TerminalCommandHandlerReturnType::WRONG_ARGUMENT;
+
+            CheckedMemcpy(bulkEnrollmentSlots, slots, sizeof(slots));
+            bulkEnrollmentSlotCount = commandArgsSize - 2;
+
+            //The enroller masks refer to the slot indices of the previous list
+            for (u32 i = 0; i < bulkEnrollmentQueueCount; i++)
+            {
+                bulkEnrollmentQueue[i].enrollerMask = 0;
+            }
+
+            return TerminalCommandHandlerReturnType::SUCCESS;
+        }
+        else if (TERMARGS(1, "bulk_add"))
+        {
+            //enroll bulk_add [serialNumber] [newNodeId] {nodeKey}
+            if (commandArgsSize < 4) return TerminalCommandHandlerReturnType::NOT_ENOUGH_ARGUMENTS;
+            if (!bulkEnrollmentActive) return TerminalCommandHandlerReturnType::WRONG_ARGUMENT;
+
+            bool didError = false;
+            BulkEnrollmentEntry entry;
+            CheckedMemset(&entry, 0x00, sizeof(entry));
+            entry.serialNumberIndex = Utility::GetIndexForSerial(commandArgs[2], &didError);
+            entry.newNodeId = Utility::StringToU16(commandArgs[3], &didError);
+            if (commandArgsSize > 4) {
+                Logger::ParseEncodedStringToBuffer(commandArgs[4], entry.nodeKey.data(), 16);
+            }
+            if (didError || entry.newNodeId == 0) return TerminalCommandHandlerReturnType::WRONG_ARGUMENT;
+
+            //The gateway has to wait for a bulk_enroll_result before it can add more nodes
+            if (GetBulkEnrollmentFreeQueueSlots() == 0)
+            {
+                logjson("ENROLLMOD", "{\"type\":\"bulk_enroll_queue_full\",\"serialNumber\":\"%s\",\"module\":%u}" SEP, commandArgs[2], (u8)ModuleId::ENROLLMENT_MODULE);
+                return TerminalCommandHandlerReturnType::SUCCESS;
+            }
+
+            bulkEnrollmentQueue[bulkEnrollmentQueueCount] = entry;
+            bulkEnrollmentQueueCount++;
+
+            return TerminalCommandHandlerReturnType::SUCCESS;
+        }
+        else if (TERMARGS(1, "bulk_stop"))
+        {
+            LogBulkEnrollmentStatus();
+            bulkEnrollmentActive = false;
+            ClearBulkEnrollment();
+
+            return TerminalCommandHandlerReturnType::SUCCESS;
+        }
+        else if (TERMARGS(1, "bulk_status"))
+        {
+            LogBulkEnrollmentStatus();
+
+            return TerminalCommandHandlerReturnType::SUCCESS;
+        }
+    }
+#endif
+
     //React on commands, return true if handled, false otherwise
     if(commandArgsSize >= 3 && TERMARGS(2 ,moduleName))
     {
@@ -471,6 +585,13 @@ void EnrollmentModule::MeshMessageReceivedHandler(BaseConnection* connection, Ba
 
                 logjson_partial("ENROLLMOD", "{\"nodeId\":%u,\"type\":\"%s\",\"module\":%u,", packet->header.sender, cmdName, (u8)ModuleId::ENROLLMENT_MODULE);
                 logjson("ENROLLMOD", "\"requestId\":%u,\"serialNumber\":\"%s\",\"code\":%u}" SEP,  packet->requestHandle, serialNumber, (u32)data->result);
+
+#if IS_ACTIVE(BULK_ENROLLMENT)
+                if (actionType == EnrollmentModuleActionResponseMessages::ENROLLMENT_RESPONSE)
+                {
+                    HandleBulkEnrollmentResponse(packet->header.sender, data->serialNumberIndex, data->result);
+                }
+#endif
             }
             else if(actionType == EnrollmentModuleActionResponseMessages::ENROLLMENT_PROPOSAL)
             {
@@ -998,6 +1119,206 @@ void EnrollmentModule::SendEnrollmentResponse(EnrollmentModuleActionResponseMess
     );
 }
 
+#if IS_ACTIVE(BULK_ENROLLMENT)
+#define _____________BULK_ENROLLMENT_____________
+
+void EnrollmentModule::ProcessBulkEnrollment()
+{
+    if (!bulkEnrollmentActive) return;
+
+    for (u32 i = 0; i < bulkEnrollmentSlotCount; i++)
+    {
+        BulkEnrollmentSlot& slot = bulkEnrollmentSlots[i];
+
+        //The enroller did not report back in time, e.g. because it could not see the node
+        if (slot.entry.serialNumberIndex != INVALID_SERIAL_NUMBER_INDEX && GS->appTimerDs > slot.deadlineDs)
+        {
+            logt("ENROLLMOD", "Bulk enrollment of %u via %u timed out", slot.entry.serialNumberIndex, slot.enrollerId);
+
+            const BulkEnrollmentEntry entry = slot.entry;
+            slot.entry.serialNumberIndex = INVALID_SERIAL_NUMBER_INDEX;
+            FinishBulkEnrollmentAttempt(entry, entry.lateOk ? EnrollmentResponseCode::OK : EnrollmentResponseCode::BULK_ENROLLMENT_TIMEOUT);
+        }
+
+        if (slot.entry.serialNumberIndex == INVALID_SERIAL_NUMBER_INDEX)
+        {
+            DispatchBulkEnrollment(slot);
+        }
+    }
+}
+
+void EnrollmentModule::DispatchBulkEnrollment(BulkEnrollmentSlot& slot)
+{
+    if (bulkEnrollmentQueueCount == 0) return;
+
+    //Prefer an enrollment that was not already tried by this enroller so that
+    //retries are spread among the enrollers that are located elsewhere
+    const u8 slotBit = (u8)(1 << (&slot - bulkEnrollmentSlots));
+    u32 index = 0;
+    for (u32 i = 0; i < bulkEnrollmentQueueCount; i++)
+    {
+        if ((bulkEnrollmentQueue[i].enrollerMask & slotBit) == 0)
+        {
+            index = i;
+            break;
+        }
+    }
+
+    slot.entry = bulkEnrollmentQueue[index];
+    for (u32 i = index; i + 1 < bulkEnrollmentQueueCount; i++)
+    {
+        bulkEnrollmentQueue[i] = bulkEnrollmentQueue[i + 1];
+    }
+    bulkEnrollmentQueueCount--;
+
+    slot.entry.attempts++;
+    slot.entry.enrollerMask |= slotBit;
+    slot.deadlineDs = GS->appTimerDs + SEC_TO_DS(bulkEnrollmentTemplate.timeoutSec) + BULK_ENROLLMENT_RESPONSE_MARGIN_DS;
+
+    EnrollmentModuleSetEnrollmentBySerialMessage message = bulkEnrollmentTemplate;
+    message.serialNumberIndex = slot.entry.serialNumberIndex;
+    message.newNodeId = slot.entry.newNodeId;
+    message.nodeKey = slot.entry.nodeKey;
+
+    logt("ENROLLMOD", "Bulk enrollment of %u via %u, attempt %u", message.serialNumberIndex, slot.enrollerId, slot.entry.attempts);
+
+    SendModuleActionMessage(
+        MessageType::MODULE_TRIGGER_ACTION,
+        slot.enrollerId,
+        (u8)EnrollmentModuleTriggerActionMessages::SET_ENROLLMENT_BY_SERIAL,
+        0,
+        (u8*)&message,
+        SIZEOF_ENROLLMENT_MODULE_SET_ENROLLMENT_BY_SERIAL_MESSAGE,
+        false
+    );
+}
+
+void EnrollmentModule::HandleBulkEnrollmentResponse(NodeId sender, u32 serialIndex, EnrollmentResponseCode result)
+{
+    if (!bulkEnrollmentActive) return;
+
+    for (u32 i = 0; i < bulkEnrollmentSlotCount; i++)
+    {
+        BulkEnrollmentSlot& slot = bulkEnrollmentSlots[i];
+        if (slot.entry.serialNumberIndex != serialIndex) continue;
+
+        if (slot.enrollerId == sender)
+        {
+            const BulkEnrollmentEntry entry = slot.entry;
+            slot.entry.serialNumberIndex = INVALID_SERIAL_NUMBER_INDEX;
+            //The current enroller will usually not find the node anymore if a previous one enrolled it
+            FinishBulkEnrollmentAttempt(entry, entry.lateOk ? EnrollmentResponseCode::OK : result);
+
+            //Hand the next enrollment to this enroller right away instead of waiting for the timer
+            DispatchBulkEnrollment(slot);
+        }
+        else if (result == EnrollmentResponseCode::OK && IsBulkEnroller(sender, slot.entry.enrollerMask))
+        {
+            //A previous enroller succeeded late, the current dispatch is kept until it answers or times out
+            //as its enroller might still be connected to the node
+            slot.entry.lateOk = true;
+        }
+        return;
+    }
+
+    //A late answer for an enrollment that has already timed out and is waiting for its retry
+    if (result != EnrollmentResponseCode::OK) return;
+    for (u32 i = 0; i < bulkEnrollmentQueueCount; i++)
+    {
+        if (bulkEnrollmentQueue[i].serialNumberIndex == serialIndex && IsBulkEnroller(sender, bulkEnrollmentQueue[i].enrollerMask))
+        {
+            const BulkEnrollmentEntry entry = bulkEnrollmentQueue[i];
+            for (u32 k = i; k + 1 < bulkEnrollmentQueueCount; k++)
+            {
+                bulkEnrollmentQueue[k] = bulkEnrollmentQueue[k + 1];
+            }
+            bulkEnrollmentQueueCount--;
+            FinishBulkEnrollmentAttempt(entry, result);
+            return;
+        }
+    }
+}
+
+bool EnrollmentModule::IsBulkEnroller(NodeId nodeId, u8 enrollerMask) const
+{
+    for (u32 i = 0; i < bulkEnrollmentSlotCount; i++)
+    {
+        if (bulkEnrollmentSlots[i].enrollerId == nodeId && (enrollerMask & (1 << i)) != 0) return true;
+    }
+    return false;
+}
+
+void EnrollmentModule::FinishBulkEnrollmentAttempt(const BulkEnrollmentEntry& entry, EnrollmentResponseCode result)
+{
+    //Failed attempts are queued again, there is always space as the queue length includes the enrollments in flight
+    if (result != EnrollmentResponseCode::OK && entry.attempts < BULK_ENROLLMENT_MAX_ATTEMPTS)
+    {
+        bulkEnrollmentQueue[bulkEnrollmentQueueCount] = entry;
+        bulkEnrollmentQueueCount++;
+        return;
+    }
+
+    if (result == EnrollmentResponseCode::OK) bulkEnrolledCount++;
+    else bulkFailedCount++;
+    bulkEnrollmentLastResultDs = GS->appTimerDs;
+
+    char serialNumber[NODE_SERIAL_NUMBER_MAX_CHAR_LENGTH];
+    Utility::GenerateBeaconSerialForIndex(entry.serialNumberIndex, serialNumber);
+
+    logjson_partial("ENROLLMOD", "{\"type\":\"bulk_enroll_result\",\"serialNumber\":\"%s\",\"code\":%u,\"attempts\":%u,", serialNumber, (u32)result, entry.attempts);
+    logjson("ENROLLMOD", "\"enrolled\":%u,\"failed\":%u,\"free\":%u,\"module\":%u}" SEP, bulkEnrolledCount, bulkFailedCount, GetBulkEnrollmentFreeQueueSlots(), (u8)ModuleId::ENROLLMENT_MODULE);
+}
+
+u8 EnrollmentModule::GetBulkEnrollmentsInFlight() const
+{
+    u8 inFlight = 0;
+    for (u32 i = 0; i < bulkEnrollmentSlotCount; i++)
+    {
+        if (bulkEnrollmentSlots[i].entry.serialNumberIndex != INVALID_SERIAL_NUMBER_INDEX) inFlight++;
+    }
+    return inFlight;
+}
+
+u32 EnrollmentModule::GetBulkEnrollmentFreeQueueSlots() const
+{
+    return BULK_ENROLLMENT_QUEUE_LENGTH - bulkEnrollmentQueueCount - GetBulkEnrollmentsInFlight();
+}
+
+u16 EnrollmentModule::GetBulkEnrolledCount() const
+{
+    return bulkEnrolledCount;
+}
+
+u16 EnrollmentModule::GetBulkFailedCount() const
+{
+    return bulkFailedCount;
+}
+
+void EnrollmentModule::ClearBulkEnrollment()
+{
+    //The list of enrollers is kept so that it does not have to be given again for every batch
+    for (u32 i = 0; i < BULK_ENROLLMENT_MAX_ENROLLERS; i++)
+    {
+        bulkEnrollmentSlots[i].entry.serialNumberIndex = INVALID_SERIAL_NUMBER_INDEX;
+    }
+    bulkEnrollmentQueueCount = 0;
+    bulkEnrollmentStartDs = 0;
+    bulkEnrollmentLastResultDs = 0;
+    bulkEnrolledCount = 0;
+    bulkFailedCount = 0;
+}
+
+void EnrollmentModule::LogBulkEnrollmentStatus() const
+{
+    //Throughput is measured until the last result so that an idle queue does not distort it
+    const u32 elapsedDs = (bulkEnrollmentLastResultDs != 0 ? bulkEnrollmentLastResultDs : GS->appTimerDs) - bulkEnrollmentStartDs;
+    const u32 nodesPerTenMinutes = elapsedDs == 0 ? 0 : (u32)bulkEnrolledCount * SEC_TO_DS(600) / elapsedDs;
+
+    logjson_partial("ENROLLMOD", "{\"type\":\"bulk_enroll_status\",\"active\":%u,\"enrollers\":%u,\"queued\":%u,\"inFlight\":%u,", (u32)bulkEnrollmentActive, bulkEnrollmentSlotCount, bulkEnrollmentQueueCount, GetBulkEnrollmentsInFlight());
+    logjson("ENROLLMOD", "\"enrolled\":%u,\"failed\":%u,\"elapsedDs\":%u,\"nodesPerMinute\":%u.%u,\"module\":%u}" SEP, bulkEnrolledCount, bulkFailedCount, elapsedDs, nodesPerTenMinutes / 10, nodesPerTenMinutes % 10, (u8)ModuleId::ENROLLMENT_MODULE);
+}
+#endif
+
 #define _____________HANDLERS_____________
 
 #if IS_ACTIVE(BUTTONS)
@@ -54,6 +54,8 @@ enum class EnrollmentResponseCode : u8 {
     PREENROLLMENT_FAILED                 = 0x11,
     SIG_CONFIGURATION_INVALID            = 0x12,
     INCORRECT_NODE_ID                    = 0x13,
+    // Only reported locally by the bulk enrollment if no enroller answered in time
+    BULK_ENROLLMENT_TIMEOUT              = 0x14,
     HIGHEST_POSSIBLE_VALUE               = 0xFF,
 };
 
@@ -227,6 +229,60 @@ class EnrollmentModule: public Module
         static constexpr u32 SCAN_TIME_DS = SEC_TO_DS(60);
         void RefreshScanJob();
 
+#if IS_ACTIVE(BULK_ENROLLMENT)
+        //The bulk enrollment accepts a stream of enrollments (e.g. from a MeshGateway) and
+        //dispatches them to a number of enrolling nodes so that several MeshAccess
+        //connections are used in parallel, one per enroller.
+        static constexpr u8 BULK_ENROLLMENT_QUEUE_LENGTH = 10; //Includes the enrollments in flight
+        static constexpr u8 BULK_ENROLLMENT_MAX_ENROLLERS = 6;
+        static constexpr u8 BULK_ENROLLMENT_MAX_ATTEMPTS = 5;
+        //Time that an enroller needs on top of its scan timeout to connect, enroll and report back
+        static constexpr u32 BULK_ENROLLMENT_RESPONSE_MARGIN_DS = SEC_TO_DS(6);
+
+        struct BulkEnrollmentEntry {
+            u32 serialNumberIndex;
+            NodeId newNodeId;
+            u8 enrollerMask; //One bit per enroller slot that this enrollment was already dispatched to
+            bool lateOk; //A previous enroller reported success while the current dispatch is still running
+            u8 attempts;
+            std::array<u8, 16> nodeKey;
+        };
+
+        struct BulkEnrollmentSlot {
+            NodeId enrollerId;
+            u32 deadlineDs;
+            BulkEnrollmentEntry entry; //serialNumberIndex is INVALID_SERIAL_NUMBER_INDEX while the enroller is idle
+        };
+
+        bool bulkEnrollmentActive = false;
+        EnrollmentModuleSetEnrollmentBySerialMessage bulkEnrollmentTemplate;
+        BulkEnrollmentEntry bulkEnrollmentQueue[BULK_ENROLLMENT_QUEUE_LENGTH];
+        u8 bulkEnrollmentQueueCount = 0;
+        BulkEnrollmentSlot bulkEnrollmentSlots[BULK_ENROLLMENT_MAX_ENROLLERS];
+        u8 bulkEnrollmentSlotCount = 0;
+        u32 bulkEnrollmentStartDs = 0;
+        u32 bulkEnrollmentLastResultDs = 0;
+        u16 bulkEnrolledCount = 0;
+        u16 bulkFailedCount = 0;
+
+        void ProcessBulkEnrollment();
+
+        void DispatchBulkEnrollment(BulkEnrollmentSlot& slot);
+
+        void HandleBulkEnrollmentResponse(NodeId sender, u32 serialIndex, EnrollmentResponseCode result);
+
+        void FinishBulkEnrollmentAttempt(const BulkEnrollmentEntry& entry, EnrollmentResponseCode result);
+
+        //Checks if the node is one of the enrollers in the given mask of enroller slots
+        bool IsBulkEnroller(NodeId nodeId, u8 enrollerMask) const;
+
+        u8 GetBulkEnrollmentsInFlight() const;
+
+        void ClearBulkEnrollment();
+
+        void LogBulkEnrollmentStatus() const;
+#endif
+
         void Enroll(ConnPacketModule const * packet, MessageLength packetLength);
 
         void EnrollOverMesh(ConnPacketModule const * packet, MessageLength packetLength, BaseConnection* connection);
@@ -270,6 +326,15 @@ class EnrollmentModule: public Module
 
         void PreEnrollmentFailed();
 
+#if IS_ACTIVE(BULK_ENROLLMENT)
+        //Bulk enrollment
+        u32 GetBulkEnrollmentFreeQueueSlots() const;
+
+        u16 GetBulkEnrolledCount() const;
+
+        u16 GetBulkFailedCount() const;
+#endif
+
         //Handlers
 #if IS_ACTIVE(BUTTONS)
         void ButtonHandler(u8 buttonId, u32 holdTimeDs) override final;
@@ -454,7 +454,7 @@ void MeshAccessModule::MeshMessageReceivedHandler(BaseConnection* connection, Ba
     //this way, it will know if the cluster size changed or if a gateway is now available or not
     else if (
         packetHeader->messageType == MessageType::CLUSTER_INFO_UPDATE
-        && sendData->dataLength >= sizeof(ConnPacketClusterInfoUpdate)
+        && sendData->dataLength >= SIZEOF_CONN_PACKET_CLUSTER_INFO_UPDATE_LEGACY
     ) {
         ConnPacketClusterInfoUpdate const * data = (ConnPacketClusterInfoUpdate const *)packetHeader;
 
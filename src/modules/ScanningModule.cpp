@@ -126,10 +126,28 @@ void ScanningModule::TimerEventHandler(u16 passedTimeDs)
         totalRSSI = 0;
     }
 
-    if(SHOULD_IV_TRIGGER(GS->appTimerDs, passedTimeDs, assetReportingIntervalDs)){
-        //Send asset tracking packets
-        SendTrackedAssets();
+    //While the path towards the sink is congested, new observations are merged into the buffer
+    //and are sent once the congestion has cleared
+    const bool reportDue = SHOULD_IV_TRIGGER(GS->appTimerDs, passedTimeDs, assetReportingIntervalDs);
+    if(reportDue || assetPacketsFlushPending){
+        if (GS->cm.IsSinkPathCongested()) {
+            //Counted once per held back report and not for every timer event while the flush is pending
+            if (reportDue) SIMSTATCOUNT("assetReportThrottled");
+            assetPacketsFlushPending = assetPacketsCount > 0;
+        }
+        else {
+            //Send asset tracking packets
+            SendTrackedAssets();
+        }
+    }
+
+#if IS_INACTIVE(GW_SAVE_SPACE)
+    if(SHOULD_IV_TRIGGER(GS->appTimerDs, passedTimeDs, assetAggregationWindowDs)){
+        //Forward all asset reports that were coalesced during the last window. They are relayed data or own
+        //observations that were already held back above, so a congestion does not hold them back again.
+        SendAggregatedTrackedAssets();
     }
+#endif
 }
 
 void ScanningModule::MeshMessageReceivedHandler(BaseConnection* connection, BaseConnectionSendData* sendData, ConnPacketHeader const * packetHeader)
@@ -152,7 +170,61 @@ void ScanningModule::MeshMessageReceivedHandler(BaseConnection* connection, Base
             u32 amount = (sendData->dataLength - SIZEOF_CONN_PACKET_MODULE).GetRaw() / sizeof(TrackedAssetMessage);
             ReceiveTrackedAssets(msg, amount, packetHeader->sender);
         }
+        else if (connPacket->actionType == (u8)ScanModuleMessages::ASSET_TRACKING_PACKET_AGGREGATED)
+        {
+            AggregatedTrackedAssetMessage const * msg = (AggregatedTrackedAssetMessage const *)connPacket->data;
+            u32 amount = (sendData->dataLength - SIZEOF_CONN_PACKET_MODULE).GetRaw() / sizeof(AggregatedTrackedAssetMessage);
+            ReceiveAggregatedTrackedAssets(msg, amount);
+        }
+    }
+}
+
+RoutingDecision ScanningModule::MessageRoutingInterceptor(BaseConnection* connection, BaseConnectionSendData* sendData, ConnPacketHeader const * packetHeader)
+{
+#if IS_INACTIVE(GW_SAVE_SPACE)
+    //Only relays coalesce asset reports, a sink must log them as they are
+    if (
+        assetAggregationWindowDs == 0
+        || connection == nullptr
+        || GET_DEVICE_TYPE() == DeviceType::SINK
+        || packetHeader->messageType != MessageType::ASSET_GENERIC
+        || packetHeader->receiver != NODE_ID_SHORTEST_SINK
+        || sendData->dataLength < SIZEOF_CONN_PACKET_MODULE
+    ) {
+        return 0;
+    }
+
+    ConnPacketModule const * connPacket = (ConnPacketModule const *)packetHeader;
+    if (connPacket->moduleId != moduleId) return 0;
+
+    const u32 payloadLength = (sendData->dataLength - SIZEOF_CONN_PACKET_MODULE).GetRaw();
+
+    if (connPacket->actionType == (u8)ScanModuleMessages::ASSET_TRACKING_PACKET)
+    {
+        TrackedAssetMessage const * msg = (TrackedAssetMessage const *)connPacket->data;
+        const u32 amount = payloadLength / sizeof(TrackedAssetMessage);
+        for (u32 i = 0; i < amount; i++) {
+            AggregateTrackedAsset(msg[i], packetHeader->sender);
+        }
+    }
+    else if (connPacket->actionType == (u8)ScanModuleMessages::ASSET_TRACKING_PACKET_AGGREGATED)
+    {
+        AggregatedTrackedAssetMessage const * msg = (AggregatedTrackedAssetMessage const *)connPacket->data;
+        const u32 amount = payloadLength / sizeof(AggregatedTrackedAssetMessage);
+        for (u32 i = 0; i < amount; i++) {
+            AggregateTrackedAsset(msg[i].asset, msg[i].reporterNodeId);
+        }
+    }
+    else
+    {
+        return 0;
     }
+
+    //The reports are now part of our aggregation buffer and are forwarded with the next flush
+    return ROUTING_DECISION_BLOCK_TO_MESH | ROUTING_DECISION_BLOCK_TO_MESH_ACCESS;
+#else
+    return 0;
+#endif
 }
 
 DeliveryPriority ScanningModule::GetPriorityOfMessage(const u8* data, MessageLength size)
@@ -279,45 +351,93 @@ void ScanningModule::HandleAssetPackets(const FruityHal::GapAdvertisementReportE
 
 bool ScanningModule::AddTrackedAsset(const AdvPacketAssetServiceData * packet, i8 rssi)
 {
-    ScannedAssetTrackingStorage* slot = nullptr;
-
-    //Look for an old entry of this asset or a free space
-    //Because we fill this buffer from the beginning, we can use the first slot that is empty
-    for (int i = 0; i < ASSET_PACKET_BUFFER_SIZE; i++) {
-        if (assetPackets[i].assetNodeId == packet->assetNodeId || assetPackets[i].assetNodeId == 0) {
-            slot = &assetPackets[i];
-            break;
+    //0 is used to mark empty slots
+    if (packet->assetNodeId == 0) return false;
+
+    ScannedAssetTrackingStorage* slot = FindTrackedAssetSlot(packet->assetNodeId);
+
+    //If the buffer is full, the asset with the weakest signal is dropped
+    if (slot == nullptr) {
+        slot = EvictWeakestTrackedAsset(rssi);
+        GS->logger.LogCustomCount(CustomErrorTypes::COUNT_DROPPED_TRACKED_ASSETS);
+        if (slot == nullptr) {
+            logt("SCANMOD", "Dropped tracked packet %u, buffer full", packet->assetNodeId);
+            return false;
         }
     }
 
-    //If a slot was found, add the packet
-    if (slot != nullptr) {
-        u16 slotNum = ((u32)slot - (u32)assetPackets.data()) / sizeof(ScannedAssetTrackingStorage);
-        logt("SCANMOD", "Tracked packet %u in slot %d", packet->assetNodeId, slotNum);
+    u16 slotNum = slot - assetPackets.data();
+    logt("SCANMOD", "Tracked packet %u in slot %d", packet->assetNodeId, slotNum);
 
-        //Clean up first, if we overwrite another assetId
-        if (slot->assetNodeId != packet->assetNodeId) {
-            slot->assetNodeId = packet->assetNodeId;
-            slot->rssiContainer.count = 0;
-            slot->rssiContainer.rssi37 = slot->rssiContainer.rssi38 = slot->rssiContainer.rssi39 = UINT8_MAX;
-            slot->rssiContainer.channelCount[0] = slot->rssiContainer.channelCount[1] = slot->rssiContainer.channelCount[2] = 0;
-        }
-        slot->batteryPower = packet->batteryPower;
-        slot->absolutePositionX = packet->absolutePositionX;
-        slot->absolutePositionY = packet->absolutePositionY;
-        slot->pressure = packet->pressure;
-        slot->moving = packet->moving;
-        slot->positionValid = packet->positionValid;
+    //Clean up first, if this is a new asset or if we overwrite another assetId
+    if (slot->assetNodeId != packet->assetNodeId) {
+        if (slot->assetNodeId == 0) assetPacketsCount++;
+        slot->assetNodeId = packet->assetNodeId;
+        slot->rssiContainer.count = 0;
+        slot->rssiContainer.rssi37 = slot->rssiContainer.rssi38 = slot->rssiContainer.rssi39 = UINT8_MAX;
+        slot->rssiContainer.channelCount[0] = slot->rssiContainer.channelCount[1] = slot->rssiContainer.channelCount[2] = 0;
+    }
+    slot->batteryPower = packet->batteryPower;
+    slot->absolutePositionX = packet->absolutePositionX;
+    slot->absolutePositionY = packet->absolutePositionY;
+    slot->pressure = packet->pressure;
+    slot->moving = packet->moving;
+    slot->positionValid = packet->positionValid;
+
+    slot->hasFreeInConnection = packet->hasFreeInConnection;
+    slot->interestedInConnection = packet->interestedInConnection;
+    slot->hasSameNetworkId = packet->networkId == GS->node.configuration.networkId;
+
+    RssiRunningAverageCalculationInPlace(slot->rssiContainer, 0, rssi);
+
+    //Busy environments would otherwise lose assets, so we send the buffer early with the next timer event
+    if (assetPacketsCount >= ASSET_PACKET_BUFFER_HIGH_WATER_MARK) {
+        assetPacketsFlushPending = true;
+    }
 
-        slot->hasFreeInConnection = packet->hasFreeInConnection;
-        slot->interestedInConnection = packet->interestedInConnection;
-        slot->hasSameNetworkId = packet->networkId == GS->node.configuration.networkId;
+    return true;
+}
 
-        RssiRunningAverageCalculationInPlace(slot->rssiContainer, 0, rssi);
+//Returns the slot of the given asset or the empty slot where it should be inserted
+//Returns nullptr if the asset is not tracked and the buffer is full
+ScanningModule::ScannedAssetTrackingStorage* ScanningModule::FindTrackedAssetSlot(NodeId assetNodeId)
+{
+    const u32 startIndex = assetNodeId % ASSET_PACKET_BUFFER_SIZE;
+    for (u32 i = 0; i < ASSET_PACKET_BUFFER_SIZE; i++) {
+        ScannedAssetTrackingStorage* slot = &assetPackets[(startIndex + i) % ASSET_PACKET_BUFFER_SIZE];
+        //As entries are never removed individually, the asset can not be stored after an empty slot
+        if (slot->assetNodeId == assetNodeId || slot->assetNodeId == 0) {
+            return slot;
+        }
+    }
+    return nullptr;
+}
 
-        return true;
+//Returns the slot of the asset with the weakest signal if it is weaker than the given rssi
+//The table is full when this is called, so the probe sequence of every asset still
+//reaches its slot after it was replaced
+ScanningModule::ScannedAssetTrackingStorage* ScanningModule::EvictWeakestTrackedAsset(i8 rssi)
+{
+    ScannedAssetTrackingStorage* weakestSlot = nullptr;
+    for (u32 i = 0; i < ASSET_PACKET_BUFFER_SIZE; i++) {
+        if (weakestSlot == nullptr || GetStrongestRssi(assetPackets[i].rssiContainer) > GetStrongestRssi(weakestSlot->rssiContainer)) {
+            weakestSlot = &assetPackets[i];
+        }
     }
-    return false;
+
+    //rssi values are positive here, a bigger value is a weaker signal
+    if (weakestSlot == nullptr || (u8)rssi >= GetStrongestRssi(weakestSlot->rssiContainer)) return nullptr;
+
+    logt("SCANMOD", "Evicted tracked asset %u", weakestSlot->assetNodeId);
+    return weakestSlot;
+}
+
+u8 ScanningModule::GetStrongestRssi(const RssiContainer& container)
+{
+    u8 strongest = container.rssi37;
+    if (container.rssi38 < strongest) strongest = container.rssi38;
+    if (container.rssi39 < strongest) strongest = container.rssi39;
+    return strongest;
 }
 #endif
 
@@ -331,11 +451,7 @@ void ScanningModule::SendTrackedAssets()
 {
 #if IS_INACTIVE(GW_SAVE_SPACE)
     //Find out how many assets were tracked
-    u8 count = 0;
-    for (int i = 0; i < ASSET_PACKET_BUFFER_SIZE; i++) {
-        if (assetPackets[i].assetNodeId == 0) break;
-        count++;
-    }
+    const u8 count = assetPacketsCount;
 
     if (count == 0) return;
 
@@ -347,39 +463,175 @@ void ScanningModule::SendTrackedAssets()
     CheckedMemset(buffer, 0, messageLength);
     TrackedAssetMessage* trackedAssets = (TrackedAssetMessage*)buffer;
 
-    for (int i = 0; i < count; i++) {
-        trackedAssets[i].assetNodeId = assetPackets[i].assetNodeId;
-        trackedAssets[i].rssi37 = assetPackets[i].rssiContainer.rssi37;
-        trackedAssets[i].rssi38 = assetPackets[i].rssiContainer.rssi38;
-        trackedAssets[i].rssi39 = assetPackets[i].rssiContainer.rssi39;
-        trackedAssets[i].batteryPower = assetPackets[i].batteryPower;
-        trackedAssets[i].absolutePositionX = assetPackets[i].absolutePositionX;
-        trackedAssets[i].absolutePositionY = assetPackets[i].absolutePositionY;
-
-        trackedAssets[i].positionValid = assetPackets[i].positionValid;
-        trackedAssets[i].moving = assetPackets[i].moving;
-        trackedAssets[i].pressure = ConvertServiceDataToMeshMessagePressure(assetPackets[i].pressure);
-
-        trackedAssets[i].hasFreeInConnection = assetPackets[i].hasFreeInConnection;
-        trackedAssets[i].interestedInConnection = assetPackets[i].interestedInConnection;
-        trackedAssets[i].hasSameNetworkId = assetPackets[i].hasSameNetworkId;
-    }
-
-    SendModuleActionMessage(
-        MessageType::ASSET_GENERIC,
-        NODE_ID_SHORTEST_SINK,
-        (u8)ScanModuleMessages::ASSET_TRACKING_PACKET,
-        0,
-        buffer,
-        messageLength,
-        false
-    );
+    //The tracked assets are spread over the hash table, so the empty slots must be skipped
+    u32 assetIndex = 0;
+    for (int slotIndex = 0; slotIndex < ASSET_PACKET_BUFFER_SIZE && assetIndex < count; slotIndex++) {
+        const ScannedAssetTrackingStorage& slot = assetPackets[slotIndex];
+        if (slot.assetNodeId == 0) continue;
+
+        TrackedAssetMessage& trackedAsset = trackedAssets[assetIndex];
+        assetIndex++;
+
+        trackedAsset.assetNodeId = slot.assetNodeId;
+        trackedAsset.rssi37 = slot.rssiContainer.rssi37;
+        trackedAsset.rssi38 = slot.rssiContainer.rssi38;
+        trackedAsset.rssi39 = slot.rssiContainer.rssi39;
+        trackedAsset.batteryPower = slot.batteryPower;
+        trackedAsset.absolutePositionX = slot.absolutePositionX;
+        trackedAsset.absolutePositionY = slot.absolutePositionY;
+
+        trackedAsset.positionValid = slot.positionValid;
+        trackedAsset.moving = slot.moving;
+        trackedAsset.pressure = ConvertServiceDataToMeshMessagePressure(slot.pressure);
+
+        trackedAsset.hasFreeInConnection = slot.hasFreeInConnection;
+        trackedAsset.interestedInConnection = slot.interestedInConnection;
+        trackedAsset.hasSameNetworkId = slot.hasSameNetworkId;
+    }
 
     //Clear the buffer
     assetPackets = {};
+    assetPacketsCount = 0;
+    assetPacketsFlushPending = false;
+
+    //Relays with aggregation merge their own observations with the ones of other nodes
+    if (assetAggregationWindowDs != 0 && GET_DEVICE_TYPE() != DeviceType::SINK)
+    {
+        for (int i = 0; i < count; i++) {
+            AggregateTrackedAsset(trackedAssets[i], GS->node.configuration.nodeId);
+        }
+        return;
+    }
+
+    //A full buffer does not fit into a single mesh message, so it is split into multiple messages
+    constexpr u32 maxAssetsPerMessage = (MAX_MESH_PACKET_SIZE - SIZEOF_CONN_PACKET_MODULE) / sizeof(TrackedAssetMessage);
+    for (u32 offset = 0; offset < count; offset += maxAssetsPerMessage) {
+        const u32 amount = (count - offset) < maxAssetsPerMessage ? (count - offset) : maxAssetsPerMessage;
+
+        SendModuleActionMessage(
+            MessageType::ASSET_GENERIC,
+            NODE_ID_SHORTEST_SINK,
+            (u8)ScanModuleMessages::ASSET_TRACKING_PACKET,
+            0,
+            (u8*)(trackedAssets + offset),
+            amount * sizeof(TrackedAssetMessage),
+            false
+        );
+    }
 #endif
 }
 
+#define _______________________ASSET_AGGREGATION______________________
+
+#if IS_INACTIVE(GW_SAVE_SPACE)
+//Adds an observation of an asset to the aggregation buffer. Only the strongest observations of each asset are kept
+void ScanningModule::AggregateTrackedAsset(const TrackedAssetMessage& asset, NodeId reporterNodeId)
+{
+    AggregatedTrackedAssetMessage* weakestEntry = nullptr;
+    u32 observations = 0;
+
+    for (u32 i = 0; i < aggregatedAssetsCount; i++) {
+        AggregatedTrackedAssetMessage& entry = aggregatedAssets[i];
+        if (entry.asset.assetNodeId != asset.assetNodeId) continue;
+
+        //A newer report of the same node replaces its old one
+        if (entry.reporterNodeId == reporterNodeId) {
+            entry.asset = asset;
+            return;
+        }
+
+        observations++;
+        if (weakestEntry == nullptr || GetStrongestRssi(entry.asset) > GetStrongestRssi(weakestEntry->asset)) {
+            weakestEntry = &entry;
+        }
+    }
+
+    if (observations >= ASSET_AGGREGATION_OBSERVATIONS_PER_ASSET) {
+        if (GetStrongestRssi(asset) < GetStrongestRssi(weakestEntry->asset)) {
+            weakestEntry->reporterNodeId = reporterNodeId;
+            weakestEntry->asset = asset;
+        }
+        return;
+    }
+
+    //If the buffer is full, we flush it early and start a new window with this observation
+    if (aggregatedAssetsCount >= ASSET_AGGREGATION_BUFFER_SIZE) {
+        SendAggregatedTrackedAssets();
+    }
+
+    aggregatedAssets[aggregatedAssetsCount].reporterNodeId = reporterNodeId;
+    aggregatedAssets[aggregatedAssetsCount].asset = asset;
+    aggregatedAssetsCount++;
+}
+
+//Sends all coalesced asset reports to the sink, split into as many messages as necessary
+void ScanningModule::SendAggregatedTrackedAssets()
+{
+    constexpr u32 maxEntriesPerMessage = (MAX_MESH_PACKET_SIZE - SIZEOF_CONN_PACKET_MODULE) / sizeof(AggregatedTrackedAssetMessage);
+
+    for (u32 offset = 0; offset < aggregatedAssetsCount; offset += maxEntriesPerMessage) {
+        const u32 amount = (aggregatedAssetsCount - offset) < maxEntriesPerMessage ? (aggregatedAssetsCount - offset) : maxEntriesPerMessage;
+
+        logt("SCANMOD", "Sending %u aggregated asset reports", amount);
+
+        SendModuleActionMessage(
+            MessageType::ASSET_GENERIC,
+            NODE_ID_SHORTEST_SINK,
+            (u8)ScanModuleMessages::ASSET_TRACKING_PACKET_AGGREGATED,
+            0,
+            (u8*)(aggregatedAssets.data() + offset),
+            amount * sizeof(AggregatedTrackedAssetMessage),
+            false
+        );
+    }
+
+    aggregatedAssetsCount = 0;
+}
+#endif
+
+//Rssi values are stored as positive values, so a smaller value is a stronger signal
+//UINT8_MAX is used for channels that have no data
+u8 ScanningModule::GetStrongestRssi(const TrackedAssetMessage& asset)
+{
+    u8 strongest = (u8)asset.rssi37;
+    if ((u8)asset.rssi38 < strongest) strongest = (u8)asset.rssi38;
+    if ((u8)asset.rssi39 < strongest) strongest = (u8)asset.rssi39;
+    return strongest;
+}
+
+void ScanningModule::ReceiveAggregatedTrackedAssets(AggregatedTrackedAssetMessage const * msg, u32 amount) const
+{
+    if (amount == 0) return;
+
+    //The observations are logged grouped by the node that scanned them so that
+    //the output is the same as if each node had sent its own report
+    DYNAMIC_ARRAY(buffer, amount * sizeof(TrackedAssetMessage));
+    TrackedAssetMessage* reporterAssets = (TrackedAssetMessage*)buffer;
+
+    for (u32 i = 0; i < amount; i++) {
+        const NodeId reporterNodeId = msg[i].reporterNodeId;
+
+        bool alreadyLogged = false;
+        for (u32 k = 0; k < i; k++) {
+            if (msg[k].reporterNodeId == reporterNodeId) {
+                alreadyLogged = true;
+                break;
+            }
+        }
+        if (alreadyLogged) continue;
+
+        u32 reporterAmount = 0;
+        for (u32 k = i; k < amount; k++) {
+            if (msg[k].reporterNodeId == reporterNodeId) {
+                reporterAssets[reporterAmount] = msg[k].asset;
+                reporterAmount++;
+            }
+        }
+
+        ReceiveTrackedAssets(reporterAssets, reporterAmount, reporterNodeId);
+    }
+}
+
 void ScanningModule::ReceiveTrackedAssetsLegacy(BaseConnectionSendData* sendData, ScanModuleTrackedAssetsLegacyMessage const * packet) const
 {
     u8 count = (sendData->dataLength - SIZEOF_CONN_PACKET_HEADER).GetRaw() / SIZEOF_SCAN_MODULE_TRACKED_ASSET_LEGACY;
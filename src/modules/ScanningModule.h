@@ -44,8 +44,12 @@ constexpr int SCAN_FILTER_NUMBER = 2;//Number of filters that can be set
 constexpr int NUM_ADDRESSES_TRACKED = 50;
 
 constexpr int ASSET_PACKET_BUFFER_SIZE = 30;
+constexpr int ASSET_PACKET_BUFFER_HIGH_WATER_MARK = 24; //Tracked assets are sent early once this many are buffered
 constexpr int ASSET_PACKET_RSSI_SEND_THRESHOLD = -88;
 
+constexpr int ASSET_AGGREGATION_BUFFER_SIZE = 30;
+constexpr int ASSET_AGGREGATION_OBSERVATIONS_PER_ASSET = 3; //Number of strongest observations that are kept per asset
+
 enum class GroupingType : u8 {
     GROUP_BY_ADDRESS =1, 
     NO_GROUPING      =2,
@@ -121,6 +125,7 @@ private:
         //TOTAL_SCANNED_PACKETS=0,  //Removed as of 21.05.2019
         //ASSET_LEGACY_TRACKING_PACKET=1,  //Removed as of 24.10.2019
         ASSET_TRACKING_PACKET = 2,
+        ASSET_TRACKING_PACKET_AGGREGATED = 3,
     };
 
     //####### Module specific message structs (these need to be packed)
@@ -168,6 +173,14 @@ public:
     };
     STATIC_ASSERT_SIZE(TrackedAssetMessage, 12);
     constexpr static u32 SIZEOF_TRACKED_ASSET_MESSAGE_WITH_CONN_PACKET_HEADER =  sizeof(ScanningModule::TrackedAssetMessage) + SIZEOF_CONN_PACKET_HEADER;
+
+    //Asset observations of multiple nodes that were merged by a relay on their way to the sink
+    struct AggregatedTrackedAssetMessage
+    {
+        NodeId reporterNodeId;
+        TrackedAssetMessage asset;
+    };
+    STATIC_ASSERT_SIZE(AggregatedTrackedAssetMessage, 14);
 private:
 
     //Storage for Asset advertising packets
@@ -187,7 +200,16 @@ private:
         u8 reservedBits : 3;
     };
 
+    //Open addressing hash table with linear probing, keyed by the assetNodeId (0 marks an empty slot)
+    //Entries are never removed individually, the table is only cleared as a whole once it was sent
+    //so that no tombstones are necessary
     std::array<ScannedAssetTrackingStorage, ASSET_PACKET_BUFFER_SIZE> assetPackets{};
+    u8 assetPacketsCount = 0;
+    bool assetPacketsFlushPending = false;
+
+    //Storage for asset reports that are coalesced before being forwarded to the sink
+    std::array<AggregatedTrackedAssetMessage, ASSET_AGGREGATION_BUFFER_SIZE> aggregatedAssets{};
+    u8 aggregatedAssetsCount = 0;
 
     //####### End of Module specitic messages
 #pragma pack(pop)
@@ -197,12 +219,21 @@ private:
     void HandleAssetLegacyPackets(const FruityHal::GapAdvertisementReportEvent& advertisementReportEvent);
     void HandleAssetPackets(const FruityHal::GapAdvertisementReportEvent& advertisementReportEvent);
     bool AddTrackedAsset(const AdvPacketAssetServiceData* packet, i8 rssi);
+    ScannedAssetTrackingStorage* FindTrackedAssetSlot(NodeId assetNodeId);
+    ScannedAssetTrackingStorage* EvictWeakestTrackedAsset(i8 rssi);
+    static u8 GetStrongestRssi(const RssiContainer& container);
     void ReceiveTrackedAssetsLegacy(BaseConnectionSendData* sendData, ScanModuleTrackedAssetsLegacyMessage const * packet) const;
     void ReceiveTrackedAssets(TrackedAssetMessage const * msg, u32 amount, NodeId sender) const;
+    void ReceiveAggregatedTrackedAssets(AggregatedTrackedAssetMessage const * msg, u32 amount) const;
     void RssiRunningAverageCalculationInPlace(RssiContainer &container, u8 advertisingChannel, i8 rssi);
     
     void SendTrackedAssets();
 
+//Asset report aggregation
+    void AggregateTrackedAsset(const TrackedAssetMessage& asset, NodeId reporterNodeId);
+    void SendAggregatedTrackedAssets();
+    static u8 GetStrongestRssi(const TrackedAssetMessage& asset);
+
 
     static u8 ConvertServiceDataToMeshMessageSpeed(u8 serviceDataSpeed);
     u8 ConvertServiceDataToMeshMessagePressure(u16 serviceDataPressure);
@@ -210,6 +241,9 @@ private:
 
 public:
     u16 assetReportingIntervalDs = 0;
+    //If not 0, relays coalesce asset reports that are sent to the sink for this window
+    //and only forward the strongest observations of each asset (0 disables aggregation)
+    u16 assetAggregationWindowDs = 0;
 
     ScanJob * p_scanJob;
 
@@ -227,6 +261,8 @@ public:
 
     void MeshMessageReceivedHandler(BaseConnection* connection, BaseConnectionSendData* sendData, ConnPacketHeader const * packetHeader) override final;
 
+    RoutingDecision MessageRoutingInterceptor(BaseConnection* connection, BaseConnectionSendData* sendData, ConnPacketHeader const * packetHeader) override final;
+
     //Priority
     virtual DeliveryPriority GetPriorityOfMessage(const u8* data, MessageLength size) override;
 
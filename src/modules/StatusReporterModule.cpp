@@ -67,6 +67,7 @@ void StatusReporterModule::ResetToDefaultConfiguration()
     configuration.nearbyReportingIntervalDs = 0;
     configuration.deviceInfoReportingIntervalDs = 0;
     configuration.liveReportingState = LiveReportTypes::LEVEL_INFO;
+    configuration.deltaReportKeyframeInterval = 0;
 
     CheckedMemset(nodeMeasurements, 0x00, sizeof(nodeMeasurements));
 
@@ -85,7 +86,8 @@ void StatusReporterModule::TimerEventHandler(u16 passedTimeDs)
     //So instead, the asset fully relies on manual querying these messages. Other than "not making sense"
     //this can lead to issues on the Gateway if it receives a messages through a MA-Connection that has a
     //virtual partnerId as the gateway gets confused by the unknown nodeId.
-    if (GET_DEVICE_TYPE() != DeviceType::ASSET)
+    //The periodic reports are skipped while the path towards the sink is congested, the next ones will follow.
+    if (GET_DEVICE_TYPE() != DeviceType::ASSET && !GS->cm.IsSinkPathCongested())
     {
         //Device Info
         if (SHOULD_IV_TRIGGER(GS->appTimerDs + GS->appTimerRandomOffsetDs, passedTimeDs, configuration.deviceInfoReportingIntervalDs)) {
@@ -93,11 +95,11 @@ void StatusReporterModule::TimerEventHandler(u16 passedTimeDs)
         }
         //Status
         if (SHOULD_IV_TRIGGER(GS->appTimerDs + GS->appTimerRandomOffsetDs, passedTimeDs, configuration.statusReportingIntervalDs)) {
-            SendStatus(NODE_ID_BROADCAST, 0, MessageType::MODULE_ACTION_RESPONSE);
+            SendPeriodicStatus();
         }
         //Connections
         if (SHOULD_IV_TRIGGER(GS->appTimerDs + GS->appTimerRandomOffsetDs, passedTimeDs, configuration.connectionReportingIntervalDs)) {
-            SendAllConnections(NODE_ID_BROADCAST, 0, MessageType::MODULE_GENERAL);
+            SendPeriodicAllConnections();
         }
         //Nearby Nodes
         if (SHOULD_IV_TRIGGER(GS->appTimerDs + GS->appTimerRandomOffsetDs, passedTimeDs, configuration.nearbyReportingIntervalDs)) {
@@ -150,8 +152,7 @@ void StatusReporterModule::TimerEventHandler(u16 passedTimeDs)
     }
 }
 
-//This method sends the node's status over the network
-void StatusReporterModule::SendStatus(NodeId toNode, u8 requestHandle, MessageType messageType) const
+StatusReporterModule::StatusReporterModuleStatusMessage StatusReporterModule::GetStatusMessage() const
 {
     MeshConnections conn = GS->cm.GetMeshConnections(ConnectionDirection::DIRECTION_IN);
     MeshConnectionHandle inConnection;
@@ -163,6 +164,7 @@ void StatusReporterModule::SendStatus(NodeId toNode, u8 requestHandle, MessageTy
     }
 
     StatusReporterModuleStatusMessage data;
+    CheckedMemset(&data, 0x00, sizeof(data));
 
     data.batteryInfo = GetBatteryVoltage();
     data.clusterSize = GS->node.GetClusterSize();
@@ -173,6 +175,14 @@ void StatusReporterModule::SendStatus(NodeId toNode, u8 requestHandle, MessageTy
     data.inConnectionRSSI = !inConnection.Exists() ? 0 : inConnection.GetAverageRSSI();
     data.initializedByGateway = GS->node.initializedByGateway;
 
+    return data;
+}
+
+//This method sends the node's status over the network
+void StatusReporterModule::SendStatus(NodeId toNode, u8 requestHandle, MessageType messageType) const
+{
+    StatusReporterModuleStatusMessage data = GetStatusMessage();
+
     SendModuleActionMessage(
         messageType,
         toNode,
@@ -184,6 +194,87 @@ void StatusReporterModule::SendStatus(NodeId toNode, u8 requestHandle, MessageTy
     );
 }
 
+bool StatusReporterModule::IsRssiDeltaReportable(i8 a, i8 b)
+{
+    return (a > b ? a - b : b - a) >= DELTA_REPORT_RSSI_THRESHOLD;
+}
+
+//Periodic status reports are sent as a full keyframe every deltaReportKeyframeInterval reports. The reports in
+//between only carry the fields that changed beyond a threshold compared to that keyframe. As the deltas are
+//always relative to the keyframe and not to each other, a lost delta is repaired by the next one.
+void StatusReporterModule::SendPeriodicStatus()
+{
+    const StatusReporterModuleStatusMessage data = GetStatusMessage();
+
+    if (configuration.deltaReportKeyframeInterval == 0 || statusReportsSinceKeyframe == 0)
+    {
+        SendStatus(NODE_ID_BROADCAST, 0, MessageType::MODULE_ACTION_RESPONSE);
+        statusKeyframe = data;
+    }
+    else
+    {
+        u8 buffer[SIZEOF_STATUS_REPORTER_MODULE_STATUS_DELTA_MESSAGE_MAX];
+        u8 changedFields = 0;
+        u32 offset = 1;
+
+        if (data.clusterSize != statusKeyframe.clusterSize)
+        {
+            changedFields |= STATUS_DELTA_CLUSTER_SIZE;
+            CheckedMemcpy(buffer + offset, &data.clusterSize, sizeof(data.clusterSize));
+            offset += sizeof(data.clusterSize);
+        }
+        if (data.inConnectionPartner != statusKeyframe.inConnectionPartner
+            || IsRssiDeltaReportable(data.inConnectionRSSI, statusKeyframe.inConnectionRSSI))
+        {
+            changedFields |= STATUS_DELTA_IN_CONNECTION;
+            CheckedMemcpy(buffer + offset, &data.inConnectionPartner, sizeof(data.inConnectionPartner));
+            offset += sizeof(data.inConnectionPartner);
+            buffer[offset++] = (u8)data.inConnectionRSSI;
+        }
+        if (data.freeIn != statusKeyframe.freeIn || data.freeOut != statusKeyframe.freeOut)
+        {
+            changedFields |= STATUS_DELTA_FREE_CONNECTIONS;
+            buffer[offset++] = (u8)(data.freeIn | (data.freeOut << 2));
+        }
+        if ((data.batteryInfo > statusKeyframe.batteryInfo ? data.batteryInfo - statusKeyframe.batteryInfo : statusKeyframe.batteryInfo - data.batteryInfo) >= DELTA_REPORT_BATTERY_THRESHOLD_DV)
+        {
+            changedFields |= STATUS_DELTA_BATTERY;
+            buffer[offset++] = data.batteryInfo;
+        }
+        if (data.connectionLossCounter != statusKeyframe.connectionLossCounter)
+        {
+            changedFields |= STATUS_DELTA_CONNECTION_LOSSES;
+            buffer[offset++] = data.connectionLossCounter;
+        }
+        if (data.initializedByGateway != statusKeyframe.initializedByGateway)
+        {
+            changedFields |= STATUS_DELTA_INITIALIZED;
+            buffer[offset++] = data.initializedByGateway;
+        }
+        buffer[0] = changedFields;
+
+        if (changedFields != 0)
+        {
+            SendModuleActionMessage(
+                MessageType::MODULE_ACTION_RESPONSE,
+                NODE_ID_BROADCAST,
+                (u8)StatusModuleActionResponseMessages::STATUS_DELTA,
+                0,
+                buffer,
+                offset,
+                false
+            );
+        }
+        else
+        {
+            SIMSTATCOUNT("statusDeltaSuppressed");
+        }
+    }
+
+    statusReportsSinceKeyframe++;
+    if (statusReportsSinceKeyframe >= configuration.deltaReportKeyframeInterval) statusReportsSinceKeyframe = 0;
+}
+
 //Message type can be either MESSAGE_TYPE_MODULE_ACTION_RESPONSE or MESSAGE_TYPE_MODULE_GENERAL
 void StatusReporterModule::SendDeviceInfoV2(NodeId toNode, u8 requestHandle, MessageType messageType) const
 {
@@ -253,8 +344,7 @@ void StatusReporterModule::SendNearbyNodes(NodeId toNode, u8 requestHandle, Mess
 }
 
 
-//This method sends information about the current connections over the network
-void StatusReporterModule::SendAllConnections(NodeId toNode, u8 requestHandle, MessageType messageType) const
+StatusReporterModuleConnectionsMessage StatusReporterModule::GetAllConnectionsMessage() const
 {
     StatusReporterModuleConnectionsMessage message;
     CheckedMemset(&message, 0x00, sizeof(StatusReporterModuleConnectionsMessage));
@@ -278,6 +368,14 @@ void StatusReporterModule::SendAllConnections(NodeId toNode, u8 requestHandle, M
         CheckedMemcpy(buffer + (i+1)*3 + 2, &avgRssi, 1);
     }
 
+    return message;
+}
+
+//This method sends information about the current connections over the network
+void StatusReporterModule::SendAllConnections(NodeId toNode, u8 requestHandle, MessageType messageType) const
+{
+    StatusReporterModuleConnectionsMessage message = GetAllConnectionsMessage();
+
     SendModuleActionMessage(
         MessageType::MODULE_ACTION_RESPONSE,
         NODE_ID_BROADCAST,
@@ -289,6 +387,65 @@ void StatusReporterModule::SendAllConnections(NodeId toNode, u8 requestHandle, M
     );
 }
 
+//Same keyframe scheme as SendPeriodicStatus, a delta carries a mask of the changed connection slots followed
+//by the partnerId and rssi of each changed slot.
+void StatusReporterModule::SendPeriodicAllConnections()
+{
+    const StatusReporterModuleConnectionsMessage message = GetAllConnectionsMessage();
+
+    if (configuration.deltaReportKeyframeInterval == 0 || connectionsReportsSinceKeyframe == 0)
+    {
+        SendAllConnections(NODE_ID_BROADCAST, 0, MessageType::MODULE_GENERAL);
+        connectionsKeyframe = message;
+    }
+    else
+    {
+        u8 buffer[SIZEOF_STATUS_REPORTER_MODULE_CONNECTIONS_DELTA_MESSAGE_MAX];
+        u8 changedSlots = 0;
+        u32 offset = 1;
+
+        const u8* current = (const u8*)&message;
+        const u8* keyframe = (const u8*)&connectionsKeyframe;
+        for (u32 slot = 0; slot < 4; slot++)
+        {
+            NodeId currentPartner;
+            NodeId keyframePartner;
+            CheckedMemcpy(&currentPartner, current + slot * 3, sizeof(NodeId));
+            CheckedMemcpy(&keyframePartner, keyframe + slot * 3, sizeof(NodeId));
+            const i8 currentRssi = (i8)current[slot * 3 + 2];
+            const i8 keyframeRssi = (i8)keyframe[slot * 3 + 2];
+
+            if (currentPartner != keyframePartner || IsRssiDeltaReportable(currentRssi, keyframeRssi))
+            {
+                changedSlots |= 1 << slot;
+                CheckedMemcpy(buffer + offset, current + slot * 3, 3);
+                offset += 3;
+            }
+        }
+        buffer[0] = changedSlots;
+
+        if (changedSlots != 0)
+        {
+            SendModuleActionMessage(
+                MessageType::MODULE_ACTION_RESPONSE,
+                NODE_ID_BROADCAST,
+                (u8)StatusModuleActionResponseMessages::ALL_CONNECTIONS_DELTA,
+                0,
+                buffer,
+                offset,
+                false
+            );
+        }
+        else
+        {
+            SIMSTATCOUNT("connectionsDeltaSuppressed");
+        }
+    }
+
+    connectionsReportsSinceKeyframe++;
+    if (connectionsReportsSinceKeyframe >= configuration.deltaReportKeyframeInterval) connectionsReportsSinceKeyframe = 0;
+}
+
 void StatusReporterModule::SendAllConnectionsVerbose(NodeId toNode, u8 requestHandle, u32 connectionIndex) const
 {
     const BaseConnections connections = GS->cm.GetBaseConnections(ConnectionDirection::INVALID);
@@ -860,6 +1017,101 @@ void StatusReporterModule::MeshMessageReceivedHandler(BaseConnection* connection
                 logjson_partial("STATUSMOD", "\"inConnectionRSSI\":%d, \"initialized\":%u", data->inConnectionRSSI, data->initializedByGateway);
                 logjson("STATUSMOD", "}" SEP);
             }
+            else if(actionType == StatusModuleActionResponseMessages::STATUS_DELTA)
+            {
+                const u8* data = packet->data;
+                const u32 dataLength = (sendData->dataLength - SIZEOF_CONN_PACKET_MODULE).GetRaw();
+                const u8 changedFields = dataLength > 0 ? data[0] : 0;
+
+                u32 expectedLength = 1;
+                if (changedFields & STATUS_DELTA_CLUSTER_SIZE) expectedLength += sizeof(ClusterSize);
+                if (changedFields & STATUS_DELTA_IN_CONNECTION) expectedLength += sizeof(NodeId) + 1;
+                if (changedFields & STATUS_DELTA_FREE_CONNECTIONS) expectedLength += 1;
+                if (changedFields & STATUS_DELTA_BATTERY) expectedLength += 1;
+                if (changedFields & STATUS_DELTA_CONNECTION_LOSSES) expectedLength += 1;
+                if (changedFields & STATUS_DELTA_INITIALIZED) expectedLength += 1;
+
+                if (dataLength < expectedLength)
+                {
+                    SIMEXCEPTION(IllegalArgumentException);
+                    logt("ERROR", "Status delta too short: %u < %u", dataLength, expectedLength);
+                    return;
+                }
+
+                //Print only the fields that changed since the last keyframe
+                logjson_partial("STATUSMOD", "{\"nodeId\":%u,\"type\":\"status_delta\",\"module\":%u", packet->header.sender, (u8)ModuleId::STATUS_REPORTER_MODULE);
+                u32 offset = 1;
+                if (changedFields & STATUS_DELTA_CLUSTER_SIZE)
+                {
+                    ClusterSize clusterSize;
+                    CheckedMemcpy(&clusterSize, data + offset, sizeof(clusterSize));
+                    offset += sizeof(clusterSize);
+                    logjson_partial("STATUSMOD", ",\"clusterSize\":%u", clusterSize);
+                }
+                if (changedFields & STATUS_DELTA_IN_CONNECTION)
+                {
+                    NodeId partner;
+                    CheckedMemcpy(&partner, data + offset, sizeof(partner));
+                    offset += sizeof(partner);
+                    const i8 rssi = (i8)data[offset++];
+                    logjson_partial("STATUSMOD", ",\"inConnectionPartner\":%u,\"inConnectionRSSI\":%d", partner, rssi);
+                }
+                if (changedFields & STATUS_DELTA_FREE_CONNECTIONS)
+                {
+                    const u8 freeConnections = data[offset++];
+                    logjson_partial("STATUSMOD", ",\"freeIn\":%u,\"freeOut\":%u", freeConnections & 0x03, freeConnections >> 2);
+                }
+                if (changedFields & STATUS_DELTA_BATTERY)
+                {
+                    logjson_partial("STATUSMOD", ",\"batteryInfo\":%u", data[offset++]);
+                }
+                if (changedFields & STATUS_DELTA_CONNECTION_LOSSES)
+                {
+                    logjson_partial("STATUSMOD", ",\"connectionLossCounter\":%u", data[offset++]);
+                }
+                if (changedFields & STATUS_DELTA_INITIALIZED)
+                {
+                    logjson_partial("STATUSMOD", ",\"initialized\":%u", data[offset++]);
+                }
+                logjson("STATUSMOD", "}" SEP);
+            }
+            else if(actionType == StatusModuleActionResponseMessages::ALL_CONNECTIONS_DELTA)
+            {
+                const u8* data = packet->data;
+                const u32 dataLength = (sendData->dataLength - SIZEOF_CONN_PACKET_MODULE).GetRaw();
+                const u8 changedSlots = dataLength > 0 ? data[0] : 0;
+
+                u32 expectedLength = 1;
+                for (u32 slot = 0; slot < 4; slot++)
+                {
+                    if (changedSlots & (1 << slot)) expectedLength += 3;
+                }
+
+                if (dataLength < expectedLength)
+                {
+                    SIMEXCEPTION(IllegalArgumentException);
+                    logt("ERROR", "Connections delta too short: %u < %u", dataLength, expectedLength);
+                    return;
+                }
+
+                logjson_partial("STATUSMOD", "{\"type\":\"connections_delta\",\"nodeId\":%d,\"module\":%u,\"slots\":[", packet->header.sender, (u8)ModuleId::STATUS_REPORTER_MODULE);
+                u32 offset = 1;
+                bool first = true;
+                for (u32 slot = 0; slot < 4; slot++)
+                {
+                    if ((changedSlots & (1 << slot)) == 0) continue;
+
+                    NodeId partner;
+                    CheckedMemcpy(&partner, data + offset, sizeof(partner));
+                    const i8 rssi = (i8)data[offset + 2];
+                    offset += 3;
+
+                    if (!first) logjson_partial("STATUSMOD", ",");
+                    logjson_partial("STATUSMOD", "{\"slot\":%u,\"partner\":%u,\"rssi\":%d}", slot, partner, rssi);
+                    first = false;
+                }
+                logjson("STATUSMOD", "]}" SEP);
+            }
             else if(actionType == StatusModuleActionResponseMessages::NEARBY_NODES)
             {
                 //Print packet to console
@@ -64,6 +64,9 @@ struct StatusReporterModuleConfiguration: ModuleConfiguration
         u16 nearbyReportingIntervalDs;
         u16 deviceInfoReportingIntervalDs;
         LiveReportTypes liveReportingState;
+        //Every n-th periodic status and connections report is sent in full, the ones in between only
+        //carry the fields that changed since that keyframe. 0 sends every periodic report in full.
+        u8 deltaReportKeyframeInterval;
         //Insert more persistent config values here
 };
 #pragma pack(pop)
@@ -182,6 +185,8 @@ public:
             REBOOT_REASON = 8,
             DEVICE_INFO_V2 = 10,
             ALL_CONNECTIONS_VERBOSE = 12,
+            STATUS_DELTA = 13,
+            ALL_CONNECTIONS_DELTA = 14,
         };
 
         enum class StatusModuleGeneralMessages : u8
@@ -239,6 +244,22 @@ private:
             } StatusReporterModuleStatusMessage;
             STATIC_ASSERT_SIZE(StatusReporterModuleStatusMessage, 9);
 
+            //Bits of the changedFields mask of a status delta, the values of the changed fields follow the
+            //mask in the order of these bits
+            enum StatusDeltaField : u8
+            {
+                STATUS_DELTA_CLUSTER_SIZE      = 1 << 0, //ClusterSize
+                STATUS_DELTA_IN_CONNECTION     = 1 << 1, //NodeId partner followed by i8 rssi
+                STATUS_DELTA_FREE_CONNECTIONS  = 1 << 2, //u8 with freeIn in the lower 2 and freeOut in the upper 6 bits
+                STATUS_DELTA_BATTERY           = 1 << 3, //u8 batteryInfo
+                STATUS_DELTA_CONNECTION_LOSSES = 1 << 4, //u8 connectionLossCounter
+                STATUS_DELTA_INITIALIZED       = 1 << 5, //u8 initializedByGateway
+            };
+            //Mask plus all fields
+            static constexpr int SIZEOF_STATUS_REPORTER_MODULE_STATUS_DELTA_MESSAGE_MAX = 1 + 2 + 3 + 1 + 1 + 1 + 1;
+            //Mask plus a NodeId and an i8 rssi for each of the four connection slots
+            static constexpr int SIZEOF_STATUS_REPORTER_MODULE_CONNECTIONS_DELTA_MESSAGE_MAX = 1 + 4 * 3;
+
             //Used for sending error logs through the mesh
             static constexpr int SIZEOF_STATUS_REPORTER_MODULE_ERROR_LOG_ENTRY_MESSAGE = 12;
             typedef struct
@@ -289,6 +310,19 @@ private:
 
         void ConvertADCtoVoltage();
 
+        //Changes smaller than these thresholds are not reported in a delta
+        constexpr static u8 DELTA_REPORT_RSSI_THRESHOLD = 5;
+        constexpr static u8 DELTA_REPORT_BATTERY_THRESHOLD_DV = 2;
+        StatusReporterModuleStatusMessage statusKeyframe;
+        StatusReporterModuleConnectionsMessage connectionsKeyframe;
+        u8 statusReportsSinceKeyframe = 0;
+        u8 connectionsReportsSinceKeyframe = 0;
+        StatusReporterModuleStatusMessage GetStatusMessage() const;
+        StatusReporterModuleConnectionsMessage GetAllConnectionsMessage() const;
+        void SendPeriodicStatus();
+        void SendPeriodicAllConnections();
+        static bool IsRssiDeltaReportable(i8 a, i8 b);
+
         bool periodicTimeSendWasActivePreviousTimerEventHandler = false;
         u32 periodicTimeSendStartTimestampDs = 0;
         constexpr static u32 PERIODIC_TIME_SEND_AUTOMATIC_DEACTIVATION = SEC_TO_DS(/*10 minutes*/ 10 * 60);
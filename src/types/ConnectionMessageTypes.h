@@ -89,6 +89,8 @@ enum class MessageType : u8
     CAPABILITY = 33,
     ASSET_GENERIC = 34,
     SIG_MESH_SIMPLE = 35, //A lightweight wrapper for SIG mesh access layer messages
+    FLOW_CONTROL = 36, //Advertises the send queue credits of a node to its direct partners
+    SINK_ROUTE = 37, //Advertises the cost of the route towards the sink to the direct partners
 
     //Module messages all use the same ConnPacketModule header
     MODULE_MESSAGES_START = 50,
@@ -218,7 +220,11 @@ typedef struct
 STATIC_ASSERT_SIZE(ConnPacketClusterAck2, SIZEOF_CONN_PACKET_CLUSTER_ACK_2);
 
 //CLUSTER_INFO_UPDATE informs all nodes in the mesh about cluster changes
-constexpr size_t SIZEOF_CONN_PACKET_PAYLOAD_CLUSTER_INFO_UPDATE = 9;
+//The sinkEtx is the expected amount of transmissions towards the sink that the sender routes to in units of SINK_ETX_PER_TRANSMISSION,
+//it was added later and is missing in updates of older nodes, see SIZEOF_CONN_PACKET_CLUSTER_INFO_UPDATE_LEGACY
+constexpr u16 SINK_ETX_PER_TRANSMISSION = 100;
+constexpr u16 SINK_ETX_UNREACHABLE = 0xFFFF;
+constexpr size_t SIZEOF_CONN_PACKET_PAYLOAD_CLUSTER_INFO_UPDATE = 11;
 typedef struct
 {
     ClusterId newClusterId_deprecated;
@@ -227,11 +233,13 @@ typedef struct
     u8 connectionMasterBitHandover : 1; //Used to hand over the connection master bit
     u8 counter : 1; //A very small counter to protect against duplicate clusterUpdates
     u8 reserved : 6;
+    u16 sinkEtx;
     
 }ConnPacketPayloadClusterInfoUpdate;
 STATIC_ASSERT_SIZE(ConnPacketPayloadClusterInfoUpdate, SIZEOF_CONN_PACKET_PAYLOAD_CLUSTER_INFO_UPDATE);
 
 constexpr size_t SIZEOF_CONN_PACKET_CLUSTER_INFO_UPDATE = (SIZEOF_CONN_PACKET_HEADER + SIZEOF_CONN_PACKET_PAYLOAD_CLUSTER_INFO_UPDATE);
+constexpr size_t SIZEOF_CONN_PACKET_CLUSTER_INFO_UPDATE_LEGACY = (SIZEOF_CONN_PACKET_CLUSTER_INFO_UPDATE - 2);
 typedef struct
 {
     ConnPacketHeader header;
@@ -722,6 +730,31 @@ typedef struct
 }ConnPacketUpdateConnectionInterval;
 STATIC_ASSERT_SIZE(ConnPacketUpdateConnectionInterval, SIZEOF_CONN_PACKET_UPDATE_CONNECTION_INTERVAL);
 
+//FLOW_CONTROL is only sent to a direct partner and is not forwarded. It advertises the amount of free send queue
+//chunks of the sender and its path towards the sink. The partner holds back its sink bound traffic while they are
+//below FLOW_CONTROL_CONGESTION_CHUNK_THRESHOLD.
+constexpr size_t SIZEOF_CONN_PACKET_FLOW_CONTROL = (SIZEOF_CONN_PACKET_HEADER + 1);
+typedef struct
+{
+    ConnPacketHeader header;
+    u8 credits;
+}ConnPacketFlowControl;
+STATIC_ASSERT_SIZE(ConnPacketFlowControl, SIZEOF_CONN_PACKET_FLOW_CONTROL);
+
+//SINK_ROUTE is only sent to a direct partner and is not forwarded. It advertises the load in percent of the sink
+//that the sender routes its sink bound traffic to if the traffic came from the partner and the expected amount of
+//transmissions towards that same sink, see CLUSTER_INFO_UPDATE. The sinkEtx was appended to the sinkLoad later,
+//so packets of SIZEOF_CONN_PACKET_SINK_ROUTE_LEGACY are valid as well and only carry the sinkLoad.
+constexpr size_t SIZEOF_CONN_PACKET_SINK_ROUTE = (SIZEOF_CONN_PACKET_HEADER + 3);
+constexpr size_t SIZEOF_CONN_PACKET_SINK_ROUTE_LEGACY = (SIZEOF_CONN_PACKET_SINK_ROUTE - 2);
+typedef struct
+{
+    ConnPacketHeader header;
+    u8 sinkLoad;
+    u16 sinkEtx;
+}ConnPacketSinkRoute;
+STATIC_ASSERT_SIZE(ConnPacketSinkRoute, SIZEOF_CONN_PACKET_SINK_ROUTE);
+
 
 //End Packing
 #pragma pack(pop)
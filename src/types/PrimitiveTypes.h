@@ -283,6 +283,7 @@ enum class LiveReportHandshakeFailCode : u8
     NETWORK_ID_MISMATCH,
     WRONG_DIRECTION,
     UNPREFERRED_CONNECTION,
+    TOPOLOGY_OPTIMIZATION,
 };
 
 enum class PinsetIdentifier : u16 {
@@ -30,6 +30,7 @@
 
 #include <PacketQueue.h>
 #include "GlobalState.h"
+#include "FruityHal.h"
 #include <Logger.h>
 #include <cstring>
 #include "Utility.h"
@@ -39,12 +40,12 @@
 void ChunkedPacketQueue::AddMessageRaw(u8* data, u16 size)
 {
     writeChunk->amountOfByteInThisChunk = Utility::NextMultipleOf(writeChunk->amountOfByteInThisChunk, sizeof(QueueEntryHeader));
-    const u32 sizeLeftInCurrentWriteChunk = CONNECTION_QUEUE_MEMORY_CHUNK_SIZE > writeChunk->amountOfByteInThisChunk ? CONNECTION_QUEUE_MEMORY_CHUNK_SIZE - writeChunk->amountOfByteInThisChunk : 0;
+    const u32 sizeLeftInCurrentWriteChunk = writeChunk->capacity > writeChunk->amountOfByteInThisChunk ? writeChunk->capacity - writeChunk->amountOfByteInThisChunk : 0;
 
     if (sizeLeftInCurrentWriteChunk >= size)
     {
         // The data fits completely in the current writeChunk
-        CheckedMemcpy(writeChunk->data.data() + writeChunk->amountOfByteInThisChunk, data, size);
+        CheckedMemcpy(writeChunk->data + writeChunk->amountOfByteInThisChunk, data, size);
         writeChunk->amountOfByteInThisChunk += size;
         writeChunk->amountOfByteInThisChunk = Utility::NextMultipleOf(writeChunk->amountOfByteInThisChunk, sizeof(QueueEntryHeader));
     }
@@ -53,7 +54,7 @@ void ChunkedPacketQueue::AddMessageRaw(u8* data, u16 size)
         // The data must be split between the current writeChunk and a new chunk
         if (sizeLeftInCurrentWriteChunk > 0)
         {
-            CheckedMemcpy(writeChunk->data.data() + writeChunk->amountOfByteInThisChunk, data, sizeLeftInCurrentWriteChunk);
+            CheckedMemcpy(writeChunk->data + writeChunk->amountOfByteInThisChunk, data, sizeLeftInCurrentWriteChunk);
             writeChunk->amountOfByteInThisChunk += sizeLeftInCurrentWriteChunk;
             writeChunk->amountOfByteInThisChunk = Utility::NextMultipleOf(writeChunk->amountOfByteInThisChunk, sizeof(QueueEntryHeader));
         }
@@ -64,9 +65,10 @@ void ChunkedPacketQueue::AddMessageRaw(u8* data, u16 size)
             SIMEXCEPTION(IllegalStateException);
             return;
         }
+        allocatedBytes += newChunk->capacity;
         writeChunk->nextChunk = newChunk;
         writeChunk = newChunk;
-        CheckedMemcpy(writeChunk->data.data(), data + sizeLeftInCurrentWriteChunk, size - sizeLeftInCurrentWriteChunk);
+        CheckedMemcpy(writeChunk->data, data + sizeLeftInCurrentWriteChunk, size - sizeLeftInCurrentWriteChunk);
         writeChunk->amountOfByteInThisChunk += size - sizeLeftInCurrentWriteChunk;
         writeChunk->amountOfByteInThisChunk = Utility::NextMultipleOf(writeChunk->amountOfByteInThisChunk, sizeof(QueueEntryHeader));
     }
@@ -74,8 +76,8 @@ void ChunkedPacketQueue::AddMessageRaw(u8* data, u16 size)
 
 u16 ChunkedPacketQueue::PeekPacketRaw(u8* outData, u16 outDataSize, const ConnectionQueueMemoryChunk* chunk, u32 head) const
 {
-    const QueueEntryHeader* header = (const QueueEntryHeader*)(chunk->data.data() + head);
-    if (header->reserved != 0)
+    const QueueEntryHeader* header = (const QueueEntryHeader*)(chunk->data + head);
+    if (header->size > MAX_MESH_PACKET_SIZE)
     {
         SIMEXCEPTION(MemoryCorruptionException);
         return 0;
@@ -100,29 +102,79 @@ u16 ChunkedPacketQueue::PeekPacketRaw(u8* outData, u16 outDataSize, const Connec
     static_assert(sizeof(QueueEntryHeader) % sizeof(u32) == 0, "Sizeof QueueEntryHeader must be a multiple of 4!");
     const u32 messageStartOffset = head + sizeof(QueueEntryHeader);
 
-    if (messageStartOffset + header->size < CONNECTION_QUEUE_MEMORY_CHUNK_SIZE)
+    if (messageStartOffset + header->size < chunk->capacity)
     {
         // The message can be read from a single chunk.
-        CheckedMemcpy(outData, chunk->data.data() + messageStartOffset, header->size);
+        CheckedMemcpy(outData, chunk->data + messageStartOffset, header->size);
     }
     else
     {
         // The message is split across two chunks.
-        const u32 amountOfDataInFirstChunk = CONNECTION_QUEUE_MEMORY_CHUNK_SIZE > messageStartOffset ? CONNECTION_QUEUE_MEMORY_CHUNK_SIZE - messageStartOffset : 0;
+        const u32 amountOfDataInFirstChunk = chunk->capacity > messageStartOffset ? chunk->capacity - messageStartOffset : 0;
         if (amountOfDataInFirstChunk > 0)
         {
-            CheckedMemcpy(outData, chunk->data.data() + messageStartOffset, amountOfDataInFirstChunk);
+            CheckedMemcpy(outData, chunk->data + messageStartOffset, amountOfDataInFirstChunk);
         }
         const u32 amountOfDataInSecondChunk = header->size - amountOfDataInFirstChunk;
         if (amountOfDataInSecondChunk > 0)
         {
-            CheckedMemcpy(outData + amountOfDataInFirstChunk, chunk->nextChunk->data.data(), amountOfDataInSecondChunk);
+            CheckedMemcpy(outData + amountOfDataInFirstChunk, chunk->nextChunk->data, amountOfDataInSecondChunk);
         }
     }
 
     return header->size;
 }
 
+ChunkedPacketQueue::ChunkHeadPair ChunkedPacketQueue::GetNextChunkHeadPair(const ChunkHeadPair& pair) const
+{
+    const QueueEntryHeader* header = (const QueueEntryHeader*)(pair.chunk->data + pair.head);
+    ChunkHeadPair retVal = pair;
+    retVal.head += sizeof(QueueEntryHeader);
+    retVal.head += header->size;
+    retVal.head = Utility::NextMultipleOf(retVal.head, sizeof(QueueEntryHeader));
+    if (retVal.head >= retVal.chunk->capacity)
+    {
+        if (retVal.chunk->nextChunk == nullptr)
+        {
+            // (Probably) An implementation error! We reached the end of the chunk linked
+            // list, but the caller expected another entry. This may also be some MemoryCorruption.
+            SIMEXCEPTION(IllegalStateException);
+            return ChunkHeadPair{ nullptr, 0 };
+        }
+        retVal.head -= retVal.chunk->capacity;
+        retVal.chunk = retVal.chunk->nextChunk;
+    }
+    return retVal;
+}
+
+u16 ChunkedPacketQueue::EncodePosition(const ConnectionQueueMemoryChunk* chunk, u32 head)
+{
+    // Entries are aligned to the header size, so the lower bits of the head are always zero.
+    static_assert(sizeof(QueueEntryHeader) == 4 && CONNECTION_QUEUE_MEMORY_CHUNK_SIZE <= 256, "The head must fit into 6 bits after removing the alignment.");
+    static_assert(ConnectionQueueMemoryAllocator::TOTAL_CHUNK_AMOUNT <= 1024, "The chunk index must fit into 10 bits.");
+    return (u16)((GS->connectionQueueMemoryAllocator.GetChunkIndex(chunk) << 6) | (head >> 2));
+}
+
+ChunkedPacketQueue::ChunkHeadPair ChunkedPacketQueue::DecodePosition(u16 position)
+{
+    return ChunkHeadPair{ GS->connectionQueueMemoryAllocator.GetChunkByIndex(position >> 6), (u32)(position & 0x3F) << 2 };
+}
+
+void ChunkedPacketQueue::FillOffsetIndex()
+{
+    // Appends the position of the oldest packet that is not yet part of the index.
+    const u32 amountOfIndexedPackets = offsetIndex.GetAmountOfElements();
+    if (amountOfIndexedPackets >= amountOfPackets || offsetIndex.IsFull()) return;
+
+    ChunkHeadPair pair{ readChunk, readChunk->currentReadHead };
+    if (amountOfIndexedPackets > 0)
+    {
+        pair = GetNextChunkHeadPair(DecodePosition(offsetIndex.PeekAt(amountOfIndexedPackets - 1)));
+    }
+    if (pair.chunk == nullptr) return;
+    offsetIndex.Push(EncodePosition(pair.chunk, pair.head));
+}
+
 ChunkedPacketQueue::ChunkHeadPair ChunkedPacketQueue::GetChunkHeadPairOfIndex(u16 index) const
 {
 
@@ -132,39 +184,47 @@ ChunkedPacketQueue::ChunkHeadPair ChunkedPacketQueue::GetChunkHeadPairOfIndex(u1
         return ChunkHeadPair{ nullptr, 0 };
     }
 
-    // Search for the chunk and the head
-    ConnectionQueueMemoryChunk* currentChunk = readChunk;
-    u32 currentHead = readChunk->currentReadHead;
-    for (u16 i = 0; i < index; i++)
+    const u32 amountOfIndexedPackets = offsetIndex.GetAmountOfElements();
+    if (index < amountOfIndexedPackets)
     {
-        const QueueEntryHeader* header = (const QueueEntryHeader*)(currentChunk->data.data() + currentHead);
-        currentHead += sizeof(QueueEntryHeader);
-        currentHead += header->size;
-        currentHead = Utility::NextMultipleOf(currentHead, sizeof(QueueEntryHeader));
-        if (currentHead >= CONNECTION_QUEUE_MEMORY_CHUNK_SIZE)
-        {
-            if (currentChunk->nextChunk == nullptr)
-            {
-                // (Probably) An implementation error! The random access peek reached the
-                // end of the chunk linked list, but did not yet reach the searched index.
-                // This may also be some MemoryCorruption.
-                SIMEXCEPTION(IllegalStateException);
-                return ChunkHeadPair{ nullptr, 0 };
-            }
-            currentChunk = currentChunk->nextChunk;
-            currentHead -= CONNECTION_QUEUE_MEMORY_CHUNK_SIZE;
-        }
+        return DecodePosition(offsetIndex.PeekAt(index));
+    }
+
+    // Packets that are not part of the index are searched starting at the cursor if it lies
+    // between the last indexed packet and the searched one, else at the last indexed packet.
+    ChunkHeadPair pair{ readChunk, readChunk->currentReadHead };
+    u32 currentIndex = 0;
+    if (cursor.chunk != nullptr && cursorIndex <= index && cursorIndex + 1 >= amountOfIndexedPackets)
+    {
+        currentIndex = cursorIndex;
+        pair = cursor;
+    }
+    else if (amountOfIndexedPackets > 0)
+    {
+        currentIndex = amountOfIndexedPackets - 1;
+        pair = DecodePosition(offsetIndex.PeekAt(currentIndex));
+    }
+    for (; currentIndex < index; currentIndex++)
+    {
+        pair = GetNextChunkHeadPair(pair);
+        if (pair.chunk == nullptr) return pair;
     }
 
-    return ChunkHeadPair{ currentChunk, currentHead };
+    cursor = pair;
+    cursorIndex = index;
+    return pair;
 }
 
 ChunkedPacketQueue::ChunkedPacketQueue()
 {
-    readChunk = GS->connectionQueueMemoryAllocator.Allocate(true);
+    readChunk = GS->connectionQueueMemoryAllocator.AllocateQueueHead();
     writeChunk = readChunk;
     lookAheadChunk = readChunk;
-    if (!readChunk)
+    if (readChunk)
+    {
+        allocatedBytes = readChunk->capacity;
+    }
+    else
     {
         //This must never happen. If it does, it indicates an implementation error.
         //The connectionQueueMemoryAllocator must always have enough chunks to support
@@ -219,8 +279,9 @@ bool ChunkedPacketQueue::SplitAndAddMessage(u8* data, const u16 size, const u16
     const u32 sizeInQueueOfStartingSplits = Utility::NextMultipleOf(Utility::NextMultipleOf(payloadSizePerSplit - SIZEOF_CONN_PACKET_SPLIT_HEADER, sizeof(QueueEntryHeader)) + SIZEOF_CONN_PACKET_SPLIT_HEADER, sizeof(QueueEntryHeader)) + sizeof(QueueEntryHeader);
     const u32 sizeInQueueOfLastSplit = Utility::NextMultipleOf(Utility::NextMultipleOf(size - (payloadSizePerSplit - SIZEOF_CONN_PACKET_SPLIT_HEADER) * (amountOfSplits - 1), sizeof(QueueEntryHeader)) + SIZEOF_CONN_PACKET_SPLIT_HEADER, sizeof(QueueEntryHeader)) + sizeof(QueueEntryHeader);
     const u32 sizeInQueue = sizeInQueueOfStartingSplits * (amountOfSplits - 1) + sizeInQueueOfLastSplit;
-    const u32 amountOfExtraChunks = (sizeInQueue - (CONNECTION_QUEUE_MEMORY_CHUNK_SIZE - readChunk->amountOfByteInThisChunk)) / CONNECTION_QUEUE_MEMORY_CHUNK_SIZE + 1;
-    if (CONNECTION_QUEUE_MEMORY_CHUNK_SIZE - readChunk->amountOfByteInThisChunk < sizeInQueue && GS->connectionQueueMemoryAllocator.IsChunkAvailable(false, amountOfExtraChunks + (u32)prio) == false)
+    const u32 sizeLeftInWriteChunk = writeChunk->capacity - writeChunk->amountOfByteInThisChunk;
+    const u32 amountOfExtraChunks = sizeLeftInWriteChunk < sizeInQueue ? (sizeInQueue - sizeLeftInWriteChunk) / CONNECTION_QUEUE_MEMORY_CHUNK_SIZE + 1 : 0;
+    if (amountOfExtraChunks > 0 && GS->connectionQueueMemoryAllocator.IsChunkAvailable(false, amountOfExtraChunks + (u32)prio) == false)
     {
         // If there is no memory left for this message.
         return false;
@@ -285,11 +346,12 @@ bool ChunkedPacketQueue::AddMessage(u8* data, u16 size, bool isSplit)
     // The following assumption is because the implementation never splits data over mutliple chunks. Thus, if one
     // chunk is completely full, the message must always be placable in a new chunk (as long as one is available).
     // A "split" in this context means a split across multiple chunks, NOT across multiple packets.
+    // Only the first chunk of a queue may be small, all chunks that are appended later are full sized.
     static_assert(MAX_MESH_PACKET_SIZE + sizeof(QueueEntryHeader) <= CONNECTION_QUEUE_MEMORY_CHUNK_SIZE,
         "The implementation of this class assumes that a maximum packet size plus the size of a header always fits in a freshly allocated chunk.");
     const u16 sizeInQueue = Utility::NextMultipleOf(size + sizeof(QueueEntryHeader), sizeof(QueueEntryHeader));
     if (
-        CONNECTION_QUEUE_MEMORY_CHUNK_SIZE - writeChunk->amountOfByteInThisChunk < sizeInQueue 
+        writeChunk->capacity - writeChunk->amountOfByteInThisChunk < sizeInQueue
         && GS->connectionQueueMemoryAllocator.IsChunkAvailable(false, 1 + (u32)prio) == false // Make sure that higher prio queues are still able to allocate at least one chunk.
         )
     {
@@ -301,11 +363,17 @@ bool ChunkedPacketQueue::AddMessage(u8* data, u16 size, bool isSplit)
     CheckedMemset(&header, 0, sizeof(header));
     header.size = size;
     header.isSplit = isSplit;
+    header.enqueueTimestamp = GetCurrentEnqueueTimestamp();
     AddMessageRaw((u8*)&header, sizeof(header));
+    // A header is never split across chunks, so it ends exactly at the current write position.
+    if (offsetIndex.GetAmountOfElements() == amountOfPackets && !offsetIndex.IsFull())
+    {
+        offsetIndex.Push(EncodePosition(writeChunk, writeChunk->amountOfByteInThisChunk - sizeof(QueueEntryHeader)));
+    }
     AddMessageRaw(data, size);
     amountOfPackets++;
 
-    if (lookAheadChunk->currentLookAheadHead == CONNECTION_QUEUE_MEMORY_CHUNK_SIZE)
+    if (lookAheadChunk->currentLookAheadHead == lookAheadChunk->capacity)
     {
         // Edge case! If we have looked ahead through all the available messages, hit exactly the end of
         // the last chunk and then add a new message, the lookAhead is not moved to the new chunk.
@@ -339,19 +407,23 @@ void ChunkedPacketQueue::PopPacket()
         return;
     }
     const bool needToMoveLookAhead = IsLookAheadAndReadSame(); // If the look ahead is the same as the read, we have to move the look ahead with the read as else the look ahead would point to invalid data.
-    const u16 size = ((QueueEntryHeader*)(readChunk->data.data() + readChunk->currentReadHead))->size;
+    if (!needToMoveLookAhead) amountOfPacketsLookedAhead--;
+    offsetIndex.Pop();
+    const u16 size = ((QueueEntryHeader*)(readChunk->data + readChunk->currentReadHead))->size;
     const u16 sizeToPop = size + sizeof(QueueEntryHeader);
     const u16 oldReadHead = readChunk->currentReadHead;
     readChunk->currentReadHead += sizeToPop;
     readChunk->currentReadHead = Utility::NextMultipleOf(readChunk->currentReadHead, sizeof(QueueEntryHeader));
     if (needToMoveLookAhead) readChunk->currentLookAheadHead = readChunk->currentReadHead;
-    if (readChunk->currentReadHead >= CONNECTION_QUEUE_MEMORY_CHUNK_SIZE && readChunk != writeChunk)
+    if (readChunk->currentReadHead >= readChunk->capacity && readChunk != writeChunk)
     {
         auto oldReadChunk = readChunk;
+        const u16 oldReadChunkCapacity = oldReadChunk->capacity;
         readChunk = readChunk->nextChunk;
         if (needToMoveLookAhead) lookAheadChunk = readChunk;
+        allocatedBytes -= oldReadChunkCapacity;
         GS->connectionQueueMemoryAllocator.Deallocate(oldReadChunk);
-        const u16 sizeRemovedFromFirstChunk = (CONNECTION_QUEUE_MEMORY_CHUNK_SIZE > oldReadHead ? CONNECTION_QUEUE_MEMORY_CHUNK_SIZE - oldReadHead : 0);
+        const u16 sizeRemovedFromFirstChunk = (oldReadChunkCapacity > oldReadHead ? oldReadChunkCapacity - oldReadHead : 0);
         if (sizeToPop > sizeRemovedFromFirstChunk)
         {
             // If the end of the popped message reaches into the next chunk
@@ -366,9 +438,27 @@ void ChunkedPacketQueue::PopPacket()
     {
         // If we have read all the bytes from the current readChunk and this is the only chunk,
         // we can reset the chunk to avoid giving it back to the allocator at some point.
-        readChunk->Reset();
+        // An idle queue should not pin a full sized chunk though, so it is exchanged for a small one.
+        if (!readChunk->IsSmall() && GS->connectionQueueMemoryAllocator.IsSmallChunkAvailable())
+        {
+            allocatedBytes -= readChunk->capacity;
+            GS->connectionQueueMemoryAllocator.Deallocate(readChunk);
+            readChunk = GS->connectionQueueMemoryAllocator.AllocateQueueHead();
+            writeChunk = readChunk;
+            lookAheadChunk = readChunk;
+            allocatedBytes += readChunk->capacity;
+        }
+        else
+        {
+            readChunk->Reset();
+        }
     }
     amountOfPackets--;
+    FillOffsetIndex();
+    // The packet under the cursor keeps its position, only its index moves by one. If the popped
+    // packet was under the cursor, the chunk it pointed to may already be deallocated.
+    if (cursorIndex > 0) cursorIndex--;
+    else cursor = ChunkHeadPair{ nullptr, 0 };
 }
 
 bool ChunkedPacketQueue::HasPackets() const
@@ -414,6 +504,40 @@ u16 ChunkedPacketQueue::PeekLookAhead(u8* outData, u16 outDataSize) const
     return PeekPacketRaw(outData, outDataSize, lookAheadChunk, lookAheadChunk->currentLookAheadHead);
 }
 
+const ChunkedPacketQueue::QueueEntryHeader* ChunkedPacketQueue::GetLookAheadHeader() const
+{
+    // Headers are aligned to their own size and the chunk size is a multiple of it, so a
+    // header is never split between two chunks and can be read in place.
+    static_assert(CONNECTION_QUEUE_MEMORY_CHUNK_SIZE % sizeof(QueueEntryHeader) == 0 && CONNECTION_QUEUE_MEMORY_SMALL_CHUNK_SIZE % sizeof(QueueEntryHeader) == 0, "A QueueEntryHeader must never cross a chunk boundary!");
+    return (const QueueEntryHeader*)(lookAheadChunk->data + lookAheadChunk->currentLookAheadHead);
+}
+
+u16 ChunkedPacketQueue::GetCurrentEnqueueTimestamp()
+{
+    return (FruityHal::GetRtcMs() / QUEUE_ENTRY_TIMESTAMP_RESOLUTION_MS) & 0x7FFF;
+}
+
+u16 ChunkedPacketQueue::GetLookAheadSize() const
+{
+    if (!HasMoreToLookAhead())
+    {
+        SIMEXCEPTION(IllegalStateException);
+        return 0;
+    }
+    return GetLookAheadHeader()->size;
+}
+
+u32 ChunkedPacketQueue::GetLookAheadQueueingTimeMs() const
+{
+    if (!HasMoreToLookAhead())
+    {
+        SIMEXCEPTION(IllegalStateException);
+        return 0;
+    }
+    const u16 passedUnits = (GetCurrentEnqueueTimestamp() - GetLookAheadHeader()->enqueueTimestamp) & 0x7FFF;
+    return passedUnits * QUEUE_ENTRY_TIMESTAMP_RESOLUTION_MS;
+}
+
 void ChunkedPacketQueue::IncrementLookAhead()
 {
     if (!HasMoreToLookAhead())
@@ -421,17 +545,19 @@ void ChunkedPacketQueue::IncrementLookAhead()
         SIMEXCEPTION(IllegalStateException);
         return;
     }
-    const QueueEntryHeader* header = ((const QueueEntryHeader*)(lookAheadChunk->data.data() + lookAheadChunk->currentLookAheadHead));
+    amountOfPacketsLookedAhead++;
+    const QueueEntryHeader* header = GetLookAheadHeader();
     isCurrentlySendingSplitMessage = header->isSplit == 1 ? true : false;
     const u16 size = header->size;
     const u16 sizeToJump = size + sizeof(QueueEntryHeader);
     const u16 oldReadHead = lookAheadChunk->currentLookAheadHead;
     lookAheadChunk->currentLookAheadHead += sizeToJump;
     lookAheadChunk->currentLookAheadHead = Utility::NextMultipleOf(lookAheadChunk->currentLookAheadHead, sizeof(QueueEntryHeader));
-    if (lookAheadChunk->currentLookAheadHead >= CONNECTION_QUEUE_MEMORY_CHUNK_SIZE && lookAheadChunk != writeChunk)
+    if (lookAheadChunk->currentLookAheadHead >= lookAheadChunk->capacity && lookAheadChunk != writeChunk)
     {
+        const u16 oldLookAheadChunkCapacity = lookAheadChunk->capacity;
         lookAheadChunk = lookAheadChunk->nextChunk;
-        const u16 sizeRemovedFromFirstChunk = (CONNECTION_QUEUE_MEMORY_CHUNK_SIZE > oldReadHead ? CONNECTION_QUEUE_MEMORY_CHUNK_SIZE - oldReadHead : 0);
+        const u16 sizeRemovedFromFirstChunk = (oldLookAheadChunkCapacity > oldReadHead ? oldLookAheadChunkCapacity - oldReadHead : 0);
         if (sizeToJump > sizeRemovedFromFirstChunk)
         {
             // If the end of the popped message reaches into the next chunk
@@ -444,6 +570,7 @@ void ChunkedPacketQueue::IncrementLookAhead()
 
 void ChunkedPacketQueue::RollbackLookAhead()
 {
+    amountOfPacketsLookedAhead = 0;
     lookAheadChunk->currentLookAheadHead = lookAheadChunk->currentReadHead;
     auto currentChunk = readChunk;
     while (currentChunk != lookAheadChunk)
@@ -456,21 +583,12 @@ void ChunkedPacketQueue::RollbackLookAhead()
 
 bool ChunkedPacketQueue::IsRandomAccessIndexLookedAhead(u16 index) const
 {
-    const ChunkHeadPair pair = GetChunkHeadPairOfIndex(index);
-
-    if (pair.chunk == lookAheadChunk)
-    {
-        return pair.head < lookAheadChunk->currentLookAheadHead;
-    }
-
-    ConnectionQueueMemoryChunk* currentChunk = readChunk;
-    while (currentChunk != lookAheadChunk)
+    if (index >= amountOfPackets)
     {
-        if (currentChunk == pair.chunk) return true;
-        currentChunk = currentChunk->nextChunk;
+        SIMEXCEPTION(IllegalArgumentException);
+        return false;
     }
-
-    return false;
+    return index < amountOfPacketsLookedAhead;
 }
 
 u32 ChunkedPacketQueue::GetAmountOfPackets() const
@@ -478,6 +596,11 @@ u32 ChunkedPacketQueue::GetAmountOfPackets() const
     return amountOfPackets;
 }
 
+u32 ChunkedPacketQueue::GetAllocatedBytes() const
+{
+    return allocatedBytes;
+}
+
 void ChunkedPacketQueue::Print() const
 {
     trace("Amount of Packets: %u" EOL, GetAmountOfPackets());
@@ -537,8 +660,15 @@ void ChunkedPacketQueue::SimReset()
         currentChunk = nextChunk;
     }
 
-    readChunk = GS->connectionQueueMemoryAllocator.Allocate(true);
+    readChunk = GS->connectionQueueMemoryAllocator.AllocateQueueHead();
     writeChunk = readChunk;
     lookAheadChunk = readChunk;
+    allocatedBytes = readChunk->capacity;
+    amountOfPackets = 0;
+    amountOfPacketsLookedAhead = 0;
+    isCurrentlySendingSplitMessage = false;
+    offsetIndex.Reset();
+    cursor = ChunkHeadPair{ nullptr, 0 };
+    cursorIndex = 0;
 }
 #endif
@@ -32,6 +32,12 @@
 
 #include "FmTypes.h"
 #include "ConnectionQueueMemoryAllocator.h"
+#include "SimpleQueue.h"
+
+// Every queue entry stores the time at which it was added so that the time until it is handed
+// to the HAL can be measured. The timestamp has 15 bits in units of this resolution, so it
+// wraps after roughly 262 seconds.
+constexpr u32 QUEUE_ENTRY_TIMESTAMP_RESOLUTION_MS = 8;
 
 /*
 * A specialized queue implementation for packets that are about to be sent through a connection.
@@ -49,13 +55,20 @@ private:
     ConnectionQueueMemoryChunk* lookAheadChunk = nullptr;
     ConnectionQueueMemoryChunk* writeChunk     = nullptr;
     u32 amountOfPackets = 0;
+    u32 allocatedBytes = 0; //Capacity of all chunks that are currently held by this queue
+    u32 amountOfPacketsLookedAhead = 0;
     bool isCurrentlySendingSplitMessage = false;
 
+    // Encoded positions (see EncodePosition) of the oldest packets in the queue. This is a bounded
+    // cache that holds min(amountOfPackets, CHUNKED_PACKET_QUEUE_OFFSET_INDEX_SIZE) entries, see Config.h
+    // for its RAM cost. Packets behind it are found by walking the chunks.
+    SimpleQueue<u16, CHUNKED_PACKET_QUEUE_OFFSET_INDEX_SIZE + 1> offsetIndex;
+
     struct QueueEntryHeader
     {
         u16 size;
         u16 isSplit : 1;
-        u16 reserved : 15;
+        u16 enqueueTimestamp : 15; //In units of QUEUE_ENTRY_TIMESTAMP_RESOLUTION_MS
     };
 
     struct ChunkHeadPair
@@ -64,9 +77,20 @@ private:
         u32 head;
     };
 
+    // Position of the packet that was last accessed behind the offsetIndex. Enumerating the
+    // queue in order continues from here so that every step only walks over a single packet.
+    mutable ChunkHeadPair cursor = { nullptr, 0 };
+    mutable u32 cursorIndex = 0;
+
     void AddMessageRaw(u8* data, u16 size);
     u16 PeekPacketRaw(u8* outData, u16 outDataSize, const ConnectionQueueMemoryChunk* chunk, u32 head) const;
+    const QueueEntryHeader* GetLookAheadHeader() const;
+    static u16 GetCurrentEnqueueTimestamp();
     ChunkHeadPair GetChunkHeadPairOfIndex(u16 index) const;
+    ChunkHeadPair GetNextChunkHeadPair(const ChunkHeadPair& pair) const;
+    static u16 EncodePosition(const ConnectionQueueMemoryChunk* chunk, u32 head);
+    static ChunkHeadPair DecodePosition(u16 position);
+    void FillOffsetIndex();
 
     DeliveryPriority prio = DeliveryPriority::VITAL;
 
@@ -81,7 +105,7 @@ public:
     
     bool AddMessage(u8* data, u16 size, bool isSplit = false);
     u16 PeekPacket      (u8* outData, u16 outDataSize) const;
-    u16 RandomAccessPeek(u8* outData, u16 outDataSize, u16 index) const; //Careful, very expensive!
+    u16 RandomAccessPeek(u8* outData, u16 outDataSize, u16 index) const; //Cheap for the first CHUNKED_PACKET_QUEUE_OFFSET_INDEX_SIZE packets and when enumerating in ascending order
     void PopPacket();
     bool HasPackets() const;
     bool IsCurrentlySendingSplitMessage() const;
@@ -91,11 +115,14 @@ public:
     bool IsLookAheadAndReadSame() const;
     bool HasMoreToLookAhead() const;
     u16 PeekLookAhead(u8* outData, u16 outDataSize) const;
+    u16 GetLookAheadSize() const;
+    u32 GetLookAheadQueueingTimeMs() const; //Time that the next look ahead entry has spent in the queue so far
     void IncrementLookAhead();
     void RollbackLookAhead();
     bool IsRandomAccessIndexLookedAhead(u16 index) const;
 
     u32 GetAmountOfPackets() const;
+    u32 GetAllocatedBytes() const;
     void Print() const;
 
     DeliveryPriority GetPriority() const;
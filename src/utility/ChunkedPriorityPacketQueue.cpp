@@ -30,6 +30,8 @@
 
 #include "ChunkedPriorityPacketQueue.h"
 #include "BaseConnection.h"
+#include "GlobalState.h"
+#include "Logger.h"
 #include "Utility.h"
 
 QueuePriorityPair ChunkedPriorityPacketQueue::GetSplitQueue()
@@ -84,10 +86,11 @@ bool ChunkedPriorityPacketQueue::SplitAndAddMessage(DeliveryPriority prio, u8* d
     }
 
     constexpr u32 MAX_VITAL_SIZE = 20 + SIZEOF_BASE_CONNECTION_SEND_DATA_PACKED;
+    bool successfullyAdded = false;
 
     if (prio == DeliveryPriority::VITAL && size <= MAX_VITAL_SIZE)
     {
-        return queues[(u32)DeliveryPriority::VITAL].AddMessage(data, size, false);
+        successfullyAdded = queues[(u32)DeliveryPriority::VITAL].AddMessage(data, size, false);
     }
     else
     {
@@ -103,8 +106,13 @@ bool ChunkedPriorityPacketQueue::SplitAndAddMessage(DeliveryPriority prio, u8* d
             prio = DeliveryPriority::HIGH;
             logt("FATAL", "Vital queue message had to be queued with high prio queue because it was too large!");
         }
-        return queues[(u32)prio].SplitAndAddMessage(data, size, payloadSizePerSplit);
+        successfullyAdded = queues[(u32)prio].SplitAndAddMessage(data, size, payloadSizePerSplit);
     }
+
+    // Chunks are only allocated when adding messages, so this is the only place where the high water mark can change.
+    const u32 allocatedBytes = GetAllocatedBytes();
+    if (allocatedBytes > allocatedBytesHighWater) allocatedBytesHighWater = allocatedBytes;
+    return successfullyAdded;
 }
 
 u32 ChunkedPriorityPacketQueue::GetAmountOfPackets() const
@@ -117,6 +125,21 @@ u32 ChunkedPriorityPacketQueue::GetAmountOfPackets() const
     return retVal;
 }
 
+u32 ChunkedPriorityPacketQueue::GetAllocatedBytes() const
+{
+    u32 retVal = 0;
+    for (u32 i = 0; i < queues.size(); i++)
+    {
+        retVal += queues[i].GetAllocatedBytes();
+    }
+    return retVal;
+}
+
+u32 ChunkedPriorityPacketQueue::GetAllocatedBytesHighWater() const
+{
+    return allocatedBytesHighWater;
+}
+
 bool ChunkedPriorityPacketQueue::IsCurrentlySendingSplitMessage() const
 {
     return GetSplitQueue().queue != nullptr;
@@ -138,6 +161,19 @@ QueuePriorityPair ChunkedPriorityPacketQueue::GetSendQueue()
         return retVal;
     }
 
+    if (GS->cm.queueSchedulingMode == QueueSchedulingMode::DEFICIT_ROUND_ROBIN)
+    {
+        return GetSendQueueByDeficitRoundRobin();
+    }
+    return GetSendQueueByPriorityDroplets();
+}
+
+QueuePriorityPair ChunkedPriorityPacketQueue::GetSendQueueByPriorityDroplets()
+{
+    QueuePriorityPair retVal;
+    retVal.priority = DeliveryPriority::INVALID;
+    retVal.queue = nullptr;
+
     //We have to iterate twice in case every queue has a priority droplet overflow.
     //In such a case, all droplets are removed and we start again from the top.
     for (u32 repeat = 0; repeat < 2; repeat++)
@@ -163,6 +199,103 @@ QueuePriorityPair ChunkedPriorityPacketQueue::GetSendQueue()
     return retVal;
 }
 
+QueuePriorityPair ChunkedPriorityPacketQueue::GetSendQueueByDeficitRoundRobin()
+{
+    QueuePriorityPair retVal;
+    retVal.priority = DeliveryPriority::INVALID;
+    retVal.queue = nullptr;
+
+    // The deficit is only charged in IncrementLookAhead, so asking again after the HAL
+    // was busy returns the same queue. Split parts are charged as well, which may leave
+    // a deficit of up to about two maximum sized packets below zero. The loop is bounded
+    // by the amount of rounds that are needed to pay that back with the smallest quantum.
+    constexpr u32 MAX_VISITS = (AMOUNT_OF_SEND_QUEUE_PRIORITIES - 1) * ((3 * MAX_MESH_PACKET_SIZE) / DEFICIT_ROUND_ROBIN_MIN_QUANTUM + 2);
+    for (u32 visit = 0; visit < MAX_VISITS; visit++)
+    {
+        const u32 i = deficitRoundRobinIndex;
+        if (!queues[i].HasMoreToLookAhead())
+        {
+            // An idle queue must not save up its quantum.
+            if (deficits[i] > 0) deficits[i] = 0;
+            AdvanceDeficitRoundRobin();
+            continue;
+        }
+        if (!deficitRoundRobinQuantumGranted)
+        {
+            u16 quantum = GS->cm.deficitRoundRobinQuanta[i];
+            if (quantum < DEFICIT_ROUND_ROBIN_MIN_QUANTUM) quantum = DEFICIT_ROUND_ROBIN_MIN_QUANTUM;
+            deficits[i] += quantum;
+            deficitRoundRobinQuantumGranted = true;
+        }
+        if (deficits[i] >= (i32)queues[i].GetLookAheadSize())
+        {
+            retVal.priority = (DeliveryPriority)i;
+            retVal.queue = &queues[i];
+            return retVal;
+        }
+        AdvanceDeficitRoundRobin();
+    }
+
+    // Should not be reachable. Falling back to strict priorities makes sure that we never stop sending.
+    SIMEXCEPTION(IllegalStateException);
+    for (u32 i = 1; i < queues.size(); i++)
+    {
+        if (queues[i].HasMoreToLookAhead())
+        {
+            retVal.priority = (DeliveryPriority)i;
+            retVal.queue = &queues[i];
+            return retVal;
+        }
+    }
+    return retVal;
+}
+
+void ChunkedPriorityPacketQueue::AdvanceDeficitRoundRobin()
+{
+    deficitRoundRobinIndex++;
+    if (deficitRoundRobinIndex >= queues.size())
+    {
+        // VITAL is not part of the round robin.
+        deficitRoundRobinIndex = 1;
+    }
+    deficitRoundRobinQuantumGranted = false;
+}
+
+void ChunkedPriorityPacketQueue::IncrementLookAhead(const QueuePriorityPair& queuePriorityPair)
+{
+    ChunkedPacketQueue* queue = queuePriorityPair.queue;
+    const u32 prio = (u32)queuePriorityPair.priority;
+    if (queue == nullptr || prio >= AMOUNT_OF_SEND_QUEUE_PRIORITIES)
+    {
+        SIMEXCEPTION(IllegalArgumentException);
+        return;
+    }
+
+    RecordLatency(queuePriorityPair.priority, queue->GetLookAheadQueueingTimeMs());
+    if (prio != (u32)DeliveryPriority::VITAL && GS->cm.queueSchedulingMode == QueueSchedulingMode::DEFICIT_ROUND_ROBIN)
+    {
+        deficits[prio] -= queue->GetLookAheadSize();
+    }
+    queue->IncrementLookAhead();
+}
+
+void ChunkedPriorityPacketQueue::RecordLatency(DeliveryPriority prio, u32 latencyMs)
+{
+    QueueLatencyStats& stats = latencyStats[(u32)prio];
+    u32 bucket = 0;
+    while (bucket < QUEUE_LATENCY_HISTOGRAM_BUCKETS - 1 && latencyMs >= GetLatencyBucketUpperBoundMs(bucket))
+    {
+        bucket++;
+    }
+    if (stats.histogram[bucket] < UINT16_MAX) stats.histogram[bucket]++;
+    if (latencyMs > stats.maxLatencyMs) stats.maxLatencyMs = latencyMs;
+
+#ifdef SIM_ENABLED
+    static const char* latencyKeys[AMOUNT_OF_SEND_QUEUE_PRIORITIES] = { "queueLatencyMsVital", "queueLatencyMsHigh", "queueLatencyMsMedium", "queueLatencyMsLow" };
+    SIMSTATAVG(latencyKeys[(u32)prio], latencyMs);
+#endif
+}
+
 ChunkedPacketQueue* ChunkedPriorityPacketQueue::GetQueueByPriority(DeliveryPriority prio)
 {
     if ((u32)prio >= AMOUNT_OF_SEND_QUEUE_PRIORITIES)
@@ -179,3 +312,37 @@ void ChunkedPriorityPacketQueue::RollbackLookAhead()
         queues[i].RollbackLookAhead();
     }
 }
+
+const QueueLatencyStats& ChunkedPriorityPacketQueue::GetLatencyStats(DeliveryPriority prio) const
+{
+    if ((u32)prio >= AMOUNT_OF_SEND_QUEUE_PRIORITIES)
+    {
+        SIMEXCEPTION(IllegalArgumentException);
+        prio = DeliveryPriority::VITAL;
+    }
+    return latencyStats[(u32)prio];
+}
+
+void ChunkedPriorityPacketQueue::ResetLatencyStats()
+{
+    CheckedMemset(latencyStats.data(), 0, sizeof(latencyStats));
+}
+
+u32 ChunkedPriorityPacketQueue::GetLatencyBucketUpperBoundMs(u32 bucket)
+{
+    return QUEUE_LATENCY_FIRST_BUCKET_MS << (2 * bucket);
+}
+
+void ChunkedPriorityPacketQueue::PrintLatencyStats() const
+{
+    for (u32 i = 0; i < latencyStats.size(); i++)
+    {
+        const QueueLatencyStats& stats = latencyStats[i];
+        trace("  prio %u, maxMs:%u, deficit:%d, hist:", i, stats.maxLatencyMs, deficits[i]);
+        for (u32 bucket = 0; bucket < stats.histogram.size(); bucket++)
+        {
+            trace(" %u", stats.histogram[bucket]);
+        }
+        trace(EOL);
+    }
+}
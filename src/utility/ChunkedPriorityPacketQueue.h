@@ -49,25 +49,69 @@ struct QueuePriorityPairConst
 constexpr u32 AMOUNT_OF_PRIORITY_DROPLETS_UNTIL_OVERFLOW = 2;
 static_assert(AMOUNT_OF_PRIORITY_DROPLETS_UNTIL_OVERFLOW > 0, "Must be at least 1, else we always overflow and never send.");
 
+// Decides how the HIGH, MEDIUM and LOW queues share the connection. VITAL data and
+// the remaining parts of a split message are always sent first, regardless of the mode.
+enum class QueueSchedulingMode : u8
+{
+    PRIORITY_DROPLETS   = 0, // Each queue may send AMOUNT_OF_PRIORITY_DROPLETS_UNTIL_OVERFLOW packets in a row before lower queues get a turn.
+    DEFICIT_ROUND_ROBIN = 1, // Each queue receives a quantum of bytes per round, which makes the share independent of the packet sizes.
+};
+
+// Quanta in bytes per round for the deficit round robin mode, indexed by DeliveryPriority.
+// VITAL is not scheduled by the round robin and therefore has no quantum.
+constexpr std::array<u16, AMOUNT_OF_SEND_QUEUE_PRIORITIES> DEFAULT_DEFICIT_ROUND_ROBIN_QUANTA = { 0, 240, 160, 80 };
+// Smaller quanta are raised to this value. It bounds the amount of rounds until a maximum sized packet can be sent.
+constexpr u16 DEFICIT_ROUND_ROBIN_MIN_QUANTUM = 20;
+
+// Latency histogram of the time between adding a packet to the queue and handing it to the HAL.
+// Bucket i counts packets with a latency below QUEUE_LATENCY_FIRST_BUCKET_MS * 4^i, the last bucket counts the rest.
+constexpr u32 QUEUE_LATENCY_HISTOGRAM_BUCKETS = 6;
+constexpr u32 QUEUE_LATENCY_FIRST_BUCKET_MS = 16;
+
+struct QueueLatencyStats
+{
+    std::array<u16, QUEUE_LATENCY_HISTOGRAM_BUCKETS> histogram; //Saturates at UINT16_MAX
+    u32 maxLatencyMs;
+};
+
 class ChunkedPriorityPacketQueue
 {
     //See Quality of Service documentation.
 private:
     std::array<ChunkedPacketQueue, AMOUNT_OF_SEND_QUEUE_PRIORITIES> queues = {};
     std::array<u32,                AMOUNT_OF_SEND_QUEUE_PRIORITIES> priorityDroplets = {};
+    std::array<i32,                AMOUNT_OF_SEND_QUEUE_PRIORITIES> deficits = {};
+    std::array<QueueLatencyStats,  AMOUNT_OF_SEND_QUEUE_PRIORITIES> latencyStats = {};
+    u32 allocatedBytesHighWater = 0;
+    u32 deficitRoundRobinIndex = 1;
+    bool deficitRoundRobinQuantumGranted = false;
 
     QueuePriorityPair GetSplitQueue();
     QueuePriorityPairConst GetSplitQueue() const;
+    QueuePriorityPair GetSendQueueByPriorityDroplets();
+    QueuePriorityPair GetSendQueueByDeficitRoundRobin();
+    void AdvanceDeficitRoundRobin();
+    void RecordLatency(DeliveryPriority prio, u32 latencyMs);
 
 public:
     ChunkedPriorityPacketQueue();
 
     bool SplitAndAddMessage(DeliveryPriority prio, u8* data, u16 size, u16 payloadSizePerSplit);
     u32 GetAmountOfPackets() const;
+    u32 GetAllocatedBytes() const;
+    u32 GetAllocatedBytesHighWater() const; //Highest value of GetAllocatedBytes since the creation of the queue
     bool IsCurrentlySendingSplitMessage() const;
     QueuePriorityPair GetSendQueue();
+    // Must be called instead of ChunkedPacketQueue::IncrementLookAhead for the queue returned by
+    // GetSendQueue once its packet was handed to the HAL. Updates the scheduling and latency statistics.
+    void IncrementLookAhead(const QueuePriorityPair& queuePriorityPair);
     ChunkedPacketQueue* GetQueueByPriority(DeliveryPriority prio);
     void RollbackLookAhead();
+
+    const QueueLatencyStats& GetLatencyStats(DeliveryPriority prio) const;
+    void ResetLatencyStats();
+    static u32 GetLatencyBucketUpperBoundMs(u32 bucket);
+    void PrintLatencyStats() const;
 };
 
 
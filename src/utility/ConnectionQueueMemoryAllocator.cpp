@@ -34,33 +34,52 @@
 
 ConnectionQueueMemoryAllocator::ConnectionQueueMemoryAllocator()
 {
-    for (u32 i = 0; i < CONNECTION_QUEUE_MEMORY_CHUNK_AMOUNT - 1; i++)
+    // The first CONNECTION_QUEUE_MEMORY_CHUNK_AMOUNT chunks are full sized, the rest are small.
+    for (u32 i = 0; i < TOTAL_CHUNK_AMOUNT; i++)
     {
-        chunks[i].nextChunk = chunks.data() + i + 1;
+        ConnectionQueueMemoryChunk& chunk = chunks[i];
+        if (i < CONNECTION_QUEUE_MEMORY_CHUNK_AMOUNT)
+        {
+            chunk.data = storage[i].data.data();
+            chunk.capacity = CONNECTION_QUEUE_MEMORY_CHUNK_SIZE;
+#ifdef SIM_ENABLED
+            chunk.memoryGuardStart = &storage[i].memoryGuardStart;
+            chunk.memoryGuardEnd   = &storage[i].memoryGuardEnd;
+#endif
+        }
+        else
+        {
+            const u32 smallIndex = i - CONNECTION_QUEUE_MEMORY_CHUNK_AMOUNT;
+            chunk.data = smallStorage[smallIndex].data.data();
+            chunk.capacity = CONNECTION_QUEUE_MEMORY_SMALL_CHUNK_SIZE;
+#ifdef SIM_ENABLED
+            chunk.memoryGuardStart = &smallStorage[smallIndex].memoryGuardStart;
+            chunk.memoryGuardEnd   = &smallStorage[smallIndex].memoryGuardEnd;
+#endif
+        }
+        const bool isLastOfItsSize = i == CONNECTION_QUEUE_MEMORY_CHUNK_AMOUNT - 1 || i == TOTAL_CHUNK_AMOUNT - 1;
+        chunk.nextChunk = isLastOfItsSize ? nullptr : chunks.data() + i + 1;
     }
-    head = chunks.data();
+    head = CONNECTION_QUEUE_MEMORY_CHUNK_AMOUNT > 0 ? chunks.data() : nullptr;
+    smallHead = CONNECTION_QUEUE_MEMORY_SMALL_CHUNK_AMOUNT > 0 ? chunks.data() + CONNECTION_QUEUE_MEMORY_CHUNK_AMOUNT : nullptr;
 }
 
-ConnectionQueueMemoryChunk* ConnectionQueueMemoryAllocator::Allocate(bool isNewConnection)
+ConnectionQueueMemoryChunk* ConnectionQueueMemoryAllocator::PopFreeChunk(ConnectionQueueMemoryChunk*& freeList)
 {
-    if (!IsChunkAvailable(isNewConnection))
-    {
-        return nullptr;
-    }
-    ConnectionQueueMemoryChunk* retVal = head;
-    head = head->nextChunk;
+    ConnectionQueueMemoryChunk* retVal = freeList;
+    freeList = freeList->nextChunk;
 
 #ifdef SIM_ENABLED
-    if (   retVal->memoryGuardStart != ConnectionQueueMemoryChunk::MEMORY_GUARD_VALUE_START
-        || retVal->memoryGuardEnd   != ConnectionQueueMemoryChunk::MEMORY_GUARD_VALUE_END)
+    if (   *retVal->memoryGuardStart != ConnectionQueueMemoryChunkStorage<0>::MEMORY_GUARD_VALUE_START
+        || *retVal->memoryGuardEnd   != ConnectionQueueMemoryChunkStorage<0>::MEMORY_GUARD_VALUE_END)
     {
-        //These values are written to each chunk and must never be overwritten. If they are,
+        //These values are written around each chunk and must never be overwritten. If they are,
         //some kind of memory corruption occured! This is necessary to check as the Sanitizers
         //do not check for such stuff as we own the complete memory region.
         SIMEXCEPTION(MemoryCorruptionException);
     }
 
-    if (!Utility::CompareMem(0x00, retVal->data.data(), retVal->data.size())) {
+    if (!Utility::CompareMem(0x00, retVal->data, retVal->capacity)) {
         //Probably use after free!
         SIMEXCEPTION(MemoryCorruptionException); //LCOV_EXCL_LINE assertion
     }
@@ -74,21 +93,40 @@ ConnectionQueueMemoryChunk* ConnectionQueueMemoryAllocator::Allocate(bool isNewC
         SIMEXCEPTION(IllegalStateException);
     }
 #endif
-    *retVal = ConnectionQueueMemoryChunk();
+    retVal->Reset();
 #ifdef SIM_ENABLED
     retVal->currentlyOwnedByAllocator = false;
 #endif
-    chunksLeft--;
     return retVal;
 }
 
+ConnectionQueueMemoryChunk* ConnectionQueueMemoryAllocator::Allocate(bool isNewConnection)
+{
+    if (!IsChunkAvailable(isNewConnection))
+    {
+        return nullptr;
+    }
+    chunksLeft--;
+    return PopFreeChunk(head);
+}
+
+ConnectionQueueMemoryChunk* ConnectionQueueMemoryAllocator::AllocateQueueHead()
+{
+    if (!IsSmallChunkAvailable())
+    {
+        return Allocate(true);
+    }
+    smallChunksLeft--;
+    return PopFreeChunk(smallHead);
+}
+
 void ConnectionQueueMemoryAllocator::Deallocate(ConnectionQueueMemoryChunk* chunk)
 {
     if (chunk == nullptr) return;
 
 #ifdef SIM_ENABLED
     bool fromThisAllocator = false;
-    for (u32 i = 0; i < CONNECTION_QUEUE_MEMORY_CHUNK_AMOUNT; i++)
+    for (u32 i = 0; i < TOTAL_CHUNK_AMOUNT; i++)
     {
         if (&chunks[i] == chunk) fromThisAllocator = true;
     }
@@ -104,28 +142,46 @@ void ConnectionQueueMemoryAllocator::Deallocate(ConnectionQueueMemoryChunk* chun
         SIMEXCEPTION(MemoryCorruptionException);
     }
 
-    if (   chunk->memoryGuardStart != ConnectionQueueMemoryChunk::MEMORY_GUARD_VALUE_START
-        || chunk->memoryGuardEnd   != ConnectionQueueMemoryChunk::MEMORY_GUARD_VALUE_END)
+    if (   *chunk->memoryGuardStart != ConnectionQueueMemoryChunkStorage<0>::MEMORY_GUARD_VALUE_START
+        || *chunk->memoryGuardEnd   != ConnectionQueueMemoryChunkStorage<0>::MEMORY_GUARD_VALUE_END)
     {
-        //These values are written to each chunk and must never be overwritten. If they are,
+        //These values are written around each chunk and must never be overwritten. If they are,
         //some kind of memory corruption occured! This is necessary to check as the Sanitizers
         //do not check for such stuff as we own the complete memory region.
         SIMEXCEPTION(MemoryCorruptionException);
     }
+    chunk->currentlyOwnedByAllocator = true;
 #endif
 
-    *chunk = ConnectionQueueMemoryChunk();
-    chunk->nextChunk = head;
-    head = chunk;
-    chunksLeft++;
+    chunk->Reset();
+    if (chunk->IsSmall())
+    {
+        chunk->nextChunk = smallHead;
+        smallHead = chunk;
+        smallChunksLeft++;
+    }
+    else
+    {
+        chunk->nextChunk = head;
+        head = chunk;
+        chunksLeft++;
+    }
 }
 
 bool ConnectionQueueMemoryAllocator::IsChunkAvailable(bool isNewConnection, u32 amountOfChunks) const
 {
+    if (chunksLeft < amountOfChunks)
+    {
+        return false;
+    }
+
     //Make sure that there is always enough place for new connections.
     //A new connection requires at least one chunk for every queue.
     //The total number of connections might be temporarily higher because of a ResolverConnection
-    if (!isNewConnection && chunksLeft - amountOfChunks < ((u32)TOTAL_NUM_CONNECTIONS + 1 - GS->cm.GetConnectionsOfType(ConnectionType::INVALID, ConnectionDirection::INVALID).count) * AMOUNT_OF_SEND_QUEUE_PRIORITIES)
+    //The queues start with a small chunk if one is left, only the queues that can't get one need a full sized chunk.
+    const u32 reservedQueueHeads = ((u32)TOTAL_NUM_CONNECTIONS + 1 - GS->cm.GetConnectionsOfType(ConnectionType::INVALID, ConnectionDirection::INVALID).count) * AMOUNT_OF_SEND_QUEUE_PRIORITIES;
+    const u32 reservedChunks = reservedQueueHeads > smallChunksLeft ? reservedQueueHeads - smallChunksLeft : 0;
+    if (!isNewConnection && chunksLeft - amountOfChunks < reservedChunks)
     {
         return false;
     }
@@ -137,9 +193,49 @@ bool ConnectionQueueMemoryAllocator::IsChunkAvailable(bool isNewConnection, u32
     return true;
 }
 
+bool ConnectionQueueMemoryAllocator::IsSmallChunkAvailable() const
+{
+    return smallHead != nullptr;
+}
+
+u16 ConnectionQueueMemoryAllocator::GetChunkIndex(const ConnectionQueueMemoryChunk* chunk) const
+{
+    if (chunk < chunks.data() || chunk >= chunks.data() + TOTAL_CHUNK_AMOUNT)
+    {
+        SIMEXCEPTION(NotFromThisAllocatorException);
+        return 0;
+    }
+    return (u16)(chunk - chunks.data());
+}
+
+ConnectionQueueMemoryChunk* ConnectionQueueMemoryAllocator::GetChunkByIndex(u16 index)
+{
+    if (index >= TOTAL_CHUNK_AMOUNT)
+    {
+        SIMEXCEPTION(IndexOutOfBoundsException);
+        return nullptr;
+    }
+    return &chunks[index];
+}
+
+u32 ConnectionQueueMemoryAllocator::GetAmountOfFreeChunks() const
+{
+    return chunksLeft;
+}
+
+u32 ConnectionQueueMemoryAllocator::GetAmountOfFreeSmallChunks() const
+{
+    return smallChunksLeft;
+}
+
+bool ConnectionQueueMemoryChunk::IsSmall() const
+{
+    return capacity < CONNECTION_QUEUE_MEMORY_CHUNK_SIZE;
+}
+
 void ConnectionQueueMemoryChunk::Reset()
 {
-    data = {};
+    CheckedMemset(data, 0, capacity);
     nextChunk = nullptr;
     amountOfByteInThisChunk = 0;
     currentReadHead = 0;
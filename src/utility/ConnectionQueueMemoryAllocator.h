@@ -33,48 +33,83 @@
 #include "Config.h"
 #include <array>
 
-static_assert(CONNECTION_QUEUE_MEMORY_CHUNK_AMOUNT >= (TOTAL_NUM_CONNECTIONS + 1) * AMOUNT_OF_SEND_QUEUE_PRIORITIES, "There must be at least enough chunks to support AMOUNT_OF_SEND_QUEUE_PRIORITIES chunks per connection.");
+static_assert(CONNECTION_QUEUE_MEMORY_SMALL_CHUNK_AMOUNT > 0 || CONNECTION_QUEUE_MEMORY_CHUNK_AMOUNT >= (TOTAL_NUM_CONNECTIONS + 1) * AMOUNT_OF_SEND_QUEUE_PRIORITIES, "There must be at least enough chunks to support AMOUNT_OF_SEND_QUEUE_PRIORITIES chunks per connection.");
+static_assert(CONNECTION_QUEUE_MEMORY_SMALL_CHUNK_AMOUNT == 0 || CONNECTION_QUEUE_MEMORY_SMALL_CHUNK_AMOUNT >= (TOTAL_NUM_CONNECTIONS + 1) * AMOUNT_OF_SEND_QUEUE_PRIORITIES, "There must be a small chunk for every queue of every connection.");
+static_assert(CONNECTION_QUEUE_MEMORY_SMALL_CHUNK_SIZE % sizeof(u32) == 0 && CONNECTION_QUEUE_MEMORY_SMALL_CHUNK_SIZE < CONNECTION_QUEUE_MEMORY_CHUNK_SIZE, "Small chunks must be 4 byte aligned and smaller than full sized chunks.");
 static_assert((CONNECTION_QUEUE_MEMORY_CHUNK_AMOUNT - CONNECTION_QUEUE_MEMORY_MAX_CHUNKS_PER_CONNECTION) > 12, "Amount of chunks got dangerously low compared to max chunks per connection.");
 static_assert((CONNECTION_QUEUE_MEMORY_MAX_CHUNKS_PER_CONNECTION * TOTAL_NUM_CONNECTIONS) > CONNECTION_QUEUE_MEMORY_CHUNK_AMOUNT, "Chunks exist that can never be used!");
+static_assert(CONNECTION_QUEUE_MEMORY_CHUNK_SIZE <= UINT16_MAX, "Offsets within a chunk are stored with 16 bit.");
 
+// The bookkeeping of a chunk. The data itself is stored in a ConnectionQueueMemoryChunkStorage of the allocator,
+// either full sized (CONNECTION_QUEUE_MEMORY_CHUNK_SIZE) or small (CONNECTION_QUEUE_MEMORY_SMALL_CHUNK_SIZE).
 class ConnectionQueueMemoryChunk
 {
     friend class ConnectionQueueMemoryAllocator;
 private:
-
 #ifdef SIM_ENABLED
-    static constexpr u32 MEMORY_GUARD_VALUE_START = 0x12344321;
-    static constexpr u32 MEMORY_GUARD_VALUE_END   = 0xABCDDCBA;
-
-    u32 memoryGuardStart = MEMORY_GUARD_VALUE_START;
+    const u32* memoryGuardStart = nullptr;
+    const u32* memoryGuardEnd = nullptr;
     bool currentlyOwnedByAllocator = true;
 #endif
 
 public:
-    alignas(4) std::array<u8, CONNECTION_QUEUE_MEMORY_CHUNK_SIZE> data{};
+    u8* data = nullptr;
     ConnectionQueueMemoryChunk* nextChunk = nullptr;
-    u32 amountOfByteInThisChunk = 0;
-    u32 currentReadHead = 0;
-    u32 currentLookAheadHead = 0;
+    //All offsets are within a chunk, so 16 bit are sufficient and keep the bookkeeping of each chunk at 16 byte
+    u16 capacity = 0;
+    u16 amountOfByteInThisChunk = 0;
+    u16 currentReadHead = 0;
+    u16 currentLookAheadHead = 0;
 
+    bool IsSmall() const;
     void Reset();
+};
 
-private:
+template<u32 capacity>
+struct ConnectionQueueMemoryChunkStorage
+{
+#ifdef SIM_ENABLED
+    static constexpr u32 MEMORY_GUARD_VALUE_START = 0x12344321;
+    static constexpr u32 MEMORY_GUARD_VALUE_END   = 0xABCDDCBA;
+
+    u32 memoryGuardStart = MEMORY_GUARD_VALUE_START;
+#endif
+    alignas(4) std::array<u8, capacity> data{};
 #ifdef SIM_ENABLED
     u32 memoryGuardEnd = MEMORY_GUARD_VALUE_END;
 #endif
 };
 
 class ConnectionQueueMemoryAllocator {
+public:
+    static constexpr u32 TOTAL_CHUNK_AMOUNT = CONNECTION_QUEUE_MEMORY_CHUNK_AMOUNT + CONNECTION_QUEUE_MEMORY_SMALL_CHUNK_AMOUNT;
+
 private:
-    std::array<ConnectionQueueMemoryChunk, CONNECTION_QUEUE_MEMORY_CHUNK_AMOUNT> chunks{};
+    std::array<ConnectionQueueMemoryChunk, TOTAL_CHUNK_AMOUNT> chunks{};
+    std::array<ConnectionQueueMemoryChunkStorage<CONNECTION_QUEUE_MEMORY_CHUNK_SIZE      >, CONNECTION_QUEUE_MEMORY_CHUNK_AMOUNT      > storage{};
+    std::array<ConnectionQueueMemoryChunkStorage<CONNECTION_QUEUE_MEMORY_SMALL_CHUNK_SIZE>, CONNECTION_QUEUE_MEMORY_SMALL_CHUNK_AMOUNT> smallStorage{};
     ConnectionQueueMemoryChunk* head = nullptr;
+    ConnectionQueueMemoryChunk* smallHead = nullptr;
     u32 chunksLeft = CONNECTION_QUEUE_MEMORY_CHUNK_AMOUNT;
+    u32 smallChunksLeft = CONNECTION_QUEUE_MEMORY_SMALL_CHUNK_AMOUNT;
+
+    ConnectionQueueMemoryChunk* PopFreeChunk(ConnectionQueueMemoryChunk*& freeList);
 
 public:
     ConnectionQueueMemoryAllocator();
 
+    // Returns a full sized chunk.
     ConnectionQueueMemoryChunk* Allocate(bool isNewConnection = false);
+    // Returns the first chunk of a queue. This is a small chunk if one is left, else a full sized chunk.
+    ConnectionQueueMemoryChunk* AllocateQueueHead();
     void Deallocate(ConnectionQueueMemoryChunk* chunk);
     bool IsChunkAvailable(bool isNewConnection = false, u32 amountOfChunks = 1) const;
+    bool IsSmallChunkAvailable() const;
+
+    // Chunks can be referenced by a small index instead of a pointer, e.g. to save RAM.
+    u16 GetChunkIndex(const ConnectionQueueMemoryChunk* chunk) const;
+    ConnectionQueueMemoryChunk* GetChunkByIndex(u16 index);
+
+    u32 GetAmountOfFreeChunks() const;
+    u32 GetAmountOfFreeSmallChunks() const;
 };
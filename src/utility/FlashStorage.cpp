@@ -176,8 +176,69 @@ void FlashStorage::RemoveExecutingTask()
 
 void FlashStorage::OnCommandSuccessful()
 {
-    if (currentTask->header.callback != nullptr) currentTask->header.callback->FlashStorageItemExecuted(currentTask, FlashStorageError::SUCCESS);
-    RemoveExecutingTask();
+    //Coalesced writes are reported to their listeners in the order in which they were queued
+    const u8 numExecutedTasks = numCoalescedTasks;
+    numCoalescedTasks = 1;
+    for (u32 i = 0; i < numExecutedTasks; i++)
+    {
+        if (i > 0) currentTask = (FlashStorageTaskItem*)taskQueue.PeekNext().data;
+        if (currentTask->header.callback != nullptr) currentTask->header.callback->FlashStorageItemExecuted(currentTask, FlashStorageError::SUCCESS);
+        RemoveExecutingTask();
+    }
+}
+
+static u32 GetPaddedLength(u16 length)
+{
+    return (length + 3) / 4 * 4;
+}
+
+u8 FlashStorage::CoalesceCachedWrites(u32** destination, u16* length)
+{
+    const u32 pageSize = FruityHal::GetCodePageSize();
+    u32 start = (u32)currentTask->params.writeCachedData.dataDestination;
+    u32 end = start + GetPaddedLength(currentTask->params.writeCachedData.dataLength);
+    const u32 pageStart = start - (start % pageSize);
+    const u32 pageEnd = pageStart + pageSize;
+
+    //Only tasks that directly follow each other are merged so that writes are never reordered with erases
+    u8 count = 1;
+    while (count < taskQueue._numElements && count < UINT8_MAX)
+    {
+        FlashStorageTaskItem const * task = (FlashStorageTaskItem const *)taskQueue.PeekNext(count).data;
+        if (task->header.command != FlashStorageCommand::WRITE_AND_CACHE_DATA) break;
+
+        const u32 taskStart = (u32)task->params.writeCachedData.dataDestination;
+        const u32 taskEnd = taskStart + GetPaddedLength(task->params.writeCachedData.dataLength);
+
+        //The task must overlap or touch the data that was merged so far
+        if (taskStart > end || taskEnd < start) break;
+
+        const u32 mergedStart = taskStart < start ? taskStart : start;
+        const u32 mergedEnd = taskEnd > end ? taskEnd : end;
+        if (mergedStart < pageStart || mergedEnd > pageEnd || mergedEnd - mergedStart > FLASH_STORAGE_COALESCE_BUFFER_SIZE) break;
+
+        start = mergedStart;
+        end = mergedEnd;
+        count++;
+    }
+    if (count == 1) return 1;
+
+    //Flash bits can only be cleared, so overlapping writes are combined the same way as the flash would combine them
+    u8* buffer = (u8*)coalesceBuffer;
+    CheckedMemset(buffer, 0xFF, end - start);
+    for (u32 i = 0; i < count; i++)
+    {
+        FlashStorageTaskItemWriteCachedData const * params = &((FlashStorageTaskItem const *)taskQueue.PeekNext(i).data)->params.writeCachedData;
+        u8* target = buffer + ((u32)params->dataDestination - start);
+        for (u32 k = 0; k < params->dataLength; k++)
+        {
+            target[k] &= params->data[k];
+        }
+    }
+
+    *destination = (u32*)start;
+    *length = end - start;
+    return count;
 }
 
 void FlashStorage::ProcessQueue(bool continueCurrentTask)
@@ -193,6 +254,7 @@ void FlashStorage::ProcessQueue(bool continueCurrentTask)
     //Get one item from the queue and execute it
     SizedData data = taskQueue.PeekNext();
     currentTask = (FlashStorageTaskItem*)data.data;
+    numCoalescedTasks = 1;
 
     logt("FLASH", "processing command %u", (u32)currentTask->header.command);
 
@@ -243,11 +305,24 @@ void FlashStorage::ProcessQueue(bool continueCurrentTask)
     else if (currentTask->header.command == FlashStorageCommand::WRITE_AND_CACHE_DATA) {
         FlashStorageTaskItemWriteCachedData* params = &currentTask->params.writeCachedData;
 
-        u8 padding = (4-params->dataLength%4)%4;
+        u32* destination = nullptr;
+        u16 length = 0;
+        numCoalescedTasks = CoalesceCachedWrites(&destination, &length);
 
-        logt("FLASH", "copy cached data to %u, length %u", (u32)params->dataDestination, params->dataLength);
+        if (numCoalescedTasks > 1)
+        {
+            logt("FLASH", "copy %u coalesced writes to %u, length %u", numCoalescedTasks, (u32)destination, length);
+
+            err = FruityHal::FlashWrite(destination, coalesceBuffer, length / 4);
+        }
+        else
+        {
+            u8 padding = (4-params->dataLength%4)%4;
 
-        err = FruityHal::FlashWrite(params->dataDestination, (u32*)params->data, (params->dataLength+padding) / 4); //FIXME: NRF_ERROR_BUSY and others not handeled
+            logt("FLASH", "copy cached data to %u, length %u", (u32)params->dataDestination, params->dataLength);
+
+            err = FruityHal::FlashWrite(params->dataDestination, (u32*)params->data, (params->dataLength+padding) / 4); //FIXME: NRF_ERROR_BUSY and others not handeled
+        }
     }
     else {
         logt("ERROR", "Wrong command %u", (u32)currentTask->header.command);
@@ -301,13 +376,22 @@ void FlashStorage::SystemEventHandler(FruityHal::SystemEvents systemEvent)
         retryCount = FLASH_STORAGE_RETRY_COUNT;
 
         logt("FLASH", "Flash operation success");
-        if(
-                   currentTask->header.command == FlashStorageCommand::WRITE_DATA
-                || currentTask->header.command == FlashStorageCommand::WRITE_AND_CACHE_DATA
-        ){
+        if(currentTask->header.command == FlashStorageCommand::WRITE_DATA){
+            RecordPageWrites(currentTask->params.writeData.dataDestination, currentTask->params.writeData.dataLength);
+            OnCommandSuccessful();
+        }
+        else if(currentTask->header.command == FlashStorageCommand::WRITE_AND_CACHE_DATA){
+            //Coalesced writes always target the page of the first task
+            RecordPageWrites(currentTask->params.writeCachedData.dataDestination, currentTask->params.writeCachedData.dataLength);
+            coalescedWrites += numCoalescedTasks - 1;
             OnCommandSuccessful();
         }
         else if(currentTask->header.command == FlashStorageCommand::ERASE_PAGES){
+            //No page was erased if all remaining pages were already empty
+            if (currentTask->params.erasePages.numPages > 0)
+            {
+                RecordPageErase(currentTask->params.erasePages.startPage + currentTask->params.erasePages.numPages - 1);
+            }
 
             //We must still erase some pages
             if(currentTask->params.erasePages.numPages > 1){
@@ -331,3 +415,77 @@ u16 FlashStorage::GetNumberOfActiveTasks() const
 {
     return taskQueue._numElements;
 }
+
+FlashStoragePageWear* FlashStorage::GetOrCreatePageWear(u16 page)
+{
+    for (u32 i = 0; i < numPageWearEntries; i++)
+    {
+        if (pageWear[i].page == page) return &pageWear[i];
+    }
+    if (numPageWearEntries >= FLASH_STORAGE_WEAR_TABLE_SIZE)
+    {
+        untrackedFlashOperations++;
+        return nullptr;
+    }
+
+    FlashStoragePageWear* entry = &pageWear[numPageWearEntries];
+    numPageWearEntries++;
+    entry->page = page;
+    return entry;
+}
+
+void FlashStorage::RecordPageErase(u16 page)
+{
+    FlashStoragePageWear* entry = GetOrCreatePageWear(page);
+    if (entry != nullptr && entry->erases < UINT16_MAX) entry->erases++;
+}
+
+void FlashStorage::RecordPageWrites(u32 const * destination, u16 length)
+{
+    const u32 offset = (u32)destination - FLASH_REGION_START_ADDRESS;
+    const u32 firstPage = offset / FruityHal::GetCodePageSize();
+    const u32 lastPage = (offset + (length > 0 ? length - 1 : 0)) / FruityHal::GetCodePageSize();
+    for (u32 page = firstPage; page <= lastPage; page++)
+    {
+        FlashStoragePageWear* entry = GetOrCreatePageWear(page);
+        if (entry != nullptr) entry->writes++;
+    }
+}
+
+const FlashStoragePageWear* FlashStorage::GetPageWear(u16 page) const
+{
+    for (u32 i = 0; i < numPageWearEntries; i++)
+    {
+        if (pageWear[i].page == page) return &pageWear[i];
+    }
+    return nullptr;
+}
+
+const FlashStoragePageWear* FlashStorage::GetPageWearEntries(u8& numEntries) const
+{
+    numEntries = numPageWearEntries;
+    return pageWear;
+}
+
+u32 FlashStorage::GetCoalescedWrites() const
+{
+    return coalescedWrites;
+}
+
+void FlashStorage::PrintWearStatistics() const
+{
+    logjson_partial("FLASH", "{\"nodeId\":%u,\"type\":\"flash_wear\",\"coalescedWrites\":%u,\"untracked\":%u,\"pages\":[", GS->node.configuration.nodeId, coalescedWrites, untrackedFlashOperations);
+    for (u32 i = 0; i < numPageWearEntries; i++)
+    {
+        logjson_partial("FLASH", "%s{\"page\":%u,\"erases\":%u,\"writes\":%u}", i == 0 ? "" : ",", pageWear[i].page, pageWear[i].erases, pageWear[i].writes);
+    }
+    logjson("FLASH", "]}" SEP);
+}
+
+void FlashStorage::ResetWearStatistics()
+{
+    CheckedMemset(pageWear, 0x00, sizeof(pageWear));
+    numPageWearEntries = 0;
+    untrackedFlashOperations = 0;
+    coalescedWrites = 0;
+}
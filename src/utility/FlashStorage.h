@@ -111,6 +111,17 @@ struct FlashStorageTaskItem
 
 constexpr int FLASH_STORAGE_RETRY_COUNT = 10;
 constexpr int FLASH_STORAGE_QUEUE_SIZE = 2048;
+//Cached writes to the same page that are queued back to back are merged into one flash operation of at most this size
+constexpr int FLASH_STORAGE_COALESCE_BUFFER_SIZE = 256;
+//Number of pages for which erase and write operations are counted
+constexpr int FLASH_STORAGE_WEAR_TABLE_SIZE = 16;
+
+struct FlashStoragePageWear
+{
+    u16 page;
+    u16 erases;
+    u32 writes;
+};
 
 /*
  * This Storage class provides easy access to all storage operations
@@ -129,6 +140,15 @@ class FlashStorage
         i8 retryCount = 0;
         bool retryCallingSoftdevice = false;
 
+        //Data of the cached writes that are executed together with the current task
+        u32 coalesceBuffer[FLASH_STORAGE_COALESCE_BUFFER_SIZE / sizeof(u32)] = {};
+        u8 numCoalescedTasks = 1;
+
+        FlashStoragePageWear pageWear[FLASH_STORAGE_WEAR_TABLE_SIZE] = {};
+        u8 numPageWearEntries = 0;
+        u32 untrackedFlashOperations = 0;
+        u32 coalescedWrites = 0;
+
         //Starts or continues to execute flash tasks
         void ProcessQueue(bool continueCurrentTask);
         
@@ -138,6 +158,13 @@ class FlashStorage
         void RemoveExecutingTask();
         void OnCommandSuccessful();
 
+        //Merges the cached writes that follow the current task into the coalesceBuffer, returns the number of merged tasks
+        u8 CoalesceCachedWrites(u32** destination, u16* length);
+
+        void RecordPageErase(u16 page);
+        void RecordPageWrites(u32 const * destination, u16 length);
+        FlashStoragePageWear* GetOrCreatePageWear(u16 page);
+
     public:
         FlashStorage();
 
@@ -161,6 +188,16 @@ class FlashStorage
         //Return the number of tasks
         u16 GetNumberOfActiveTasks() const;
 
+        //Returns the erase and write counters of a page or nullptr if nothing was counted for this page
+        const FlashStoragePageWear* GetPageWear(u16 page) const;
+        const FlashStoragePageWear* GetPageWearEntries(u8& numEntries) const;
+
+        //Number of cached writes that were saved by merging them with a previous one
+        u32 GetCoalescedWrites() const;
+
+        void PrintWearStatistics() const;
+        void ResetWearStatistics();
+
         //This system event handler must be called by the implementation
         void SystemEventHandler(FruityHal::SystemEvents sys_evt);
 };
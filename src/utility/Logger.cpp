@@ -595,6 +595,10 @@ const char* Logger::GetErrorLogCustomError(CustomErrorTypes type)
         return "COUNT_UART_RX_ERROR";
     case CustomErrorTypes::INFO_UNUSED_STACK_BYTES:
         return "INFO_UNUSED_STACK_BYTES";
+    case CustomErrorTypes::COUNT_DROPPED_TRACKED_ASSETS:
+        return "COUNT_DROPPED_TRACKED_ASSETS";
+    case CustomErrorTypes::WARN_RECORD_STORAGE_DEFRAGMENT_ERASE_FAILED:
+        return "WARN_RECORD_STORAGE_DEFRAGMENT_ERASE_FAILED";
     default:
         SIMEXCEPTION(ErrorCodeUnknownException); //Could be an error or should be added to the list
         return "UNKNOWN_ERROR";
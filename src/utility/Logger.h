@@ -142,6 +142,8 @@ enum class CustomErrorTypes : u8 {
     COUNT_UART_RX_ERROR = 82,
     INFO_UNUSED_STACK_BYTES = 83,
     FATAL_CONNECTION_REMOVED_WHILE_ENROLLED_NODES_SYNC = 84,
+    COUNT_DROPPED_TRACKED_ASSETS = 85,
+    WARN_RECORD_STORAGE_DEFRAGMENT_ERASE_FAILED = 86,
 };
 
 #ifdef _MSC_VER
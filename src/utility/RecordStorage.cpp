@@ -58,6 +58,10 @@
  * Once all pages are full, the page with the most possible free space is defragmented. Therefore,
  * all current and active records will be moved to the swap page. Afterwards this page is activated and
  * the old page is erased and becomes the new swap page.
+ *
+ * To avoid that an operation has to wait for a defragmentation, a page is already defragmented in the background
+ * once the free space runs low. This defragmentation only queues one flash operation per timer tick and
+ * record operations continue in between, except if they need the page that is currently defragmented.
 
  * The implementation does currently only support updating a record up to 65000 times and 65000 erase cycles of the settings pages
 
@@ -82,7 +86,9 @@ RecordStorage::RecordStorage()
 void RecordStorage::Init()
 {
     startPage = (u8*)Utility::GetSettingsPageBaseAddress();
+    numPages = Utility::GetSettingsPageCount();
     RepairPages();
+    UpdateLargestRecordLength();
     isInit = true;
 }
 
@@ -189,6 +195,10 @@ void RecordStorage::SaveRecordInternal(SaveRecordOperation& op)
 
         //If not, we must first defragment the page which has the most available space
         if (freeSpace == nullptr) {
+            //A background defragmentation is already freeing space, check again once it is done
+            if (defragmentationStage != DefragmentationStage::NO_DEFRAGMENTATION) {
+                return WaitForDefragmentation();
+            }
             RecordStoragePage* pageToDefragment = FindPageToDefragment();
             if (pageToDefragment != nullptr) {
                 op.stage = RecordStorageSaveStage::SAVE;
@@ -245,15 +255,20 @@ void RecordStorage::SaveRecordInternal(SaveRecordOperation& op)
             //The crc is calculated over the record header and data, excluding the first two byte (crc and flags)
             newRecord->crc = Utility::CalculateCrc8(((u8*)newRecord) + 2, newRecord->recordLength - 2);
             op.stage = RecordStorageSaveStage::CALLBACKS_AND_FINISH;
+            if (recordLength > largestRecordLength) largestRecordLength = recordLength;
             GS->flashStorage.CacheAndWriteData((u32*)newRecord, (u32*)freeSpace, recordLength, this, (u32)FlashUserTypes::DEFAULT);
             return;
 
         }
+        else if (defragmentationStage != DefragmentationStage::NO_DEFRAGMENTATION) {
+            op.stage = RecordStorageSaveStage::DEFRAGMENT_IF_NEEDED;
+            return WaitForDefragmentation();
+        }
         else {
             logt("ERROR", "no space in RS");
             GS->logger.LogCustomError(CustomErrorTypes::FATAL_NO_RECORDSTORAGE_SPACE_LEFT, recordLength);
 
-            for (u32 i = 0; i < RECORD_STORAGE_NUM_PAGES; i++) {
+            for (u32 i = 0; i < numPages; i++) {
                 RecordStoragePage& page = getPage(i);
                 u16 freeSpaceAfterDefragment = GetFreeSpaceWhenDefragmented(page);
                 logt("ERROR", "freeSpace in page %u: %u", ((u32)&page - (u32)FLASH_REGION_START_ADDRESS) / (u32)FruityHal::GetCodePageSize(), freeSpaceAfterDefragment);
@@ -286,6 +301,11 @@ void RecordStorage::DeactivateRecordInternal(DeactivateRecordOperation& op)
             return RecordOperationFinished(op.op, RecordStorageResultCode::SUCCESS);
         }
 
+        //The record might already have been copied to the swap page, where it would stay active
+        if (IsOnDefragmentPage(record)) {
+            return WaitForDefragmentation();
+        }
+
         RecordStorageRecord newRecordHeader;
         CheckedMemset(&newRecordHeader, 0xFF, SIZEOF_RECORD_STORAGE_RECORD_HEADER);
         newRecordHeader.recordActive = 0;
@@ -316,10 +336,13 @@ RecordStorageResultCode RecordStorage::LockDownAndClearAllSettings(ModuleIdWrapp
         opQueue.DiscardNext();
     }
     opQueue.Clean();
+    //All pages are erased, so a running defragmentation is obsolete
+    defragmentationStage = DefragmentationStage::NO_DEFRAGMENTATION;
+    defragmentInBackground = false;
     lockDownCallback = callback;
     lockDownUserType = userType;
     lockDownModuleId = responsibleModuleForShutDown;
-    FlashStorageError flashRetVal = GS->flashStorage.ErasePages(TO_PAGE(startPage), RECORD_STORAGE_NUM_PAGES, this, (u32)FlashUserTypes::LOCK_DOWN);
+    FlashStorageError flashRetVal = GS->flashStorage.ErasePages(TO_PAGE(startPage), numPages, this, (u32)FlashUserTypes::LOCK_DOWN);
     if (flashRetVal == FlashStorageError::SUCCESS)
     {
         recordStorageLockDown = true;
@@ -354,7 +377,7 @@ void RecordStorage::RepairPages()
     if (repairStage == RepairStage::ERASE_CORRUPT_PAGES)
     {
         //Erase all corrupt pages
-        for (u32 i = 0; i < RECORD_STORAGE_NUM_PAGES; i++) {
+        for (u32 i = 0; i < numPages; i++) {
             RecordStoragePage& page = getPage(i);
             RecordStoragePageState pageState = GetPageState(page);
 
@@ -377,7 +400,7 @@ void RecordStorage::RepairPages()
         //the other page at the end
         u16 maxVersionCounter = 0;
         if (swapPage == nullptr) {
-            for (u32 i = 0; i < RECORD_STORAGE_NUM_PAGES; i++) {
+            for (u32 i = 0; i < numPages; i++) {
                 RecordStoragePage& page = getPage(i);
                 if (page.versionCounter > maxVersionCounter) {
                     swapPage = &page;
@@ -399,7 +422,7 @@ void RecordStorage::RepairPages()
 
         //Determine max version counter
         u16 maxVersionCounter = 0;
-        for (u32 i = 0; i < RECORD_STORAGE_NUM_PAGES; i++) {
+        for (u32 i = 0; i < numPages; i++) {
             RecordStoragePage& page = getPage(i);
             if (GetPageState(page) == RecordStoragePageState::ACTIVE && page.versionCounter > maxVersionCounter) {
                 maxVersionCounter = page.versionCounter;
@@ -408,7 +431,7 @@ void RecordStorage::RepairPages()
 
         //Check that all pages except the swap page are active
         //Marks empty pages active with incrementing versionCounters
-        for (u32 i = 0; i < RECORD_STORAGE_NUM_PAGES; i++) {
+        for (u32 i = 0; i < numPages; i++) {
             RecordStoragePage& page = getPage(i);
             if (&page != swapPage && GetPageState(page) == RecordStoragePageState::EMPTY) {
                 RecordStoragePage pageHeader;
@@ -429,7 +452,7 @@ void RecordStorage::RepairPages()
     //if not, defragment this page. There can only be one such page after a power loss
     if(repairStage == RepairStage::VALIDATE_PAGES)
     {
-        for (u32 i = 0; i < RECORD_STORAGE_NUM_PAGES; i++) {
+        for (u32 i = 0; i < numPages; i++) {
             RecordStoragePage& page = getPage(i);
             RecordStoragePageState pageState = GetPageState(page);
 
@@ -486,7 +509,7 @@ void RecordStorage::RepairPages()
 //This will copy the contents of a page to the swap page while ignoring invalid records
 //The implementation only queues one item at a time and will continue from there after being called again
 //This allows us to keep queue size and ram usage to an absolute minimum
-void RecordStorage::DefragmentPage(RecordStoragePage& pageToDefragment, bool force)
+void RecordStorage::DefragmentPage(RecordStoragePage& pageToDefragment, bool force, bool inBackground)
 {
     logt("WARNING", "defr");
 
@@ -494,6 +517,7 @@ void RecordStorage::DefragmentPage(RecordStoragePage& pageToDefragment, bool for
         defragmentPage = &pageToDefragment;
         defragmentSwapPage = GetSwapPage();
         defragmentationStage = DefragmentationStage::MOVE_TO_SWAP_PAGE;
+        defragmentInBackground = inBackground;
 
         if (!force && GetFreeSpaceOnPage(*defragmentPage) == GetFreeSpaceWhenDefragmented(*defragmentPage)) {
             logt("RS", "No defrag possible");
@@ -559,7 +583,7 @@ void RecordStorage::DefragmentPage(RecordStoragePage& pageToDefragment, bool for
 
         //Check the current versionCounter of all pages
         u16 maxVersionCounter = 0;
-        for (u32 i = 0; i < RECORD_STORAGE_NUM_PAGES; i++) {
+        for (u32 i = 0; i < numPages; i++) {
             RecordStoragePage& page = getPage(i);
             if (GetPageState(page) != RecordStoragePageState::ACTIVE) continue;
             if (page.versionCounter > maxVersionCounter) {
@@ -591,13 +615,16 @@ void RecordStorage::DefragmentPage(RecordStoragePage& pageToDefragment, bool for
     else if (defragmentationStage == DefragmentationStage::ERASE_OLD_PAGE)
     {
         //Finally, erase the page that we just swapped
-        GS->flashStorage.ErasePage(((u32)defragmentPage - FLASH_REGION_START_ADDRESS) / FruityHal::GetCodePageSize(), this, (u32)FlashUserTypes::DEFAULT);
+        //A distinct user type is used so that the result does not continue the queued record operations
+        GS->flashStorage.ErasePage(((u32)defragmentPage - FLASH_REGION_START_ADDRESS) / FruityHal::GetCodePageSize(), this, (u32)FlashUserTypes::DEFRAGMENT_ERASE);
 
         defragmentationStage = DefragmentationStage::FINALIZE;
     }
     else if (defragmentationStage == DefragmentationStage::FINALIZE)
     {
         defragmentationStage = DefragmentationStage::NO_DEFRAGMENTATION;
+        defragmentInBackground = false;
+        defragmentEraseRetryCounter = 0;
 
         //Call the listener manually because we did not queue another task
         ProcessQueue(true);
@@ -618,6 +645,9 @@ void RecordStorage::RecordOperationFinished(RecordStorageOperation& op, RecordSt
     //Clear operation from operation queue
     opQueue.DiscardNext();
 
+    //The free space might have changed
+    RestartBackgroundDefragmentCheck();
+
     //Continue of tasks are available
     ProcessQueue(true);
 }
@@ -655,7 +685,7 @@ RecordStoragePage* RecordStorage::FindPageToDefragment() const
     u32 maxFreeSpace = 0;
 
     //Go through all pages to find page with the most free space
-    for (u32 i = 0; i< RECORD_STORAGE_NUM_PAGES; i++)
+    for (u32 i = 0; i< numPages; i++)
     {
         //Check if this page is active
         RecordStoragePage& page = getPage(i);
@@ -673,7 +703,7 @@ RecordStoragePage* RecordStorage::FindPageToDefragment() const
 
 RecordStoragePage& RecordStorage::getPage(u32 index) const
 {
-    if (index >= RECORD_STORAGE_NUM_PAGES)
+    if (index >= numPages)
     {
         SIMEXCEPTION(IllegalArgumentException);
     }
@@ -709,7 +739,7 @@ RecordStorageRecord* RecordStorage::GetRecord(u16 recordId) const
     RecordStorageRecord* result = nullptr;
 
     //Go through all pages
-    for(u32 i = 0; i< RECORD_STORAGE_NUM_PAGES; i++)
+    for(u32 i = 0; i< numPages; i++)
     {
         //Check if this page is active
         RecordStoragePage& page = getPage(i);
@@ -744,12 +774,15 @@ RecordStorageRecord* RecordStorage::GetRecord(u16 recordId) const
 u8* RecordStorage::GetFreeRecordSpace(u16 dataLength) const
 {
     //Go through all pages
-    for(u32 i = 0; i< RECORD_STORAGE_NUM_PAGES; i++)
+    for(u32 i = 0; i< numPages; i++)
     {
         //Check if this page is active
         RecordStoragePage& page = getPage(i);
         if(GetPageState(page) != RecordStoragePageState::ACTIVE) continue;
 
+        //Records written to the page that is defragmented would be lost
+        if(IsOnDefragmentPage(&page)) continue;
+
         //Get first record
         RecordStorageRecord* record = (RecordStorageRecord*)page.data;
 
@@ -807,9 +840,28 @@ u16 RecordStorage::GetFreeSpaceWhenDefragmented(const RecordStoragePage& page) c
     return (FruityHal::GetCodePageSize() - usedSpace);
 }
 
+void RecordStorage::UpdateLargestRecordLength()
+{
+    //Outdated versions are included as well, so that this does not have to look up each record
+    largestRecordLength = 0;
+    for (u32 i = 0; i < numPages; i++)
+    {
+        const RecordStoragePage& page = getPage(i);
+        if (GetPageState(page) != RecordStoragePageState::ACTIVE) continue;
+
+        const RecordStorageRecord * record = (const RecordStorageRecord *)page.data;
+        while (IsRecordValid(page, record))
+        {
+            if (record->recordActive && record->recordLength > largestRecordLength) largestRecordLength = record->recordLength;
+
+            record = (const RecordStorageRecord*)((const u8*)record + record->recordLength);
+        }
+    }
+}
+
 RecordStoragePage* RecordStorage::GetSwapPage() const
 {
-    for(u32 i = 0; i< RECORD_STORAGE_NUM_PAGES; i++)
+    for(u32 i = 0; i< numPages; i++)
     {
         RecordStoragePage& page = getPage(i);
         if(GetPageState(page) == RecordStoragePageState::EMPTY){
@@ -873,7 +925,8 @@ void RecordStorage::FlashStorageItemExecuted(FlashStorageTaskItem* task, FlashSt
         //TODO: Use errorCode
 
         //If either a repair or defrag is in Progress, do nothing, these are called from the QueueEmptyHandler
-        if (repairStage != RepairStage::NO_REPAIR || defragmentationStage != DefragmentationStage::NO_DEFRAGMENTATION) {
+        //Only a background defragmentation lets the operations continue
+        if (repairStage != RepairStage::NO_REPAIR || (defragmentationStage != DefragmentationStage::NO_DEFRAGMENTATION && !defragmentInBackground)) {
             processQueueInProgress = false;
             return;
         }
@@ -899,6 +952,24 @@ void RecordStorage::FlashStorageItemExecuted(FlashStorageTaskItem* task, FlashSt
             processQueueInProgress = false;
         }
     }
+    else if (task != nullptr && task->header.userType == (u32)FlashUserTypes::DEFRAGMENT_ERASE)
+    {
+        //Without the erase, the old page stays active next to its copy and there is no swap page left,
+        //so the erase is queued again once the defragmentation continues
+        if (errorCode != FlashStorageError::SUCCESS && defragmentationStage == DefragmentationStage::FINALIZE)
+        {
+            GS->logger.LogCustomError(CustomErrorTypes::WARN_RECORD_STORAGE_DEFRAGMENT_ERASE_FAILED, (u32)errorCode);
+            if (defragmentEraseRetryCounter < DEFRAGMENT_ERASE_RETRY_MAX)
+            {
+                defragmentEraseRetryCounter++;
+                defragmentationStage = DefragmentationStage::ERASE_OLD_PAGE;
+            }
+            else
+            {
+                SIMEXCEPTION(IllegalStateException);
+            }
+        }
+    }
     else if (task != nullptr && task->header.userType == (u32)FlashUserTypes::LOCK_DOWN)
     {
         //If we were not successful and havn't exceeded our retry counter, we try again. 
@@ -942,8 +1013,87 @@ void RecordStorage::FlashStorageQueueEmptyHandler()
             DefragmentPage(*defragmentPage, false);
         }
     }
-    else if (defragmentationStage != DefragmentationStage::NO_DEFRAGMENTATION)
+    //A background defragmentation is continued from the TimerEventHandler
+    else if (defragmentationStage != DefragmentationStage::NO_DEFRAGMENTATION && !defragmentInBackground)
     {
         DefragmentPage(*defragmentPage, false);
     }
 }
+
+void RecordStorage::TimerEventHandler(u16 passedTimeDs)
+{
+    if (!isInit || recordStorageLockDown || repairStage != RepairStage::NO_REPAIR) return;
+
+    if (defragmentationStage != DefragmentationStage::NO_DEFRAGMENTATION)
+    {
+        //Queues at most one flash operation, so that queued record operations only wait for a single one
+        if (defragmentInBackground && GS->flashStorage.GetNumberOfActiveTasks() == 0)
+        {
+            DefragmentPage(*defragmentPage, false);
+        }
+        return;
+    }
+
+    if (!backgroundDefragmentCheckNeeded || opQueue._numElements > 0 || GS->flashStorage.GetNumberOfActiveTasks() != 0) return;
+
+    //Only one page is checked per tick as this has to go through all records
+    RecordStoragePage& page = getPage(backgroundCheckPageIndex);
+    if (GetPageState(page) == RecordStoragePageState::ACTIVE)
+    {
+        const u16 freeSpace = GetFreeSpaceOnPage(page);
+        const u16 gain = GetFreeSpaceWhenDefragmented(page) - freeSpace;
+        if (freeSpace > backgroundCheckMaxFreeSpace) backgroundCheckMaxFreeSpace = freeSpace;
+        if (gain > backgroundCheckBestGain)
+        {
+            backgroundCheckBestGain = gain;
+            backgroundCheckBestPage = &page;
+        }
+    }
+
+    backgroundCheckPageIndex++;
+    if (backgroundCheckPageIndex < numPages) return;
+
+    //A record must fit on a single page, so the fill of the pages decides and not the sum of their free space.
+    //Defragmenting is needed once no page can take the largest record anymore. Before that, a page is only
+    //defragmented if all pages are at least half full and this frees half a page, so that pages are not erased
+    //more often than with a defragmentation on demand.
+    const u16 halfPage = FruityHal::GetCodePageSize() / 2;
+    const bool largestRecordDoesNotFit = backgroundCheckMaxFreeSpace < largestRecordLength
+        && backgroundCheckBestGain >= largestRecordLength;
+    const bool halfPageGain = backgroundCheckMaxFreeSpace < halfPage && backgroundCheckBestGain >= halfPage;
+    if (largestRecordDoesNotFit || halfPageGain)
+    {
+        logt("RS", "Background defragmentation (free %u, largest record %u, gain %u)", backgroundCheckMaxFreeSpace, largestRecordLength, backgroundCheckBestGain);
+        DefragmentPage(*backgroundCheckBestPage, false, true);
+    }
+
+    RestartBackgroundDefragmentCheck();
+    backgroundDefragmentCheckNeeded = false;
+}
+
+//Turns a background defragmentation into a foreground one so that the current operation continues once it is done
+void RecordStorage::WaitForDefragmentation()
+{
+    defragmentInBackground = false;
+
+    //Otherwise, the FlashStorageQueueEmptyHandler continues the defragmentation
+    if (GS->flashStorage.GetNumberOfActiveTasks() == 0) {
+        DefragmentPage(*defragmentPage, false);
+    }
+}
+
+bool RecordStorage::IsOnDefragmentPage(const void* address) const
+{
+    if (defragmentationStage == DefragmentationStage::NO_DEFRAGMENTATION) return false;
+
+    return (u32)address >= (u32)defragmentPage && (u32)address < (u32)defragmentPage + FruityHal::GetCodePageSize();
+}
+
+void RecordStorage::RestartBackgroundDefragmentCheck()
+{
+    backgroundDefragmentCheckNeeded = true;
+    backgroundCheckPageIndex = 0;
+    backgroundCheckMaxFreeSpace = 0;
+    backgroundCheckBestGain = 0;
+    backgroundCheckBestPage = nullptr;
+}
@@ -233,9 +233,11 @@ class RecordStorage : public FlashStorageEventListener
         {
             DEFAULT   = 0, //TODO: All usages of this value should be refactored to use a distinct user type instead.
             LOCK_DOWN = 1,
+            DEFRAGMENT_ERASE = 2,
         };
 
         u8* startPage = nullptr;
+        u16 numPages = 0;
 
         //A queue that stores high level operations
         u32 opBuffer[RECORD_STORAGE_QUEUE_SIZE / sizeof(u32)] = {};
@@ -248,6 +250,17 @@ class RecordStorage : public FlashStorageEventListener
         RecordStoragePage* defragmentPage = nullptr;
         RecordStoragePage* defragmentSwapPage = nullptr;
         DefragmentationStage defragmentationStage = DefragmentationStage::NO_DEFRAGMENTATION;
+        //A background defragmentation advances by one flash operation per timer tick and lets record operations run in between
+        bool defragmentInBackground = false;
+
+        //Variables for finding a page to defragment in the background, one page is checked per timer tick
+        bool backgroundDefragmentCheckNeeded = false;
+        u16 backgroundCheckPageIndex = 0;
+        u16 backgroundCheckMaxFreeSpace = 0; //Largest free space on a single active page
+        u16 backgroundCheckBestGain = 0;
+        RecordStoragePage* backgroundCheckBestPage = nullptr;
+        //Largest record that was found on the pages or saved since, it is not lowered once the record shrinks
+        u16 largestRecordLength = 0;
 
         bool processQueueInProgress = false;
 
@@ -256,7 +269,11 @@ class RecordStorage : public FlashStorageEventListener
         //Removes a record
         void DeactivateRecordInternal(DeactivateRecordOperation& op);
                 
-        void DefragmentPage(RecordStoragePage& pageToDefragment, bool force);
+        void DefragmentPage(RecordStoragePage& pageToDefragment, bool force, bool inBackground = false);
+        //Lets the running defragmentation continue without waiting for timer ticks, as an operation depends on it
+        void WaitForDefragmentation();
+        bool IsOnDefragmentPage(const void* address) const;
+        void RestartBackgroundDefragmentCheck();
         void RepairPages();
 
         void ProcessQueue(bool force);
@@ -269,6 +286,8 @@ class RecordStorage : public FlashStorageEventListener
         u8* GetFreeRecordSpace(u16 dataLength) const;
         u16 GetFreeSpaceOnPage(const RecordStoragePage& page) const;
         u16 GetFreeSpaceWhenDefragmented(const RecordStoragePage& page) const;
+        //Goes through the records of all pages once
+        void UpdateLargestRecordLength();
 
         //Helpers
         //Checks if a record is valid
@@ -283,6 +302,9 @@ class RecordStorage : public FlashStorageEventListener
         RecordStorageEventListener *lockDownCallback = nullptr;
         u32 lockDownUserType = 0;
         constexpr static u8 LOCK_DOWN_RETRY_MAX = 10;
+        //The erase of a defragmented page is retried as the page can not be used as a swap page otherwise
+        constexpr static u8 DEFRAGMENT_ERASE_RETRY_MAX = 3;
+        u8 defragmentEraseRetryCounter = 0;
         u8 lockDownRetryCounter = 0;
         //Only the module that is responsible for the lockdown is allowed to open up the record storage again.
         ModuleIdWrapper lockDownModuleId = INVALID_WRAPPED_MODULE_ID;
@@ -308,6 +330,9 @@ class RecordStorage : public FlashStorageEventListener
         //Resets all settings
         RecordStorageResultCode LockDownAndClearAllSettings(ModuleIdWrapper responsibleModuleForLockDown, RecordStorageEventListener * callback, u32 userType);
         
+        //Checks if a page should be defragmented and advances a background defragmentation
+        void TimerEventHandler(u16 passedTimeDs);
+
         //Listener
         void FlashStorageItemExecuted(FlashStorageTaskItem* task, FlashStorageError errorCode) override;
         void FlashStorageQueueEmptyHandler();
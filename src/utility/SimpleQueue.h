@@ -111,6 +111,16 @@ public:
         return data[readHead];
     }
 
+    // Returns the element at the given position, counted from the oldest element.
+    T PeekAt(u32 index) const
+    {
+        if (index >= GetAmountOfElements())
+        {
+            SIMEXCEPTION(IndexOutOfBoundsException);
+        }
+        return data[(readHead + index) % N];
+    }
+
     void Reset()
     {
         readHead = 0;
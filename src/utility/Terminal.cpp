@@ -799,7 +799,7 @@ std::string Terminal::ReadStdioLine() {
     return retVal;
 }
 
-extern bool meshGwCommunication;
+extern SIM_THREAD_LOCAL bool meshGwCommunication;
 
 //Used to inject a message into the readBuffer directly
 void Terminal::PutIntoTerminalCommandQueue(std::string &message, bool skipCrc)
@@ -870,6 +870,16 @@ void Terminal::StdioCheckAndProcessLine()
             StdioPutString(executionReplayLine.c_str());
         }
 
+        if (cherrySimInstance->simConfig.recordTerminalCommands)
+        {
+            ReplayRecordEntry executedCommand;
+            executedCommand.index = cherrySimInstance->currentNode->index;
+            executedCommand.time = cherrySimInstance->simState.simTimeMs;
+            executedCommand.command = message;
+            executedCommand.skipCrcCheck = entry.skipCrcCheck;
+            cherrySimInstance->executedTerminalCommands.push_back(executedCommand);
+        }
+
         const char *simPos = strstr(message.c_str(), "sim ");
         if (simPos == message.c_str())
         {
@@ -61,18 +61,46 @@ u32 TimeManager::GetTime()
 TimePoint TimeManager::GetTimePoint()
 {
     ProcessTicks();
-    return TimePoint(GetTime(), additionalTicks);
+    return TimePoint(GetTime(), additionalTicks + GetTicksSinceLastTimerTick());
+}
+
+u32 TimeManager::GetTicksSinceLastTimerTick() const
+{
+    const u32 ticks = FruityHal::GetRtcDifferenceMs(FruityHal::GetRtcMs(), lastTimerTickRtcMs) * ticksPerSecond / 1000;
+    //If the timer tick is pending, the ticks are added shortly
+    return ticks < MAIN_TIMER_TICK ? ticks : MAIN_TIMER_TICK;
+}
+
+//Sets the ticks so that they have the given value right now, although our last timer tick was a bit earlier
+void TimeManager::SetCurrentTicks(u32 ticks)
+{
+    const u32 ticksSinceLastTimerTick = GetTicksSinceLastTimerTick();
+    if (ticks < ticksSinceLastTimerTick)
+    {
+        if (timeSinceSyncTime > 0) timeSinceSyncTime--;
+        else if (syncTime > 0) syncTime--;
+        ticks += ticksPerSecond;
+    }
+    additionalTicks = ticks - ticksSinceLastTimerTick;
 }
 
 void TimeManager::SetTime(u32 syncTimeDs, u32 timeSinceSyncTimeDs, i16 offset, u32 additionalTicks)
 {
+    //The time set by command only has a resolution of seconds. If it matches our own time, we keep our ticks so
+    //that a regular refresh of the time does not make the whole mesh jump.
+    ProcessTicks();
+    const bool sameSecond = IsTimeSynced() && additionalTicks == 0 && syncTime + timeSinceSyncTime == syncTimeDs + timeSinceSyncTimeDs;
+
     this->syncTime = syncTimeDs;
     this->timeSinceSyncTime = timeSinceSyncTimeDs;
-    this->additionalTicks = additionalTicks;
+    if (!sameSecond) SetCurrentTicks(additionalTicks);
     this->offset = offset;
     this->counter++;
     this->waitingForCorrection = false;
     this->timeCorrectionReceived = true;
+    //The time set by command only has a resolution of seconds, which is too coarse to estimate our drift
+    this->ticksSinceLastSync = 0;
+    this->driftEstimationTicks = 0;
 
     //We inform the connection manager so that it resends the time sync messages.
     logt("TSYNC", "Received time by command! NodeId: %u", (u32)GS->node.configuration.nodeId);
@@ -83,9 +111,26 @@ void TimeManager::SetTime(const TimeSyncInitial & timeSyncIntitialMessage)
 {
     if (timeSyncIntitialMessage.counter > this->counter)
     {
+        //Remember how far our clock was off, the drift can be estimated once we know the correction of this sync
+        this->driftEstimationTicks = 0;
+        if (IsTimeCorrected() && ticksSinceLastSync >= MIN_DRIFT_ESTIMATION_TICKS)
+        {
+            ProcessTicks();
+            const i32 secondDifference = (i32)((syncTime + timeSinceSyncTime) - (timeSyncIntitialMessage.syncTimeStamp + timeSyncIntitialMessage.timeSincSyncTimeStamp));
+            //Bigger differences are a jump of the time anyway and would overflow
+            if (secondDifference > -MAX_DRIFT_ESTIMATION_ERROR_SEC && secondDifference < MAX_DRIFT_ESTIMATION_ERROR_SEC)
+            {
+                this->ticksAheadOfReceivedTime = secondDifference * (i32)ticksPerSecond
+                    + (i32)(additionalTicks + GetTicksSinceLastTimerTick())
+                    - (i32)timeSyncIntitialMessage.additionalTicks;
+                this->driftEstimationTicks = ticksSinceLastSync;
+            }
+        }
+        this->ticksSinceLastSync = 0;
+
         this->syncTime = timeSyncIntitialMessage.syncTimeStamp;
         this->timeSinceSyncTime = timeSyncIntitialMessage.timeSincSyncTimeStamp;
-        this->additionalTicks = timeSyncIntitialMessage.additionalTicks;
+        SetCurrentTicks(timeSyncIntitialMessage.additionalTicks);
         this->offset = timeSyncIntitialMessage.offset;
         this->counter = timeSyncIntitialMessage.counter; //THIS is the main difference to SetTime(u32,u32,u32)!
         this->waitingForCorrection = true;
@@ -103,11 +148,13 @@ void TimeManager::SetTime(const TimeSyncInterNetwork& timeSyncInterNetwork)
     {
         this->syncTime = timeSyncInterNetwork.syncTimeStamp;
         this->timeSinceSyncTime = timeSyncInterNetwork.timeSincSyncTimeStamp;
-        this->additionalTicks = timeSyncInterNetwork.additionalTicks;
+        SetCurrentTicks(timeSyncInterNetwork.additionalTicks);
         this->offset = timeSyncInterNetwork.offset;
         this->counter++;
         this->waitingForCorrection = false;
         this->timeCorrectionReceived = false;
+        this->ticksSinceLastSync = 0;
+        this->driftEstimationTicks = 0;
 
         //We inform the connection manager so that it resends the time sync messages.
         logt("TSYNC", "Received time by inter mesh! NodeId: %u, Partner: %u", (u32)GS->node.configuration.nodeId, (u32)timeSyncInterNetwork.header.header.sender);
@@ -125,21 +172,82 @@ bool TimeManager::IsTimeCorrected() const
     return (timeCorrectionReceived || !waitingForCorrection) && IsTimeSynced();
 }
 
+i32 TimeManager::GetClockDriftPpm() const
+{
+    return clockDriftPpm;
+}
+
+i32 TimeManager::GetLastSyncErrorTicks() const
+{
+    return lastSyncErrorTicks;
+}
+
 void TimeManager::AddTicks(u32 ticks)
 {
     additionalTicks += ticks;
+    lastTimerTickRtcMs = FruityHal::GetRtcMs();
+    if (ticksSinceLastSync < UINT32_MAX - ticks) ticksSinceLastSync += ticks;
+
+    //Apply the rate correction for our estimated drift, the fractions of a tick are carried over
+    if (clockDriftPpm != 0)
+    {
+        driftCompensationRemainder += (i32)ticks * clockDriftPpm;
+        const i32 compensationTicks = driftCompensationRemainder / 1000000;
+        //As this might be called from an interrupt, we do not borrow from the seconds but wait for enough ticks
+        if (compensationTicks > 0 || (compensationTicks < 0 && additionalTicks >= (u32)-compensationTicks))
+        {
+            AdjustTicks(compensationTicks);
+            driftCompensationRemainder -= compensationTicks * 1000000;
+        }
+    }
+}
+
+void TimeManager::AdjustTicks(i32 ticks)
+{
+    additionalTicks = (u32)((i32)additionalTicks + ticks);
 }
 
 void TimeManager::AddCorrection(u32 ticks)
 {
     if (waitingForCorrection)
     {
-        AddTicks(ticks);
+        AdjustTicks((i32)ticks);
         this->waitingForCorrection = false;
         this->timeCorrectionReceived = true;
 
         logt("TSYNC", "Time synced and corrected");
+
+        if (driftEstimationTicks != 0)
+        {
+            //The received time plus the correction is the time of our partner when we received the sync
+            EstimateClockDrift((i32)ticks - ticksAheadOfReceivedTime);
+            driftEstimationTicks = 0;
+        }
+    }
+}
+
+void TimeManager::EstimateClockDrift(i32 errorTicks)
+{
+    lastSyncErrorTicks = errorTicks;
+
+    //This is the drift that remained although we already compensated our previous estimation
+    const i32 maxErrorTicks = MAX_DRIFT_ESTIMATION_ERROR_SEC * (i32)ticksPerSecond;
+    const i32 residualPpm = (errorTicks > -maxErrorTicks && errorTicks < maxErrorTicks)
+        ? errorTicks * 1000 / (i32)(driftEstimationTicks / 1000)
+        : INT32_MAX;
+    if (residualPpm > MAX_CLOCK_DRIFT_PPM || residualPpm < -MAX_CLOCK_DRIFT_PPM)
+    {
+        logt("TSYNC", "Time jumped by %d ticks, drift not estimated", errorTicks);
+        return;
     }
+
+    //Only half of the residual is taken over so that the jitter of a single sync doesn't disturb the estimation
+    i32 drift = clockDriftPpm + residualPpm / 2;
+    if (drift > MAX_CLOCK_DRIFT_PPM) drift = MAX_CLOCK_DRIFT_PPM;
+    if (drift < -MAX_CLOCK_DRIFT_PPM) drift = -MAX_CLOCK_DRIFT_PPM;
+    clockDriftPpm = drift;
+
+    logt("TSYNC", "Sync error %d ticks, clock drift now %d ppm", errorTicks, clockDriftPpm);
 }
 
 void TimeManager::ProcessTicks()
@@ -150,6 +258,15 @@ void TimeManager::ProcessTicks()
     additionalTicks -= seconds * ticksPerSecond;
 }
 
+#ifdef SIM_ENABLED
+void TimeManager::AddSimulatedClockDrift(i32 ticks)
+{
+    //The drifting crystal also drives the ticks that we count between two syncs
+    if (ticks > 0 || ticksSinceLastSync >= (u32)-ticks) ticksSinceLastSync += ticks;
+    AdjustTicks(ticks);
+}
+#endif
+
 void TimeManager::HandleUpdateTimestampMessages(ConnPacketHeader const * packetHeader, MessageLength dataLength)
 {
     if (packetHeader->messageType == MessageType::UPDATE_TIMESTAMP)
@@ -208,7 +325,7 @@ TimeSyncInitial TimeManager::GetTimeSyncIntialMessage(NodeId receiver) const
 
     retVal.syncTimeStamp = syncTime;
     retVal.timeSincSyncTimeStamp = timeSinceSyncTime;
-    retVal.additionalTicks = additionalTicks;
+    retVal.additionalTicks = additionalTicks + GetTicksSinceLastTimerTick();
     retVal.offset = offset;
     retVal.counter = counter;
     
@@ -227,7 +344,7 @@ TimeSyncInterNetwork TimeManager::GetTimeSyncInterNetworkMessage(NodeId receiver
 
     retVal.syncTimeStamp = syncTime;
     retVal.timeSincSyncTimeStamp = timeSinceSyncTime;
-    retVal.additionalTicks = additionalTicks;
+    retVal.additionalTicks = additionalTicks + GetTicksSinceLastTimerTick();
     retVal.offset = offset;
 
     return retVal;
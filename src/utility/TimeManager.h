@@ -67,6 +67,27 @@ private:
     bool waitingForCorrection = false;
     bool timeCorrectionReceived = false;
 
+    //Clock drift compensation: Each time sync that we receive through the mesh tells us how far our own clock was
+    //off since the last sync. From this, the drift of our clock is estimated and every tick that passes is corrected
+    //by it until the next sync arrives.
+    static constexpr i32 MAX_CLOCK_DRIFT_PPM = 200; //A higher drift is treated as a jump of the time and not estimated
+    static constexpr u32 MIN_DRIFT_ESTIMATION_TICKS = 60 * ticksPerSecond;
+    static constexpr i32 MAX_DRIFT_ESTIMATION_ERROR_SEC = 60; //Keeps the calculation of the drift in range
+    i32 clockDriftPpm = 0; //Positive if our clock is too slow and ticks are added
+    i32 driftCompensationRemainder = 0; //Correction in ticks * 1000000 that was not yet applied
+    u32 ticksSinceLastSync = 0;
+    u32 driftEstimationTicks = 0; //The ticks between the last two syncs, 0 if the current sync can't be used for estimation
+    i32 ticksAheadOfReceivedTime = 0; //How far our clock was ahead of the uncorrected time of the current sync
+    i32 lastSyncErrorTicks = 0;
+
+    //Our timer only adds ticks every MAIN_TIMER_TICK, the rtc is used to interpolate the ticks in between
+    u32 lastTimerTickRtcMs = 0;
+    u32 GetTicksSinceLastTimerTick() const;
+    void SetCurrentTicks(u32 ticks);
+
+    void AdjustTicks(i32 ticks);
+    void EstimateClockDrift(i32 errorTicks);
+
 public:
     TimeManager();
 
@@ -77,10 +98,15 @@ public:
     void SetTime(const TimeSyncInterNetwork& timeSyncInterNetwork);
     bool IsTimeSynced() const;
     bool IsTimeCorrected() const;
+    i32 GetClockDriftPpm() const;
+    i32 GetLastSyncErrorTicks() const; //How far our clock was off when the last time sync was received, positive if it was behind
 
     void AddTicks(u32 ticks);
     void AddCorrection(u32 ticks);
     void ProcessTicks();
+#ifdef SIM_ENABLED
+    void AddSimulatedClockDrift(i32 ticks); //Simulates a crystal that runs too fast or too slow
+#endif
     
     void HandleUpdateTimestampMessages(ConnPacketHeader const * packetHeader, MessageLength dataLength);
 
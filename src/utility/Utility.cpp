@@ -42,11 +42,17 @@ u32 Utility::GetSettingsPageBaseAddress()
 {
     const bool bootloaderAvailable = (FruityHal::GetBootloaderAddress() != 0xFFFFFFFF);
     const u32 bootloaderAddress = bootloaderAvailable ? FruityHal::GetBootloaderAddress() : FruityHal::GetCodeSize()*FruityHal::GetCodePageSize();
-    const u32 appSettingsAddress = bootloaderAddress - (RECORD_STORAGE_NUM_PAGES)* FruityHal::GetCodePageSize();
+    const u32 appSettingsAddress = bootloaderAddress - GetSettingsPageCount() * FruityHal::GetCodePageSize();
 
     return (appSettingsAddress);
 }
 
+u16 Utility::GetSettingsPageCount()
+{
+    //Can be changed in the featureset header as the settings pages are placed below the bootloader
+    return RECORD_STORAGE_NUM_PAGES;
+}
+
 RecordStorageResultCode Utility::SaveModuleSettingsToFlash(const Module* module, ModuleConfiguration* configurationPointer, const u16 configurationLength, RecordStorageEventListener* listener, u32 userType, u8* userData, u16 userDataLength)
 {
     if (module == nullptr || module->recordStorageId == RECORD_STORAGE_RECORD_ID_INVALID) return RecordStorageResultCode::INTERNAL_ERROR;
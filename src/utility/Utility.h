@@ -75,6 +75,7 @@ namespace Utility
 
     //General methods for loading settings
     u32 GetSettingsPageBaseAddress();
+    u16 GetSettingsPageCount();
     RecordStorageResultCode SaveModuleSettingsToFlash(const Module* module, ModuleConfiguration* configurationPointer, const u16 configurationLength, RecordStorageEventListener* listener, u32 userType, u8* userData, u16 userDataLength);
 #ifndef SIM_ENABLED
     SizedData GetStackWatcherAddress();